@@ -58,6 +58,25 @@ benches=(
     parse
 )
 
+# With BENCH_HERMETIC=1, the evaluation cases are recorded once with the first
+# build and every build then replays that trace, so that they all evaluate
+# exactly the same inputs without touching the store or the network. All the
+# builds must support `replay-eval-trace`. Flake fetches are not traced, so the
+# search case is left out.
+if [[ -n ${BENCH_HERMETIC:-} ]]; then
+    for k in rebuild parse; do
+        trace="bench/trace-${k}.json"
+        eval "${cases[$k]//\{BUILD\}/${builds[0]}} --option record-eval-trace $trace" > /dev/null
+        cases[$k]+=" --option replay-eval-trace $trace --read-only --store dummy://"
+    done
+    cases[rebuild-lh]="GC_INITIAL_HEAP_SIZE=10g ${cases[rebuild]}"
+    benches=(
+        rebuild
+        rebuild-lh
+        parse
+    )
+fi
+
 for k in "${benches[@]}"; do
     taskset -c 2,3 \
         chrt -f 50 \
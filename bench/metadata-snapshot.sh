@@ -0,0 +1,68 @@
+#!/usr/bin/env nix-shell
+#!nix-shell -i bash -p bash -p hyperfine
+
+# Times whole-store queries on a synthetic store of N paths (default 5000000,
+# each referring to the three paths before it) with `use-metadata-snapshot`
+# enabled and disabled: `nix path-info --all`, and `nix-store --query
+# --requisites` of the last path, whose closure is the whole store. The first
+# (warmup) run with the snapshot enabled builds it; the timed runs then only
+# check that it is up to date.
+#
+# Usage: ./bench/metadata-snapshot.sh [-n paths] result [result...]
+
+set -euo pipefail
+shopt -s inherit_errexit
+
+scriptdir=$(cd "$(dirname -- "$0")" ; pwd -P)
+cd "$scriptdir/.."
+
+paths=5000000
+if [[ "${1:-}" == -n ]]; then
+    paths="$2"
+    shift 2
+fi
+
+if [[ $# -lt 1 ]]; then
+    echo "Usage: ./bench/metadata-snapshot.sh [-n paths] result [result...]" >&2
+    exit 1
+fi
+
+export NIX_CONF_DIR='/var/empty'
+
+work="$(mktemp -d)"
+trap 'rm -rf "$work"' EXIT
+
+# The input format of `nix-store --load-db`: path, NAR hash, NAR size,
+# deriver, number of references, references.
+awk -v n="$paths" 'BEGIN {
+    for (i = 0; i < n; i++) {
+        printf "/nix/store/%032d-path-%d\n", i, i
+        printf "0000000000000000000000000000000000000000000000000000000000000000\n120\n\n"
+        refs = i < 3 ? i : 3
+        printf "%d\n", refs
+        for (j = 1; j <= refs; j++)
+            printf "/nix/store/%032d-path-%d\n", i - j, i - j
+    }
+}' > "$work/reginfo"
+
+"$1/bin/nix-store" --store "$work/store" --load-db < "$work/reginfo"
+rm "$work/reginfo"
+top=$(printf "/nix/store/%032d-path-%d" $((paths - 1)) $((paths - 1)))
+
+# Runs with the snapshot disabled delete it, so each build's first run with it
+# enabled (the warmup) builds it afresh.
+commands=()
+for build in "$@"; do
+    for snapshot in true false; do
+        commands+=("$build/bin/nix --extra-experimental-features nix-command path-info --store '$work/store' --option use-metadata-snapshot $snapshot --all > /dev/null")
+        commands+=("$build/bin/nix-store --store '$work/store' --option use-metadata-snapshot $snapshot --query --requisites $top > /dev/null")
+    done
+done
+
+hyperfine \
+    --warmup 1 --runs 10 \
+    --export-json=bench/bench-metadata-snapshot.json \
+    "${commands[@]}"
+
+echo "Benchmarks summary (from ./bench/summarize.jq bench/bench-metadata-snapshot.json)"
+bench/summarize.jq bench/bench-metadata-snapshot.json
@@ -0,0 +1,59 @@
+#!/usr/bin/env nix-shell
+#!nix-shell -i bash -p bash -p hyperfine
+
+# Compares NAR serialisation with and without `nar-read-ahead-threads` on a
+# tree of many small files and on a tree of few large files. Page caches are
+# dropped before every run (this needs root), since read-ahead is about hiding
+# cold-cache I/O latency.
+#
+# Usage: ./bench/nar-dump.sh result [threads...]
+
+set -euo pipefail
+shopt -s inherit_errexit
+
+scriptdir=$(cd "$(dirname -- "$0")" ; pwd -P)
+cd "$scriptdir/.."
+
+if [[ $# -lt 1 ]]; then
+    echo "Usage: ./bench/nar-dump.sh result [threads...]" >&2
+    exit 1
+fi
+
+build="$1"
+shift
+if [[ $# -eq 0 ]]; then
+    set -- 4 16
+fi
+threads=(0 "$@")
+
+export NIX_CONF_DIR='/var/empty'
+
+trees="$(mktemp -d)"
+trap 'rm -rf "$trees"' EXIT
+
+# ~50k files between 0 and 16KiB spread over 500 directories
+mkdir "$trees/small"
+for d in $(seq 500); do
+    mkdir "$trees/small/$d"
+    for f in $(seq 100); do
+        head -c $(( (d * f * 37) % 16384 )) /dev/urandom > "$trees/small/$d/$f"
+    done
+done
+
+# 8 files of 256MiB
+mkdir "$trees/large"
+for f in $(seq 8); do
+    head -c $(( 256 * 1024 * 1024 )) /dev/urandom > "$trees/large/$f"
+done
+
+for tree in small large; do
+    hyperfine \
+        --parameter-list THREADS "$(IFS=,; echo "${threads[*]}")" \
+        --prepare 'sync; echo 3 > /proc/sys/vm/drop_caches' \
+        --warmup 1 --runs 5 \
+        --export-json="bench/bench-nar-dump-${tree}.json" \
+        "$build/bin/nix-store --option nar-read-ahead-threads {THREADS} --dump $trees/$tree > /dev/null"
+done
+
+echo "Benchmarks summary (from ./bench/summarize.jq bench/bench-nar-dump-*.json)"
+bench/summarize.jq bench/bench-nar-dump-*.json
@@ -0,0 +1,57 @@
+#!/usr/bin/env nix-shell
+#!nix-shell -i bash -p bash -p hyperfine
+
+# Times registering a synthetic closure of N paths (default 100000), each
+# referring to the three paths before it, with `nix-store --load-db` into an
+# empty store. Pass several builds to compare them.
+#
+# Usage: ./bench/register-validity.sh [-n paths] result [result...]
+
+set -euo pipefail
+shopt -s inherit_errexit
+
+scriptdir=$(cd "$(dirname -- "$0")" ; pwd -P)
+cd "$scriptdir/.."
+
+paths=100000
+if [[ "${1:-}" == -n ]]; then
+    paths="$2"
+    shift 2
+fi
+
+if [[ $# -lt 1 ]]; then
+    echo "Usage: ./bench/register-validity.sh [-n paths] result [result...]" >&2
+    exit 1
+fi
+
+export NIX_CONF_DIR='/var/empty'
+
+work="$(mktemp -d)"
+trap 'rm -rf "$work"' EXIT
+
+# The input format of `nix-store --load-db`: path, NAR hash, NAR size,
+# deriver, number of references, references.
+awk -v n="$paths" 'BEGIN {
+    for (i = 0; i < n; i++) {
+        printf "/nix/store/%032d-path-%d\n", i, i
+        printf "0000000000000000000000000000000000000000000000000000000000000000\n120\n\n"
+        refs = i < 3 ? i : 3
+        printf "%d\n", refs
+        for (j = 1; j <= refs; j++)
+            printf "/nix/store/%032d-path-%d\n", i - j, i - j
+    }
+}' > "$work/reginfo"
+
+commands=()
+for build in "$@"; do
+    commands+=("$build/bin/nix-store --store $work/store --load-db < $work/reginfo")
+done
+
+hyperfine \
+    --prepare "rm -rf $work/store" \
+    --warmup 1 --runs 5 \
+    --export-json=bench/bench-register-validity.json \
+    "${commands[@]}"
+
+echo "Benchmarks summary (from ./bench/summarize.jq bench/bench-register-validity.json)"
+bench/summarize.jq bench/bench-register-validity.json
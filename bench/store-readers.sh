@@ -0,0 +1,65 @@
+#!/usr/bin/env nix-shell
+#!nix-shell -i bash -p bash -p hyperfine
+
+# Times concurrent queries on the local store database: `nix store verify
+# --recursive` over a synthetic store of N paths (default 100000, each
+# referring to the three paths before it) looks up every path from a pool of
+# one thread per core. The path info cache is shrunk to a single entry, so that
+# nearly every lookup goes to the database. Each build is run with WAL mode,
+# where the lookups are spread over the pool of read-only connections, and
+# without it, where they all share the one writer connection.
+#
+# Usage: ./bench/store-readers.sh [-n paths] result [result...]
+
+set -euo pipefail
+shopt -s inherit_errexit
+
+scriptdir=$(cd "$(dirname -- "$0")" ; pwd -P)
+cd "$scriptdir/.."
+
+paths=100000
+if [[ "${1:-}" == -n ]]; then
+    paths="$2"
+    shift 2
+fi
+
+if [[ $# -lt 1 ]]; then
+    echo "Usage: ./bench/store-readers.sh [-n paths] result [result...]" >&2
+    exit 1
+fi
+
+export NIX_CONF_DIR='/var/empty'
+
+work="$(mktemp -d)"
+trap 'rm -rf "$work"' EXIT
+
+# The input format of `nix-store --load-db`: path, NAR hash, NAR size,
+# deriver, number of references, references.
+awk -v n="$paths" 'BEGIN {
+    for (i = 0; i < n; i++) {
+        printf "/nix/store/%032d-path-%d\n", i, i
+        printf "0000000000000000000000000000000000000000000000000000000000000000\n120\n\n"
+        refs = i < 3 ? i : 3
+        printf "%d\n", refs
+        for (j = 1; j <= refs; j++)
+            printf "/nix/store/%032d-path-%d\n", i - j, i - j
+    }
+}' > "$work/reginfo"
+
+"$1/bin/nix-store" --store "$work/store" --load-db < "$work/reginfo"
+top=$(printf "/nix/store/%032d-path-%d" $((paths - 1)) $((paths - 1)))
+
+commands=()
+for build in "$@"; do
+    for wal in true false; do
+        commands+=("$build/bin/nix --extra-experimental-features nix-command store verify --store '$work/store?path-info-cache-size=1' --option use-sqlite-wal $wal --recursive --no-contents --no-trust $top")
+    done
+done
+
+hyperfine \
+    --warmup 1 --runs 10 \
+    --export-json=bench/bench-store-readers.json \
+    "${commands[@]}"
+
+echo "Benchmarks summary (from ./bench/summarize.jq bench/bench-store-readers.json)"
+bench/summarize.jq bench/bench-store-readers.json
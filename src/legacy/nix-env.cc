@@ -17,6 +17,8 @@
 #include "xml-writer.hh"
 #include "legacy.hh"
 #include "eval-settings.hh" // for defexpr
+#include "finally.hh"
+#include "package-index.hh"
 #include "nix-env.hh"
 
 #include <ctime>
@@ -51,6 +53,7 @@ struct InstallSourceInfo
     Path profile; /* for srcProfile */
     std::string systemFilter; /* for srcNixExprDrvs */
     Bindings * autoArgs;
+    std::map<std::string, std::string> rawAutoArgs; /* for the package index */
 };
 
 
@@ -109,8 +112,11 @@ static constexpr size_t maxAttrs = 1024;
 static void getAllExprs(EvalState & state,
     const SourcePath & path, StringSet & seen, BindingsBuilder & attrs)
 {
+    auto entries = path.readDirectory();
+    if (state.dependencies) state.dependencies->addDirectory(path, entries);
+
     StringSet namesSorted;
-    for (auto & [name, _] : path.readDirectory()) namesSorted.insert(name);
+    for (auto & [name, _] : entries) namesSorted.insert(name);
 
     for (auto & i : namesSorted) {
         /* Ignore the manifest.nix used by profiles.  This is
@@ -122,6 +128,7 @@ static void getAllExprs(EvalState & state,
 
         InputAccessor::Stat st;
         try {
+            if (state.dependencies) resolveExprPath(path2, state.dependencies.get());
             st = path2.resolveSymlinks().lstat();
         } catch (Error &) {
             continue; // ignore dangling symlinks in ~/.nix-defexpr
@@ -161,6 +168,7 @@ static void getAllExprs(EvalState & state,
 
 static void loadSourceExpr(EvalState & state, const SourcePath & path, Value & v)
 {
+    if (state.dependencies) resolveExprPath(path, state.dependencies.get());
     auto st = path.resolveSymlinks().lstat();
 
     if (isNixExpr(path, st))
@@ -205,6 +213,62 @@ static void loadDerivations(EvalState & state, const SourcePath & nixExprPath,
 }
 
 
+/* Like loadDerivations(), but answer from the package index if it is
+   still valid, and (re)build the index otherwise. */
+static void loadIndexedDerivations(Globals & globals,
+    const std::string & pathPrefix, DrvInfos & elems)
+{
+    auto & state(*globals.state);
+    auto & instSource(globals.instSource);
+
+    auto fingerprint = eval_cache::fingerprintEvaluation(state,
+        {"package-index-v1", instSource.nixExprPath->to_string(), pathPrefix, instSource.systemFilter},
+        instSource.rawAutoArgs);
+
+    if (auto entries = eval_cache::lookupPackageIndex(fingerprint)) {
+        debug("using package index with %d entries", entries->size());
+        for (auto & entry : *entries) {
+            DrvInfo elem(state, entry.attrPath, nullptr);
+            elem.setName(entry.name);
+            elem.setSystem(entry.system);
+            if (!entry.description.empty()) {
+                auto v = state.allocValue();
+                v->mkString(entry.description);
+                elem.setMeta("description", v);
+            }
+            elems.push_back(std::move(elem));
+        }
+        return;
+    }
+
+    eval_cache::checkEvalAllowed("the package index is not valid");
+
+    state.dependencies = std::make_shared<eval_cache::Dependencies>();
+    Finally resetDependencies([&]() { state.dependencies.reset(); });
+
+    loadDerivations(state, *instSource.nixExprPath,
+        instSource.systemFilter, *instSource.autoArgs, pathPrefix, elems);
+
+    std::vector<eval_cache::PackageIndexEntry> entries;
+    for (auto & i : elems) {
+        try {
+            entries.push_back({
+                .attrPath = i.attrPath,
+                .name = i.queryName(),
+                .system = i.querySystem(),
+                .description = i.queryMetaString("description"),
+            });
+        } catch (Error & e) {
+            /* Let the query itself report this, if it is relevant. */
+            debug("not storing package index: %s", e.what());
+            return;
+        }
+    }
+
+    eval_cache::writePackageIndex(fingerprint, entries, state.dependencies->get());
+}
+
+
 static NixInt getPriority(EvalState & state, DrvInfo & drv)
 {
     return drv.queryMetaInt("priority", NixInt(0));
@@ -1042,7 +1106,17 @@ static void opQuery(Globals & globals, Strings opFlags, Strings opArgs)
     if (source == sInstalled || compareVersions || printStatus)
         installedElems = queryInstalled(*globals.state, globals.profile);
 
-    if (source == sAvailable || compareVersions)
+    /* The package index only knows enough to list packages by name,
+       attribute path, system and description. */
+    bool useIndex = evalSettings.usePackageIndex
+        && source == sAvailable
+        && !compareVersions && !printStatus && !globals.prebuiltOnly
+        && !printDrvPath && !printOutPath && !printMeta
+        && !xmlOutput && !jsonOutput;
+
+    if (useIndex)
+        loadIndexedDerivations(globals, attrPath, availElems);
+    else if (source == sAvailable || compareVersions)
         loadDerivations(*globals.state, *globals.instSource.nixExprPath,
             globals.instSource.systemFilter, *globals.instSource.autoArgs,
             attrPath, availElems);
@@ -1237,19 +1311,19 @@ static void opQuery(Globals & globals, Strings opFlags, Strings opArgs)
                         else {
                             if (v->type() == nString) {
                                 attrs2["type"] = "string";
-                                attrs2["value"] = v->string.s;
+                                attrs2["value"] = v->c_str();
                                 xml.writeEmptyElement("meta", attrs2);
                             } else if (v->type() == nInt) {
                                 attrs2["type"] = "int";
-                                attrs2["value"] = fmt("%1%", v->integer);
+                                attrs2["value"] = fmt("%1%", v->integer());
                                 xml.writeEmptyElement("meta", attrs2);
                             } else if (v->type() == nFloat) {
                                 attrs2["type"] = "float";
-                                attrs2["value"] = fmt("%1%", v->fpoint);
+                                attrs2["value"] = fmt("%1%", v->fpoint());
                                 xml.writeEmptyElement("meta", attrs2);
                             } else if (v->type() == nBool) {
                                 attrs2["type"] = "bool";
-                                attrs2["value"] = v->boolean ? "true" : "false";
+                                attrs2["value"] = v->boolean() ? "true" : "false";
                                 xml.writeEmptyElement("meta", attrs2);
                             } else if (v->type() == nList) {
                                 attrs2["type"] = "strings";
@@ -1257,19 +1331,19 @@ static void opQuery(Globals & globals, Strings opFlags, Strings opArgs)
                                 for (auto elem : v->listItems()) {
                                     if (elem->type() != nString) continue;
                                     XMLAttrs attrs3;
-                                    attrs3["value"] = elem->string.s;
+                                    attrs3["value"] = elem->c_str();
                                     xml.writeEmptyElement("string", attrs3);
                                 }
                             } else if (v->type() == nAttrs) {
                                 attrs2["type"] = "strings";
                                 XMLOpenElement m(xml, "meta", attrs2);
-                                Bindings & attrs = *v->attrs;
+                                Bindings & attrs = *v->attrs();
                                 for (auto &i : attrs) {
                                     Attr & a(*attrs.find(i.name));
                                     if(a.value->type() != nString) continue;
                                     XMLAttrs attrs3;
                                     attrs3["type"] = globals.state->symbols[i.name];
-                                    attrs3["value"] = a.value->string.s;
+                                    attrs3["value"] = a.value->c_str();
                                     xml.writeEmptyElement("string", attrs3);
                             }
                             }
@@ -1531,6 +1605,7 @@ static int main_nix_env(int argc, char * * argv)
             : globals.state->rootPath(CanonPath(nixExprPath)));
 
         globals.instSource.autoArgs = myArgs.getAutoArgs(*globals.state);
+        globals.instSource.rawAutoArgs = myArgs.getRawAutoArgs();
 
         if (globals.profile == "")
             globals.profile = getEnv("NIX_PROFILE").value_or("");
@@ -124,6 +124,13 @@ struct SourceExprCommand : virtual Args, MixFlakeOptions
     ref<Installable> parseInstallable(
         ref<Store> store, const std::string & installable);
 
+    /**
+     * Return the key of the evaluation cache for `--file` or `--expr`,
+     * and start recording the dependencies of the evaluation, if
+     * `file-eval-cache` is enabled and the source can be cached.
+     */
+    std::optional<Hash> getFileEvalCacheKey(EvalState & state);
+
     virtual Strings getDefaultFlakeAttrPaths();
 
     virtual Strings getDefaultFlakeAttrPathPrefixes();
@@ -224,10 +231,11 @@ struct BuiltPathsCommand : InstallablesCommand, virtual MixOperateOnOptions
 private:
 
     bool recursive = false;
-    bool all = false;
 
 protected:
 
+    bool all = false;
+
     Realise realiseMode = Realise::Derivation;
 
 public:
@@ -20,6 +20,12 @@ struct MixEvalArgs : virtual Args, virtual MixRepair
 
     Bindings * getAutoArgs(EvalState & state);
 
+    /**
+     * The `--arg` and `--argstr` options as given on the command line.
+     */
+    const std::map<std::string, std::string> & getRawAutoArgs() const
+    { return autoArgs; }
+
     SearchPath searchPath;
 
     std::optional<std::string> evalStoreUrl;
@@ -4,6 +4,7 @@
 #include "attr-path.hh"
 #include "common-eval-args.hh"
 #include "eval.hh"
+#include "eval-cache.hh"
 #include "get-drvs.hh"
 #include "flake/flake.hh"
 
@@ -16,12 +17,14 @@ InstallableAttrPath::InstallableAttrPath(
     SourceExprCommand & cmd,
     Value * v,
     const std::string & attrPath,
-    ExtendedOutputsSpec extendedOutputsSpec)
+    ExtendedOutputsSpec extendedOutputsSpec,
+    std::optional<Hash> cacheKey)
     : InstallableValue(state)
     , cmd(cmd)
     , v(allocRootValue(v))
     , attrPath(attrPath)
     , extendedOutputsSpec(std::move(extendedOutputsSpec))
+    , cacheKey(std::move(cacheKey))
 { }
 
 std::pair<Value *, PosIdx> InstallableAttrPath::toValue(EvalState & state)
@@ -31,8 +34,82 @@ std::pair<Value *, PosIdx> InstallableAttrPath::toValue(EvalState & state)
     return {vRes, pos};
 }
 
+std::vector<ref<eval_cache::AttrCursor>>
+InstallableAttrPath::getCursors(EvalState & state)
+{
+    if (!cacheKey)
+        return InstallableValue::getCursors(state);
+
+    /* The cursor API has no list indices and doesn't auto-call
+       functions below the root, so leave such paths to the
+       evaluator. */
+    auto path = parseAttrPath(state, attrPath);
+    for (auto & name : path)
+        if (string2Int<unsigned int>(state.symbols[name]))
+            return InstallableValue::getCursors(state);
+
+    auto search = state.evalCaches.find(*cacheKey);
+    if (search == state.evalCaches.end()) {
+        auto rootLoader = [&state, &cmd = cmd, v = v]()
+        {
+            eval_cache::checkEvalAllowed("not everything is cached");
+
+            return findAlongAttrPath(state, "", *cmd.getAutoArgs(state), **v).first;
+        };
+        search = state.evalCaches.emplace(*cacheKey,
+            make_ref<eval_cache::EvalCache>(*cacheKey, state, rootLoader, state.dependencies)).first;
+    }
+
+    auto attr = search->second->getRoot()->findAlongAttrPath(path);
+    if (!attr)
+        return InstallableValue::getCursors(state);
+
+    return {ref(*attr)};
+}
+
 DerivedPathsWithInfo InstallableAttrPath::toDerivedPaths()
 {
+    if (cacheKey) {
+        auto attr = getCursor(*state);
+        if (attr->isDerivation()) {
+            auto drvPath = attr->forceDerivation();
+
+            /* Mirror DrvInfo::queryOutputs(). */
+            auto outputs = std::visit(overloaded {
+                [&](const ExtendedOutputsSpec::Default & d) -> OutputsSpec {
+                    std::set<std::string> outputsToInstall;
+                    auto aOutputSpecified = attr->maybeGetAttr(state->sOutputSpecified);
+                    if (aOutputSpecified && aOutputSpecified->getBool())
+                        outputsToInstall = { attr->getAttr("outputName")->getString() };
+                    else if (auto aMeta = attr->maybeGetAttr(state->sMeta);
+                        aMeta && aMeta->maybeGetAttr("outputsToInstall"))
+                    {
+                        for (auto & s : aMeta->getAttr("outputsToInstall")->getListOfStrings())
+                            outputsToInstall.insert(s);
+                    } else if (auto aOutputs = attr->maybeGetAttr(state->sOutputs)) {
+                        for (auto & s : aOutputs->getListOfStrings())
+                            outputsToInstall.insert(s);
+                    } else
+                        outputsToInstall.insert("out");
+                    return OutputsSpec::Names { std::move(outputsToInstall) };
+                },
+                [&](const ExtendedOutputsSpec::Explicit & e) -> OutputsSpec {
+                    return e;
+                },
+            }, extendedOutputsSpec.raw);
+
+            return {{
+                .path = DerivedPath::Built {
+                    .drvPath = makeConstantStorePathRef(std::move(drvPath)),
+                    .outputs = outputs,
+                },
+                .info = make_ref<ExtraPathInfoValue>(ExtraPathInfoValue::Value {
+                    .extendedOutputsSpec = outputs,
+                }),
+            }};
+        }
+    }
+
     auto [v, pos] = toValue(*state);
 
     if (std::optional derivedPathWithInfo = trySinglePathToDerivedPaths(
@@ -97,12 +174,14 @@ InstallableAttrPath InstallableAttrPath::parse(
     SourceExprCommand & cmd,
     Value * v,
     std::string_view prefix,
-    ExtendedOutputsSpec extendedOutputsSpec)
+    ExtendedOutputsSpec extendedOutputsSpec,
+    std::optional<Hash> cacheKey)
 {
     return {
         state, cmd, v,
         prefix == "." ? "" : std::string { prefix },
         std::move(extendedOutputsSpec),
+        std::move(cacheKey),
     };
 }
 
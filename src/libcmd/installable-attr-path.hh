@@ -18,12 +18,19 @@ class InstallableAttrPath : public InstallableValue
     std::string attrPath;
     ExtendedOutputsSpec extendedOutputsSpec;
 
+    /**
+     * Key of the evaluation cache to use, if `file-eval-cache` is
+     * enabled.
+     */
+    std::optional<Hash> cacheKey;
+
     InstallableAttrPath(
         ref<EvalState> state,
         SourceExprCommand & cmd,
         Value * v,
         const std::string & attrPath,
-        ExtendedOutputsSpec extendedOutputsSpec);
+        ExtendedOutputsSpec extendedOutputsSpec,
+        std::optional<Hash> cacheKey);
 
     std::string what() const override { return attrPath; };
 
@@ -31,6 +38,9 @@ class InstallableAttrPath : public InstallableValue
 
     DerivedPathsWithInfo toDerivedPaths() override;
 
+    std::vector<ref<eval_cache::AttrCursor>>
+    getCursors(EvalState & state) override;
+
 public:
 
     static InstallableAttrPath parse(
@@ -38,7 +48,8 @@ public:
         SourceExprCommand & cmd,
         Value * v,
         std::string_view prefix,
-        ExtendedOutputsSpec extendedOutputsSpec);
+        ExtendedOutputsSpec extendedOutputsSpec,
+        std::optional<Hash> cacheKey = std::nullopt);
 };
 
 }
@@ -17,6 +17,7 @@
 #include "eval-cache.hh"
 #include "registry.hh"
 #include "build-result.hh"
+#include "binary-cache-store.hh"
 
 
 #include <nlohmann/json.hpp>
@@ -241,7 +242,7 @@ void SourceExprCommand::completeInstallable(AddCompletions & completions, std::s
             state->autoCallFunction(*autoArgs, v1, v2);
 
             if (v2.type() == nAttrs) {
-                for (auto & i : *v2.attrs) {
+                for (auto & i : *v2.attrs()) {
                     std::string name = state->symbols[i.name];
                     if (name.find(searchWord) == 0) {
                         if (prefix_ == "")
@@ -389,6 +390,27 @@ static StorePath getDeriver(
     return *derivers.begin();
 }
 
+/* Fetch the evaluation cache for `fingerprint` from the first
+   binary cache substituter that has one. */
+static void substituteEvalCache(const Hash & fingerprint)
+{
+    if (eval_cache::haveEvalCache(fingerprint)) return;
+
+    for (auto & sub : getDefaultSubstituters()) {
+        auto binaryCache = sub.dynamic_pointer_cast<BinaryCacheStore>();
+        if (!binaryCache) continue;
+        try {
+            if (auto bundle = binaryCache->getFileContents(eval_cache::evalCacheBundleName(fingerprint))) {
+                debug("using evaluation cache from '%s'", sub->getUri());
+                eval_cache::importEvalCache(fingerprint, *bundle);
+                return;
+            }
+        } catch (Error & e) {
+            logWarning(e.info());
+        }
+    }
+}
+
 ref<eval_cache::EvalCache> openEvalCache(
     EvalState & state,
     std::shared_ptr<flake::LockedFlake> lockedFlake)
@@ -398,17 +420,14 @@ ref<eval_cache::EvalCache> openEvalCache(
         : std::nullopt;
     auto rootLoader = [&state, lockedFlake]()
         {
-            /* For testing whether the evaluation cache is
-               complete. */
-            if (getEnv("NIX_ALLOW_EVAL").value_or("1") == "0")
-                throw Error("not everything is cached, but evaluation is not allowed");
+            eval_cache::checkEvalAllowed("not everything is cached");
 
             auto vFlake = state.allocValue();
             flake::callFlake(state, *lockedFlake, *vFlake);
 
             state.forceAttrs(*vFlake, noPos, "while parsing cached flake data");
 
-            auto aOutputs = vFlake->attrs->get(state.symbols.create("outputs"));
+            auto aOutputs = vFlake->attrs()->get(state.symbols.create("outputs"));
             assert(aOutputs);
 
             return aOutputs->value;
@@ -417,6 +436,8 @@ ref<eval_cache::EvalCache> openEvalCache(
     if (fingerprint) {
         auto search = state.evalCaches.find(fingerprint.value());
         if (search == state.evalCaches.end()) {
+            if (evalSettings.substituteEvalCache)
+                substituteEvalCache(*fingerprint);
             search = state.evalCaches.emplace(fingerprint.value(), make_ref<nix::eval_cache::EvalCache>(fingerprint, state, rootLoader)).first;
         }
         return search->second;
@@ -425,6 +446,28 @@ ref<eval_cache::EvalCache> openEvalCache(
     }
 }
 
+std::optional<Hash> SourceExprCommand::getFileEvalCacheKey(EvalState & state)
+{
+    if (!evalSettings.useEvalCache || !evalSettings.useFileEvalCache)
+        return std::nullopt;
+
+    /* Standard input can't be read twice, and remote sources are
+       unlocked, so there is nothing to key those on. */
+    if (file && (*file == "-" || EvalSettings::isPseudoUrl(*file) || file->starts_with("flake:")))
+        return std::nullopt;
+
+    /* Everything that determines the result other than what the
+       evaluation reads, which is tracked in `state.dependencies`. */
+    auto fingerprint = eval_cache::fingerprintEvaluation(state,
+        {"file-eval-cache-v1", file ? "file" : "expr", file ? *file : *expr, absPath(".")},
+        getRawAutoArgs());
+
+    if (!state.dependencies)
+        state.dependencies = std::make_shared<eval_cache::Dependencies>();
+
+    return fingerprint;
+}
+
 Installables SourceExprCommand::parseInstallables(
     ref<Store> store, std::vector<std::string> ss)
 {
@@ -438,6 +481,7 @@ Installables SourceExprCommand::parseInstallables(
         if (file) evalSettings.pureEval.override(false);
 
         auto state = getEvalState();
+        auto cacheKey = getFileEvalCacheKey(*state);
         auto vFile = state->allocValue();
 
         if (file == "-") {
@@ -456,7 +500,7 @@ Installables SourceExprCommand::parseInstallables(
             result.push_back(
                 make_ref<InstallableAttrPath>(
                     InstallableAttrPath::parse(
-                        state, *this, vFile, std::move(prefix), std::move(extendedOutputsSpec))));
+                        state, *this, vFile, std::move(prefix), std::move(extendedOutputsSpec), cacheKey)));
         }
 
     } else {
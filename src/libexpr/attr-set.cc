@@ -30,7 +30,7 @@ Bindings * EvalState::allocBindings(size_t capacity)
 Value * EvalState::allocAttr(Value & vAttrs, Symbol name)
 {
     Value * v = allocValue();
-    vAttrs.attrs->push_back(Attr(name, v));
+    vAttrs.attrs()->push_back(Attr(name, v));
     return v;
 }
 
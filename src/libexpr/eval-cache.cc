@@ -3,6 +3,13 @@
 #include "eval.hh"
 #include "store-api.hh"
 #include "users.hh"
+#include "archive.hh"
+#include "compression.hh"
+#include "crypto.hh"
+#include "globals.hh"
+#include "eval-settings.hh"
+
+#include <deque>
 
 namespace nix::eval_cache {
 
@@ -17,6 +24,198 @@ create table if not exists Attributes (
 );
 )sql";
 
+static const char * dependenciesSchema = R"sql(
+create table if not exists Dependencies (
+    type        integer not null,
+    name        text not null,
+    fingerprint text not null,
+    primary key (type, name)
+);
+)sql";
+
+static std::string hashOf(std::string_view s)
+{
+    return hashString(HashType::SHA256, s).to_string(Base::Base16, false);
+}
+
+static std::string directoryFingerprint(const InputAccessor::DirEntries & entries)
+{
+    std::string s;
+    for (auto & [name, type] : entries)
+        s += fmt("%s\t%d\n", name, type ? (int) *type : -1);
+    return hashOf(s);
+}
+
+static std::string statFingerprint(std::optional<InputAccessor::Type> type)
+{
+    return type ? std::to_string((int) *type) : "none";
+}
+
+void Dependencies::add(Type type, std::string name, std::string fingerprint)
+{
+    /* Keep the first fingerprint seen for a dependency: if it changed
+       during the evaluation, the next check must fail. */
+    deps.lock()->emplace(std::make_pair(type, std::move(name)), std::move(fingerprint));
+}
+
+void Dependencies::addFile(const SourcePath & path, std::string_view contents)
+{
+    add(Type::File, path.to_string(), hashOf(contents));
+}
+
+void Dependencies::addDirectory(const SourcePath & path, const InputAccessor::DirEntries & entries)
+{
+    add(Type::Directory, path.to_string(), directoryFingerprint(entries));
+}
+
+void Dependencies::addStat(const SourcePath & path, std::optional<InputAccessor::Type> type)
+{
+    add(Type::Stat, path.to_string(), statFingerprint(type));
+}
+
+void Dependencies::addStat(const SourcePath & path)
+{
+    auto st = path.maybeLstat();
+    addStat(path, st ? std::optional(st->type) : std::nullopt);
+}
+
+void Dependencies::addLink(const SourcePath & path, std::string_view target)
+{
+    add(Type::Link, path.to_string(), std::string(target));
+}
+
+void Dependencies::addTree(const SourcePath & path)
+{
+    add(Type::Tree, path.to_string(),
+        hashPath(HashType::SHA256, path.to_string()).first.to_string(Base::Base16, false));
+}
+
+void Dependencies::addEnv(const std::string & name, const std::optional<std::string> & value)
+{
+    add(Type::Env, name, value ? "=" + *value : "");
+}
+
+void Dependencies::addVolatile(std::string_view what)
+{
+    add(Type::Volatile, std::string(what), "");
+}
+
+Dependencies::Map Dependencies::get()
+{
+    return *deps.lock();
+}
+
+bool Dependencies::isValid(Type type, const std::string & name, const std::string & fingerprint)
+{
+    try {
+        SourcePath path{CanonPath(name)};
+        switch (type) {
+        case Type::File:
+            return hashOf(path.readFile()) == fingerprint;
+        case Type::Directory:
+            return directoryFingerprint(path.readDirectory()) == fingerprint;
+        case Type::Stat: {
+            auto st = path.maybeLstat();
+            return statFingerprint(st ? std::optional(st->type) : std::nullopt) == fingerprint;
+        }
+        case Type::Link:
+            return path.readLink() == fingerprint;
+        case Type::Tree:
+            return hashPath(HashType::SHA256, name).first.to_string(Base::Base16, false) == fingerprint;
+        case Type::Env: {
+            auto value = getEnv(name);
+            return (value ? "=" + *value : "") == fingerprint;
+        }
+        case Type::Volatile:
+        default:
+            return false;
+        }
+    } catch (Error & e) {
+        debug("cannot check evaluation dependency '%s': %s", name, e.what());
+        return false;
+    }
+}
+
+void Dependencies::createTable(SQLite & db)
+{
+    db.exec(dependenciesSchema);
+}
+
+bool Dependencies::checkTable(SQLite & db, std::string_view what)
+{
+    SQLiteStmt query;
+    query.create(db, "select type, name, fingerprint from Dependencies");
+    auto use(query.use());
+    while (use.next()) {
+        auto name = use.getStr(1);
+        if (!isValid((Type) use.getInt(0), name, use.getStr(2))) {
+            debug("%s dependency '%s' has changed", what, name);
+            return false;
+        }
+    }
+    return true;
+}
+
+void Dependencies::writeTable(SQLite & db, const Map & deps)
+{
+    SQLiteStmt insert;
+    insert.create(db, "insert or ignore into Dependencies(type, name, fingerprint) values (?, ?, ?)");
+    for (auto & [key, fingerprint] : deps)
+        insert.use()
+            ((int) key.first)
+            (key.second)
+            (fingerprint).exec();
+}
+
+Hash fingerprintEvaluation(
+    EvalState & state,
+    std::initializer_list<std::string_view> inputs,
+    const std::map<std::string, std::string> & autoArgs)
+{
+    HashSink sink(HashType::SHA256);
+    for (auto & input : inputs)
+        sink << input;
+    sink << nixVersion
+         << settings.thisSystem.get()
+         << state.store->storeDir
+         << evalSettings.pureEval.get()
+         << evalSettings.restrictEval.get();
+    for (auto & [name, value] : autoArgs)
+        sink << name << value;
+    for (auto & elem : state.getSearchPath().elements)
+        sink << elem.prefix.s << elem.path.s;
+    return sink.finish().first;
+}
+
+void checkEvalAllowed(std::string_view reason)
+{
+    if (getEnv("NIX_ALLOW_EVAL").value_or("1") == "0")
+        throw Error("%s, but evaluation is not allowed", reason);
+}
+
+void createDatabaseAtomically(const Path & dbPath, std::function<void(SQLite & db)> fill)
+{
+    createDirs(dirOf(dbPath));
+
+    auto tmpPath = fmt("%s.tmp-%d", dbPath, getpid());
+    AutoDelete delTmp(tmpPath, false);
+
+    {
+        SQLite db(tmpPath);
+        db.isCache();
+        fill(db);
+    }
+
+    if (rename(tmpPath.c_str(), dbPath.c_str()) == -1)
+        throw SysError("moving '%s' to '%s'", tmpPath, dbPath);
+    delTmp.cancel();
+}
+
+static Path evalCachePath(const Hash & fingerprint)
+{
+    return getCacheDir() + "/nix/eval-cache-v5/" + fingerprint.to_string(Base::Base16, false) + ".sqlite";
+}
+
 struct AttrDb
 {
     std::atomic_bool failed{false};
@@ -37,6 +236,8 @@ struct AttrDb
 
     SymbolTable & symbols;
 
+    std::shared_ptr<Dependencies> dependencies;
+
     AttrDb(
         const Store & cfg,
         const Hash & fingerprint,
@@ -47,14 +248,13 @@ struct AttrDb
     {
         auto state(_state->lock());
 
-        Path cacheDir = getCacheDir() + "/nix/eval-cache-v5";
-        createDirs(cacheDir);
-
-        Path dbPath = cacheDir + "/" + fingerprint.to_string(Base::Base16, false) + ".sqlite";
+        Path dbPath = evalCachePath(fingerprint);
+        createDirs(dirOf(dbPath));
 
         state->db = SQLite(dbPath);
         state->db.isCache();
         state->db.exec(schema);
+        Dependencies::createTable(state->db);
 
         state->insertAttribute.create(state->db,
             "insert or replace into Attributes(parent, name, type, value) values (?, ?, ?, ?)");
@@ -75,6 +275,8 @@ struct AttrDb
     {
         try {
             auto state(_state->lock());
+            if (!failed && dependencies)
+                Dependencies::writeTable(state->db, dependencies->get());
             if (!failed)
                 state->txn->commit();
             state->txn.reset();
@@ -83,6 +285,24 @@ struct AttrDb
         }
     }
 
+    /**
+     * Start tracking `deps`, first discarding the cached attributes
+     * if any of the dependencies recorded for them has changed.
+     */
+    void useDependencies(std::shared_ptr<Dependencies> deps)
+    {
+        doSQLite([&]()
+        {
+            auto state(_state->lock());
+
+            if (!Dependencies::checkTable(state->db, "evaluation cache"))
+                state->db.exec("delete from Attributes; delete from Dependencies");
+
+            return 0;
+        });
+        dependencies = std::move(deps);
+    }
+
     template<typename F>
     AttrId doSQLite(F && fun)
     {
@@ -337,11 +557,14 @@ static std::shared_ptr<AttrDb> makeAttrDb(
 EvalCache::EvalCache(
     std::optional<std::reference_wrapper<const Hash>> useCache,
     EvalState & state,
-    RootLoader rootLoader)
+    RootLoader rootLoader,
+    std::shared_ptr<Dependencies> dependencies)
     : db(useCache ? makeAttrDb(*state.store, *useCache, state.symbols) : nullptr)
     , state(state)
     , rootLoader(rootLoader)
 {
+    if (db && dependencies)
+        db->useDependencies(std::move(dependencies));
 }
 
 Value * EvalCache::getRootValue()
@@ -386,7 +609,7 @@ Value & AttrCursor::getValue()
         if (parent) {
             auto & vParent = parent->first->getValue();
             root->state.forceAttrs(vParent, noPos, "while searching for an attribute");
-            auto attr = vParent.attrs->get(parent->second);
+            auto attr = vParent.attrs()->get(parent->second);
             if (!attr)
                 throw Error("attribute '%s' is unexpectedly missing", getAttrPathStr());
             _value = allocRootValue(attr->value);
@@ -440,16 +663,16 @@ Value & AttrCursor::forceValue()
 
     if (root->db && (!cachedValue || std::get_if<placeholder_t>(&cachedValue->second))) {
         if (v.type() == nString)
-            cachedValue = {root->db->setString(getKey(), v.string.s, v.string.context),
-                           string_t{v.string.s, {}}};
+            cachedValue = {root->db->setString(getKey(), v.c_str(), v.context()),
+                           string_t{v.c_str(), {}}};
         else if (v.type() == nPath) {
             auto path = v.path().path;
             cachedValue = {root->db->setString(getKey(), path.abs()), string_t{path.abs(), {}}};
         }
         else if (v.type() == nBool)
-            cachedValue = {root->db->setBool(getKey(), v.boolean), v.boolean};
+            cachedValue = {root->db->setBool(getKey(), v.boolean()), v.boolean()};
         else if (v.type() == nInt)
-            cachedValue = {root->db->setInt(getKey(), v.integer.value), int_t{v.integer}};
+            cachedValue = {root->db->setInt(getKey(), v.integer().value), int_t{v.integer()}};
         else if (v.type() == nAttrs)
             ; // FIXME: do something?
         else
@@ -506,7 +729,7 @@ std::shared_ptr<AttrCursor> AttrCursor::maybeGetAttr(Symbol name)
         return nullptr;
         //error<TypeError>("'%s' is not an attribute set", getAttrPathStr()).debugThrow();
 
-    auto attr = v.attrs->get(name);
+    auto attr = v.attrs()->get(name);
 
     if (!attr) {
         if (root->db) {
@@ -580,7 +803,7 @@ std::string AttrCursor::getString()
         root->state.error<TypeError>("'%s' is not a string but %s", getAttrPathStr(), v.type()).debugThrow();
     }
 
-    return v.type() == nString ? v.string.s : v.path().to_string();
+    return v.type() == nString ? v.c_str() : v.path().to_string();
 }
 
 string_t AttrCursor::getStringWithContext()
@@ -622,7 +845,7 @@ string_t AttrCursor::getStringWithContext()
     if (v.type() == nString) {
         NixStringContext context;
         copyContext(v, context);
-        return {v.string.s, std::move(context)};
+        return {v.c_str(), std::move(context)};
     } else if (v.type() == nPath) {
         return {v.path().to_string(), {}};
     } else {
@@ -649,7 +872,7 @@ bool AttrCursor::getBool()
     if (v.type() != nBool)
         root->state.error<TypeError>("'%s' is not a Boolean", getAttrPathStr()).debugThrow();
 
-    return v.boolean;
+    return v.boolean();
 }
 
 NixInt AttrCursor::getInt()
@@ -671,7 +894,7 @@ NixInt AttrCursor::getInt()
     if (v.type() != nInt)
         root->state.error<TypeError>("'%s' is not an integer", getAttrPathStr()).debugThrow();
 
-    return v.integer;
+    return v.integer();
 }
 
 std::vector<std::string> AttrCursor::getListOfStrings()
@@ -727,7 +950,7 @@ std::vector<Symbol> AttrCursor::getAttrs()
         root->state.error<TypeError>("'%s' is not an attribute set", getAttrPathStr()).debugThrow();
 
     std::vector<Symbol> attrs;
-    for (auto & attr : *getValue().attrs)
+    for (auto & attr : *getValue().attrs())
         attrs.push_back(attr.name);
     std::sort(attrs.begin(), attrs.end(), [&](Symbol a, Symbol b) {
         std::string_view sa = root->state.symbols[a], sb = root->state.symbols[b];
@@ -761,4 +984,171 @@ StorePath AttrCursor::forceDerivation()
     return drvPath;
 }
 
+
+static const std::string bundleMagic = "lix-eval-cache-bundle-1";
+
+/* The data covered by the signatures of a bundle. */
+static std::string bundleFingerprint(const Hash & fingerprint, std::string_view payload)
+{
+    return fmt("%s;%s;%s",
+        bundleMagic,
+        fingerprint.to_string(Base::Base16, false),
+        hashString(HashType::SHA256, payload).to_string(Base::Base32, true));
+}
+
+std::string evalCacheBundleName(const Hash & fingerprint)
+{
+    return "eval-cache/" + fingerprint.to_string(Base::Base16, false) + ".bundle";
+}
+
+bool haveEvalCache(const Hash & fingerprint)
+{
+    return pathExists(evalCachePath(fingerprint));
+}
+
+std::optional<std::string> exportEvalCache(const Hash & fingerprint)
+{
+    auto dbPath = evalCachePath(fingerprint);
+    if (!pathExists(dbPath)) return std::nullopt;
+
+    SQLite db(dbPath, SQLiteOpenMode::ReadOnly);
+
+    struct Row
+    {
+        std::string name;
+        int type;
+        std::optional<std::string> value, context;
+    };
+
+    std::map<AttrId, std::vector<std::pair<AttrId, Row>>> children;
+    SQLiteStmt query;
+    query.create(db,
+        "select rowid, parent, name, type, value, context from Attributes order by parent, name");
+    auto use(query.use());
+    while (use.next()) {
+        Row row {
+            .name = use.isNull(2) ? "" : use.getStr(2),
+            .type = (int) use.getInt(3),
+            .value = use.isNull(4) ? std::nullopt : std::optional(use.getStr(4)),
+            .context = use.isNull(5) ? std::nullopt : std::optional(use.getStr(5)),
+        };
+        /* Failures may be specific to the machine that evaluated
+           them, so failed attributes are exported as not evaluated
+           yet. They can't be left out, because their parent still
+           lists them. */
+        if (row.type == (int) AttrType::Failed)
+            row = Row { .name = std::move(row.name), .type = (int) AttrType::Placeholder };
+        children[use.getInt(1)].push_back({use.getInt(0), std::move(row)});
+    }
+
+    /* Number the attributes breadth-first from the root, with the
+       children of each attribute in name order, so that the same tree
+       always yields the same bundle. Names are interned. */
+    std::vector<std::pair<uint64_t, Row *>> rows;
+    std::map<std::string_view, uint64_t> names;
+    std::deque<std::pair<AttrId, uint64_t>> todo{{0, 0}};
+    while (!todo.empty()) {
+        auto [id, index] = todo.front();
+        todo.pop_front();
+        auto i = children.find(id);
+        if (i == children.end()) continue;
+        for (auto & [childId, row] : i->second) {
+            names.emplace(row.name, 0);
+            rows.push_back({index, &row});
+            todo.push_back({childId, rows.size()});
+        }
+    }
+
+    StringSink sink;
+    sink << names.size();
+    uint64_t n = 0;
+    for (auto & [name, index] : names) {
+        index = n++;
+        sink << name;
+    }
+    sink << rows.size();
+    for (auto & [parent, row] : rows) {
+        sink << parent << names[row->name] << row->type;
+        sink << (row->value ? 1 : 0) << row->value.value_or("");
+        sink << (row->context ? 1 : 0) << row->context.value_or("");
+    }
+
+    auto payload = compress("zstd", sink.s);
+
+    Strings sigs;
+    for (auto & secretKeyFile : settings.secretKeyFiles.get())
+        sigs.push_back(SecretKey(readFile(secretKeyFile)).signDetached(bundleFingerprint(fingerprint, payload)));
+
+    StringSink bundle;
+    bundle << bundleMagic << fingerprint.to_string(Base::Base16, false) << sigs << payload;
+    return std::move(bundle.s);
+}
+
+void importEvalCache(const Hash & fingerprint, std::string_view bundle)
+{
+    StringSource source(bundle);
+
+    if (readString(source) != bundleMagic)
+        throw Error("evaluation cache bundle has an unsupported format");
+    if (readString(source) != fingerprint.to_string(Base::Base16, false))
+        throw Error("evaluation cache bundle is for a different fingerprint");
+    auto sigs = readStrings<Strings>(source);
+    auto payload = readString(source);
+
+    if (settings.requireSigs) {
+        auto publicKeys = getDefaultPublicKeys();
+        auto data = bundleFingerprint(fingerprint, payload);
+        if (std::none_of(sigs.begin(), sigs.end(),
+                [&](auto & sig) { return verifyDetached(data, sig, publicKeys); }))
+            throw Error("evaluation cache bundle for '%s' lacks a valid signature",
+                fingerprint.to_string(Base::Base16, false));
+    }
+
+    auto dbPath = evalCachePath(fingerprint);
+    if (pathExists(dbPath)) return;
+
+    createDatabaseAtomically(dbPath, [&](SQLite & db) {
+        auto data = decompress("zstd", payload);
+        StringSource in(data);
+
+        std::vector<std::string> names(readNum<uint64_t>(in));
+        for (auto & name : names)
+            name = readString(in);
+
+        db.exec(schema);
+        Dependencies::createTable(db);
+        SQLiteStmt insert;
+        insert.create(db,
+            "insert into Attributes(parent, name, type, value, context) values (?, ?, ?, ?, ?)");
+
+        SQLiteTxn txn(db);
+
+        /* Maps bundle indices (starting at 1) to row IDs; index 0 is
+           the parent of the root. */
+        auto nrRows = readNum<uint64_t>(in);
+        std::vector<AttrId> ids{0};
+        ids.reserve(nrRows + 1);
+        for (uint64_t n = 0; n < nrRows; ++n) {
+            auto parent = readNum<uint64_t>(in);
+            auto name = readNum<uint64_t>(in);
+            auto type = readNum<int>(in);
+            auto hasValue = readNum<int>(in);
+            auto value = readString(in);
+            auto hasContext = readNum<int>(in);
+            auto context = readString(in);
+            if (parent >= ids.size() || name >= names.size())
+                throw Error("evaluation cache bundle is corrupt");
+            insert.use()
+                (ids[parent])
+                (names[name])
+                (type)
+                (value, hasValue)
+                (context, hasContext).exec();
+            ids.push_back(db.getLastInsertedRowId());
+        }
+
+        txn.commit();
+    });
+}
+
 }
@@ -8,11 +8,110 @@
 #include <functional>
 #include <variant>
 
+namespace nix {
+struct SQLite;
+}
+
 namespace nix::eval_cache {
 
 struct AttrDb;
 class AttrCursor;
 
+/**
+ * The external inputs read during an evaluation: files, directories,
+ * environment variables and so on. A cache that is not keyed on a
+ * locked flake records these so that it can tell on the next run
+ * whether anything it was computed from has changed.
+ */
+class Dependencies
+{
+public:
+
+    enum class Type : int {
+        /** The contents of a file. */
+        File = 0,
+        /** The entries of a directory. */
+        Directory = 1,
+        /** The type of a path, or the fact that it doesn't exist. */
+        Stat = 2,
+        /** The target of a symlink. */
+        Link = 3,
+        /** The NAR serialisation of a path copied to the store. */
+        Tree = 4,
+        /** The value of an environment variable. */
+        Env = 5,
+        /** Something that cannot be checked, such as an unlocked fetch. */
+        Volatile = 6,
+    };
+
+    typedef std::map<std::pair<Type, std::string>, std::string> Map;
+
+    void addFile(const SourcePath & path, std::string_view contents);
+    void addDirectory(const SourcePath & path, const InputAccessor::DirEntries & entries);
+    void addStat(const SourcePath & path, std::optional<InputAccessor::Type> type);
+    void addStat(const SourcePath & path);
+    void addLink(const SourcePath & path, std::string_view target);
+    void addTree(const SourcePath & path);
+    void addEnv(const std::string & name, const std::optional<std::string> & value);
+    void addVolatile(std::string_view what);
+
+    Map get();
+
+    /**
+     * Return whether a dependency recorded with `fingerprint` still
+     * has that fingerprint.
+     */
+    static bool isValid(Type type, const std::string & name, const std::string & fingerprint);
+
+    /**
+     * Create the table in which a cache database records the
+     * dependencies it was computed from.
+     */
+    static void createTable(SQLite & db);
+
+    /**
+     * Return whether every dependency recorded in `db` is still
+     * valid. `what` names the cache in debug messages.
+     */
+    static bool checkTable(SQLite & db, std::string_view what);
+
+    /**
+     * Record `deps` in `db`.
+     */
+    static void writeTable(SQLite & db, const Map & deps);
+
+private:
+
+    Sync<Map> deps;
+
+    void add(Type type, std::string name, std::string fingerprint);
+};
+
+/**
+ * Fingerprint an evaluation that is not keyed on a locked flake, from
+ * everything that determines its result other than what it reads
+ * (which `Dependencies` tracks): the `inputs` that identify what is
+ * evaluated, the automatic arguments and the evaluator settings.
+ */
+Hash fingerprintEvaluation(
+    EvalState & state,
+    std::initializer_list<std::string_view> inputs,
+    const std::map<std::string, std::string> & autoArgs);
+
+/**
+ * Throw if `NIX_ALLOW_EVAL` is set to `0`, for testing whether a cache
+ * is complete. `reason` says why the caller has to evaluate.
+ */
+void checkEvalAllowed(std::string_view reason);
+
+/**
+ * Create the cache database `dbPath` by letting `fill` populate a new
+ * database next to it and then moving that into place, so that
+ * concurrent readers never see a partial database and an existing
+ * one is replaced atomically. Nothing is moved if `fill` throws.
+ */
+void createDatabaseAtomically(const Path & dbPath, std::function<void(SQLite & db)> fill);
+
 class EvalCache : public std::enable_shared_from_this<EvalCache>
 {
     friend class AttrCursor;
@@ -27,10 +126,16 @@ class EvalCache : public std::enable_shared_from_this<EvalCache>
 
 public:
 
+    /**
+     * @param dependencies If set, the cache is only reused if the
+     * dependencies it recorded on previous runs are unchanged, and
+     * the ones recorded during this run are added to it.
+     */
     EvalCache(
         std::optional<std::reference_wrapper<const Hash>> useCache,
         EvalState & state,
-        RootLoader rootLoader);
+        RootLoader rootLoader,
+        std::shared_ptr<Dependencies> dependencies = nullptr);
 
     ref<AttrCursor> getRoot();
 };
@@ -136,4 +241,30 @@ public:
     StorePath forceDerivation();
 };
 
+/**
+ * Name under which the evaluation cache bundle for `fingerprint` is
+ * stored in a binary cache.
+ */
+std::string evalCacheBundleName(const Hash & fingerprint);
+
+/**
+ * Whether there is a local evaluation cache for `fingerprint`.
+ */
+bool haveEvalCache(const Hash & fingerprint);
+
+/**
+ * Serialise the local evaluation cache for `fingerprint` into a
+ * compact, machine-independent bundle signed with the keys in
+ * `secret-key-files`, or return std::nullopt if there is no such cache.
+ */
+std::optional<std::string> exportEvalCache(const Hash & fingerprint);
+
+/**
+ * Install a bundle created by exportEvalCache() as the local
+ * evaluation cache for `fingerprint`, unless there already is one.
+ * Unless `require-sigs` is disabled, the bundle must be signed by a
+ * trusted key.
+ */
+void importEvalCache(const Hash & fingerprint, std::string_view bundle);
+
 }
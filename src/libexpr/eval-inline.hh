@@ -69,8 +69,8 @@ Env & EvalState::allocEnv(size_t size)
 void EvalState::forceValue(Value & v, const PosIdx pos)
 {
     if (v.isThunk()) {
-        Env * env = v.thunk.env;
-        Expr & expr = *v.thunk.expr;
+        Env * env = v.thunk().env;
+        Expr & expr = *v.thunk().expr;
         try {
             v.mkBlackhole();
             //checkInterrupt();
@@ -82,7 +82,7 @@ void EvalState::forceValue(Value & v, const PosIdx pos)
         }
     }
     else if (v.isApp())
-        callFunction(*v.app.left, *v.app.right, v, pos);
+        callFunction(*v.app().left, *v.app().right, v, pos);
 }
 
 
@@ -129,6 +129,60 @@ struct EvalSettings : Config
     Setting<bool> useEvalCache{this, true, "eval-cache",
         "Whether to use the flake evaluation cache."};
 
+    Setting<bool> substituteEvalCache{this, false, "substitute-eval-cache",
+        R"(
+          Whether to look for the evaluation cache of a flake in the
+          substituters if there is no local one. Such caches are published
+          with `nix flake archive --include-eval-cache`, and must be signed by a key
+          in `trusted-public-keys` unless `require-sigs` is disabled.
+        )"};
+
+    Setting<bool> useFileEvalCache{this, false, "file-eval-cache",
+        R"(
+          Whether to also cache the evaluation of installables given with
+          `--file` or `--expr`. The cache records the files, directories and
+          environment variables read during evaluation, and is discarded
+          when any of them changes.
+
+          Evaluations that fetch unlocked inputs or use `builtins.currentTime`
+          are not reliably cacheable; unlocked fetches discard the cache on
+          the next run, but the current time is not tracked.
+        )"};
+
+    Setting<bool> usePackageIndex{this, false, "package-index",
+        R"(
+          Whether `nix-env --query --available` may answer from a cached
+          index of the available packages instead of evaluating them. The
+          index is only used for queries that print names, attribute paths,
+          systems and descriptions, and is discarded when any file,
+          directory or environment variable read while building it changes.
+        )"};
+
+    PathsSetting<std::optional<Path>> recordEvalTrace{this, std::nullopt, "record-eval-trace",
+        R"(
+          If set, record the external inputs of the evaluation in a trace
+          file at this path: the files, directories and symlinks that are
+          read, the environment variables read by `builtins.getEnv`, and
+          the results of fetches. The trace is written when the evaluation
+          ends, and can be replayed with
+          [`replay-eval-trace`](#conf-replay-eval-trace).
+        )"};
+
+    PathsSetting<std::optional<Path>> replayEvalTrace{this, std::nullopt, "replay-eval-trace",
+        R"(
+          If set, serve the external inputs of the evaluation from the
+          trace file at this path, which was written by
+          [`record-eval-trace`](#conf-record-eval-trace), instead of
+          reading them from the filesystem, the environment or the
+          network. Evaluation fails if it needs an input that is not in
+          the trace.
+
+          This makes it possible to run the same evaluation again on
+          another machine or with another version of Lix, for instance to
+          compare their performance. Combine it with `--read-only` and
+          `--store dummy://` to also avoid writing to the store.
+        )"};
+
     Setting<bool> ignoreExceptionsDuringTry{this, false, "ignore-try",
         R"(
           If set to true, ignore exceptions inside 'tryEval' calls when evaluating nix expressions in
@@ -0,0 +1,242 @@
+#include "eval-trace.hh"
+#include "environment-variables.hh"
+#include "archive.hh"
+#include "file-system.hh"
+#include "logging.hh"
+#include "signals.hh"
+#include "strings.hh"
+
+namespace nix {
+
+static const unsigned int traceVersion = 2;
+
+static std::string_view typeToString(InputAccessor::Type type)
+{
+    switch (type) {
+    case InputAccessor::tRegular: return "regular";
+    case InputAccessor::tSymlink: return "symlink";
+    case InputAccessor::tDirectory: return "directory";
+    default: return "unknown";
+    }
+}
+
+static InputAccessor::Type typeFromString(std::string_view s)
+{
+    return
+        s == "regular" ? InputAccessor::tRegular :
+        s == "symlink" ? InputAccessor::tSymlink :
+        s == "directory" ? InputAccessor::tDirectory :
+        InputAccessor::tMisc;
+}
+
+EvalTrace::EvalTrace(Mode mode, Path path)
+    : mode(mode)
+    , path(std::move(path))
+{
+}
+
+ref<EvalTrace> EvalTrace::record(const Path & path)
+{
+    return ref<EvalTrace>(new EvalTrace(Mode::Record, absPath(path)));
+}
+
+ref<EvalTrace> EvalTrace::replay(const Path & path)
+{
+    auto trace = ref<EvalTrace>(new EvalTrace(Mode::Replay, absPath(path)));
+
+    auto json = nlohmann::json::parse(nix::readFile(trace->path));
+    if (json.value("version", 0) != traceVersion)
+        throw Error("evaluation trace '%s' has an unsupported version", trace->path);
+
+    auto inputs(trace->inputs_.lock());
+
+    for (auto & [name, contents] : json["files"].items())
+        inputs->files.emplace(name, base64Decode(contents.get<std::string>()));
+
+    for (auto & [name, stat] : json["stats"].items())
+        inputs->stats.emplace(name, stat.is_null()
+            ? std::nullopt
+            : std::optional(InputAccessor::Stat {
+                .type = typeFromString(stat["type"].get<std::string>()),
+                .isExecutable = stat["executable"].get<bool>(),
+            }));
+
+    for (auto & [name, entries] : json["directories"].items()) {
+        auto & res = inputs->directories[name];
+        for (auto & [entry, type] : entries.items())
+            res.emplace(entry, type.is_null()
+                ? std::nullopt
+                : std::optional(typeFromString(type.get<std::string>())));
+    }
+
+    for (auto & [name, target] : json["links"].items())
+        inputs->links.emplace(name, target.get<std::string>());
+
+    for (auto & [name, value] : json["env"].items())
+        inputs->env.emplace(name, value.is_null()
+            ? std::nullopt
+            : std::optional(value.get<std::string>()));
+
+    for (auto & [key, result] : json["fetches"].items())
+        inputs->fetches.emplace(key, result);
+
+    return trace;
+}
+
+void EvalTrace::save()
+{
+    assert(mode == Mode::Record);
+
+    auto inputs(inputs_.lock());
+
+    auto json = nlohmann::json::object();
+    json["version"] = traceVersion;
+
+    auto & files = json["files"] = nlohmann::json::object();
+    for (auto & [name, contents] : inputs->files)
+        files[name] = base64Encode(contents);
+
+    auto & stats = json["stats"] = nlohmann::json::object();
+    for (auto & [name, stat] : inputs->stats)
+        stats[name] = stat
+            ? nlohmann::json {
+                {"type", typeToString(stat->type)},
+                {"executable", stat->isExecutable},
+            }
+            : nlohmann::json();
+
+    auto & directories = json["directories"] = nlohmann::json::object();
+    for (auto & [name, entries] : inputs->directories) {
+        auto & res = directories[name] = nlohmann::json::object();
+        for (auto & [entry, type] : entries)
+            res[entry] = type ? nlohmann::json(typeToString(*type)) : nlohmann::json();
+    }
+
+    json["links"] = inputs->links;
+
+    auto & env = json["env"] = nlohmann::json::object();
+    for (auto & [name, value] : inputs->env)
+        env[name] = value ? nlohmann::json(*value) : nlohmann::json();
+
+    json["fetches"] = inputs->fetches;
+
+    writeFile(path, json.dump());
+    debug("wrote evaluation trace to '%s'", path);
+}
+
+template<typename T>
+T EvalTrace::lookup(
+    std::map<std::string, T> Inputs::* map,
+    std::string_view what,
+    const std::string & key,
+    std::function<T()> compute)
+{
+    if (mode == Mode::Replay) {
+        auto inputs(inputs_.lock());
+        auto & m = (*inputs).*map;
+        auto i = m.find(key);
+        if (i == m.end())
+            throw Error("%s '%s' is not in the evaluation trace '%s'", what, key, path);
+        return i->second;
+    }
+
+    auto res = compute();
+    ((*inputs_.lock()).*map).insert_or_assign(key, res);
+    return res;
+}
+
+std::optional<std::string> EvalTrace::getEnv(const std::string & name)
+{
+    return lookup<std::optional<std::string>>(&Inputs::env, "environment variable", name,
+        [&]() { return nix::getEnv(name); });
+}
+
+nlohmann::json EvalTrace::fetch(const std::string & key, std::function<nlohmann::json()> fetch)
+{
+    return lookup<nlohmann::json>(&Inputs::fetches, "fetch", key, fetch);
+}
+
+std::string EvalTrace::readFile(const CanonPath & path)
+{
+    return lookup<std::string>(&Inputs::files, "file", path.abs(),
+        [&]() { return SourceAccessHook::readFile(path); });
+}
+
+std::optional<InputAccessor::Stat> EvalTrace::maybeLstat(const CanonPath & path)
+{
+    return lookup<std::optional<InputAccessor::Stat>>(&Inputs::stats, "status of", path.abs(),
+        [&]() { return SourceAccessHook::maybeLstat(path); });
+}
+
+InputAccessor::DirEntries EvalTrace::readDirectory(const CanonPath & path)
+{
+    return lookup<InputAccessor::DirEntries>(&Inputs::directories, "directory", path.abs(),
+        [&]() { return SourceAccessHook::readDirectory(path); });
+}
+
+std::string EvalTrace::readLink(const CanonPath & path)
+{
+    return lookup<std::string>(&Inputs::links, "symlink", path.abs(),
+        [&]() { return SourceAccessHook::readLink(path); });
+}
+
+WireFormatGenerator EvalTrace::dumpTraced(const CanonPath & path, PathFilter & filter)
+{
+    checkInterrupt();
+
+    auto st = maybeLstat(path);
+    if (!st)
+        throw SysError(ENOENT, "getting status of '%s'", path.abs());
+
+    co_yield "(";
+
+    switch (st->type) {
+    case InputAccessor::tRegular:
+        co_yield "type";
+        co_yield "regular";
+        if (st->isExecutable) {
+            co_yield "executable";
+            co_yield "";
+        }
+        co_yield "contents";
+        co_yield readFile(path);
+        break;
+
+    case InputAccessor::tDirectory:
+        co_yield "type";
+        co_yield "directory";
+        /* Unlike nix::dumpPath(), this doesn't undo the case hack of
+           restorePath(), which source trees don't use. */
+        for (auto & [name, type] : readDirectory(path)) {
+            auto child = path + name;
+            if (!filter(child.abs())) continue;
+            co_yield "entry";
+            co_yield "(";
+            co_yield "name";
+            co_yield name;
+            co_yield "node";
+            co_yield dumpTraced(child, filter);
+            co_yield ")";
+        }
+        break;
+
+    case InputAccessor::tSymlink:
+        co_yield "type";
+        co_yield "symlink";
+        co_yield "target";
+        co_yield readLink(path);
+        break;
+
+    default:
+        throw Error("file '%1%' has an unsupported type", path.abs());
+    }
+
+    co_yield ")";
+}
+
+void EvalTrace::dumpPath(const CanonPath & path, Sink & sink, PathFilter & filter)
+{
+    sink << narVersionMagic1 << dumpTraced(path, filter);
+}
+
+}
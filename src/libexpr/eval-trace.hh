@@ -0,0 +1,108 @@
+#pragma once
+///@file
+
+#include "serialise.hh"
+#include "source-path.hh"
+#include "sync.hh"
+#include "ref.hh"
+
+#include <functional>
+#include <nlohmann/json.hpp>
+
+namespace nix {
+
+/**
+ * A record of the external inputs consumed by an evaluation: the
+ * files, directories and symlinks it looked at, the environment
+ * variables it read and the results of the fetches it did. A trace
+ * recorded once can be replayed later to run exactly the same
+ * evaluation without access to the original files or the network,
+ * e.g. to compare the performance of two versions of the evaluator.
+ *
+ * While installed as the `SourceAccessHook`, a recording trace
+ * forwards all filesystem accesses to the real filesystem and keeps
+ * what they returned; a replaying trace serves them from the trace,
+ * and fails on accesses that were not recorded.
+ */
+class EvalTrace : public SourceAccessHook
+{
+public:
+
+    enum class Mode { Record, Replay };
+
+    const Mode mode;
+
+    /**
+     * Start recording a trace that `save()` writes to `path`.
+     */
+    static ref<EvalTrace> record(const Path & path);
+
+    /**
+     * Load the trace recorded in `path` for replaying it.
+     */
+    static ref<EvalTrace> replay(const Path & path);
+
+    /**
+     * Write the inputs recorded so far to the trace file.
+     */
+    void save();
+
+    /**
+     * Return the value of an environment variable, as of the time the
+     * trace was recorded.
+     */
+    std::optional<std::string> getEnv(const std::string & name);
+
+    /**
+     * Do the fetch identified by `key` by calling `fetch`, or when
+     * replaying, return what `fetch` returned while recording.
+     */
+    nlohmann::json fetch(const std::string & key, std::function<nlohmann::json()> fetch);
+
+    std::string readFile(const CanonPath & path) override;
+
+    std::optional<InputAccessor::Stat> maybeLstat(const CanonPath & path) override;
+
+    InputAccessor::DirEntries readDirectory(const CanonPath & path) override;
+
+    std::string readLink(const CanonPath & path) override;
+
+    /**
+     * Serialise `path` as a NAR, built from the traced accesses above,
+     * so that `filter` runs again when replaying.
+     */
+    void dumpPath(const CanonPath & path, Sink & sink, PathFilter & filter) override;
+
+private:
+
+    EvalTrace(Mode mode, Path path);
+
+    Path path;
+
+    struct Inputs
+    {
+        std::map<std::string, std::string> files;
+        std::map<std::string, std::optional<InputAccessor::Stat>> stats;
+        std::map<std::string, InputAccessor::DirEntries> directories;
+        std::map<std::string, std::string> links;
+        std::map<std::string, std::optional<std::string>> env;
+        std::map<std::string, nlohmann::json> fetches;
+    };
+
+    Sync<Inputs> inputs_;
+
+    WireFormatGenerator dumpTraced(const CanonPath & path, PathFilter & filter);
+
+    /**
+     * Return the entry for `key` in `map`, calling
+     * `compute` to fill it in when recording.
+     */
+    template<typename T>
+    T lookup(
+        std::map<std::string, T> Inputs::* map,
+        std::string_view what,
+        const std::string & key,
+        std::function<T()> compute);
+};
+
+}
@@ -1,5 +1,7 @@
 #include "eval.hh"
+#include "eval-cache.hh"
 #include "eval-settings.hh"
+#include "eval-trace.hh"
 #include "hash.hh"
 #include "primops.hh"
 #include "print-options.hh"
@@ -74,7 +76,7 @@ std::string printValue(EvalState & state, Value & v)
 const Value * getPrimOp(const Value &v) {
     const Value * primOp = &v;
     while (primOp->isPrimOpApp()) {
-        primOp = primOp->primOpApp.left;
+        primOp = primOp->primOpApp().left;
     }
     assert(primOp->isPrimOp());
     return primOp;
@@ -105,13 +107,13 @@ std::string showType(const Value & v)
     // Allow selecting a subset of enum values
     #pragma GCC diagnostic push
     #pragma GCC diagnostic ignored "-Wswitch-enum"
-    switch (v.internalType) {
-        case tString: return v.string.context ? "a string with context" : "a string";
+    switch (v.internalType()) {
+        case tString: return v.context() ? "a string with context" : "a string";
         case tPrimOp:
-            return fmt("the built-in function '%s'", std::string(v.primOp->name));
+            return fmt("the built-in function '%s'", std::string(v.primOp()->name));
         case tPrimOpApp:
-            return fmt("the partially applied built-in function '%s'", std::string(getPrimOp(v)->primOp->name));
-        case tExternal: return v.external->showType();
+            return fmt("the partially applied built-in function '%s'", std::string(getPrimOp(v)->primOp()->name));
+        case tExternal: return v.external()->showType();
         case tThunk: return v.isBlackhole() ? "a black hole" : "a thunk";
         case tApp: return "a function application";
     default:
@@ -140,7 +142,7 @@ static Symbol getName(const AttrName & name, EvalState & state, Env & env)
         Value nameValue;
         name.expr->eval(state, env, nameValue);
         state.forceStringNoCtx(nameValue, name.expr->getPos(), "while evaluating an attribute name");
-        return state.symbols.create(nameValue.string.s);
+        return state.symbols.create(nameValue.c_str());
     }
 }
 
@@ -163,6 +165,12 @@ void initGC()
 
     GC_INIT();
 
+    /* Values keep the type tag in the low bits of pointers, see
+       `Value::PrimaryTag`, so the collector must accept pointers that
+       are off by as much. */
+    for (size_t i = 1; i < alignof(uintptr_t); ++i)
+        GC_register_displacement(i);
+
     GC_set_oom_fn(oomHandler);
 
     /* Set the initial heap size to something fairly big (25% of
@@ -272,9 +280,23 @@ EvalState::EvalState(
 
     assert(gcInitialised);
 
+    if (auto path = evalSettings.replayEvalTrace.get())
+        trace = EvalTrace::replay(*path);
+    else if (auto path = evalSettings.recordEvalTrace.get())
+        trace = EvalTrace::record(*path);
+    if (trace) {
+        /* The hook is global, so it can't serve two traces at once. */
+        if (hasSourceAccessHook())
+            throw Error("only one evaluation at a time can record or replay an evaluation trace");
+        setSourceAccessHook(trace);
+    }
+
     static_assert(sizeof(Env) <= 16, "environment must be <= 16 bytes");
 
     vEmptyList.mkList(0);
+    vNull.mkNull();
+    vTrue.mkBool(true);
+    vFalse.mkBool(false);
 
     /* Initialise the Nix expression search path. */
     if (!evalSettings.pureEval) {
@@ -313,6 +335,15 @@ EvalState::EvalState(
 
 EvalState::~EvalState()
 {
+    if (trace) {
+        setSourceAccessHook(nullptr);
+        if (trace->mode == EvalTrace::Mode::Record)
+            try {
+                trace->save();
+            } catch (...) {
+                ignoreExceptionInDestructor();
+            }
+    }
 }
 
 
@@ -450,7 +481,7 @@ void EvalState::addConstant(const std::string & name, Value * v, Constant info)
         /* Install value the base environment. */
         staticBaseEnv->vars.emplace_back(symbols.create(name), baseEnvDispl);
         baseEnv.values[baseEnvDispl++] = v;
-        baseEnv.values[0]->attrs->push_back(Attr(symbols.create(name2), v));
+        baseEnv.values[0]->attrs()->push_back(Attr(symbols.create(name2), v));
     }
 }
 
@@ -493,14 +524,14 @@ Value * EvalState::addPrimOp(PrimOp && primOp)
     v->mkPrimOp(new PrimOp(primOp));
     staticBaseEnv->vars.emplace_back(envName, baseEnvDispl);
     baseEnv.values[baseEnvDispl++] = v;
-    baseEnv.values[0]->attrs->push_back(Attr(symbols.create(primOp.name), v));
+    baseEnv.values[0]->attrs()->push_back(Attr(symbols.create(primOp.name), v));
     return v;
 }
 
 
 Value & EvalState::getBuiltin(const std::string & name)
 {
-    return *baseEnv.values[0]->attrs->find(symbols.create(name))->value;
+    return *baseEnv.values[0]->attrs()->find(symbols.create(name))->value;
 }
 
 
@@ -508,12 +539,12 @@ std::optional<EvalState::Doc> EvalState::getDoc(Value & v)
 {
     if (v.isPrimOp()) {
         auto v2 = &v;
-        if (auto * doc = v2->primOp->doc)
+        if (auto * doc = v2->primOp()->doc)
             return Doc {
                 .pos = {},
-                .name = v2->primOp->name,
-                .arity = v2->primOp->arity,
-                .args = v2->primOp->args,
+                .name = v2->primOp()->name,
+                .arity = v2->primOp()->arity,
+                .args = v2->primOp()->args,
                 .doc = doc,
             };
     }
@@ -545,7 +576,7 @@ void printWithBindings(const SymbolTable & st, const Env & env)
 {
     if (!env.values[0]->isThunk()) {
         std::set<std::string_view> bindings;
-        for (const auto & attr : *env.values[0]->attrs)
+        for (const auto & attr : *env.values[0]->attrs())
             bindings.emplace(st[attr.name]);
 
         std::cout << "with: ";
@@ -602,8 +633,8 @@ void mapStaticEnvBindings(const SymbolTable & st, const StaticEnv & se, const En
 
         if (se.isWith && !env.values[0]->isThunk()) {
             // add 'with' bindings.
-            Bindings::iterator j = env.values[0]->attrs->begin();
-            while (j != env.values[0]->attrs->end()) {
+            Bindings::iterator j = env.values[0]->attrs()->begin();
+            while (j != env.values[0]->attrs()->end()) {
                 vm[st[j->name]] = j->value;
                 ++j;
             }
@@ -734,8 +765,8 @@ inline Value * EvalState::lookupVar(Env * env, const ExprVar & var, bool noEval)
     auto * fromWith = var.fromWith;
     while (1) {
         forceAttrs(*env->values[0], fromWith->pos, "while evaluating the first subexpression of a with expression");
-        Bindings::iterator j = env->values[0]->attrs->find(var.name);
-        if (j != env->values[0]->attrs->end()) {
+        Bindings::iterator j = env->values[0]->attrs()->find(var.name);
+        if (j != env->values[0]->attrs()->end()) {
             if (countCalls) attrSelects[j->pos]++;
             return j->value;
         }
@@ -748,9 +779,12 @@ inline Value * EvalState::lookupVar(Env * env, const ExprVar & var, bool noEval)
 
 void EvalState::mkList(Value & v, size_t size)
 {
-    v.mkList(size);
-    if (size > 2)
-        v.bigList.elems = gcAllocType<Value *>(size);
+    if (size > std::numeric_limits<uint32_t>::max())
+        error<EvalError>("cannot create a list of %d elements", size).debugThrow();
+    if (size == 1)
+        v.mkList(size);
+    else
+        v.mkList(size ? gcAllocType<Value *>(size) : nullptr, size);
     nrListElems += size;
 }
 
@@ -870,6 +904,26 @@ Value * Expr::maybeThunk(EvalState & state, Env & env)
 }
 
 
+Value * Expr::maybeThunkStrict(EvalState & state, Env & env)
+{
+    if (!isTotal()) return maybeThunk(state, env);
+    state.nrEager++;
+    Value * v = state.allocValue();
+    eval(state, env, *v);
+    return v;
+}
+
+
+Value * ExprLambda::maybeThunk(EvalState & state, Env & env)
+{
+    /* A closure is no bigger than the thunk that would produce it. */
+    state.nrEager++;
+    Value * v = state.allocValue();
+    v->mkLambda(&env, this);
+    return v;
+}
+
+
 Value * ExprVar::maybeThunk(EvalState & state, Env & env)
 {
     Value * v = state.lookupVar(&env, *this, true);
@@ -915,30 +969,52 @@ void EvalState::evalFile(const SourcePath & path_, Value & v, bool mustBeTrivial
         return;
     }
 
-    auto resolvedPath = resolveExprPath(path);
+    auto resolvedPath = resolveExprPath(path, dependencies.get());
     if ((i = fileEvalCache.find(resolvedPath)) != fileEvalCache.end()) {
         v = i->second;
         return;
     }
 
     debug("evaluating file '%1%'", resolvedPath);
-    Expr * e = nullptr;
+    Expr * e = &parseFileCached(checkSourcePath(resolvedPath));
+
+    cacheFile(path, resolvedPath, e, v, mustBeTrivial);
+}
 
-    auto j = fileParseCache.find(resolvedPath);
-    if (j != fileParseCache.end())
-        e = j->second;
 
-    if (!e)
-        e = &parseExprFromFile(checkSourcePath(resolvedPath));
+Expr & EvalState::parseFileCached(const SourcePath & path)
+{
+    auto i = fileParseCache.find(path);
+    if (i != fileParseCache.end() && i->second.checked)
+        return *i->second.e;
 
-    cacheFile(path, resolvedPath, e, v, mustBeTrivial);
+    auto buffer = path.readFile();
+    if (dependencies) dependencies->addFile(path, buffer);
+    auto sourceHash = hashString(HashType::SHA256, buffer);
+
+    /* The file was parsed before the last resetFileCache(). Its parse
+       tree only depends on the file contents, so it can be reused as
+       long as those haven't changed. */
+    if (i != fileParseCache.end() && i->second.sourceHash == sourceHash) {
+        debug("reusing parse tree of unchanged file '%1%'", path);
+        nrParsesReused++;
+        i->second.checked = true;
+        return *i->second.e;
+    }
+
+    auto e = parseExprFromBuffer(std::move(buffer), path, staticBaseEnv);
+    fileParseCache.insert_or_assign(path, ParsedFile{.e = e, .sourceHash = sourceHash, .checked = true});
+    return *e;
 }
 
 
 void EvalState::resetFileCache()
 {
     fileEvalCache.clear();
-    fileParseCache.clear();
+    /* Keep the parse trees, but check that the files they came from
+       are unchanged before using them again. */
+    for (auto & [_, parsed] : fileParseCache)
+        parsed.checked = false;
 }
 
 
@@ -949,8 +1025,6 @@ void EvalState::cacheFile(
     Value & v,
     bool mustBeTrivial)
 {
-    fileParseCache[resolvedPath] = e;
-
     try {
         auto dts = debugRepl
             ? makeDebugTraceStacker(
@@ -994,7 +1068,7 @@ inline bool EvalState::evalBool(Env & env, Expr & e, const PosIdx pos, std::stri
                  showType(v),
                  ValuePrinter(*this, v, errorPrintOptions)
              ).atPos(pos).withFrame(env, e).debugThrow();
-        return v.boolean;
+        return v.boolean();
     } catch (Error & e) {
         e.addTrace(positions[pos], errorCtx);
         throw;
@@ -1088,7 +1162,7 @@ void ExprAttrs::eval(EvalState & state, Env & env, Value & v)
             } else
                 vAttr = i.second.e->maybeThunk(state, *i.second.chooseByKind(&env2, &env, inheritEnv));
             env2.values[displ++] = vAttr;
-            v.attrs->push_back(Attr(i.first, vAttr, i.second.pos));
+            v.attrs()->push_back(Attr(i.first, vAttr, i.second.pos));
         }
 
         /* If the rec contains an attribute called `__overrides', then
@@ -1100,12 +1174,12 @@ void ExprAttrs::eval(EvalState & state, Env & env, Value & v)
            been substituted into the bodies of the other attributes.
            Hence we need __overrides.) */
         if (hasOverrides) {
-            Value * vOverrides = (*v.attrs)[overrides->second.displ].value;
+            Value * vOverrides = (*v.attrs())[overrides->second.displ].value;
             state.forceAttrs(*vOverrides, [&]() { return vOverrides->determinePos(noPos); }, "while evaluating the `__overrides` attribute");
-            Bindings * newBnds = state.allocBindings(v.attrs->capacity() + vOverrides->attrs->size());
-            for (auto & i : *v.attrs)
+            Bindings * newBnds = state.allocBindings(v.attrs()->capacity() + vOverrides->attrs()->size());
+            for (auto & i : *v.attrs())
                 newBnds->push_back(i);
-            for (auto & i : *vOverrides->attrs) {
+            for (auto & i : *vOverrides->attrs()) {
                 AttrDefs::iterator j = attrs.find(i.name);
                 if (j != attrs.end()) {
                     (*newBnds)[j->second.displ] = i;
@@ -1114,14 +1188,14 @@ void ExprAttrs::eval(EvalState & state, Env & env, Value & v)
                     newBnds->push_back(i);
             }
             newBnds->sort();
-            v.attrs = newBnds;
+            v.mkAttrs(newBnds);
         }
     }
 
     else {
         Env * inheritEnv = inheritFromExprs ? buildInheritFromEnv(state, env) : nullptr;
         for (auto & i : attrs) {
-            v.attrs->push_back(Attr(
+            v.attrs()->push_back(Attr(
                     i.first,
                     i.second.e->maybeThunk(state, *i.second.chooseByKind(&env, &env, inheritEnv)),
                     i.second.pos));
@@ -1136,18 +1210,18 @@ void ExprAttrs::eval(EvalState & state, Env & env, Value & v)
         if (nameVal.type() == nNull)
             continue;
         state.forceStringNoCtx(nameVal, i.pos, "while evaluating the name of a dynamic attribute");
-        auto nameSym = state.symbols.create(nameVal.string.s);
-        Bindings::iterator j = v.attrs->find(nameSym);
-        if (j != v.attrs->end())
+        auto nameSym = state.symbols.create(nameVal.c_str());
+        Bindings::iterator j = v.attrs()->find(nameSym);
+        if (j != v.attrs()->end())
             state.error<EvalError>("dynamic attribute '%1%' already defined at %2%", state.symbols[nameSym], state.positions[j->pos]).atPos(i.pos).withFrame(env, *this).debugThrow();
 
         i.valueExpr->setName(nameSym);
         /* Keep sorted order so find can catch duplicates */
-        v.attrs->push_back(Attr(nameSym, i.valueExpr->maybeThunk(state, *dynamicEnv), i.pos));
-        v.attrs->sort(); // FIXME: inefficient
+        v.attrs()->push_back(Attr(nameSym, i.valueExpr->maybeThunk(state, *dynamicEnv), i.pos));
+        v.attrs()->sort(); // FIXME: inefficient
     }
 
-    v.attrs->pos = pos;
+    v.attrs()->pos = pos;
 }
 
 
@@ -1165,9 +1239,10 @@ void ExprLet::eval(EvalState & state, Env & env, Value & v)
        environment. */
     Displacement displ = 0;
     for (auto & i : attrs->attrs) {
-        env2.values[displ++] = i.second.e->maybeThunk(
-            state,
-            *i.second.chooseByKind(&env2, &env, inheritEnv));
+        auto & env3 = *i.second.chooseByKind(&env2, &env, inheritEnv);
+        env2.values[displ++] = i.second.strict
+            ? i.second.e->maybeThunkStrict(state, env3)
+            : i.second.e->maybeThunk(state, env3);
     }
 
     auto dts = state.debugRepl
@@ -1327,9 +1402,29 @@ void ExprSelect::eval(EvalState & state, Env & env, Value & v)
             }
 
             // Now that we know this is actually an attrset, try to find an attr
-            // with the selected name.
-            Bindings::iterator attrIt = vCurrent->attrs->find(name);
-            if (attrIt == vCurrent->attrs->end()) {
+            // with the selected name, first at the slots it was last found at.
+            Bindings & attrs = *vCurrent->attrs();
+            Bindings::iterator attrIt = attrs.end();
+            auto cache = partIdx < slotCache.size() ? &slotCache[partIdx] : nullptr;
+            if (cache) {
+                for (auto slot : cache->slots)
+                    if (slot < attrs.size() && attrs[slot].name == name) {
+                        attrIt = &attrs[slot];
+                        break;
+                    }
+                if (attrIt != attrs.end())
+                    state.nrSelectCacheHits++;
+                else
+                    state.nrSelectCacheMisses++;
+            }
+            if (attrIt == attrs.end()) {
+                attrIt = attrs.find(name);
+                if (cache && attrIt != attrs.end()) {
+                    cache->slots[1] = cache->slots[0];
+                    cache->slots[0] = attrIt - attrs.begin();
+                }
+            }
+            if (attrIt == attrs.end()) {
 
                 // If we have an `or` provided default, then we'll use that.
                 if (def != nullptr) {
@@ -1339,7 +1434,7 @@ void ExprSelect::eval(EvalState & state, Env & env, Value & v)
 
                 // Otherwise, missing attr error.
                 std::set<std::string> allAttrNames;
-                for (auto const & attr : *vCurrent->attrs) {
+                for (auto const & attr : *vCurrent->attrs()) {
                     allAttrNames.insert(state.symbols[attr.name]);
                 }
                 auto suggestions = Suggestions::bestMatches(allAttrNames, state.symbols[name]);
@@ -1386,7 +1481,7 @@ void ExprOpHasAttr::eval(EvalState & state, Env & env, Value & v)
         Bindings::iterator j;
         auto name = getName(i, state, env);
         if (vAttrs->type() != nAttrs ||
-            (j = vAttrs->attrs->find(name)) == vAttrs->attrs->end())
+            (j = vAttrs->attrs()->find(name)) == vAttrs->attrs()->end())
         {
             v.mkBool(false);
             return;
@@ -1509,13 +1604,13 @@ void EvalState::callFunction(Value & fun, size_t nrArgs, Value * * args, Value &
 
         if (vCur.isLambda()) {
 
-            ExprLambda & lambda(*vCur.lambda.fun);
+            ExprLambda & lambda(*vCur.lambda().fun);
 
             auto size =
                 (!lambda.arg ? 0 : 1) +
                 (lambda.hasFormals() ? lambda.formals->formals.size() : 0);
             Env & env2(allocEnv(size));
-            env2.up = vCur.lambda.env;
+            env2.up = vCur.lambda().env;
 
             Displacement displ = 0;
 
@@ -1540,14 +1635,14 @@ void EvalState::callFunction(Value & fun, size_t nrArgs, Value * * args, Value &
                     env2,
                     displ,
                     lambda,
-                    *args[0]->attrs
+                    *args[0]->attrs()
                 );
                 for (auto const & missingArg : formalsMatch.missing) {
                     auto const missing = symbols[missingArg];
                     error<TypeError>("function '%s' called without required argument '%s'", lambda.getName(symbols), missing)
                         .atPos(lambda.pos)
                         .withTrace(pos, "from call site")
-                        .withFrame(*fun.lambda.env, lambda)
+                        .withFrame(*fun.lambda().env, lambda)
                         .debugThrow();
                 }
                 for (auto const & unexpectedArg : formalsMatch.unexpected) {
@@ -1561,7 +1656,7 @@ void EvalState::callFunction(Value & fun, size_t nrArgs, Value * * args, Value &
                         .atPos(lambda.pos)
                         .withTrace(pos, "from call site")
                         .withSuggestions(sug)
-                        .withFrame(*fun.lambda.env, lambda)
+                        .withFrame(*fun.lambda().env, lambda)
                         .debugThrow();
                 }
 
@@ -1599,7 +1694,7 @@ void EvalState::callFunction(Value & fun, size_t nrArgs, Value * * args, Value &
 
         else if (vCur.isPrimOp()) {
 
-            size_t argsLeft = vCur.primOp->arity;
+            size_t argsLeft = vCur.primOp()->arity;
 
             if (nrArgs < argsLeft) {
                 /* We don't have enough arguments, so create a tPrimOpApp chain. */
@@ -1607,7 +1702,7 @@ void EvalState::callFunction(Value & fun, size_t nrArgs, Value * * args, Value &
                 return;
             } else {
                 /* We have all the arguments, so call the primop. */
-                auto * fn = vCur.primOp;
+                auto * fn = vCur.primOp();
 
                 nrPrimOpCalls++;
                 if (countCalls) primOpCalls[fn->name]++;
@@ -1639,10 +1734,10 @@ void EvalState::callFunction(Value & fun, size_t nrArgs, Value * * args, Value &
             Value * primOp = &vCur;
             while (primOp->isPrimOpApp()) {
                 argsDone++;
-                primOp = primOp->primOpApp.left;
+                primOp = primOp->primOpApp().left;
             }
             assert(primOp->isPrimOp());
-            auto arity = primOp->primOp->arity;
+            auto arity = primOp->primOp()->arity;
             auto argsLeft = arity - argsDone;
 
             if (nrArgs < argsLeft) {
@@ -1655,13 +1750,13 @@ void EvalState::callFunction(Value & fun, size_t nrArgs, Value * * args, Value &
 
                 Value * vArgs[maxPrimOpArity];
                 auto n = argsDone;
-                for (Value * arg = &vCur; arg->isPrimOpApp(); arg = arg->primOpApp.left)
-                    vArgs[--n] = arg->primOpApp.right;
+                for (Value * arg = &vCur; arg->isPrimOpApp(); arg = arg->primOpApp().left)
+                    vArgs[--n] = arg->primOpApp().right;
 
                 for (size_t i = 0; i < argsLeft; ++i)
                     vArgs[argsDone + i] = args[i];
 
-                auto fn = primOp->primOp;
+                auto fn = primOp->primOp();
                 nrPrimOpCalls++;
                 if (countCalls) primOpCalls[fn->name]++;
 
@@ -1681,7 +1776,7 @@ void EvalState::callFunction(Value & fun, size_t nrArgs, Value * * args, Value &
             }
         }
 
-        else if (vCur.type() == nAttrs && (functor = vCur.attrs->get(sFunctor))) {
+        else if (vCur.type() == nAttrs && (functor = vCur.attrs()->get(sFunctor))) {
             /* 'vCur' may be allocated on the stack of the calling
                function, but for functors we may keep a reference, so
                heap-allocate a copy and use that instead. */
@@ -1733,9 +1828,14 @@ void ExprCall::eval(EvalState & state, Env & env, Value & v)
     // 4: about 60
     // 5: under 10
     // This excluded attrset lambdas (`{...}:`). Contributions of mixed lambdas appears insignificant at ~150 total.
+    /* A function with formals forces its argument straight away. */
+    bool strictArg = vFun.isLambda() && vFun.lambda().fun->hasFormals();
+
     SmallValueVector<4> vArgs(args.size());
     for (size_t i = 0; i < args.size(); ++i)
-        vArgs[i] = args[i]->maybeThunk(state, env);
+        vArgs[i] = i == 0 && strictArg
+            ? args[i]->maybeThunkStrict(state, env)
+            : args[i]->maybeThunk(state, env);
 
     state.callFunction(vFun, args.size(), vArgs.data(), v, pos);
 }
@@ -1756,8 +1856,8 @@ void EvalState::autoCallFunction(Bindings & args, Value & fun, Value & res)
     forceValue(fun, pos);
 
     if (fun.type() == nAttrs) {
-        auto found = fun.attrs->find(sFunctor);
-        if (found != fun.attrs->end()) {
+        auto found = fun.attrs()->find(sFunctor);
+        if (found != fun.attrs()->end()) {
             Value * v = allocValue();
             callFunction(*found->value, fun, *v, pos);
             forceValue(*v, pos);
@@ -1765,14 +1865,14 @@ void EvalState::autoCallFunction(Bindings & args, Value & fun, Value & res)
         }
     }
 
-    if (!fun.isLambda() || !fun.lambda.fun->hasFormals()) {
+    if (!fun.isLambda() || !fun.lambda().fun->hasFormals()) {
         res = fun;
         return;
     }
 
-    auto attrs = buildBindings(std::max(static_cast<uint32_t>(fun.lambda.fun->formals->formals.size()), args.size()));
+    auto attrs = buildBindings(std::max(static_cast<uint32_t>(fun.lambda().fun->formals->formals.size()), args.size()));
 
-    if (fun.lambda.fun->formals->ellipsis) {
+    if (fun.lambda().fun->formals->ellipsis) {
         // If the formals have an ellipsis (eg the function accepts extra args) pass
         // all available automatic arguments (which includes arguments specified on
         // the command line via --arg/--argstr)
@@ -1780,7 +1880,7 @@ void EvalState::autoCallFunction(Bindings & args, Value & fun, Value & res)
             attrs.insert(v);
     } else {
         // Otherwise, only pass the arguments that the function accepts
-        for (auto & i : fun.lambda.fun->formals->formals) {
+        for (auto & i : fun.lambda().fun->formals->formals) {
             Bindings::iterator j = args.find(i.name);
             if (j != args.end()) {
                 attrs.insert(*j);
@@ -1790,7 +1890,7 @@ Nix attempted to evaluate a function as a top level expression; in
 this case it must have its arguments supplied either by default
 values, or passed explicitly with '--arg' or '--argstr'. See
 https://docs.lix.systems/manual/lix/stable/language/constructs.html#functions)", symbols[i.name])
-                    .atPos(i.pos).withFrame(*fun.lambda.env, *fun.lambda.fun).debugThrow();
+                    .atPos(i.pos).withFrame(*fun.lambda().env, *fun.lambda().fun).debugThrow();
             }
         }
     }
@@ -1875,17 +1975,17 @@ void ExprOpUpdate::eval(EvalState & state, Env & env, Value & v)
 
     state.nrOpUpdates++;
 
-    if (v1.attrs->size() == 0) { v = v2; return; }
-    if (v2.attrs->size() == 0) { v = v1; return; }
+    if (v1.attrs()->size() == 0) { v = v2; return; }
+    if (v2.attrs()->size() == 0) { v = v1; return; }
 
-    auto attrs = state.buildBindings(v1.attrs->size() + v2.attrs->size());
+    auto attrs = state.buildBindings(v1.attrs()->size() + v2.attrs()->size());
 
     /* Merge the sets, preferring values from the second set.  Make
        sure to keep the resulting vector in sorted order. */
-    Bindings::iterator i = v1.attrs->begin();
-    Bindings::iterator j = v2.attrs->begin();
+    Bindings::iterator i = v1.attrs()->begin();
+    Bindings::iterator j = v2.attrs()->begin();
 
-    while (i != v1.attrs->end() && j != v2.attrs->end()) {
+    while (i != v1.attrs()->end() && j != v2.attrs()->end()) {
         if (i->name == j->name) {
             attrs.insert(*j);
             ++i; ++j;
@@ -1896,12 +1996,12 @@ void ExprOpUpdate::eval(EvalState & state, Env & env, Value & v)
             attrs.insert(*j++);
     }
 
-    while (i != v1.attrs->end()) attrs.insert(*i++);
-    while (j != v2.attrs->end()) attrs.insert(*j++);
+    while (i != v1.attrs()->end()) attrs.insert(*i++);
+    while (j != v2.attrs()->end()) attrs.insert(*j++);
 
     v.mkAttrs(attrs.alreadySorted());
 
-    state.nrOpUpdateValuesCopied += v.attrs->size();
+    state.nrOpUpdateValuesCopied += v.attrs()->size();
 }
 
 
@@ -1914,6 +2014,12 @@ void ExprOpConcatLists::eval(EvalState & state, Env & env, Value & v)
 }
 
 
+/**
+ * The number of slots at the start of a growable list array that hold
+ * its header.
+ */
+static constexpr size_t listHeaderSlots = 2;
+
 void EvalState::concatLists(Value & v, size_t nrLists, Value * * lists, const PosIdx pos, std::string_view errorCtx)
 {
     nrListConcats++;
@@ -1932,9 +2038,64 @@ void EvalState::concatLists(Value & v, size_t nrLists, Value * * lists, const Po
         return;
     }
 
-    mkList(v, len);
+    if (len <= 2) {
+        mkList(v, len);
+        auto out = v.listElems();
+        for (size_t n = 0, pos = 0; n < nrLists; ++n) {
+            auto l = lists[n]->listSize();
+            if (l)
+                memcpy(out + pos, lists[n]->listElems(), l * sizeof(Value *));
+            pos += l;
+        }
+        return;
+    }
+
+    if (len > std::numeric_limits<uint32_t>::max())
+        error<EvalError>("cannot create a list of %d elements", len).atPos(pos).debugThrow();
+
+    /* Arrays created here start with a header holding the number of
+       slots in use and the capacity. If the first list ends where its
+       array is filled up to, the others can be appended in place: the
+       first list keeps its size, so nothing that refers to it can tell.
+       This makes accumulating a list with `++` linear rather than
+       quadratic. */
+    size_t first = 0;
+    while (!lists[first]->listSize()) ++first;
+    auto & head = *lists[first];
+    auto headSize = head.listSize();
+    bool headGrowable = head.listGrowable();
+
+    if (headGrowable) {
+        auto header = reinterpret_cast<uintptr_t *>(head.listStorage());
+        auto end = head.listOffset() + headSize;
+        if (header[0] == end && end + (len - headSize) <= header[1]) {
+            nrListConcatsInPlace++;
+            v.mkGrowableList(head.listStorage(), head.listOffset(), len);
+            auto out = v.listElems();
+            for (size_t n = first + 1, pos = headSize; n < nrLists; ++n) {
+                auto l = lists[n]->listSize();
+                if (l)
+                    memcpy(out + pos, lists[n]->listElems(), l * sizeof(Value *));
+                pos += l;
+            }
+            header[0] = end + (len - headSize);
+            return;
+        }
+    }
+
+    /* Leave room to grow only when the first list was itself built by
+       appending, to avoid the overhead on one-off concatenations. */
+    size_t capacity = listHeaderSlots + (headGrowable ? 2 * len : len);
+    auto elems = gcAllocType<Value *>(capacity);
+    auto header = reinterpret_cast<uintptr_t *>(elems);
+    header[0] = listHeaderSlots + len;
+    header[1] = capacity;
+    nrListElems += capacity;
+
+    v.mkGrowableList(elems, listHeaderSlots, len);
+
     auto out = v.listElems();
-    for (size_t n = 0, pos = 0; n < nrLists; ++n) {
+    for (size_t n = first, pos = 0; n < nrLists; ++n) {
         auto l = lists[n]->listSize();
         if (l)
             memcpy(out + pos, lists[n]->listElems(), l * sizeof(Value *));
@@ -1992,24 +2153,24 @@ void ExprConcatStrings::eval(EvalState & state, Env & env, Value & v)
 
         if (firstType == nInt) {
             if (vTmp.type() == nInt) {
-                auto newN = n + vTmp.integer;
+                auto newN = n + vTmp.integer();
                 if (auto checked = newN.valueChecked(); checked.has_value()) {
                     n = NixInt(*checked);
                 } else {
-                    state.error<EvalError>("integer overflow in adding %1% + %2%", n, vTmp.integer).atPos(i_pos).debugThrow();
+                    state.error<EvalError>("integer overflow in adding %1% + %2%", n, vTmp.integer()).atPos(i_pos).debugThrow();
                 }
             } else if (vTmp.type() == nFloat) {
                 // Upgrade the type from int to float;
                 firstType = nFloat;
                 nf = n.value;
-                nf += vTmp.fpoint;
+                nf += vTmp.fpoint();
             } else
                 state.error<EvalError>("cannot add %1% to an integer", showType(vTmp)).atPos(i_pos).withFrame(env, *this).debugThrow();
         } else if (firstType == nFloat) {
             if (vTmp.type() == nInt) {
-                nf += vTmp.integer.value;
+                nf += vTmp.integer().value;
             } else if (vTmp.type() == nFloat) {
-                nf += vTmp.fpoint;
+                nf += vTmp.fpoint();
             } else
                 state.error<EvalError>("cannot add %1% to a float", showType(vTmp)).atPos(i_pos).withFrame(env, *this).debugThrow();
         } else {
@@ -2082,11 +2243,11 @@ void EvalState::forceValueDeep(Value & v)
         forceValue(v, v.determinePos(noPos));
 
         if (v.type() == nAttrs) {
-            for (auto & i : *v.attrs)
+            for (auto & i : *v.attrs())
                 try {
                     // If the value is a thunk, we're evaling. Otherwise no trace necessary.
                     auto dts = debugRepl && i.value->isThunk()
-                        ? makeDebugTraceStacker(*this, *i.value->thunk.expr, *i.value->thunk.env, positions[i.pos],
+                        ? makeDebugTraceStacker(*this, *i.value->thunk().expr, *i.value->thunk().env, positions[i.pos],
                             "while evaluating the attribute '%1%'", symbols[i.name])
                         : nullptr;
 
@@ -2117,13 +2278,13 @@ NixInt EvalState::forceInt(Value & v, const PosIdx pos, std::string_view errorCt
                 showType(v),
                 ValuePrinter(*this, v, errorPrintOptions)
             ).atPos(pos).debugThrow();
-        return v.integer;
+        return v.integer();
     } catch (Error & e) {
         e.addTrace(positions[pos], errorCtx);
         throw;
     }
 
-    return v.integer;
+    return v.integer();
 }
 
 
@@ -2132,14 +2293,14 @@ NixFloat EvalState::forceFloat(Value & v, const PosIdx pos, std::string_view err
     try {
         forceValue(v, pos);
         if (v.type() == nInt)
-            return v.integer.value;
+            return v.integer().value;
         else if (v.type() != nFloat)
             error<TypeError>(
                 "expected a float but found %1%: %2%",
                 showType(v),
                 ValuePrinter(*this, v, errorPrintOptions)
             ).atPos(pos).debugThrow();
-        return v.fpoint;
+        return v.fpoint();
     } catch (Error & e) {
         e.addTrace(positions[pos], errorCtx);
         throw;
@@ -2157,19 +2318,19 @@ bool EvalState::forceBool(Value & v, const PosIdx pos, std::string_view errorCtx
                 showType(v),
                 ValuePrinter(*this, v, errorPrintOptions)
             ).atPos(pos).debugThrow();
-        return v.boolean;
+        return v.boolean();
     } catch (Error & e) {
         e.addTrace(positions[pos], errorCtx);
         throw;
     }
 
-    return v.boolean;
+    return v.boolean();
 }
 
 
 bool EvalState::isFunctor(Value & fun)
 {
-    return fun.type() == nAttrs && fun.attrs->find(sFunctor) != fun.attrs->end();
+    return fun.type() == nAttrs && fun.attrs()->find(sFunctor) != fun.attrs()->end();
 }
 
 
@@ -2200,7 +2361,7 @@ std::string_view EvalState::forceString(Value & v, const PosIdx pos, std::string
                 showType(v),
                 ValuePrinter(*this, v, errorPrintOptions)
             ).atPos(pos).debugThrow();
-        return v.string.s;
+        return v.c_str();
     } catch (Error & e) {
         e.addTrace(positions[pos], errorCtx);
         throw;
@@ -2210,8 +2371,8 @@ std::string_view EvalState::forceString(Value & v, const PosIdx pos, std::string
 
 void copyContext(const Value & v, NixStringContext & context)
 {
-    if (v.string.context)
-        for (const char * * p = v.string.context; *p; ++p)
+    if (v.context())
+        for (const char * * p = v.context(); *p; ++p)
             context.insert(NixStringContextElem::parse(*p));
 }
 
@@ -2227,8 +2388,8 @@ std::string_view EvalState::forceString(Value & v, NixStringContext & context, c
 std::string_view EvalState::forceStringNoCtx(Value & v, const PosIdx pos, std::string_view errorCtx)
 {
     auto s = forceString(v, pos, errorCtx);
-    if (v.string.context) {
-        error<EvalError>("the string '%1%' is not allowed to refer to a store path (such as '%2%')", v.string.s, v.string.context[0]).withTrace(pos, errorCtx).debugThrow();
+    if (v.context()) {
+        error<EvalError>("the string '%1%' is not allowed to refer to a store path (such as '%2%')", v.c_str(), v.context()[0]).withTrace(pos, errorCtx).debugThrow();
     }
     return s;
 }
@@ -2237,19 +2398,19 @@ std::string_view EvalState::forceStringNoCtx(Value & v, const PosIdx pos, std::s
 bool EvalState::isDerivation(Value & v)
 {
     if (v.type() != nAttrs) return false;
-    Bindings::iterator i = v.attrs->find(sType);
-    if (i == v.attrs->end()) return false;
+    Bindings::iterator i = v.attrs()->find(sType);
+    if (i == v.attrs()->end()) return false;
     forceValue(*i->value, i->pos);
     if (i->value->type() != nString) return false;
-    return strcmp(i->value->string.s, "derivation") == 0;
+    return strcmp(i->value->c_str(), "derivation") == 0;
 }
 
 
 std::optional<std::string> EvalState::tryAttrsToString(const PosIdx pos, Value & v,
     NixStringContext & context, bool coerceMore, bool copyToStore)
 {
-    auto i = v.attrs->find(sToString);
-    if (i != v.attrs->end()) {
+    auto i = v.attrs()->find(sToString);
+    if (i != v.attrs()->end()) {
         Value v1;
         callFunction(*i->value, v, v1, pos);
         return coerceToString(pos, v1, context,
@@ -2273,7 +2434,7 @@ BackedStringView EvalState::coerceToString(
 
     if (v.type() == nString) {
         copyContext(v, context);
-        return std::string_view(v.string.s);
+        return std::string_view(v.c_str());
     }
 
     if (v.type() == nPath) {
@@ -2281,7 +2442,7 @@ BackedStringView EvalState::coerceToString(
             !canonicalizePath && !copyToStore
             ? // FIXME: hack to preserve path literals that end in a
               // slash, as in /foo/${x}.
-              v._path
+              v.pathStr()
             : copyToStore
             ? store->printStorePath(copyPathToStore(context, v.path()))
             : std::string(v.path().path.abs());
@@ -2291,8 +2452,8 @@ BackedStringView EvalState::coerceToString(
         auto maybeString = tryAttrsToString(pos, v, context, coerceMore, copyToStore);
         if (maybeString)
             return std::move(*maybeString);
-        auto i = v.attrs->find(sOutPath);
-        if (i == v.attrs->end()) {
+        auto i = v.attrs()->find(sOutPath);
+        if (i == v.attrs()->end()) {
             error<TypeError>(
                 "cannot coerce %1% to a string: %2%",
                 showType(v),
@@ -2307,7 +2468,7 @@ BackedStringView EvalState::coerceToString(
 
     if (v.type() == nExternal) {
         try {
-            return v.external->coerceToString(*this, pos, context, coerceMore, copyToStore);
+            return v.external()->coerceToString(*this, pos, context, coerceMore, copyToStore);
         } catch (Error & e) {
             e.addTrace(nullptr, errorCtx);
             throw;
@@ -2317,10 +2478,10 @@ BackedStringView EvalState::coerceToString(
     if (coerceMore) {
         /* Note that `false' is represented as an empty string for
            shell scripting convenience, just like `null'. */
-        if (v.type() == nBool && v.boolean) return "1";
-        if (v.type() == nBool && !v.boolean) return "";
-        if (v.type() == nInt) return std::to_string(v.integer.value);
-        if (v.type() == nFloat) return std::to_string(v.fpoint);
+        if (v.type() == nBool && v.boolean()) return "1";
+        if (v.type() == nBool && !v.boolean()) return "";
+        if (v.type() == nInt) return std::to_string(v.integer().value);
+        if (v.type() == nFloat) return std::to_string(v.fpoint());
         if (v.type() == nNull) return "";
 
         if (v.isList()) {
@@ -2362,6 +2523,8 @@ StorePath EvalState::copyPathToStore(NixStringContext & context, const SourcePat
     auto dstPath = i != srcToStore.end()
         ? i->second
         : [&]() {
+            if (dependencies && !store->isInStore(path.path.abs()))
+                dependencies->addTree(path);
             auto dstPath = fetchToStore(*store, path, path.baseName(), FileIngestionMethod::Recursive, nullptr, repair);
             allowPath(dstPath);
             srcToStore.insert_or_assign(path, dstPath);
@@ -2463,25 +2626,25 @@ bool EvalState::eqValues(Value & v1, Value & v2, const PosIdx pos, std::string_v
 
     // Special case type-compatibility between float and int
     if (v1.type() == nInt && v2.type() == nFloat)
-        return v1.integer.value == v2.fpoint;
+        return v1.integer().value == v2.fpoint();
     if (v1.type() == nFloat && v2.type() == nInt)
-        return v1.fpoint == v2.integer.value;
+        return v1.fpoint() == v2.integer().value;
 
     // All other types are not compatible with each other.
     if (v1.type() != v2.type()) return false;
 
     switch (v1.type()) {
         case nInt:
-            return v1.integer == v2.integer;
+            return v1.integer() == v2.integer();
 
         case nBool:
-            return v1.boolean == v2.boolean;
+            return v1.boolean() == v2.boolean();
 
         case nString:
-            return strcmp(v1.string.s, v2.string.s) == 0;
+            return strcmp(v1.c_str(), v2.c_str()) == 0;
 
         case nPath:
-            return strcmp(v1._path, v2._path) == 0;
+            return strcmp(v1.pathStr(), v2.pathStr()) == 0;
 
         case nNull:
             return true;
@@ -2496,17 +2659,17 @@ bool EvalState::eqValues(Value & v1, Value & v2, const PosIdx pos, std::string_v
             /* If both sets denote a derivation (type = "derivation"),
                then compare their outPaths. */
             if (isDerivation(v1) && isDerivation(v2)) {
-                Bindings::iterator i = v1.attrs->find(sOutPath);
-                Bindings::iterator j = v2.attrs->find(sOutPath);
-                if (i != v1.attrs->end() && j != v2.attrs->end())
+                Bindings::iterator i = v1.attrs()->find(sOutPath);
+                Bindings::iterator j = v2.attrs()->find(sOutPath);
+                if (i != v1.attrs()->end() && j != v2.attrs()->end())
                     return eqValues(*i->value, *j->value, pos, errorCtx);
             }
 
-            if (v1.attrs->size() != v2.attrs->size()) return false;
+            if (v1.attrs()->size() != v2.attrs()->size()) return false;
 
             /* Otherwise, compare the attributes one by one. */
             Bindings::iterator i, j;
-            for (i = v1.attrs->begin(), j = v2.attrs->begin(); i != v1.attrs->end(); ++i, ++j)
+            for (i = v1.attrs()->begin(), j = v2.attrs()->begin(); i != v1.attrs()->end(); ++i, ++j)
                 if (i->name != j->name || !eqValues(*i->value, *j->value, pos, errorCtx))
                     return false;
 
@@ -2518,10 +2681,10 @@ bool EvalState::eqValues(Value & v1, Value & v2, const PosIdx pos, std::string_v
             return false;
 
         case nExternal:
-            return *v1.external == *v2.external;
+            return *v1.external() == *v2.external();
 
         case nFloat:
-            return v1.fpoint == v2.fpoint;
+            return v1.fpoint() == v2.fpoint();
 
         case nThunk: // Must not be left by forceValue
         default:
@@ -2589,6 +2752,7 @@ void EvalState::printStatistics()
         {"elements", nrListElems},
         {"bytes", bLists},
         {"concats", nrListConcats},
+        {"concatsInPlace", nrListConcatsInPlace},
     };
     topObj["values"] = {
         {"number", nrValues},
@@ -2613,9 +2777,13 @@ void EvalState::printStatistics()
     topObj["nrOpUpdateValuesCopied"] = nrOpUpdateValuesCopied;
     topObj["nrThunks"] = nrThunks;
     topObj["nrAvoided"] = nrAvoided;
+    topObj["nrEager"] = nrEager;
     topObj["nrLookups"] = nrLookups;
+    topObj["nrSelectCacheHits"] = nrSelectCacheHits;
+    topObj["nrSelectCacheMisses"] = nrSelectCacheMisses;
     topObj["nrPrimOpCalls"] = nrPrimOpCalls;
     topObj["nrFunctionCalls"] = nrFunctionCalls;
+    topObj["nrParsesReused"] = nrParsesReused;
 #if HAVE_BOEHMGC
     topObj["gc"] = {
         {"heapSize", heapSize},
@@ -2675,7 +2843,7 @@ void EvalState::printStatistics()
 }
 
 
-SourcePath resolveExprPath(SourcePath path)
+SourcePath resolveExprPath(SourcePath path, eval_cache::Dependencies * dependencies)
 {
     unsigned int followCount = 0, maxFollow = 1024;
 
@@ -2685,8 +2853,12 @@ SourcePath resolveExprPath(SourcePath path)
         // Basic cycle/depth limit to avoid infinite loops.
         if (++followCount >= maxFollow)
             throw Error("too many symbolic links encountered while traversing the path '%s'", path);
-        if (path.lstat().type != InputAccessor::tSymlink) break;
-        path = {CanonPath(path.readLink(), path.path.parent().value_or(CanonPath::root))};
+        auto type = path.lstat().type;
+        if (dependencies) dependencies->addStat(path, type);
+        if (type != InputAccessor::tSymlink) break;
+        auto target = path.readLink();
+        if (dependencies) dependencies->addLink(path, target);
+        path = {CanonPath(target, path.path.parent().value_or(CanonPath::root))};
     }
 
     /* If `path' refers to a directory, append `/default.nix'. */
@@ -2706,9 +2878,19 @@ Expr & EvalState::parseExprFromFile(const SourcePath & path)
 Expr & EvalState::parseExprFromFile(const SourcePath & path, std::shared_ptr<StaticEnv> & staticEnv)
 {
     auto buffer = path.readFile();
+    if (dependencies) dependencies->addFile(path, buffer);
+    return *parseExprFromBuffer(std::move(buffer), path, staticEnv);
+}
+
+
+Expr * EvalState::parseExprFromBuffer(
+    std::string buffer,
+    const SourcePath & path,
+    std::shared_ptr<StaticEnv> & staticEnv)
+{
     // readFile hopefully have left some extra space for terminators
     buffer.append("\0\0", 2);
-    return *parse(buffer.data(), buffer.size(), Pos::Origin(path), path.parent(), staticEnv);
+    return parse(buffer.data(), buffer.size(), Pos::Origin(path), path.parent(), staticEnv);
 }
 
 
@@ -2771,7 +2953,8 @@ SourcePath EvalState::findFile(const SearchPath & searchPath, const std::string_
         auto r = *rOpt;
 
         Path res = suffix == "" ? r : concatStrings(r, "/", suffix);
-        if (pathExists(res)) return CanonPath(canonPath(res));
+        if (dependencies) dependencies->addStat(CanonPath(res));
+        if (rootPath(CanonPath(res)).pathExists()) return CanonPath(canonPath(res));
     }
 
     if (path.starts_with("nix/"))
@@ -2795,9 +2978,14 @@ std::optional<std::string> EvalState::resolveSearchPathPath(const SearchPath::Pa
     std::optional<std::string> res;
 
     if (EvalSettings::isPseudoUrl(value)) {
+        if (dependencies) dependencies->addVolatile(value);
         try {
-            auto storePath = fetchers::downloadTarball(
-                store, EvalSettings::resolvePseudoUrl(value), "source", false).tree.storePath;
+            auto download = [&]() {
+                return store->printStorePath(fetchers::downloadTarball(
+                    store, EvalSettings::resolvePseudoUrl(value), "source", false).tree.storePath);
+            };
+            auto storePath = store->parseStorePath(
+                trace ? trace->fetch("tarball " + value, download).get<std::string>() : download());
             res = { store->toRealPath(storePath) };
         } catch (FileTransferError & e) {
             logWarning({
@@ -2809,15 +2997,21 @@ std::optional<std::string> EvalState::resolveSearchPathPath(const SearchPath::Pa
 
     else if (value.starts_with("flake:")) {
         experimentalFeatureSettings.require(Xp::Flakes);
+        if (dependencies) dependencies->addVolatile(value);
         auto flakeRef = parseFlakeRef(value.substr(6), {}, true, false);
         debug("fetching flake search path element '%s''", value);
-        auto storePath = flakeRef.resolve(store).fetchTree(store).first.storePath;
+        auto fetch = [&]() {
+            return store->printStorePath(flakeRef.resolve(store).fetchTree(store).first.storePath);
+        };
+        auto storePath = store->parseStorePath(
+            trace ? trace->fetch("flake " + value, fetch).get<std::string>() : fetch());
         res = { store->toRealPath(storePath) };
     }
 
     else {
         auto path = absPath(value);
-        if (pathExists(path))
+        if (dependencies) dependencies->addStat(CanonPath(path));
+        if (rootPath(CanonPath(path)).pathExists())
             res = { path };
         else {
             logWarning({
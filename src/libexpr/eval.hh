@@ -4,6 +4,7 @@
 #include "attr-set.hh"
 #include "eval-error.hh"
 #include "gc-alloc.hh"
+#include "hash.hh"
 #include "types.hh"
 #include "value.hh"
 #include "nixexpr.hh"
@@ -34,8 +35,10 @@ class StorePath;
 struct SingleDerivedPath;
 enum RepairFlag : bool;
 struct MemoryInputAccessor;
+class EvalTrace;
 namespace eval_cache {
     class EvalCache;
+    class Dependencies;
 }
 
 /**
@@ -194,6 +197,18 @@ public:
      */
     Value vEmptyList;
 
+    /**
+     * Null and Boolean constants. Like `vEmptyList`, these are shared
+     * by every value that only refers to them by pointer, such as list
+     * elements and attributes, instead of allocating a copy each time.
+     */
+    Value vNull, vTrue, vFalse;
+
+    Value * getBool(bool b)
+    {
+        return b ? &vTrue : &vFalse;
+    }
+
     const SourcePath derivationInternal;
 
     /**
@@ -241,6 +256,19 @@ public:
      */
     std::map<const Hash, ref<eval_cache::EvalCache>> evalCaches;
 
+    /**
+     * If set, the external inputs read by the evaluator (files,
+     * environment variables, ...) are recorded here, for evaluation
+     * caches that are not keyed on a locked flake.
+     */
+    std::shared_ptr<eval_cache::Dependencies> dependencies;
+
+    /**
+     * If set, the evaluation trace that the external inputs of this
+     * evaluation are recorded in or replayed from.
+     */
+    std::shared_ptr<EvalTrace> trace;
+
 private:
 
     /* Cache for calls to addToStore(); maps source paths to the store
@@ -248,9 +276,24 @@ private:
     std::map<SourcePath, StorePath> srcToStore;
 
     /**
-     * A cache from path names to parse trees.
+     * A cache from path names to parse trees. Unlike the values in
+     * `fileEvalCache`, parse trees survive `resetFileCache()`, and are
+     * reused afterwards if the file they were parsed from is unchanged.
      */
-    using FileParseCache = GcMap<SourcePath, Expr *>;
+    struct ParsedFile
+    {
+        Expr * e;
+        /**
+         * SHA-256 hash of the source the parse tree was produced from.
+         */
+        Hash sourceHash;
+        /**
+         * Whether `sourceHash` was checked against the file since the
+         * last call to `resetFileCache()`.
+         */
+        bool checked;
+    };
+    using FileParseCache = GcMap<SourcePath, ParsedFile>;
     FileParseCache fileParseCache;
 
     /**
@@ -378,6 +421,15 @@ public:
 
     void resetFileCache();
 
+private:
+    /**
+     * Parse the given file, or return its parse tree from
+     * `fileParseCache`.
+     */
+    Expr & parseFileCached(const SourcePath & path);
+
+public:
+
     /**
      * Look up a file in the search path.
      */
@@ -581,6 +633,14 @@ private:
         std::shared_ptr<StaticEnv> & staticEnv,
         const FeatureSettings & xpSettings = featureSettings);
 
+    /**
+     * Parse the contents `buffer` of the file `path`.
+     */
+    Expr * parseExprFromBuffer(
+        std::string buffer,
+        const SourcePath & path,
+        std::shared_ptr<StaticEnv> & staticEnv);
+
     /**
      * Current Nix call stack depth, used with `max-call-depth` setting to throw stack overflow hopefully before we run out of system stack.
      */
@@ -726,14 +786,23 @@ private:
     unsigned long nrValues = 0;
     unsigned long nrListElems = 0;
     unsigned long nrLookups = 0;
+    /** Attribute selections answered by, or missing, the inline caches of `ExprSelect`. */
+    unsigned long nrSelectCacheHits = 0;
+    unsigned long nrSelectCacheMisses = 0;
     unsigned long nrAttrsets = 0;
     unsigned long nrAttrsInAttrsets = 0;
     unsigned long nrAvoided = 0;
+    /** Values computed ahead of time instead of allocating a thunk. */
+    unsigned long nrEager = 0;
     unsigned long nrOpUpdates = 0;
     unsigned long nrOpUpdateValuesCopied = 0;
     unsigned long nrListConcats = 0;
+    /** Concatenations that appended to the array of their first operand. */
+    unsigned long nrListConcatsInPlace = 0;
     unsigned long nrPrimOpCalls = 0;
     unsigned long nrFunctionCalls = 0;
+    /** Files whose parse tree was reused after `resetFileCache()`. */
+    unsigned long nrParsesReused = 0;
 
     bool countCalls;
 
@@ -755,6 +824,8 @@ private:
     friend struct ExprInt;
     friend struct ExprFloat;
     friend struct ExprPath;
+    friend struct ExprLambda;
+    friend struct Expr;
     friend struct ExprSelect;
     friend void prim_getAttr(EvalState & state, const PosIdx pos, Value * * args, Value & v);
     friend void prim_match(EvalState & state, const PosIdx pos, Value * * args, Value & v);
@@ -784,8 +855,11 @@ std::string showType(const Value & v);
 
 /**
  * If `path` refers to a directory, then append "/default.nix".
+ *
+ * The symlinks and types looked at are recorded in `dependencies`, if
+ * given.
  */
-SourcePath resolveExprPath(SourcePath path);
+SourcePath resolveExprPath(SourcePath path, eval_cache::Dependencies * dependencies = nullptr);
 
 static constexpr std::string_view corepkgsPrefix{"/__corepkgs__/"};
 
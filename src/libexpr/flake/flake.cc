@@ -9,6 +9,7 @@
 #include "finally.hh"
 #include "fetch-settings.hh"
 #include "terminal.hh"
+#include "thread-pool.hh"
 
 namespace nix {
 
@@ -50,7 +51,7 @@ static std::tuple<fetchers::Tree, FlakeRef, FlakeRef> fetchOrSubstituteTree(
         } else {
             if (allowLookup) {
                 resolvedRef = originalRef.resolve(state.store);
-                auto fetchedResolved = lookupInFlakeCache(flakeCache, originalRef);
+                auto fetchedResolved = lookupInFlakeCache(flakeCache, resolvedRef);
                 if (!fetchedResolved) fetchedResolved.emplace(resolvedRef.fetchTree(state.store));
                 flakeCache.push_back({resolvedRef, *fetchedResolved});
                 fetched.emplace(*fetchedResolved);
@@ -74,6 +75,60 @@ static std::tuple<fetchers::Tree, FlakeRef, FlakeRef> fetchOrSubstituteTree(
     return {std::move(tree), resolvedRef, lockedRef};
 }
 
+/* Fetch the trees of `refs` concurrently and add them to `flakeCache`,
+   so that fetchOrSubstituteTree() finds them there. Failures are
+   ignored; the subsequent sequential fetch reports them. */
+static void prefetchTrees(
+    EvalState & state,
+    const std::vector<std::pair<FlakeRef, bool>> & refs,
+    FlakeCache & flakeCache)
+{
+    auto jobs = fetchSettings.flakeInputFetchJobs.get();
+    if (jobs <= 1) return;
+
+    std::vector<FlakeRef> todo;
+    for (auto & [ref, allowLookup] : refs) {
+        /* Local paths are cheap, and may be relative to their parent. */
+        if (ref.input.getType() == "path") continue;
+        std::optional<FlakeRef> resolvedRef;
+        if (ref.input.isDirect())
+            resolvedRef = ref;
+        else if (allowLookup) {
+            try {
+                resolvedRef = ref.resolve(state.store);
+            } catch (Error &) {
+                continue;
+            }
+        } else
+            continue;
+        if (lookupInFlakeCache(flakeCache, *resolvedRef)
+            || std::find(todo.begin(), todo.end(), *resolvedRef) != todo.end())
+            continue;
+        todo.push_back(std::move(*resolvedRef));
+    }
+
+    if (todo.size() < 2) return;
+
+    std::vector<std::optional<FetchedFlake>> fetched(todo.size());
+
+    ThreadPool pool(std::min<size_t>(jobs, todo.size()));
+    for (size_t n = 0; n < todo.size(); ++n)
+        pool.enqueue([&, n]() {
+            try {
+                fetched[n] = todo[n].fetchTree(state.store);
+            } catch (Error & e) {
+                debug("prefetching flake input '%s' failed: %s", todo[n], e.what());
+            }
+        });
+    pool.process();
+
+    /* Add the results in input order so that the cache contents don't
+       depend on scheduling. */
+    for (size_t n = 0; n < todo.size(); ++n)
+        if (fetched[n])
+            flakeCache.push_back({todo[n], std::move(*fetched[n])});
+}
+
 static void forceTrivialValue(EvalState & state, Value & value, const PosIdx pos)
 {
     if (value.isThunk() && value.isTrivial())
@@ -110,20 +165,20 @@ static FlakeInput parseFlakeInput(EvalState & state,
     fetchers::Attrs attrs;
     std::optional<std::string> url;
 
-    for (nix::Attr attr : *(value->attrs)) {
+    for (nix::Attr attr : *(value->attrs())) {
         try {
             if (attr.name == sUrl) {
                 expectType(state, nString, *attr.value, attr.pos);
-                url = attr.value->string.s;
+                url = attr.value->c_str();
                 attrs.emplace("url", *url);
             } else if (attr.name == sFlake) {
                 expectType(state, nBool, *attr.value, attr.pos);
-                input.isFlake = attr.value->boolean;
+                input.isFlake = attr.value->boolean();
             } else if (attr.name == sInputs) {
                 input.overrides = parseFlakeInputs(state, attr.value, attr.pos, baseDir, lockRootPath, depth + 1);
             } else if (attr.name == sFollows) {
                 expectType(state, nString, *attr.value, attr.pos);
-                auto follows(parseInputPath(attr.value->string.s));
+                auto follows(parseInputPath(attr.value->c_str()));
                 follows.insert(follows.begin(), lockRootPath.begin(), lockRootPath.end());
                 input.follows = follows;
             } else {
@@ -132,13 +187,13 @@ static FlakeInput parseFlakeInput(EvalState & state,
                 #pragma GCC diagnostic ignored "-Wswitch-enum"
                 switch (attr.value->type()) {
                     case nString:
-                        attrs.emplace(state.symbols[attr.name], attr.value->string.s);
+                        attrs.emplace(state.symbols[attr.name], attr.value->c_str());
                         break;
                     case nBool:
-                        attrs.emplace(state.symbols[attr.name], Explicit<bool> { attr.value->boolean });
+                        attrs.emplace(state.symbols[attr.name], Explicit<bool> { attr.value->boolean() });
                         break;
                     case nInt: {
-                        auto intValue = attr.value->integer.value;
+                        auto intValue = attr.value->integer().value;
 
                         if (intValue < 0) {
                             state.error<EvalError>("negative value given for flake input attribute %1%: %2%", state.symbols[attr.name], intValue).debugThrow();
@@ -194,7 +249,7 @@ static std::map<FlakeId, FlakeInput> parseFlakeInputs(
 
     expectType(state, nAttrs, *value, pos);
 
-    for (nix::Attr & inputAttr : *(*value).attrs) {
+    for (nix::Attr & inputAttr : *(*value).attrs()) {
         inputs.emplace(state.symbols[inputAttr.name],
             parseFlakeInput(state,
                 state.symbols[inputAttr.name],
@@ -244,23 +299,23 @@ static Flake getFlake(
     Value vInfo;
     state.evalFile(CanonPath(flakeFile), vInfo, true); // FIXME: symlink attack
 
-    if (auto description = vInfo.attrs->get(state.sDescription)) {
+    if (auto description = vInfo.attrs()->get(state.sDescription)) {
         expectType(state, nString, *description->value, description->pos);
-        flake.description = description->value->string.s;
+        flake.description = description->value->c_str();
     }
 
     auto sInputs = state.symbols.create("inputs");
 
-    if (auto inputs = vInfo.attrs->get(sInputs))
+    if (auto inputs = vInfo.attrs()->get(sInputs))
         flake.inputs = parseFlakeInputs(state, inputs->value, inputs->pos, flakeDir, lockRootPath, 0);
 
     auto sOutputs = state.symbols.create("outputs");
 
-    if (auto outputs = vInfo.attrs->get(sOutputs)) {
+    if (auto outputs = vInfo.attrs()->get(sOutputs)) {
         expectType(state, nFunction, *outputs->value, outputs->pos);
 
-        if (outputs->value->isLambda() && outputs->value->lambda.fun->hasFormals()) {
-            for (auto & formal : outputs->value->lambda.fun->formals->formals) {
+        if (outputs->value->isLambda() && outputs->value->lambda().fun->hasFormals()) {
+            for (auto & formal : outputs->value->lambda().fun->formals->formals) {
                 if (formal.name != state.sSelf)
                     flake.inputs.emplace(state.symbols[formal.name], FlakeInput {
                         .ref = parseFlakeRef(state.symbols[formal.name])
@@ -273,10 +328,10 @@ static Flake getFlake(
 
     auto sNixConfig = state.symbols.create("nixConfig");
 
-    if (auto nixConfig = vInfo.attrs->get(sNixConfig)) {
+    if (auto nixConfig = vInfo.attrs()->get(sNixConfig)) {
         expectType(state, nAttrs, *nixConfig->value, nixConfig->pos);
 
-        for (auto & setting : *nixConfig->value->attrs) {
+        for (auto & setting : *nixConfig->value->attrs()) {
             forceTrivialValue(state, *setting.value, setting.pos);
             if (setting.value->type() == nString)
                 flake.config.settings.emplace(
@@ -312,7 +367,7 @@ static Flake getFlake(
         }
     }
 
-    for (auto & attr : *vInfo.attrs) {
+    for (auto & attr : *vInfo.attrs()) {
         if (attr.name != state.sDescription &&
             attr.name != sInputs &&
             attr.name != sOutputs &&
@@ -450,6 +505,37 @@ LockedFlake lockFlake(
                         printInputPath(inputPathPrefix), follow);
             }
 
+            auto findOldLock = [&](const FlakeId & id, const InputPath & inputPath) -> std::shared_ptr<LockedNode>
+            {
+                if (oldNode && !lockFlags.inputUpdates.count(inputPath))
+                    if (auto oldLock2 = get(oldNode->inputs, id))
+                        if (auto oldLock3 = std::get_if<0>(&*oldLock2))
+                            return *oldLock3;
+                return nullptr;
+            };
+
+            /* Fetch the inputs that need a new lock file entry
+               concurrently. This only fills `flakeCache`; the loop
+               below still visits and locks the inputs in the same
+               order as before. */
+            {
+                std::vector<std::pair<FlakeRef, bool>> toFetch;
+                for (auto & [id, input2] : flakeInputs) {
+                    auto inputPath(inputPathPrefix);
+                    inputPath.push_back(id);
+                    auto i = overrides.find(inputPath);
+                    bool hasOverride = i != overrides.end();
+                    auto & ref = hasOverride && i->second.ref ? i->second.ref : input2.ref;
+                    auto & follows = hasOverride && i->second.follows ? i->second.follows : input2.follows;
+                    if (follows || !ref) continue;
+                    auto oldLock = findOldLock(id, inputPath);
+                    if (oldLock && oldLock->originalRef == *ref && !hasOverride) continue;
+                    if (!lockFlags.allowUnlocked && !ref->input.isLocked()) continue;
+                    toFetch.emplace_back(*ref, useRegistries);
+                }
+                prefetchTrees(state, toFetch, flakeCache);
+            }
+
             /* Go over the flake inputs, resolve/fetch them if
                necessary (i.e. if they're new or the flakeref changed
                from what's in the lock file). */
@@ -495,14 +581,9 @@ LockedFlake lockFlake(
 
                     /* Do we have an entry in the existing lock file?
                        And the input is not in updateInputs? */
-                    std::shared_ptr<LockedNode> oldLock;
-
                     updatesUsed.insert(inputPath);
 
-                    if (oldNode && !lockFlags.inputUpdates.count(inputPath))
-                        if (auto oldLock2 = get(oldNode->inputs, id))
-                            if (auto oldLock3 = std::get_if<0>(&*oldLock2))
-                                oldLock = *oldLock3;
+                    auto oldLock = findOldLock(id, inputPath);
 
                     if (oldLock
                         && oldLock->originalRef == *input.ref
@@ -890,10 +971,10 @@ static void prim_flakeRefToString(
     state.forceAttrs(*args[0], noPos,
         "while evaluating the argument passed to builtins.flakeRefToString");
     fetchers::Attrs attrs;
-    for (const auto & attr : *args[0]->attrs) {
+    for (const auto & attr : *args[0]->attrs()) {
         auto t = attr.value->type();
         if (t == nInt) {
-            auto intValue = attr.value->integer.value;
+            auto intValue = attr.value->integer().value;
 
             if (intValue < 0) {
                 state.error<EvalError>("negative value given for flake ref attr %1%: %2%", state.symbols[attr.name], intValue).atPos(pos).debugThrow();
@@ -903,7 +984,7 @@ static void prim_flakeRefToString(
             attrs.emplace(state.symbols[attr.name], asUnsigned);
         } else if (t == nBool) {
             attrs.emplace(state.symbols[attr.name],
-                          Explicit<bool> { attr.value->boolean });
+                          Explicit<bool> { attr.value->boolean() });
         } else if (t == nString) {
             attrs.emplace(state.symbols[attr.name],
                           std::string(attr.value->str()));
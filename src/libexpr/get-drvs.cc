@@ -157,7 +157,7 @@ void DrvInfo::fillOutputs(bool withPaths)
             state->forceAttrs(*out->value, outputs->pos, errMsg);
 
             // ...and evaluate its `outPath` attribute.
-            Attr * outPath = out->value->attrs->get(this->state->sOutPath);
+            Attr * outPath = out->value->attrs()->get(this->state->sOutPath);
             if (outPath == nullptr) {
                 continue;
                 // FIXME: throw error?
@@ -225,7 +225,7 @@ DrvInfo::Outputs DrvInfo::queryOutputs(bool withPaths, bool onlyOutputsToInstall
     Outputs result;
     for (auto elem : outTI->listItems()) {
         if (elem->type() != nString) throw errMsg;
-        auto out = outputs.find(elem->string.s);
+        auto out = outputs.find(elem->c_str());
         if (out == outputs.end()) throw errMsg;
         result.insert(*out);
     }
@@ -250,7 +250,7 @@ Bindings * DrvInfo::getMeta()
     Bindings::iterator a = attrs->find(state->sMeta);
     if (a == attrs->end()) return 0;
     state->forceAttrs(*a->value, a->pos, "while evaluating the 'meta' attribute of a derivation");
-    meta = a->value->attrs;
+    meta = a->value->attrs();
     return meta;
 }
 
@@ -274,9 +274,9 @@ bool DrvInfo::checkMeta(Value & v)
         return true;
     }
     else if (v.type() == nAttrs) {
-        Bindings::iterator i = v.attrs->find(state->sOutPath);
-        if (i != v.attrs->end()) return false;
-        for (auto & i : *v.attrs)
+        Bindings::iterator i = v.attrs()->find(state->sOutPath);
+        if (i != v.attrs()->end()) return false;
+        for (auto & i : *v.attrs())
             if (!checkMeta(*i.value)) return false;
         return true;
     }
@@ -298,7 +298,7 @@ std::string DrvInfo::queryMetaString(const std::string & name)
 {
     Value * v = queryMeta(name);
     if (!v || v->type() != nString) return "";
-    return v->string.s;
+    return v->c_str();
 }
 
 
@@ -306,11 +306,11 @@ NixInt DrvInfo::queryMetaInt(const std::string & name, NixInt def)
 {
     Value * v = queryMeta(name);
     if (!v) return def;
-    if (v->type() == nInt) return v->integer;
+    if (v->type() == nInt) return v->integer();
     if (v->type() == nString) {
         /* Backwards compatibility with before we had support for
            integer meta fields. */
-        if (auto n = string2Int<NixInt::Inner>(v->string.s))
+        if (auto n = string2Int<NixInt::Inner>(v->c_str()))
             return NixInt{*n};
     }
     return def;
@@ -320,11 +320,11 @@ NixFloat DrvInfo::queryMetaFloat(const std::string & name, NixFloat def)
 {
     Value * v = queryMeta(name);
     if (!v) return def;
-    if (v->type() == nFloat) return v->fpoint;
+    if (v->type() == nFloat) return v->fpoint();
     if (v->type() == nString) {
         /* Backwards compatibility with before we had support for
            float meta fields. */
-        if (auto n = string2Float<NixFloat>(v->string.s))
+        if (auto n = string2Float<NixFloat>(v->c_str()))
             return *n;
     }
     return def;
@@ -335,12 +335,12 @@ bool DrvInfo::queryMetaBool(const std::string & name, bool def)
 {
     Value * v = queryMeta(name);
     if (!v) return def;
-    if (v->type() == nBool) return v->boolean;
+    if (v->type() == nBool) return v->boolean();
     if (v->type() == nString) {
         /* Backwards compatibility with before we had support for
            Boolean meta fields. */
-        if (strcmp(v->string.s, "true") == 0) return true;
-        if (strcmp(v->string.s, "false") == 0) return false;
+        if (strcmp(v->c_str(), "true") == 0) return true;
+        if (strcmp(v->c_str(), "false") == 0) return false;
     }
     return def;
 }
@@ -374,7 +374,7 @@ static bool getDerivation(EvalState & state, Value & v,
         state.forceValue(v, v.determinePos(noPos));
         if (!state.isDerivation(v)) return true;
 
-        DrvInfo drv(state, attrPath, v.attrs);
+        DrvInfo drv(state, attrPath, v.attrs());
 
         drv.queryName();
 
@@ -454,7 +454,7 @@ static void getDerivations(EvalState & state, Value & vIn,
 
     /* Dont consider sets we've already seen, e.g. y in
        `rec { x.d = derivation {...}; y = x; }`. */
-    auto const &[_, didInsert] = done.insert(v.attrs);
+    auto const &[_, didInsert] = done.insert(v.attrs());
     if (!didInsert) {
         return;
     }
@@ -462,14 +462,14 @@ static void getDerivations(EvalState & state, Value & vIn,
     // FIXME: what the fuck???
     /* !!! undocumented hackery to support combining channels in
        nix-env.cc. */
-    bool combineChannels = v.attrs->find(state.symbols.create("_combineChannels")) != v.attrs->end();
+    bool combineChannels = v.attrs()->find(state.symbols.create("_combineChannels")) != v.attrs()->end();
 
     /* Consider the attributes in sorted order to get more
        deterministic behaviour in nix-env operations (e.g. when
        there are names clashes between derivations, the derivation
        bound to the attribute with the "lower" name should take
        precedence). */
-    for (auto & attr : v.attrs->lexicographicOrder(state.symbols)) {
+    for (auto & attr : v.attrs()->lexicographicOrder(state.symbols)) {
         debug("evaluating attribute '%1%'", state.symbols[attr->name]);
         // FIXME: only consider attrs with identifier-like names?? Why???
         if (!std::regex_match(std::string(state.symbols[attr->name]), attrRegex)) {
@@ -483,7 +483,7 @@ static void getDerivations(EvalState & state, Value & vIn,
                should we recurse into it?  => Only if it has a
                `recurseForDerivations = true' attribute. */
             if (attr->value->type() == nAttrs) {
-                Attr * recurseForDrvs = attr->value->attrs->get(state.sRecurseForDerivations);
+                Attr * recurseForDrvs = attr->value->attrs()->get(state.sRecurseForDerivations);
                 if (recurseForDrvs == nullptr) {
                     continue;
                 }
@@ -74,6 +74,7 @@ public:
     */
 
     void setName(const std::string & s) { name = s; }
+    void setSystem(const std::string & s) { system = s; }
     void setDrvPath(StorePath path) { drvPath = {{std::move(path)}}; }
     void setOutPath(StorePath path) { outPath = {{std::move(path)}}; }
 
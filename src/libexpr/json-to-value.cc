@@ -31,6 +31,15 @@ class JSONSax : nlohmann::json_sax<json> {
                 v = allocRootValue(state.allocValue());
             return **v;
         }
+        /* Refer to a shared constant instead of allocating a value,
+           unless the result has to be written to a given one. */
+        void share(Value & constant)
+        {
+            if (v)
+                **v = constant;
+            else
+                v = allocRootValue(&constant);
+        }
         virtual ~JSONState() {}
         virtual void add() {}
     };
@@ -38,6 +47,7 @@ class JSONSax : nlohmann::json_sax<json> {
     class JSONObjectState : public JSONState {
         using JSONState::JSONState;
         ValueMap attrs;
+        Symbol pendingKey;
         std::unique_ptr<JSONState> resolve(EvalState & state) override
         {
             auto attrs2 = state.buildBindings(attrs.size());
@@ -46,11 +56,15 @@ class JSONSax : nlohmann::json_sax<json> {
             parent->value(state).mkAttrs(attrs2.alreadySorted());
             return std::move(parent);
         }
-        void add() override { v = nullptr; }
+        void add() override
+        {
+            attrs.insert_or_assign(pendingKey, *v);
+            v = nullptr;
+        }
     public:
         void key(string_t & name, EvalState & state)
         {
-            attrs.insert_or_assign(state.symbols.create(name), &value(state));
+            pendingKey = state.symbols.create(name);
         }
     };
 
@@ -84,14 +98,14 @@ public:
 
     bool null() override
     {
-        rs->value(state).mkNull();
+        rs->share(state.vNull);
         rs->add();
         return true;
     }
 
     bool boolean(bool val) override
     {
-        rs->value(state).mkBool(val);
+        rs->share(*state.getBool(val));
         rs->add();
         return true;
     }
@@ -378,6 +378,8 @@ void ExprSelect::bindVars(EvalState & es, const std::shared_ptr<const StaticEnv>
     for (auto & i : attrPath)
         if (!i.symbol)
             i.expr->bindVars(es, env);
+
+    slotCache.resize(attrPath.size());
 }
 
 void ExprOpHasAttr::bindVars(EvalState & es, const std::shared_ptr<const StaticEnv> & env)
@@ -518,6 +520,9 @@ void ExprLet::bindVars(EvalState & es, const std::shared_ptr<const StaticEnv> &
         es.exprEnvs.insert(std::make_pair(this, env));
 
     body->bindVars(es, newEnv);
+
+    for (auto & [_, def] : attrs->attrs)
+        def.strict = def.e->isTotal() && body->forcesVar(0, def.displ);
 }
 
 void ExprWith::bindVars(EvalState & es, const std::shared_ptr<const StaticEnv> & env)
@@ -589,6 +594,51 @@ void ExprPos::bindVars(EvalState & es, const std::shared_ptr<const StaticEnv> &
 }
 
 
+/* Strictness analysis. This only has to be sound for expressions
+   that are evaluated to weak head normal form: a `true` result means
+   that the variable is forced whenever the expression is. */
+
+bool ExprVar::forcesVar(Level level, Displacement displ) const
+{
+    return !fromWith && this->level == level && this->displ == displ;
+}
+
+bool ExprIf::forcesVar(Level level, Displacement displ) const
+{
+    return cond->forcesVar(level, displ)
+        || (then->forcesVar(level, displ) && else_->forcesVar(level, displ));
+}
+
+bool ExprConcatStrings::forcesVar(Level level, Displacement displ) const
+{
+    return std::any_of(es.begin(), es.end(),
+        [&](auto & e) { return e.second->forcesVar(level, displ); });
+}
+
+#define BothOperands(name) \
+    bool name::forcesVar(Level level, Displacement displ) const \
+    { \
+        return e1->forcesVar(level, displ) || e2->forcesVar(level, displ); \
+    }
+
+#define FirstOperand(name) \
+    bool name::forcesVar(Level level, Displacement displ) const \
+    { \
+        return e1->forcesVar(level, displ); \
+    }
+
+BothOperands(ExprOpEq)
+BothOperands(ExprOpNEq)
+BothOperands(ExprOpUpdate)
+BothOperands(ExprOpConcatLists)
+FirstOperand(ExprOpAnd)
+FirstOperand(ExprOpOr)
+FirstOperand(ExprOpImpl)
+
+#undef BothOperands
+#undef FirstOperand
+
+
 /* Storing function names. */
 
 void Expr::setName(Symbol name)
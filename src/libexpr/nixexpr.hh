@@ -41,6 +41,9 @@ std::string showAttrPath(const SymbolTable & symbols, const AttrPath & attrPath)
 
 /* Abstract syntax of Nix expressions. */
 
+typedef uint32_t Level;
+typedef uint32_t Displacement;
+
 struct Expr
 {
 protected:
@@ -64,6 +67,26 @@ public:
     virtual Value * maybeThunk(EvalState & state, Env & env);
     virtual void setName(Symbol name);
     virtual PosIdx getPos() const { return noPos; }
+
+    /**
+     * Whether evaluating this expression always succeeds without
+     * forcing anything, so that it can be evaluated ahead of time
+     * wherever its value is known to be needed.
+     */
+    virtual bool isTotal() const { return false; }
+
+    /**
+     * Whether evaluating this expression always forces the variable
+     * at `displ` in the environment `level` levels up.
+     */
+    virtual bool forcesVar(Level level, Displacement displ) const { return false; }
+
+    /**
+     * Like maybeThunk(), for a position where the value is known to be
+     * forced: total expressions are evaluated right away instead of
+     * being wrapped in a thunk that would be overwritten shortly after.
+     */
+    Value * maybeThunkStrict(EvalState & state, Env & env);
 };
 
 #define COMMON_METHODS \
@@ -108,9 +131,6 @@ struct ExprPath : Expr
     COMMON_METHODS
 };
 
-typedef uint32_t Level;
-typedef uint32_t Displacement;
-
 struct ExprVar : Expr
 {
     PosIdx pos;
@@ -136,6 +156,7 @@ struct ExprVar : Expr
     ExprVar(const PosIdx & pos, Symbol name) : pos(pos), name(name) { };
     Value * maybeThunk(EvalState & state, Env & env) override;
     PosIdx getPos() const override { return pos; }
+    bool forcesVar(Level level, Displacement displ) const override;
     COMMON_METHODS
 };
 
@@ -175,9 +196,22 @@ struct ExprSelect : Expr
     /** The path of attributes being selected. e.g. `bar.baz` in `foo.bar.baz.` */
     AttrPath attrPath;
 
+    /**
+     * Inline cache: the slots at which each component of `attrPath` was
+     * most recently found. Attribute sets selected from at the same site
+     * tend to have the same layout, so these are checked before falling
+     * back to a binary search.
+     */
+    struct SlotCache
+    {
+        uint32_t slots[2] = {0, 0};
+    };
+    std::vector<SlotCache> slotCache;
+
     ExprSelect(const PosIdx & pos, std::unique_ptr<Expr> e, AttrPath attrPath, std::unique_ptr<Expr> def) : pos(pos), e(std::move(e)), def(std::move(def)), attrPath(std::move(attrPath)) { };
     ExprSelect(const PosIdx & pos, std::unique_ptr<Expr> e, Symbol name) : pos(pos), e(std::move(e)) { attrPath.push_back(AttrName(name)); };
     PosIdx getPos() const override { return pos; }
+    bool forcesVar(Level level, Displacement displ) const override { return e->forcesVar(level, displ); }
     COMMON_METHODS
 };
 
@@ -187,6 +221,7 @@ struct ExprOpHasAttr : Expr
     AttrPath attrPath;
     ExprOpHasAttr(std::unique_ptr<Expr> e, AttrPath attrPath) : e(std::move(e)), attrPath(std::move(attrPath)) { };
     PosIdx getPos() const override { return e->getPos(); }
+    bool forcesVar(Level level, Displacement displ) const override { return e->forcesVar(level, displ); }
     COMMON_METHODS
 };
 
@@ -208,6 +243,8 @@ struct ExprAttrs : Expr
         std::unique_ptr<Expr> e;
         PosIdx pos;
         Displacement displ; // displacement
+        /** Set for `let` bindings that the body always forces. */
+        bool strict = false;
         AttrDef(std::unique_ptr<Expr> e, const PosIdx & pos, Kind kind = Kind::Plain)
             : kind(kind), e(std::move(e)), pos(pos) { };
         AttrDef() { };
@@ -240,6 +277,7 @@ struct ExprAttrs : Expr
     ExprAttrs(const PosIdx &pos) : recursive(false), pos(pos) { };
     ExprAttrs() : recursive(false) { };
     PosIdx getPos() const override { return pos; }
+    bool isTotal() const override { return !recursive && dynamicAttrs.empty(); }
     COMMON_METHODS
 
     std::shared_ptr<const StaticEnv> bindInheritSources(
@@ -254,6 +292,8 @@ struct ExprList : Expr
     ExprList() { };
     COMMON_METHODS
     Value * maybeThunk(EvalState & state, Env & env) override;
+    /* The empty list is shared, so there is nothing to gain for it. */
+    bool isTotal() const override { return !elems.empty(); }
 
     PosIdx getPos() const override
     {
@@ -322,6 +362,8 @@ struct ExprLambda : Expr
     std::string showNamePos(const EvalState & state) const;
     inline bool hasFormals() const { return formals != nullptr; }
     PosIdx getPos() const override { return pos; }
+    Value * maybeThunk(EvalState & state, Env & env) override;
+    bool isTotal() const override { return true; }
 
     /** Returns the name of the lambda,
      * or "anonymous lambda" if it doesn't have one.
@@ -359,6 +401,7 @@ struct ExprCall : Expr
         : fun(std::move(fun)), args(std::move(args)), pos(pos)
     { }
     PosIdx getPos() const override { return pos; }
+    bool forcesVar(Level level, Displacement displ) const override { return fun->forcesVar(level, displ); }
     COMMON_METHODS
 };
 
@@ -367,6 +410,7 @@ struct ExprLet : Expr
     std::unique_ptr<ExprAttrs> attrs;
     std::unique_ptr<Expr> body;
     ExprLet(std::unique_ptr<ExprAttrs> attrs, std::unique_ptr<Expr> body) : attrs(std::move(attrs)), body(std::move(body)) { };
+    bool forcesVar(Level level, Displacement displ) const override { return body->forcesVar(level + 1, displ); }
     COMMON_METHODS
 };
 
@@ -378,6 +422,7 @@ struct ExprWith : Expr
     ExprWith * parentWith;
     ExprWith(const PosIdx & pos, std::unique_ptr<Expr> attrs, std::unique_ptr<Expr> body) : pos(pos), attrs(std::move(attrs)), body(std::move(body)) { };
     PosIdx getPos() const override { return pos; }
+    bool forcesVar(Level level, Displacement displ) const override { return body->forcesVar(level + 1, displ); }
     COMMON_METHODS
 };
 
@@ -387,6 +432,7 @@ struct ExprIf : Expr
     std::unique_ptr<Expr> cond, then, else_;
     ExprIf(const PosIdx & pos, std::unique_ptr<Expr> cond, std::unique_ptr<Expr> then, std::unique_ptr<Expr> else_) : pos(pos), cond(std::move(cond)), then(std::move(then)), else_(std::move(else_)) { };
     PosIdx getPos() const override { return pos; }
+    bool forcesVar(Level level, Displacement displ) const override;
     COMMON_METHODS
 };
 
@@ -396,6 +442,7 @@ struct ExprAssert : Expr
     std::unique_ptr<Expr> cond, body;
     ExprAssert(const PosIdx & pos, std::unique_ptr<Expr> cond, std::unique_ptr<Expr> body) : pos(pos), cond(std::move(cond)), body(std::move(body)) { };
     PosIdx getPos() const override { return pos; }
+    bool forcesVar(Level level, Displacement displ) const override { return cond->forcesVar(level, displ) || body->forcesVar(level, displ); }
     COMMON_METHODS
 };
 
@@ -404,6 +451,7 @@ struct ExprOpNot : Expr
     std::unique_ptr<Expr> e;
     ExprOpNot(std::unique_ptr<Expr> e) : e(std::move(e)) { };
     PosIdx getPos() const override { return e->getPos(); }
+    bool forcesVar(Level level, Displacement displ) const override { return e->forcesVar(level, displ); }
     COMMON_METHODS
 };
 
@@ -423,6 +471,7 @@ struct ExprOpNot : Expr
             e1->bindVars(es, env); e2->bindVars(es, env);    \
         } \
         void eval(EvalState & state, Env & env, Value & v) override; \
+        bool forcesVar(Level level, Displacement displ) const override; \
         PosIdx getPos() const override { return pos; } \
     };
 
@@ -442,6 +491,7 @@ struct ExprConcatStrings : Expr
     ExprConcatStrings(const PosIdx & pos, bool forceString, std::vector<std::pair<PosIdx, std::unique_ptr<Expr>>> es)
         : pos(pos), forceString(forceString), es(std::move(es)) { };
     PosIdx getPos() const override { return pos; }
+    bool forcesVar(Level level, Displacement displ) const override;
     COMMON_METHODS
 };
 
@@ -0,0 +1,91 @@
+#include "package-index.hh"
+#include "logging.hh"
+#include "sqlite.hh"
+#include "users.hh"
+
+namespace nix::eval_cache {
+
+static const char * schema = R"sql(
+create table if not exists Packages (
+    attrPath    text primary key not null,
+    name        text not null,
+    system      text not null,
+    description text not null
+);
+)sql";
+
+static Path packageIndexPath(const Hash & fingerprint)
+{
+    return getCacheDir() + "/nix/package-index-v1/" + fingerprint.to_string(Base::Base16, false) + ".sqlite";
+}
+
+std::optional<std::vector<PackageIndexEntry>> lookupPackageIndex(const Hash & fingerprint)
+{
+    auto dbPath = packageIndexPath(fingerprint);
+    if (!pathExists(dbPath)) return std::nullopt;
+
+    try {
+        SQLite db(dbPath);
+        db.isCache();
+
+        if (!Dependencies::checkTable(db, "package index"))
+            return std::nullopt;
+
+        std::vector<PackageIndexEntry> entries;
+        SQLiteStmt queryPackages;
+        queryPackages.create(db, "select attrPath, name, system, description from Packages order by attrPath");
+        auto packages(queryPackages.use());
+        while (packages.next())
+            entries.push_back({
+                .attrPath = packages.getStr(0),
+                .name = packages.getStr(1),
+                .system = packages.getStr(2),
+                .description = packages.getStr(3),
+            });
+        return entries;
+    } catch (SQLiteError & e) {
+        debug("cannot read package index '%s': %s", dbPath, e.what());
+        return std::nullopt;
+    }
+}
+
+void writePackageIndex(
+    const Hash & fingerprint,
+    const std::vector<PackageIndexEntry> & entries,
+    const Dependencies::Map & dependencies)
+{
+    for (auto & [key, _] : dependencies)
+        if (key.first == Dependencies::Type::Volatile) {
+            debug("not storing package index that depends on '%s'", key.second);
+            return;
+        }
+
+    auto dbPath = packageIndexPath(fingerprint);
+
+    try {
+        createDatabaseAtomically(dbPath, [&](SQLite & db) {
+            db.exec(schema);
+            Dependencies::createTable(db);
+
+            SQLiteTxn txn(db);
+
+            SQLiteStmt insertPackage;
+            insertPackage.create(db,
+                "insert or replace into Packages(attrPath, name, system, description) values (?, ?, ?, ?)");
+            for (auto & entry : entries)
+                insertPackage.use()
+                    (entry.attrPath)
+                    (entry.name)
+                    (entry.system)
+                    (entry.description).exec();
+
+            Dependencies::writeTable(db, dependencies);
+
+            txn.commit();
+        });
+    } catch (SQLiteError & e) {
+        debug("cannot write package index '%s': %s", dbPath, e.what());
+    }
+}
+
+}
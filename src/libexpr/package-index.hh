@@ -0,0 +1,37 @@
+#pragma once
+///@file
+
+#include "eval-cache.hh"
+
+namespace nix::eval_cache {
+
+/**
+ * What `nix-env -qa` needs to know about a derivation to select and
+ * list it, without going back to the evaluator.
+ */
+struct PackageIndexEntry
+{
+    std::string attrPath;
+    std::string name;
+    std::string system;
+    std::string description;
+};
+
+/**
+ * Return the package index stored under `fingerprint`, or nothing if
+ * there is none or if one of the dependencies it was computed from
+ * has changed since.
+ */
+std::optional<std::vector<PackageIndexEntry>> lookupPackageIndex(const Hash & fingerprint);
+
+/**
+ * Store `entries` under `fingerprint`, together with the
+ * dependencies of the evaluation that produced them. Indices that
+ * depend on something that cannot be checked are not stored.
+ */
+void writePackageIndex(
+    const Hash & fingerprint,
+    const std::vector<PackageIndexEntry> & entries,
+    const Dependencies::Map & dependencies);
+
+}
@@ -1,6 +1,8 @@
 #include "primops.hh"
 #include "eval-inline.hh"
+#include "eval-cache.hh"
 #include "eval-settings.hh"
+#include "eval-trace.hh"
 #include "store-api.hh"
 #include "fetchers.hh"
 #include "filetransfer.hh"
@@ -35,8 +37,8 @@ void emitTreeAttrs(
     attrs.alloc("narHash").mkString(narHash->to_string(Base::SRI, true));
 
     if (input.getType() == "git")
-        attrs.alloc("submodules").mkBool(
-            fetchers::maybeGetBoolAttr(input.attrs, "submodules").value_or(false));
+        attrs.insert(state.symbols.create("submodules"), state.getBool(
+            fetchers::maybeGetBoolAttr(input.attrs, "submodules").value_or(false)));
 
     if (!forceDirty) {
 
@@ -98,6 +100,29 @@ std::string fixURIForGit(std::string uri, EvalState & state)
         return fixURI(uri, state);
 }
 
+/**
+ * Fetch `input`, or when replaying an evaluation trace, return the
+ * tree and the locked input that the fetch returned while recording.
+ */
+static std::pair<fetchers::Tree, fetchers::Input> fetchTraced(EvalState & state, const fetchers::Input & input)
+{
+    auto res = state.trace->fetch("tree " + input.to_string(), [&]() {
+        auto [tree, input2] = input.fetch(state.store);
+        return nlohmann::json {
+            {"storePath", state.store->printStorePath(tree.storePath)},
+            {"input", fetchers::attrsToJSON(input2.toAttrs())},
+        };
+    });
+    auto storePath = state.store->parseStorePath(res["storePath"].get<std::string>());
+    return {
+        fetchers::Tree {
+            .actualPath = state.store->toRealPath(storePath),
+            .storePath = std::move(storePath),
+        },
+        fetchers::Input::fromAttrs(fetchers::jsonToAttrs(res["input"])),
+    };
+}
+
 struct FetchTreeParams {
     bool emptyRevFallback = false;
     bool allowNameArgument = false;
@@ -121,7 +146,7 @@ static void fetchTree(
 
         fetchers::Attrs attrs;
 
-        if (auto aType = args[0]->attrs->get(state.sType)) {
+        if (auto aType = args[0]->attrs()->get(state.sType)) {
             if (type)
                 state.error<EvalError>(
                     "unexpected attribute 'type'"
@@ -134,7 +159,7 @@ static void fetchTree(
 
         attrs.emplace("type", type.value());
 
-        for (auto & attr : *args[0]->attrs) {
+        for (auto & attr : *args[0]->attrs()) {
             if (attr.name == state.sType) continue;
             state.forceValue(*attr.value, attr.pos);
             if (attr.value->type() == nPath || attr.value->type() == nString) {
@@ -147,9 +172,9 @@ static void fetchTree(
                     : s);
             }
             else if (attr.value->type() == nBool)
-                attrs.emplace(state.symbols[attr.name], Explicit<bool>{attr.value->boolean});
+                attrs.emplace(state.symbols[attr.name], Explicit<bool>{attr.value->boolean()});
             else if (attr.value->type() == nInt) {
-                auto intValue = attr.value->integer.value;
+                auto intValue = attr.value->integer().value;
 
                 if (intValue < 0) {
                     state.error<EvalError>("negative value given for fetchTree attr %1%: %2%", state.symbols[attr.name], intValue).atPos(pos).debugThrow();
@@ -191,7 +216,12 @@ static void fetchTree(
         state.error<EvalError>("in pure evaluation mode, 'fetchTree' requires a locked input").atPos(pos).debugThrow();
     }
 
-    auto [tree, input2] = input.fetch(state.store);
+    if (state.dependencies && !input.isLocked())
+        state.dependencies->addVolatile(input.to_string());
+
+    auto [tree, input2] = state.trace
+        ? fetchTraced(state, input)
+        : input.fetch(state.store);
 
     state.allowPath(tree.storePath);
 
@@ -221,7 +251,7 @@ static void fetch(EvalState & state, const PosIdx pos, Value * * args, Value & v
 
     if (args[0]->type() == nAttrs) {
 
-        for (auto & attr : *args[0]->attrs) {
+        for (auto & attr : *args[0]->attrs()) {
             std::string_view n(state.symbols[attr.name]);
             if (n == "url")
                 url = state.forceStringNoCtx(*attr.value, attr.pos, "while evaluating the url we should fetch");
@@ -251,43 +281,53 @@ static void fetch(EvalState & state, const PosIdx pos, Value * * args, Value & v
     if (evalSettings.pureEval && !expectedHash)
         state.error<EvalError>("in pure evaluation mode, '%s' requires a 'sha256' argument", who).atPos(pos).debugThrow();
 
-    // early exit if pinned and already in the store
-    if (expectedHash && expectedHash->type == HashType::SHA256) {
-        auto expectedPath = state.store->makeFixedOutputPath(
-            name,
-            FixedOutputInfo {
-                .method = unpack ? FileIngestionMethod::Recursive : FileIngestionMethod::Flat,
-                .hash = *expectedHash,
-                .references = {}
-            });
-
-        if (state.store->isValidPath(expectedPath)) {
-            state.allowAndSetStorePathString(expectedPath, v);
-            return;
+    if (state.dependencies && !expectedHash)
+        state.dependencies->addVolatile(*url);
+
+    auto download = [&]() -> std::string {
+        // early exit if pinned and already in the store
+        if (expectedHash && expectedHash->type == HashType::SHA256) {
+            auto expectedPath = state.store->makeFixedOutputPath(
+                name,
+                FixedOutputInfo {
+                    .method = unpack ? FileIngestionMethod::Recursive : FileIngestionMethod::Flat,
+                    .hash = *expectedHash,
+                    .references = {}
+                });
+
+            if (state.store->isValidPath(expectedPath))
+                return state.store->printStorePath(expectedPath);
         }
-    }
 
-    // TODO: fetching may fail, yet the path may be substitutable.
-    //       https://github.com/NixOS/nix/issues/4313
-    auto storePath =
-        unpack
-        ? fetchers::downloadTarball(state.store, *url, name, (bool) expectedHash).tree.storePath
-        : fetchers::downloadFile(state.store, *url, name, (bool) expectedHash).storePath;
-
-    if (expectedHash) {
-        auto hash = unpack
-            ? state.store->queryPathInfo(storePath)->narHash
-            : hashFile(HashType::SHA256, state.store->toRealPath(storePath));
-        if (hash != *expectedHash) {
-            state.error<EvalError>(
-                "hash mismatch in file downloaded from '%s':\n  specified: %s\n  got:       %s",
-                *url,
-                expectedHash->to_string(Base::Base32, true),
-                hash.to_string(Base::Base32, true)
-            ).withExitStatus(102)
-            .debugThrow();
+        // TODO: fetching may fail, yet the path may be substitutable.
+        //       https://github.com/NixOS/nix/issues/4313
+        auto storePath =
+            unpack
+            ? fetchers::downloadTarball(state.store, *url, name, (bool) expectedHash).tree.storePath
+            : fetchers::downloadFile(state.store, *url, name, (bool) expectedHash).storePath;
+
+        if (expectedHash) {
+            auto hash = unpack
+                ? state.store->queryPathInfo(storePath)->narHash
+                : hashFile(HashType::SHA256, state.store->toRealPath(storePath));
+            if (hash != *expectedHash) {
+                state.error<EvalError>(
+                    "hash mismatch in file downloaded from '%s':\n  specified: %s\n  got:       %s",
+                    *url,
+                    expectedHash->to_string(Base::Base32, true),
+                    hash.to_string(Base::Base32, true)
+                ).withExitStatus(102)
+                .debugThrow();
+            }
         }
-    }
+
+        return state.store->printStorePath(storePath);
+    };
+
+    auto storePath = state.store->parseStorePath(
+        state.trace
+        ? state.trace->fetch(fmt("%s %s %s", who, name, *url), download).get<std::string>()
+        : download());
 
     state.allowAndSetStorePathString(storePath, v);
 }
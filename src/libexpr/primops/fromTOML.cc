@@ -14,6 +14,18 @@ static void prim_fromTOML(EvalState & state, const PosIdx pos, Value * * args, V
 
     std::function<void(Value &, toml::value)> visit;
 
+    /* Booleans and empty values refer to a shared constant, everything
+       else gets a value of its own. */
+    auto element = [&](const toml::value & t) -> Value * {
+        if (t.type() == toml::value_t::boolean)
+            return state.getBool(toml::get<bool>(t));
+        if (t.type() == toml::value_t::empty)
+            return &state.vNull;
+        auto v = state.allocValue();
+        visit(*v, t);
+        return v;
+    };
+
     visit = [&](Value & v, toml::value t) {
 
         switch(t.type())
@@ -28,7 +40,7 @@ static void prim_fromTOML(EvalState & state, const PosIdx pos, Value * * args, V
                     auto attrs = state.buildBindings(size);
 
                     for(auto & elem : table)
-                        visit(attrs.alloc(elem.first), elem.second);
+                        attrs.insert(state.symbols.create(elem.first), element(elem.second));
 
                     v.mkAttrs(attrs);
                 }
@@ -40,7 +52,7 @@ static void prim_fromTOML(EvalState & state, const PosIdx pos, Value * * args, V
                     size_t size = array.size();
                     state.mkList(v, size);
                     for (size_t i = 0; i < size; ++i)
-                        visit(*(v.listElems()[i] = state.allocValue()), array[i]);
+                        v.listElems()[i] = element(array[i]);
                 }
                 break;;
             case toml::value_t::boolean:
@@ -22,16 +22,16 @@ json printValueAsJSON(EvalState & state, bool strict,
     switch (v.type()) {
 
         case nInt:
-            out = v.integer.value;
+            out = v.integer().value;
             break;
 
         case nBool:
-            out = v.boolean;
+            out = v.boolean();
             break;
 
         case nString:
             copyContext(v, context);
-            out = v.string.s;
+            out = v.c_str();
             break;
 
         case nPath:
@@ -52,14 +52,14 @@ json printValueAsJSON(EvalState & state, bool strict,
                 out = *maybeString;
                 break;
             }
-            auto i = v.attrs->find(state.sOutPath);
-            if (i == v.attrs->end()) {
+            auto i = v.attrs()->find(state.sOutPath);
+            if (i == v.attrs()->end()) {
                 out = json::object();
                 StringSet names;
-                for (auto & j : *v.attrs)
+                for (auto & j : *v.attrs())
                     names.emplace(state.symbols[j.name]);
                 for (auto & j : names) {
-                    Attr & a(*v.attrs->find(state.symbols.create(j)));
+                    Attr & a(*v.attrs()->find(state.symbols.create(j)));
                     try {
                         out[j] = printValueAsJSON(state, strict, *a.value, a.pos, context, copyToStore);
                     } catch (Error & e) {
@@ -90,11 +90,11 @@ json printValueAsJSON(EvalState & state, bool strict,
         }
 
         case nExternal:
-            return v.external->printValueAsJSON(state, strict, context, copyToStore);
+            return v.external()->printValueAsJSON(state, strict, context, copyToStore);
             break;
 
         case nFloat:
-            out = v.fpoint;
+            out = v.fpoint();
             break;
 
         case nThunk:
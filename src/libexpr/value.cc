@@ -9,23 +9,21 @@
 namespace nix
 {
 
-static void copyContextToValue(Value & v, const NixStringContext & context)
+void Value::setContext(const NixStringContext & context)
 {
     if (!context.empty()) {
         size_t n = 0;
-        v.string.context = gcAllocType<char const *>(context.size() + 1);
+        auto contextPtr = gcAllocType<char const *>(context.size() + 1);
         for (auto & i : context)
-            v.string.context[n++] = gcCopyStringIfNeeded(i.to_string());
-        v.string.context[n] = 0;
+            contextPtr[n++] = gcCopyStringIfNeeded(i.to_string());
+        contextPtr[n] = 0;
+        setString(c_str(), contextPtr);
     }
 }
 
 Value::Value(primop_t, PrimOp & primop)
-    : internalType(tPrimOp)
-    , primOp(&primop)
-    , _primop_pad(0)
 {
-    primop.check();
+    mkPrimOp(&primop);
 }
 
 
@@ -39,10 +37,10 @@ PosIdx Value::determinePos(const PosIdx pos) const
     // Allow selecting a subset of enum values
     #pragma GCC diagnostic push
     #pragma GCC diagnostic ignored "-Wswitch-enum"
-    switch (internalType) {
-        case tAttrs: return attrs->pos;
-        case tLambda: return lambda.fun->pos;
-        case tApp: return app.left->determinePos(pos);
+    switch (internalType()) {
+        case tAttrs: return attrs()->pos;
+        case tLambda: return lambda().fun->pos;
+        case tApp: return app().left->determinePos(pos);
         default: return pos;
     }
     #pragma GCC diagnostic pop
@@ -51,50 +49,53 @@ PosIdx Value::determinePos(const PosIdx pos) const
 bool Value::isTrivial() const
 {
     return
-        internalType != tApp
-        && internalType != tPrimOpApp
-        && (internalType != tThunk
-            || (dynamic_cast<ExprAttrs *>(thunk.expr)
-                && static_cast<ExprAttrs *>(thunk.expr)->dynamicAttrs.empty())
-            || dynamic_cast<ExprLambda *>(thunk.expr)
-            || dynamic_cast<ExprList *>(thunk.expr));
+        !isApp()
+        && !isPrimOpApp()
+        && (!isThunk()
+            || (dynamic_cast<ExprAttrs *>(thunk().expr)
+                && static_cast<ExprAttrs *>(thunk().expr)->dynamicAttrs.empty())
+            || dynamic_cast<ExprLambda *>(thunk().expr)
+            || dynamic_cast<ExprList *>(thunk().expr));
 }
 
 PrimOp * Value::primOpAppPrimOp() const
 {
-    Value * left = primOpApp.left;
+    Value * left = primOpApp().left;
     while (left && !left->isPrimOp()) {
-        left = left->primOpApp.left;
+        left = left->primOpApp().left;
     }
 
     if (!left)
         return nullptr;
-    return left->primOp;
+    return left->primOp();
 }
 
 void Value::mkPrimOp(PrimOp * p)
 {
     p->check();
-    clearValue();
-    internalType = tPrimOp;
-    primOp = p;
+    setSingleWord(tPrimOp, p);
 }
 
 void Value::mkString(std::string_view s)
 {
-    mkString(gcCopyStringIfNeeded(s));
+    if (!setInlineString(s))
+        mkString(gcCopyStringIfNeeded(s));
 }
 
 void Value::mkString(std::string_view s, const NixStringContext & context)
 {
-    mkString(s);
-    copyContextToValue(*this, context);
+    if (context.empty())
+        mkString(s);
+    else {
+        mkString(gcCopyStringIfNeeded(s));
+        setContext(context);
+    }
 }
 
 void Value::mkStringMove(const char * s, const NixStringContext & context)
 {
     mkString(s);
-    copyContextToValue(*this, context);
+    setContext(context);
 }
 
 
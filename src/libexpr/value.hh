@@ -1,8 +1,10 @@
 #pragma once
 ///@file
 
+#include <bit>
 #include <cassert>
 #include <climits>
+#include <cstring>
 #include <functional>
 #include <ranges>
 #include <span>
@@ -31,15 +33,16 @@ typedef enum {
     tNull,
     tAttrs,
     tList1,
-    tList2,
     tListN,
+    tPrimOp,
+    tExternal,
+    tFloat,
+    /* The types stored as a pair of pointers, see `Value::ptPair`. They
+       must come last and stay within the range the tag bits can hold. */
     tThunk,
     tApp,
     tLambda,
-    tPrimOp,
     tPrimOpApp,
-    tExternal,
-    tFloat
 } InternalType;
 
 /**
@@ -191,10 +194,166 @@ struct NewValueAs
 struct Value
 {
 private:
-    InternalType internalType;
+    /**
+     * A value is two words. The low `tagBits` bits of the first one say
+     * how the rest is laid out; the pointers kept in tagged words are at
+     * least 8-byte aligned, so those bits are otherwise always zero. The
+     * garbage collector is told to accept pointers offset by a tag, see
+     * `initGC()`.
+     */
+    enum PrimaryTag : uintptr_t {
+        /**
+         * All zeroes, as left by the allocator.
+         */
+        ptUninitialized = 0,
+        /**
+         * The internal type in the rest of the first word, and the
+         * payload, if any, in the second word.
+         */
+        ptSingleWord,
+        /**
+         * The allocation holding the elements of a `tListN`, and its
+         * `ListN` in the second word.
+         */
+        ptListN,
+        /**
+         * The context of a `tString` (or null), and its characters in
+         * the second word.
+         */
+        ptString,
+        /**
+         * A `tString` without context of at most `maxInlineString`
+         * bytes, stored NUL-terminated in the bytes after the tag.
+         */
+        ptInlineString,
+        /**
+         * The first of a pair of pointers, with the second pointer in
+         * the second word, tagged with the internal type minus `tThunk`.
+         */
+        ptPair,
+    };
+
+    static constexpr unsigned tagBits = 3;
+    static constexpr uintptr_t tagMask = (uintptr_t(1) << tagBits) - 1;
+
+    static_assert(tPrimOpApp - tThunk <= tagMask);
+
+    /**
+     * Inline strings need the tag byte to be the first one of the value,
+     * so that the characters after it are contiguous.
+     */
+    static constexpr size_t maxInlineString =
+        std::endian::native == std::endian::little ? 2 * sizeof(uintptr_t) - 2 : 0;
+
+    /**
+     * The second word of a `tListN`: the `size` elements starting at
+     * `elems[offset]`, where `elems` is the start of the allocation (in
+     * the first word), which keeps it alive for the garbage collector
+     * while the list shares it with the list it is a suffix of.
+     *
+     * If `growable` is set, the allocation starts with a header that
+     * lets `EvalState::concatLists` append to it in place.
+     */
+    struct ListN
+    {
+        uint32_t size;
+        uint32_t offset : 31;
+        uint32_t growable : 1;
+    };
+
+    static_assert(sizeof(ListN) == sizeof(uintptr_t));
+
+    uintptr_t payload[2];
 
     friend std::string showType(const Value & v);
 
+    InternalType internalType() const
+    {
+        switch (payload[0] & tagMask) {
+            case ptSingleWord: return static_cast<InternalType>(payload[0] >> tagBits);
+            case ptListN: return tListN;
+            case ptString: case ptInlineString: return tString;
+            case ptPair: return static_cast<InternalType>(tThunk + (payload[1] & tagMask));
+            default: return static_cast<InternalType>(0);
+        }
+    }
+
+    static uintptr_t untagged(const void * p)
+    {
+        auto word = reinterpret_cast<uintptr_t>(p);
+        assert(!(word & tagMask));
+        return word;
+    }
+
+    template<typename T>
+    T * firstPointer() const
+    {
+        return reinterpret_cast<T *>(payload[0] & ~tagMask);
+    }
+
+    template<typename T>
+    T * secondPointer() const
+    {
+        return reinterpret_cast<T *>(payload[1] & ~tagMask);
+    }
+
+    void setSingleWord(InternalType type, uintptr_t word = 0)
+    {
+        payload[0] = ptSingleWord | (static_cast<uintptr_t>(type) << tagBits);
+        payload[1] = word;
+    }
+
+    void setSingleWord(InternalType type, const void * p)
+    {
+        setSingleWord(type, reinterpret_cast<uintptr_t>(p));
+    }
+
+    void setPair(InternalType type, const void * first, const void * second)
+    {
+        payload[0] = untagged(first) | ptPair;
+        payload[1] = untagged(second) | (type - tThunk);
+    }
+
+    void setListN(Value * * elems, size_t offset, size_t size, bool growable)
+    {
+        payload[0] = untagged(elems) | ptListN;
+        payload[1] = std::bit_cast<uintptr_t>(ListN {
+            .size = static_cast<uint32_t>(size),
+            .offset = static_cast<uint32_t>(offset),
+            .growable = growable,
+        });
+    }
+
+    ListN listN() const
+    {
+        return std::bit_cast<ListN>(payload[1]);
+    }
+
+    /**
+     * Store `s` inline if it fits, and return whether it did.
+     */
+    bool setInlineString(std::string_view s)
+    {
+        if (!maxInlineString || s.size() > maxInlineString)
+            return false;
+        /* `s` may point into this value. */
+        uintptr_t words[2] = {0, 0};
+        auto bytes = reinterpret_cast<char *>(words);
+        bytes[0] = ptInlineString;
+        memcpy(bytes + 1, s.data(), s.size());
+        payload[0] = words[0];
+        payload[1] = words[1];
+        return true;
+    }
+
+    void setString(const char * s, const char * * context)
+    {
+        payload[0] = untagged(context) | ptString;
+        payload[1] = reinterpret_cast<uintptr_t>(s);
+    }
+
+    void setContext(const NixStringContext & context);
+
 public:
 
     // Discount `using NewValueAs::*;`
@@ -220,38 +379,29 @@ public:
     /// Default constructor which is still used in the codebase but should not
     /// be used in new code. Zero initializes its members.
     [[deprecated]] Value()
-        : internalType(static_cast<InternalType>(0))
-        , _empty{ 0, 0 }
+        : payload{ 0, 0 }
     { }
 
     /// Constructs a nix language value of type "int", with the integral value
     /// of @ref i.
     Value(integer_t, NixInt i)
-        : internalType(tInt)
-        , _empty{ 0, 0 }
     {
-        // the NixInt ctor here is is special because NixInt has a ctor too, so
-        // we're not allowed to have it as an anonymous aggreagte member. we do
-        // however still have the option to clear the data members using _empty
-        // and leaving the second word of data cleared by setting only integer.
-        integer = i;
+        mkInt(i);
     }
 
     /// Constructs a nix language value of type "float", with the floating
     /// point value of @ref f.
     Value(floating_t, NixFloat f)
-        : internalType(tFloat)
-        , fpoint(f)
-        , _float_pad(0)
-    { }
+    {
+        mkFloat(f);
+    }
 
     /// Constructs a nix language value of type "bool", with the boolean
     /// value of @ref b.
     Value(boolean_t, bool b)
-        : internalType(tBool)
-        , boolean(b)
-        , _bool_pad(0)
-    { }
+    {
+        mkBool(b);
+    }
 
     /// Constructs a nix language value of type "string", with the value of the
     /// C-string pointed to by @ref strPtr, and optionally with an array of
@@ -261,35 +411,21 @@ public:
     /// assumes suitable memory has already been allocated (with the GC if
     /// enabled), and string and context data copied into that memory.
     Value(string_t, char const * strPtr, char const ** contextPtr = nullptr)
-        : internalType(tString)
-        , string({ .s = strPtr, .context = contextPtr })
-    { }
+    {
+        setString(strPtr, contextPtr);
+    }
 
     /// Constructx a nix language value of type "string", with a copy of the
     /// string data viewed by @ref copyFrom.
     ///
     /// The string data *is* copied from @ref copyFrom, and this constructor
-    /// performs a dynamic (GC) allocation to do so.
+    /// performs a dynamic (GC) allocation to do so, unless the string is
+    /// short enough to be stored inline.
     Value(string_t, std::string_view copyFrom, NixStringContext const & context = {})
-        : internalType(tString)
-        , string({ .s = gcCopyStringIfNeeded(copyFrom), .context = nullptr })
     {
-        if (context.empty()) {
-            // It stays nullptr.
-            return;
-        }
-
-        // Copy the context.
-        this->string.context = gcAllocType<char const *>(context.size() + 1);
-
-        size_t n = 0;
-        for (NixStringContextElem const & contextElem : context) {
-            this->string.context[n] = gcCopyStringIfNeeded(contextElem.to_string());
-            n += 1;
-        }
-
-        // Terminator sentinel.
-        this->string.context[n] = nullptr;
+        if (!context.empty() || !setInlineString(copyFrom))
+            setString(gcCopyStringIfNeeded(copyFrom), nullptr);
+        setContext(context);
     }
 
     /// Constructx a nix language value of type "string", with the value of the
@@ -302,25 +438,9 @@ public:
     /// @ref context, and this constructor performs a dynamic (GC) allocation
     /// to do so.
     Value(string_t, char const * strPtr, NixStringContext const & context)
-        : internalType(tString)
-        , string({ .s = strPtr, .context = nullptr })
     {
-        if (context.empty()) {
-            // It stays nullptr
-            return;
-        }
-
-        // Copy the context.
-        this->string.context = gcAllocType<char const *>(context.size() + 1);
-
-        size_t n = 0;
-        for (NixStringContextElem const & contextElem : context) {
-            this->string.context[n] = gcCopyStringIfNeeded(contextElem.to_string());
-            n += 1;
-        }
-
-        // Terminator sentinel.
-        this->string.context[n] = nullptr;
+        setString(strPtr, nullptr);
+        setContext(context);
     }
 
     /// Constructs a nix language value of type "path", with the value of the
@@ -330,10 +450,9 @@ public:
     /// has already been allocated (with the GC if enabled), and string data
     /// has been copied into that memory.
     Value(path_t, char const * strPtr)
-        : internalType(tPath)
-        , _path(strPtr)
-        , _path_pad(0)
-    { }
+    {
+        mkPath(strPtr);
+    }
 
     /// Constructs a nix language value of type "path", with the path
     /// @ref path.
@@ -341,10 +460,9 @@ public:
     /// The data from @ref path *is* copied, and this constructor performs a
     /// dynamic (GC) allocation to do so.
     Value(path_t, SourcePath const & path)
-        : internalType(tPath)
-        , _path(gcCopyStringIfNeeded(path.path.abs()))
-        , _path_pad(0)
-    { }
+    {
+        mkPath(gcCopyStringIfNeeded(path.path.abs()));
+    }
 
     /// Constructs a nix language value of type "list", with element array
     /// @ref items.
@@ -354,25 +472,15 @@ public:
     /// memory that has already been allocated (with the GC if enabled), and
     /// an array of valid Value pointers has been copied into that memory.
     ///
-    /// Howver, as an implementation detail, if @ref items is only 2 items or
-    /// smaller, the list is stored inline, and the Value pointers in
-    /// @ref items are shallow copied into this structure, without dynamically
-    /// allocating memory.
+    /// Howver, as an implementation detail, if @ref items is only 1 item, the
+    /// list is stored inline, and the Value pointer in @ref items is shallow
+    /// copied into this structure, without dynamically allocating memory.
     Value(list_t, std::span<Value *> items)
     {
-        if (items.size() == 1) {
-            this->internalType = tList1;
-            this->smallList[0] = items[0];
-            this->smallList[1] = nullptr;
-        } else if (items.size() == 2) {
-            this->internalType = tList2;
-            this->smallList[0] = items[0];
-            this->smallList[1] = items[1];
-        } else {
-            this->internalType = tListN;
-            this->bigList.size = items.size();
-            this->bigList.elems = items.data();
-        }
+        if (items.size() == 1)
+            setSingleWord(tList1, items[0]);
+        else
+            setListN(items.data(), 0, items.size(), false);
     }
 
     /// Constructs a nix language value of type "list", with an element array
@@ -389,31 +497,22 @@ public:
     Value(list_t, SizedIterableT & items, TransformerT const & transformer)
     {
         if (items.size() == 1) {
-            this->internalType = tList1;
-            this->smallList[0] = transformer(*items.begin());
-            this->smallList[1] = nullptr;
-        } else if (items.size() == 2) {
-            this->internalType = tList2;
-            auto it = items.begin();
-            this->smallList[0] = transformer(*it);
-            it++;
-            this->smallList[1] = transformer(*it);
+            setSingleWord(tList1, transformer(*items.begin()));
         } else {
-            this->internalType = tListN;
-            this->bigList.size = items.size();
-            this->bigList.elems = gcAllocType<Value *>(items.size());
+            auto elems = gcAllocType<Value *>(items.size());
             auto it = items.begin();
             for (size_t i = 0; i < items.size(); i++, it++) {
-                this->bigList.elems[i] = transformer(*it);
+                elems[i] = transformer(*it);
             }
+            setListN(elems, 0, items.size(), false);
         }
     }
 
     /// Constructs a nix language value of the singleton type "null".
     Value(null_t)
-        : internalType(tNull)
-        , _empty{0, 0}
-    { }
+    {
+        mkNull();
+    }
 
     /// Constructs a nix language value of type "set", with the attribute
     /// bindings pointed to by @ref bindings.
@@ -421,19 +520,18 @@ public:
     /// The bindings are not not copied; this constructor assumes @ref bindings
     /// has already been suitably allocated by something like nix::buildBindings.
     Value(attrs_t, Bindings * bindings)
-        : internalType(tAttrs)
-        , attrs(bindings)
-        , _attrs_pad(0)
-    { }
+    {
+        mkAttrs(bindings);
+    }
 
     /// Constructs a nix language lazy delayed computation, or "thunk".
     ///
     /// The thunk stores the environment it will be computed in @ref env, and
     /// the expression that will need to be evaluated @ref expr.
     Value(thunk_t, Env & env, Expr & expr)
-        : internalType(tThunk)
-        , thunk({ .env = &env, .expr = &expr })
-    { }
+    {
+        mkThunk(&env, expr);
+    }
 
     /// Constructs a nix language value of type "lambda", which represents
     /// a builtin, primitive operation ("primop"), from the primop
@@ -443,24 +541,23 @@ public:
     /// Constructs a nix language value of type "lambda", which represents a
     /// partially applied primop.
     Value(primOpApp_t, Value & lhs, Value & rhs)
-        : internalType(tPrimOpApp)
-        , primOpApp({ .left = &lhs, .right = &rhs })
-    { }
+    {
+        mkPrimOpApp(&lhs, &rhs);
+    }
 
     /// Constructs a nix language value of type "lambda", which represents a
     /// lazy partial application of another lambda.
     Value(app_t, Value & lhs, Value & rhs)
-        : internalType(tApp)
-        , app({ .left = &lhs, .right = &rhs })
-    { }
+    {
+        mkApp(&lhs, &rhs);
+    }
 
     /// Constructs a nix language value of type "external", which is only used
     /// by plugins. Do any existing plugins even use this mechanism?
     Value(external_t, ExternalValueBase & external)
-        : internalType(tExternal)
-        , external(&external)
-        , _external_pad(0)
-    { }
+    {
+        mkExternal(&external);
+    }
 
     /// Constructs a nix language value of type "lambda", which represents a
     /// run of the mill lambda defined in nix code.
@@ -469,23 +566,22 @@ public:
     /// the lambda expression itself @ref lambda, which will not be evaluated
     /// until it is applied.
     Value(lambda_t, Env & env, ExprLambda & lambda)
-        : internalType(tLambda)
-        , lambda({ .env = &env, .fun = &lambda })
-    { }
+    {
+        mkLambda(&env, &lambda);
+    }
 
     /// Constructs an evil thunk, whose evaluation represents infinite recursion.
     explicit Value(blackhole_t)
-        : internalType(tThunk)
-        , thunk({ .env = nullptr, .expr = eBlackHoleAddr })
-    { }
+    {
+        mkBlackhole();
+    }
 
     Value(Value const & rhs) = default;
 
     /// Move constructor. Does the same thing as the copy constructor, but
     /// also zeroes out the other Value.
     Value(Value && rhs)
-        : internalType(rhs.internalType)
-        , _empty{ 0, 0 }
+        : payload{ 0, 0 }
     {
         *this = std::move(rhs);
     }
@@ -500,9 +596,8 @@ public:
         *this = static_cast<const Value &>(rhs);
         if (this != &rhs) {
             // Kill `rhs`, because non-destructive move lol.
-            rhs.internalType = static_cast<InternalType>(0);
-            rhs._empty[0] = 0;
-            rhs._empty[1] = 0;
+            rhs.payload[0] = 0;
+            rhs.payload[1] = 0;
         }
         return *this;
     }
@@ -514,97 +609,17 @@ public:
     // needed by callers into methods of this type
 
     // type() == nThunk
-    inline bool isThunk() const { return internalType == tThunk; };
-    inline bool isApp() const { return internalType == tApp; };
+    inline bool isThunk() const { return isPair(tThunk); };
+    inline bool isApp() const { return isPair(tApp); };
     inline bool isBlackhole() const
     {
-        return internalType == tThunk && thunk.expr == eBlackHoleAddr;
+        return isThunk() && thunk().expr == eBlackHoleAddr;
     }
 
     // type() == nFunction
-    inline bool isLambda() const { return internalType == tLambda; };
-    inline bool isPrimOp() const { return internalType == tPrimOp; };
-    inline bool isPrimOpApp() const { return internalType == tPrimOpApp; };
-
-    union
-    {
-        /// Dummy field, which takes up as much space as the largest union variants
-        /// to set the union's memory to zeroed memory.
-        uintptr_t _empty[2];
-
-        NixInt integer;
-        struct {
-            bool boolean;
-            uintptr_t _bool_pad;
-        };
-
-        /**
-         * Strings in the evaluator carry a so-called `context` which
-         * is a list of strings representing store paths.  This is to
-         * allow users to write things like
-
-         *   "--with-freetype2-library=" + freetype + "/lib"
-
-         * where `freetype` is a derivation (or a source to be copied
-         * to the store).  If we just concatenated the strings without
-         * keeping track of the referenced store paths, then if the
-         * string is used as a derivation attribute, the derivation
-         * will not have the correct dependencies in its inputDrvs and
-         * inputSrcs.
-
-         * The semantics of the context is as follows: when a string
-         * with context C is used as a derivation attribute, then the
-         * derivations in C will be added to the inputDrvs of the
-         * derivation, and the other store paths in C will be added to
-         * the inputSrcs of the derivations.
-
-         * For canonicity, the store paths should be in sorted order.
-         */
-        struct {
-            const char * s;
-            const char * * context; // must be in sorted order
-        } string;
-
-        struct {
-            const char * _path;
-            uintptr_t _path_pad;
-        };
-        struct {
-            Bindings * attrs;
-            uintptr_t _attrs_pad;
-        };
-        struct {
-            size_t size;
-            Value * * elems;
-        } bigList;
-        Value * smallList[2];
-        struct {
-            Env * env;
-            Expr * expr;
-        } thunk;
-        struct {
-            Value * left, * right;
-        } app;
-        struct {
-            Env * env;
-            ExprLambda * fun;
-        } lambda;
-        struct {
-            PrimOp * primOp;
-            uintptr_t _primop_pad;
-        };
-        struct {
-            Value * left, * right;
-        } primOpApp;
-        struct {
-            ExternalValueBase * external;
-            uintptr_t _external_pad;
-        };
-        struct {
-            NixFloat fpoint;
-            uintptr_t _float_pad;
-        };
-    };
+    inline bool isLambda() const { return isPair(tLambda); };
+    inline bool isPrimOp() const { return internalType() == tPrimOp; };
+    inline bool isPrimOpApp() const { return isPair(tPrimOpApp); };
 
     /**
      * Returns the normal type of a Value. This only returns nThunk if
@@ -615,14 +630,14 @@ public:
      */
     inline ValueType type(bool invalidIsThunk = false) const
     {
-        switch (internalType) {
+        switch (internalType()) {
             case tInt: return nInt;
             case tBool: return nBool;
             case tString: return nString;
             case tPath: return nPath;
             case tNull: return nNull;
             case tAttrs: return nAttrs;
-            case tList1: case tList2: case tListN: return nList;
+            case tList1: case tListN: return nList;
             case tLambda: case tPrimOp: case tPrimOpApp: return nFunction;
             case tExternal: return nExternal;
             case tFloat: return nFloat;
@@ -634,15 +649,6 @@ public:
             abort();
     }
 
-    /**
-     * After overwriting an app node, be sure to clear pointers in the
-     * Value to ensure that the target isn't kept alive unnecessarily.
-     */
-    inline void clearValue()
-    {
-        app.left = app.right = 0;
-    }
-
     inline void mkInt(NixInt::Inner n)
     {
         mkInt(NixInt{n});
@@ -650,23 +656,17 @@ public:
 
     inline void mkInt(NixInt n)
     {
-        clearValue();
-        internalType = tInt;
-        integer = n;
+        setSingleWord(tInt, std::bit_cast<uintptr_t>(n.value));
     }
 
     inline void mkBool(bool b)
     {
-        clearValue();
-        internalType = tBool;
-        boolean = b;
+        setSingleWord(tBool, uintptr_t(b));
     }
 
     inline void mkString(const char * s, const char * * context = 0)
     {
-        internalType = tString;
-        string.s = s;
-        string.context = context;
+        setString(s, context);
     }
 
     void mkString(std::string_view s);
@@ -679,73 +679,97 @@ public:
 
     inline void mkPath(const char * path)
     {
-        clearValue();
-        internalType = tPath;
-        _path = path;
+        setSingleWord(tPath, path);
     }
 
     inline void mkNull()
     {
-        clearValue();
-        internalType = tNull;
+        setSingleWord(tNull);
     }
 
     inline void mkAttrs(Bindings * a)
     {
-        clearValue();
-        internalType = tAttrs;
-        attrs = a;
+        setSingleWord(tAttrs, a);
     }
 
     Value & mkAttrs(BindingsBuilder & bindings);
 
+    /**
+     * Make this a list of `size` elements. Lists of more than one
+     * element must then be given their storage with `mkList(elems,
+     * size)`, which `EvalState::mkList()` does.
+     */
     inline void mkList(size_t size)
     {
-        clearValue();
         if (size == 1)
-            internalType = tList1;
-        else if (size == 2)
-            internalType = tList2;
-        else {
-            internalType = tListN;
-            bigList.size = size;
+            setSingleWord(tList1);
+        else
+            setListN(nullptr, 0, size, false);
+    }
+
+    /**
+     * Make this the list of the `size` elements at `elems`, which must be
+     * the start of an allocation.
+     */
+    inline void mkList(Value * * elems, size_t size)
+    {
+        setListN(elems, 0, size, false);
+    }
+
+    /**
+     * Make this the list of the `size` elements of `list` starting at
+     * `start`. Lists of more than one element share the storage of
+     * `list`, so this never allocates.
+     */
+    inline void mkListSlice(const Value & list, size_t start, size_t size)
+    {
+        assert(start + size <= list.listSize());
+        if (size != 1) {
+            if (list.internalType() == tListN) {
+                auto l = list.listN();
+                setListN(list.firstPointer<Value *>(), l.offset + start, size, l.growable);
+            } else
+                mkList(0);
+            return;
         }
+        setSingleWord(tList1, list.listElems()[start]);
+    }
+
+    /**
+     * Make this a growable list: the `size` elements starting at
+     * `elems[offset]`, where `elems` starts with the header described
+     * in `EvalState::concatLists`.
+     */
+    inline void mkGrowableList(Value * * elems, size_t offset, size_t size)
+    {
+        setListN(elems, offset, size, true);
     }
 
     inline void mkThunk(Env * e, Expr & ex)
     {
-        internalType = tThunk;
-        thunk.env = e;
-        thunk.expr = &ex;
+        setPair(tThunk, e, &ex);
     }
 
     inline void mkApp(Value * l, Value * r)
     {
-        internalType = tApp;
-        app.left = l;
-        app.right = r;
+        setPair(tApp, l, r);
     }
 
     inline void mkLambda(Env * e, ExprLambda * f)
     {
-        internalType = tLambda;
-        lambda.env = e;
-        lambda.fun = f;
+        setPair(tLambda, e, f);
     }
 
     inline void mkBlackhole()
     {
-        internalType = tThunk;
-        thunk.expr = eBlackHoleAddr;
+        setPair(tThunk, nullptr, eBlackHoleAddr);
     }
 
     void mkPrimOp(PrimOp * p);
 
     inline void mkPrimOpApp(Value * l, Value * r)
     {
-        internalType = tPrimOpApp;
-        primOpApp.left = l;
-        primOpApp.right = r;
+        setPair(tPrimOpApp, l, r);
     }
 
     /**
@@ -755,36 +779,57 @@ public:
 
     inline void mkExternal(ExternalValueBase * e)
     {
-        clearValue();
-        internalType = tExternal;
-        external = e;
+        setSingleWord(tExternal, e);
     }
 
     inline void mkFloat(NixFloat n)
     {
-        clearValue();
-        internalType = tFloat;
-        fpoint = n;
+        setSingleWord(tFloat, std::bit_cast<uintptr_t>(n));
     }
 
     bool isList() const
     {
-        return internalType == tList1 || internalType == tList2 || internalType == tListN;
+        auto t = internalType();
+        return t == tList1 || t == tListN;
     }
 
     Value * * listElems()
     {
-        return internalType == tList1 || internalType == tList2 ? smallList : bigList.elems;
+        return internalType() == tList1
+            ? reinterpret_cast<Value * *>(&payload[1])
+            : firstPointer<Value *>() + listN().offset;
     }
 
     Value * const * listElems() const
     {
-        return internalType == tList1 || internalType == tList2 ? smallList : bigList.elems;
+        return const_cast<Value *>(this)->listElems();
     }
 
     size_t listSize() const
     {
-        return internalType == tList1 ? 1 : internalType == tList2 ? 2 : bigList.size;
+        return internalType() == tList1 ? 1 : listN().size;
+    }
+
+    /**
+     * For a list of more than one element, the start of the allocation
+     * holding its elements, and whether it is growable, see
+     * `mkGrowableList()`.
+     */
+    Value * * listStorage() const
+    {
+        assert(internalType() == tListN);
+        return firstPointer<Value *>();
+    }
+
+    bool listGrowable() const
+    {
+        return internalType() == tListN && listN().growable;
+    }
+
+    size_t listOffset() const
+    {
+        assert(internalType() == tListN);
+        return listN().offset;
     }
 
     PosIdx determinePos(const PosIdx pos) const;
@@ -824,19 +869,141 @@ public:
         return ConstListIterable { begin, begin + listSize() };
     }
 
-    SourcePath path() const
+    NixInt integer() const
+    {
+        return NixInt{std::bit_cast<NixInt::Inner>(payload[1])};
+    }
+
+    bool boolean() const
+    {
+        return payload[1];
+    }
+
+    NixFloat fpoint() const
     {
-        assert(internalType == tPath);
-        return SourcePath{CanonPath(_path)};
+        return std::bit_cast<NixFloat>(payload[1]);
+    }
+
+    /**
+     * The characters of a string. Short strings are stored in the value
+     * itself, so this is only valid as long as the value is and isn't
+     * overwritten, unlike with the other payload pointers.
+     */
+    const char * c_str() const
+    {
+        assert(internalType() == tString);
+        return (payload[0] & tagMask) == ptInlineString
+            ? reinterpret_cast<const char *>(payload) + 1
+            : reinterpret_cast<const char *>(payload[1]);
     }
 
     std::string_view str() const
     {
-        assert(internalType == tString);
-        return std::string_view(string.s);
+        return std::string_view(c_str());
+    }
+
+    /**
+     * Strings in the evaluator carry a so-called `context` which
+     * is a list of strings representing store paths.  This is to
+     * allow users to write things like
+
+     *   "--with-freetype2-library=" + freetype + "/lib"
+
+     * where `freetype` is a derivation (or a source to be copied
+     * to the store).  If we just concatenated the strings without
+     * keeping track of the referenced store paths, then if the
+     * string is used as a derivation attribute, the derivation
+     * will not have the correct dependencies in its inputDrvs and
+     * inputSrcs.
+
+     * The semantics of the context is as follows: when a string
+     * with context C is used as a derivation attribute, then the
+     * derivations in C will be added to the inputDrvs of the
+     * derivation, and the other store paths in C will be added to
+     * the inputSrcs of the derivations.
+
+     * For canonicity, the store paths should be in sorted order.
+     * The array is null-terminated, or the context is null if empty.
+     */
+    const char * * context() const
+    {
+        assert(internalType() == tString);
+        return (payload[0] & tagMask) == ptString ? firstPointer<const char *>() : nullptr;
+    }
+
+    const char * pathStr() const
+    {
+        assert(internalType() == tPath);
+        return reinterpret_cast<const char *>(payload[1]);
+    }
+
+    SourcePath path() const
+    {
+        return SourcePath{CanonPath(pathStr())};
+    }
+
+    Bindings * attrs() const
+    {
+        return reinterpret_cast<Bindings *>(payload[1]);
+    }
+
+    struct ClosureThunk
+    {
+        Env * env;
+        Expr * expr;
+    };
+
+    ClosureThunk thunk() const
+    {
+        return {firstPointer<Env>(), secondPointer<Expr>()};
+    }
+
+    struct FunctionApplicationThunk
+    {
+        Value * left, * right;
+    };
+
+    FunctionApplicationThunk app() const
+    {
+        return {firstPointer<Value>(), secondPointer<Value>()};
+    }
+
+    struct Lambda
+    {
+        Env * env;
+        ExprLambda * fun;
+    };
+
+    Lambda lambda() const
+    {
+        return {firstPointer<Env>(), secondPointer<ExprLambda>()};
+    }
+
+    PrimOp * primOp() const
+    {
+        return reinterpret_cast<PrimOp *>(payload[1]);
+    }
+
+    FunctionApplicationThunk primOpApp() const
+    {
+        return {firstPointer<Value>(), secondPointer<Value>()};
+    }
+
+    ExternalValueBase * external() const
+    {
+        return reinterpret_cast<ExternalValueBase *>(payload[1]);
+    }
+
+private:
+
+    bool isPair(InternalType type) const
+    {
+        return (payload[0] & tagMask) == ptPair && (payload[1] & tagMask) == static_cast<uintptr_t>(type - tThunk);
     }
 };
 
+static_assert(sizeof(Value) == 2 * sizeof(uintptr_t));
+
 using ValueVector = GcVector<Value *>;
 using ValueMap = GcMap<Symbol, Value *>;
 using ValueVectorMap = std::map<Symbol, ValueVector>;
@@ -91,6 +91,14 @@ struct FetchSettings : public Config
         "Whether to use flake registries to resolve flake references.",
         {}, true, Xp::Flakes};
 
+    Setting<unsigned int> flakeInputFetchJobs{this, 8, "flake-input-fetch-jobs",
+        R"(
+          Maximum number of flake inputs that are fetched concurrently while
+          computing a lock file. Setting this to 0 or 1 fetches inputs one at
+          a time.
+        )",
+        {}, true, Xp::Flakes};
+
     Setting<AcceptFlakeConfig> acceptFlakeConfig{
         this, AcceptFlakeConfig::Ask, "accept-flake-config",
         R"(
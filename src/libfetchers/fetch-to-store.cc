@@ -16,6 +16,21 @@ StorePath fetchToStore(
 
     auto filter2 = filter ? *filter : defaultPathFilter;
 
+    /* If source accesses are being recorded or replayed, the contents
+       have to come from the hook rather than from the filesystem. */
+    if (hasSourceAccessHook() && method == FileIngestionMethod::Recursive) {
+        StringSink nar;
+        path.dumpPath(nar, filter2);
+        if (settings.readOnlyMode)
+            return store.makeFixedOutputPath(name, FixedOutputInfo {
+                .method = method,
+                .hash = hashString(HashType::SHA256, nar.s),
+                .references = {},
+            });
+        StringSource source(nar.s);
+        return store.addToStoreFromDump(source, name, method, HashType::SHA256, repair);
+    }
+
     return
         settings.readOnlyMode
         ? store.computeStorePathForPath(name, path.path.abs(), method, HashType::SHA256, filter2).first
@@ -247,29 +247,8 @@ void ProgressBar::result(ActivityId act, ResultType type, const std::vector<Fiel
     }
 
     else if (type == resBuildLogLine || type == resPostBuildLogLine) {
-        auto lastLine = chomp(getS(fields, 0));
-        if (!lastLine.empty()) {
-            auto i = state->its.find(act);
-            assert(i != state->its.end());
-            ActInfo info = *i->second;
-            if (printBuildLogs) {
-                auto suffix = "> ";
-                if (type == resPostBuildLogLine) {
-                    suffix = " (post)> ";
-                }
-                log(*state, lvlInfo, ANSI_FAINT + info.name.value_or("unnamed") + suffix + ANSI_NORMAL + lastLine);
-            } else {
-                if (!printMultiline) {
-                    state->activities.erase(i->second);
-                    info.lastLine = lastLine;
-                    state->activities.emplace_back(info);
-                    i->second = std::prev(state->activities.end());
-                } else {
-                    i->second->lastLine = lastLine;
-                }
-                update(*state);
-            }
-        }
+        if (logLine(*state, act, type, getS(fields, 0)))
+            update(*state);
     }
 
     else if (type == resUntrustedPath) {
@@ -313,6 +292,49 @@ void ProgressBar::result(ActivityId act, ResultType type, const std::vector<Fiel
     }
 }
 
+void ProgressBar::results(ActivityId act, ResultType type, const std::vector<Fields> & fields)
+{
+    if (type != resBuildLogLine && type != resPostBuildLogLine)
+        return Logger::results(act, type, fields);
+
+    auto state(state_.lock());
+
+    bool needUpdate = false;
+    for (auto & f : fields)
+        needUpdate |= logLine(*state, act, type, getS(f, 0));
+    if (needUpdate)
+        update(*state);
+}
+
+bool ProgressBar::logLine(State & state, ActivityId act, ResultType type, std::string_view line)
+{
+    auto lastLine = chomp(line);
+    if (lastLine.empty())
+        return false;
+
+    auto i = state.its.find(act);
+    assert(i != state.its.end());
+    ActInfo info = *i->second;
+    if (printBuildLogs) {
+        auto suffix = "> ";
+        if (type == resPostBuildLogLine) {
+            suffix = " (post)> ";
+        }
+        log(state, lvlInfo, ANSI_FAINT + info.name.value_or("unnamed") + suffix + ANSI_NORMAL + lastLine);
+        return false;
+    } else {
+        if (!printMultiline) {
+            state.activities.erase(i->second);
+            info.lastLine = lastLine;
+            state.activities.emplace_back(info);
+            i->second = std::prev(state.activities.end());
+        } else {
+            i->second->lastLine = lastLine;
+        }
+        return true;
+    }
+}
+
 void ProgressBar::update(State & state)
 {
     state.haveUpdate = true;
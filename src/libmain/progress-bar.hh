@@ -95,6 +95,14 @@ struct ProgressBar : public Logger
 
     void result(ActivityId act, ResultType type, const std::vector<Field> & fields) override;
 
+    void results(ActivityId act, ResultType type, const std::vector<Fields> & fields) override;
+
+    /**
+     * Handle a `resBuildLogLine` or `resPostBuildLogLine` result.
+     * Returns whether the progress display needs to be updated.
+     */
+    bool logLine(State & state, ActivityId act, ResultType type, std::string_view line);
+
     void update(State & state);
 
     std::chrono::milliseconds draw(State & state, const std::optional<std::string_view> & s);
@@ -1314,7 +1314,7 @@ Path DerivationGoal::openLogFile()
     createDirs(dir);
 
     Path logFileName = fmt("%s/%s%s", dir, baseName.substr(2),
-        settings.compressLog ? ".bz2" : "");
+        settings.compressLog ? ".zst" : "");
 
     fdLogFile = AutoCloseFD{open(logFileName.c_str(), O_CREAT | O_WRONLY | O_TRUNC | O_CLOEXEC, 0666)};
     if (!fdLogFile) throw SysError("creating log file '%1%'", logFileName);
@@ -1322,7 +1322,7 @@ Path DerivationGoal::openLogFile()
     logFileSink = std::make_shared<FdSink>(fdLogFile.get());
 
     if (settings.compressLog)
-        logSink = std::shared_ptr<CompressionSink>(makeCompressionSink("bzip2", *logFileSink));
+        logSink = std::shared_ptr<CompressionSink>(makeSeekableCompressionSink(*logFileSink));
     else
         logSink = logFileSink;
 
@@ -1332,6 +1332,10 @@ Path DerivationGoal::openLogFile()
 
 void DerivationGoal::closeLogFile()
 {
+    if (act) {
+        queueElisionMarker();
+        flushLogBatch();
+    }
     auto logSink2 = std::dynamic_pointer_cast<CompressionSink>(logSink);
     if (logSink2) logSink2->finish();
     if (logFileSink) logFileSink->flush();
@@ -1502,6 +1506,8 @@ try {
 
     return handlers.then([this](auto r) -> Outcome<void, WorkResult> {
         if (!currentLogLine.empty()) flushLine();
+        queueElisionMarker();
+        flushLogBatch();
         return r;
     });
 } catch (...) {
@@ -1526,6 +1532,7 @@ kj::Promise<Outcome<void, Goal::WorkResult>>
 DerivationGoal::handleChildStreams(InputStream & builderIn, InputStream * hookIn) noexcept
 {
     lastChildActivity = worker.aio.provider->getTimer().now();
+    logRateWindowStart = lastChildActivity;
 
     auto handlers = kj::joinPromisesFailFast([&] {
         kj::Vector<kj::Promise<Outcome<void, WorkResult>>> parts{2};
@@ -1544,14 +1551,33 @@ DerivationGoal::handleChildStreams(InputStream & builderIn, InputStream * hookIn
         }));
     }
 
+    handlers = handlers.exclusiveJoin(flushLogBatchesPeriodically().then([](auto r) {
+        return kj::arr(std::move(r));
+    }));
+
     for (auto r : co_await handlers) {
         BOOST_OUTCOME_CO_TRYV(r);
     }
     co_return result::success();
 }
 
+kj::Promise<Outcome<void, Goal::WorkResult>> DerivationGoal::flushLogBatchesPeriodically() noexcept
+try {
+    while (true) {
+        co_await worker.aio.provider->getTimer().afterDelay(100 * kj::MILLISECONDS);
+        flushLogBatch();
+    }
+} catch (...) {
+    co_return std::current_exception();
+}
+
 void DerivationGoal::flushLine()
 {
+    /* Structured messages are handled immediately, so pass on the
+       lines that came before them first to keep them in order. */
+    if (currentLogLine.starts_with("@nix "))
+        flushLogBatch();
+
     if (handleJSONLogMessage(currentLogLine, *act, builderActivities, false))
         ;
 
@@ -1559,13 +1585,54 @@ void DerivationGoal::flushLine()
         logTail.push_back(currentLogLine);
         if (logTail.size() > settings.logLines) logTail.pop_front();
 
-        act->result(resBuildLogLine, currentLogLine);
+        queueLogLine(currentLogLine);
     }
 
     currentLogLine = "";
     currentLogLinePos = 0;
 }
 
+void DerivationGoal::queueLogLine(const std::string & line)
+{
+    auto now = worker.aio.provider->getTimer().now();
+    if (now - logRateWindowStart >= 1 * kj::SECONDS) {
+        queueElisionMarker();
+        logRateWindowStart = now;
+        logRateWindowLines = logRateWindowBytes = 0;
+    }
+
+    if ((settings.logRateLimitLines && logRateWindowLines >= settings.logRateLimitLines)
+        || (settings.logRateLimitBytes && logRateWindowBytes + line.size() > settings.logRateLimitBytes))
+    {
+        elidedLogLines++;
+        return;
+    }
+
+    logRateWindowLines++;
+    logRateWindowBytes += line.size();
+    pendingLogLines.push_back({line});
+
+    /* Don't let a single batch grow without bound between flushes. */
+    if (pendingLogLines.size() >= 1024)
+        flushLogBatch();
+}
+
+void DerivationGoal::queueElisionMarker()
+{
+    if (!elidedLogLines) return;
+    pendingLogLines.push_back({fmt(
+        "[%d lines of build output elided by the build log rate limit; see `nix log` for the full log]",
+        elidedLogLines)});
+    elidedLogLines = 0;
+}
+
+void DerivationGoal::flushLogBatch()
+{
+    if (pendingLogLines.empty()) return;
+    act->results(resBuildLogLine, pendingLogLines);
+    pendingLogLines.clear();
+}
+
 
 std::map<std::string, std::optional<StorePath>> DerivationGoal::queryPartialDerivationOutputMap()
 {
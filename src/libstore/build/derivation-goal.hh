@@ -208,6 +208,22 @@ struct DerivationGoal : public Goal
     std::string currentLogLine;
     size_t currentLogLinePos = 0; // to handle carriage return
 
+    /**
+     * Build log lines not yet passed to the logger. Lines are passed on
+     * in batches, see flushLogBatch().
+     */
+    std::vector<Logger::Fields> pendingLogLines;
+
+    /**
+     * Start of the current one-second window for the
+     * `build-log-rate-limit-*` settings, the number of lines and bytes
+     * passed on in it, and the number of lines elided since the last
+     * elision marker.
+     */
+    kj::TimePoint logRateWindowStart = kj::minValue;
+    unsigned long logRateWindowLines = 0, logRateWindowBytes = 0;
+    unsigned long elidedLogLines = 0;
+
     std::string currentHookLine;
 
     /**
@@ -330,9 +346,26 @@ protected:
     kj::Promise<Outcome<void, WorkResult>> handleBuilderOutput(InputStream & in) noexcept;
     kj::Promise<Outcome<void, WorkResult>> handleHookOutput(InputStream & in) noexcept;
     kj::Promise<Outcome<void, WorkResult>> monitorForSilence() noexcept;
+    kj::Promise<Outcome<void, WorkResult>> flushLogBatchesPeriodically() noexcept;
     WorkResult tooMuchLogs();
     void flushLine();
 
+    /**
+     * Queue a build log line for the logger, subject to the
+     * `build-log-rate-limit-*` settings.
+     */
+    void queueLogLine(const std::string & line);
+
+    /**
+     * Queue a line reporting the lines elided by the rate limit, if any.
+     */
+    void queueElisionMarker();
+
+    /**
+     * Pass all queued build log lines to the logger at once.
+     */
+    void flushLogBatch();
+
 public:
     /**
      * Wrappers around the corresponding Store methods that first consult the
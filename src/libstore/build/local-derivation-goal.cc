@@ -18,6 +18,7 @@
 #include "unix-domain-socket.hh"
 #include "mount.hh"
 #include "strings.hh"
+#include "trash.hh"
 
 #include <regex>
 #include <queue>
@@ -392,7 +393,11 @@ void LocalDerivationGoal::cleanupPostOutputsRegisteredModeNonCheck()
         deletePath(worker.store.Store::toRealPath(i.second));
 
     /* Delete the chroot (if we were using one). */
-    autoDelChroot.reset(); /* this runs the destructor */
+    if (autoDelChroot) {
+        autoDelChroot->cancel();
+        autoDelChroot.reset();
+        deletePathInBackground(chrootRootDir);
+    }
 
     cleanupPostOutputsRegisteredModeCheck();
 }
@@ -2617,7 +2622,7 @@ void LocalDerivationGoal::deleteTmpDir(bool force)
             chmod(tmpDir.c_str(), 0755);
         }
         else
-            deletePath(tmpDir);
+            deletePathInBackground(tmpDir);
         tmpDir = "";
     }
 }
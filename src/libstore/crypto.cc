@@ -2,7 +2,9 @@
 #include "crypto.hh"
 #include "file-system.hh"
 #include "globals.hh"
+#include "sharded-cache.hh"
 #include "strings.hh"
+#include "thread-pool.hh"
 
 #include <sodium.h>
 
@@ -74,21 +76,116 @@ PublicKey::PublicKey(std::string_view s)
         throw Error("public key is not valid");
 }
 
-bool verifyDetached(const std::string & data, const std::string & sig,
-    const PublicKeys & publicKeys)
+/**
+ * Signatures that are known to be valid, keyed by a hash of the public
+ * key, the signature and the signed data. Verifying a signature is much
+ * more expensive than hashing the data, and the same signatures are
+ * often checked repeatedly, e.g. first by `pathInfoIsUntrusted()` and
+ * then again by `addToStore()`.
+ */
+static ShardedCache<std::string, bool> verifiedSignatures(65536);
+
+static std::string verificationKey(
+    std::string_view data, std::string_view sig, const PublicKey & key)
+{
+    unsigned char res[crypto_generichash_BYTES];
+    crypto_generichash_state state;
+    crypto_generichash_init(&state, nullptr, 0, sizeof(res));
+    for (auto s : {std::string_view(key.key), sig, data})
+        crypto_generichash_update(&state, charptr_cast<const unsigned char *>(s.data()), s.size());
+    crypto_generichash_final(&state, res, sizeof(res));
+    return std::string(reinterpret_cast<char *>(res), sizeof(res));
+}
+
+/**
+ * Look up the public key of a signature and decode the signature.
+ * Returns `std::nullopt` if the key is not in `publicKeys`.
+ */
+static std::optional<std::pair<const PublicKey *, std::string>> parseSignature(
+    std::string_view sig, const PublicKeys & publicKeys)
 {
     auto ss = split(sig);
 
     auto key = publicKeys.find(std::string(ss.first));
-    if (key == publicKeys.end()) return false;
+    if (key == publicKeys.end()) return std::nullopt;
 
     auto sig2 = base64Decode(ss.second);
     if (sig2.size() != crypto_sign_BYTES)
         throw Error("signature is not valid");
 
-    return crypto_sign_verify_detached(charptr_cast<unsigned char *>(sig2.data()),
+    return std::pair{&key->second, std::move(sig2)};
+}
+
+static bool verifyParsed(std::string_view data, const std::string & sig, const PublicKey & key)
+{
+    auto cacheKey = verificationKey(data, sig, key);
+    if (verifiedSignatures.get(cacheKey)) return true;
+
+    bool valid = crypto_sign_verify_detached(charptr_cast<const unsigned char *>(sig.data()),
         charptr_cast<const unsigned char *>(data.data()), data.size(),
-        charptr_cast<const unsigned char *>(key->second.key.data())) == 0;
+        charptr_cast<const unsigned char *>(key.key.data())) == 0;
+
+    if (valid) verifiedSignatures.upsert(cacheKey, true);
+    return valid;
+}
+
+bool verifyDetached(const std::string & data, const std::string & sig,
+    const PublicKeys & publicKeys)
+{
+    auto parsed = parseSignature(sig, publicKeys);
+    if (!parsed) return false;
+    return verifyParsed(data, parsed->second, *parsed->first);
+}
+
+std::vector<bool> verifyDetachedBatch(
+    const std::vector<std::pair<std::string_view, std::string_view>> & sigs,
+    const PublicKeys & publicKeys)
+{
+    struct Check
+    {
+        std::string_view data;
+        const PublicKey * key = nullptr;
+        std::string sig;
+        bool valid = false;
+    };
+
+    std::vector<Check> checks(sigs.size());
+    for (size_t i = 0; i < sigs.size(); i++) {
+        checks[i].data = sigs[i].first;
+        try {
+            if (auto parsed = parseSignature(sigs[i].second, publicKeys)) {
+                checks[i].key = parsed->first;
+                checks[i].sig = std::move(parsed->second);
+            }
+        } catch (Error &) {
+            /* A malformed signature is simply not a valid one. */
+        }
+    }
+
+    /* Signatures are verified in chunks, so that the overhead of the
+       thread pool is small compared to the work of a single item. */
+    constexpr size_t chunkSize = 64;
+
+    auto verifyChunk = [&](size_t start) {
+        for (size_t i = start; i < std::min(start + chunkSize, checks.size()); i++)
+            if (checks[i].key)
+                checks[i].valid = verifyParsed(checks[i].data, checks[i].sig, *checks[i].key);
+    };
+
+    if (checks.size() <= chunkSize)
+        verifyChunk(0);
+    else {
+        ThreadPool pool;
+        for (size_t start = 0; start < checks.size(); start += chunkSize)
+            pool.enqueue([&verifyChunk, start]() { verifyChunk(start); });
+        pool.process();
+    }
+
+    std::vector<bool> res;
+    res.reserve(checks.size());
+    for (auto & check : checks)
+        res.push_back(check.valid);
+    return res;
 }
 
 PublicKeys getDefaultPublicKeys()
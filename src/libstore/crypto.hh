@@ -4,6 +4,7 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
 namespace nix {
 
@@ -64,6 +65,18 @@ typedef std::map<std::string, PublicKey> PublicKeys;
 bool verifyDetached(const std::string & data, const std::string & sig,
     const PublicKeys & publicKeys);
 
+/**
+ * Check many (data, signature) pairs at once, spreading the work over
+ * all cores. Unlike verifyDetached(), a malformed signature is reported
+ * as invalid rather than throwing.
+ *
+ * @return for each pair, whether it is a correct signature using one of
+ * the given public keys.
+ */
+std::vector<bool> verifyDetachedBatch(
+    const std::vector<std::pair<std::string_view, std::string_view>> & sigs,
+    const PublicKeys & publicKeys);
+
 PublicKeys getDefaultPublicKeys();
 
 }
@@ -153,6 +153,16 @@ struct TunnelLogger : public Logger
         buf << STDERR_RESULT << act << type << fields;
         enqueueMsg(buf.s);
     }
+
+    /* Send all results with a single write. They are still individual
+       STDERR_RESULT messages, so clients of any version understand them. */
+    void results(ActivityId act, ResultType type, const std::vector<Fields> & fields) override
+    {
+        StringSink buf;
+        for (auto & f : fields)
+            buf << STDERR_RESULT << act << type << f;
+        enqueueMsg(buf.s);
+    }
 };
 
 struct TunnelSink : Sink
@@ -6,6 +6,7 @@
 #include "finally.hh"
 #include "unix-domain-socket.hh"
 #include "strings.hh"
+#include "trash.hh"
 
 #include <queue>
 #include <regex>
@@ -558,7 +559,7 @@ void LocalStore::collectGarbage(const GCOptions & options, GCResults & results)
     bool gcKeepOutputs = settings.gcKeepOutputs;
     bool gcKeepDerivations = settings.gcKeepDerivations;
 
-    StorePathSet roots, dead, alive;
+    StorePathHashSet roots, dead, alive;
 
     /* Using `--ignore-liveness' with `--delete' can have unintended
        consequences if `keep-outputs' or `keep-derivations' are true
@@ -639,7 +640,7 @@ void LocalStore::collectGarbage(const GCOptions & options, GCResults & results)
         }
     };
 
-    std::map<StorePath, StorePathSet> referrersCache;
+    StorePathHashMap<StorePathSet> referrersCache;
 
     /* Helper function that visits all paths reachable from `start`
        via the referrers edges and optionally derivers and derivation
@@ -775,12 +776,13 @@ void LocalStore::collectGarbage(const GCOptions & options, GCResults & results)
                unreachable. We don't use readDirectory() here so that
                GCing can start faster. */
             auto linksName = baseNameOf(linksDir);
+            std::string trashName(baseNameOf(trashDirOf(realStoreDir)));
             Paths entries;
             struct dirent * dirent;
             while (errno = 0, dirent = readdir(dir.get())) {
                 checkInterrupt();
                 std::string name = dirent->d_name;
-                if (name == "." || name == ".." || name == linksName) continue;
+                if (name == "." || name == ".." || name == linksName || name == trashName) continue;
 
                 if (auto storePath = maybeParseStorePath(storeDir + "/" + name))
                     deleteReferrersClosure(*storePath);
@@ -804,6 +806,20 @@ void LocalStore::collectGarbage(const GCOptions & options, GCResults & results)
         return;
     }
 
+    /* Delete whatever was left in the trash, e.g. by a build that was
+       interrupted while its build directory was deleted. */
+    if (options.action == GCOptions::gcDeleteDead) {
+        printInfo("emptying the trash...");
+        for (auto & parent : {
+                realStoreDir.get(),
+                canonPath(settings.buildDir.get().value_or(defaultTempDir()), true)})
+        {
+            uint64_t bytesFreed;
+            emptyTrash(parent, bytesFreed);
+            results.bytesFreed += bytesFreed;
+        }
+    }
+
     /* Unlink all files in /nix/store/.links that have a link count of 1,
        which indicates that there are no other links and so they can be
        safely deleted.  FIXME: race condition with optimisePath(): we
@@ -318,6 +318,23 @@ public:
     Setting<bool> useSQLiteWAL{this, !isWSL1(), "use-sqlite-wal",
         "Whether SQLite should use WAL mode."};
 
+    Setting<bool> useMetadataSnapshot{this, false, "use-metadata-snapshot",
+        R"(
+          If set to `true`, the local store keeps a memory-mapped snapshot
+          of the valid paths, their NAR sizes and their references in
+          `/nix/var/nix/db/metadata-snapshot`, and uses it instead of the
+          database for whole-store and closure queries, such as
+          `nix path-info --all`, `nix-store --query --requisites` and
+          `nix-store --verify`. The snapshot is brought up to date from a
+          log of changed paths that the database keeps while this setting
+          is enabled, and is rebuilt from scratch if too many paths
+          changed.
+
+          Set this in `nix.conf` rather than per command, so that the
+          daemon and other processes opening the store agree: disabling
+          it removes the log and the snapshot.
+        )"};
+
     Setting<bool> syncBeforeRegistering{this, false, "sync-before-registering",
         "Whether to call `sync()` before registering a path as valid."};
 
@@ -438,8 +455,11 @@ public:
         this, true, "compress-build-log",
         R"(
           If set to `true` (the default), build logs written to
-          `/nix/var/log/nix/drvs` will be compressed on the fly using bzip2.
-          Otherwise, they will not be compressed.
+          `/nix/var/log/nix/drvs` will be compressed on the fly using zstd,
+          in the zstd seekable format, so that the end of a log can be read
+          without decompressing all of it. Otherwise, they will not be
+          compressed. Logs compressed with bzip2 by older versions remain
+          readable.
         )",
         {"build-compress-log"}};
 
@@ -452,6 +472,25 @@ public:
         )",
         {"build-max-log-size"}};
 
+    Setting<unsigned long> logRateLimitLines{
+        this, 0, "build-log-rate-limit-lines",
+        R"(
+          The maximum number of lines of build output per second and build
+          that are passed on to the client (e.g. shown by `nix build -L` or
+          the progress bar). Lines over the limit are replaced by a single
+          line stating how many lines were elided. The build log written to
+          disk is not affected. A value of `0` (the default) means that there
+          is no limit.
+        )"};
+
+    Setting<unsigned long> logRateLimitBytes{
+        this, 0, "build-log-rate-limit-bytes",
+        R"(
+          Like `build-log-rate-limit-lines`, but limits the number of bytes
+          of build output per second and build that are passed on to the
+          client. A value of `0` (the default) means that there is no limit.
+        )"};
+
     Setting<unsigned int> pollInterval{this, 5, "build-poll-interval",
         "How often (in seconds) to poll for locks."};
 
@@ -627,6 +666,13 @@ public:
             If Nix runs without sandbox, or if the platform does not support sandboxing with bind mounts (e.g. macOS), then the [`builder`](@docroot@/language/derivations.md#attr-builder)'s environment will contain this directory, instead of the virtual location [`sandbox-build-dir`](#conf-sandbox-build-dir).
         )"};
 
+    Setting<bool> asyncBuildDirCleanup{this, true, "async-build-dir-cleanup",
+        R"(
+            If set to `true`, the build directories and sandbox roots of finished builds are moved into a trash directory next to them and deleted by a background thread at idle I/O priority, so that the next build doesn't wait for them to be deleted.
+
+            Whatever is left in the trash when Nix is interrupted or crashes is deleted the next time the Nix daemon starts.
+        )"};
+
     Setting<PathSet> allowedImpureHostPrefixes{this, {}, "allowed-impure-host-deps",
         "Which prefixes to allow derivations to ask for access to (primarily for Darwin)."};
 
@@ -97,11 +97,18 @@ std::optional<std::string> LocalFSStore::getBuildLogExact(const StorePath & path
             j == 0
             ? fmt("%s/%s/%s/%s", logDir, drvsLogDir, baseName.substr(0, 2), baseName.substr(2))
             : fmt("%s/%s/%s", logDir, drvsLogDir, baseName);
+        Path logZstPath = logPath + ".zst";
         Path logBz2Path = logPath + ".bz2";
 
         if (pathExists(logPath))
             return readFile(logPath);
 
+        else if (pathExists(logZstPath)) {
+            try {
+                return decompress("zstd", readFile(logZstPath));
+            } catch (Error &) { }
+        }
+
         else if (pathExists(logBz2Path)) {
             try {
                 return decompress("bzip2", readFile(logBz2Path));
@@ -113,4 +120,39 @@ std::optional<std::string> LocalFSStore::getBuildLogExact(const StorePath & path
     return std::nullopt;
 }
 
+std::optional<std::string> LocalFSStore::getBuildLogTailExact(const StorePath & path, size_t lines)
+{
+    auto baseName = path.to_string();
+
+    /* Look for the log in the same places and order as
+       getBuildLogExact(). Seekable logs only need their last frames
+       decompressed. Anything else (plain, legacy bzip2 or unfinished
+       logs) is read in full. */
+    for (int j = 0; j < 2; j++) {
+
+        Path logPath =
+            j == 0
+            ? fmt("%s/%s/%s/%s", logDir, drvsLogDir, baseName.substr(0, 2), baseName.substr(2))
+            : fmt("%s/%s/%s", logDir, drvsLogDir, baseName);
+        Path logZstPath = logPath + ".zst";
+
+        if (pathExists(logPath))
+            break;
+
+        else if (pathExists(logZstPath)) {
+            try {
+                if (auto reader = SeekableZstdReader::open(logZstPath))
+                    return reader->tailLines(lines);
+            } catch (Error &) { }
+            break;
+        }
+
+        else if (pathExists(logPath + ".bz2"))
+            break;
+
+    }
+
+    return LogStore::getBuildLogTailExact(path, lines);
+}
+
 }
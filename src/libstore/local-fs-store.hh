@@ -71,6 +71,8 @@ public:
 
     std::optional<std::string> getBuildLogExact(const StorePath & path) override;
 
+    std::optional<std::string> getBuildLogTailExact(const StorePath & path, size_t lines) override;
+
 };
 
 }
@@ -53,11 +53,12 @@ std::string LocalStoreConfig::doc()
         ;
 }
 
-struct LocalStore::State::Stmts {
+struct LocalStore::DBConnection::Stmts {
     /* Some precompiled SQLite statements. */
     SQLiteStmt RegisterValidPath;
     SQLiteStmt UpdatePathInfo;
     SQLiteStmt AddReference;
+    SQLiteStmt AddReferences;
     SQLiteStmt QueryPathInfo;
     SQLiteStmt QueryReferences;
     SQLiteStmt QueryReferrers;
@@ -71,10 +72,43 @@ struct LocalStore::State::Stmts {
     SQLiteStmt QueryAllRealisedOutputs;
     SQLiteStmt QueryPathFromHashPart;
     SQLiteStmt QueryValidPaths;
+    SQLiteStmt QueryClosure;
+    SQLiteStmt QueryReverseClosure;
     SQLiteStmt QueryRealisationReferences;
     SQLiteStmt AddRealisationReference;
+    SQLiteStmt QueryClosureAggregates;
+    SQLiteStmt ComputeClosureAggregates;
+    SQLiteStmt InsertClosureAggregates;
+    SQLiteStmt QueryMetadataLogRange;
+    SQLiteStmt QueryMetadataLog;
+    SQLiteStmt TruncateMetadataLog;
+    SQLiteStmt QueryValidPathSizes;
+    SQLiteStmt QueryAllReferences;
 };
 
+/* A recursive common table expression `Closure(id)` of the paths
+   reachable from `seed` along references (or referrers, if
+   `flipDirection`), for use by the closure queries below. */
+static std::string closureCTE(std::string_view seed, bool flipDirection = false)
+{
+    return fmt(R"(
+        with recursive Closure(id) as (
+            %s
+            union
+            select %s from Refs join Closure on %s = Closure.id
+        )
+    )", seed, flipDirection ? "referrer" : "reference", flipDirection ? "reference" : "referrer");
+}
+
+static std::string closureQuery(bool flipDirection)
+{
+    return closureCTE("select id from ValidPaths where path = ?", flipDirection)
+        + "select path from Closure join ValidPaths using (id);";
+}
+
+/* Number of rows inserted by one execution of AddReferences. */
+static constexpr size_t referencesPerInsert = 128;
+
 int getSchema(Path schemaPath)
 {
     int curSchema = 0;
@@ -183,12 +217,13 @@ LocalStore::LocalStore(const Params & params)
     , linksDir(realStoreDir + "/.links")
     , reservedSpacePath(dbDir + "/reserved")
     , schemaPath(dbDir + "/schema")
+    , metadataSnapshotPath(dbDir + "/metadata-snapshot")
     , tempRootsDir(stateDir + "/temproots")
     , fnTempRoots(fmt("%s/%d", tempRootsDir, getpid()))
     , locksHeld(tokenizeString<PathSet>(getEnv("NIX_HELD_LOCKS").value_or("")))
 {
     auto state(_state.lock());
-    state->stmts = std::make_unique<State::Stmts>();
+    state->stmts = std::make_unique<DBConnection::Stmts>();
 
     /* Create missing state directories if they don't already exist. */
     createDirs(realStoreDir);
@@ -369,6 +404,75 @@ LocalStore::LocalStore(const Params & params)
         }
     }
 
+    /* Closure aggregates are only a cache, so they live in a table
+       that doesn't need a schema bump and that older versions of Lix
+       ignore. Since a valid path's closure cannot change until the
+       path is deleted, deletions are handled by the foreign key even
+       when done by older versions. Changing a path's NAR size (e.g.
+       when repairing it) is rare enough to drop all aggregates. */
+    if (!readOnly)
+        state->db.exec(R"(
+            create table if not exists ClosureAggregates (
+                id      integer primary key not null,
+                narSize integer not null,
+                paths   integer not null,
+                foreign key (id) references ValidPaths(id) on delete cascade
+            );
+
+            create trigger if not exists ClearClosureAggregates after update of narSize on ValidPaths
+              when old.narSize is not new.narSize
+              begin
+                delete from ClosureAggregates;
+              end;
+        )");
+
+    /* The metadata snapshot (see metadata-snapshot.hh) is brought up
+       to date from a log of the paths that were registered, changed or
+       invalidated since it was taken. Triggers fill in the log, so that
+       changes made by other processes, including older versions of
+       Lix, are seen. Like the closure aggregates, this lives outside
+       of the versioned schema. */
+    if (!readOnly) {
+        if (settings.useMetadataSnapshot)
+            state->db.exec(R"(
+                create table if not exists MetadataLog (
+                    seq     integer primary key autoincrement not null,
+                    path    text not null
+                );
+
+                create trigger if not exists LogRegisteredPath after insert on ValidPaths
+                  begin
+                    insert into MetadataLog (path) values (new.path);
+                  end;
+
+                create trigger if not exists LogUpdatedPath after update of narSize on ValidPaths
+                  when old.narSize is not new.narSize
+                  begin
+                    insert into MetadataLog (path) values (new.path);
+                  end;
+
+                create trigger if not exists LogInvalidatedPath after delete on ValidPaths
+                  begin
+                    insert into MetadataLog (path) values (old.path);
+                  end;
+            )");
+        else {
+            /* Nobody reads the log without the snapshot, so stop
+               keeping it. */
+            SQLiteStmt hasLog;
+            hasLog.create(state->db, "select 1 from sqlite_master where type = 'table' and name = 'MetadataLog';");
+            if (hasLog.use().next()) {
+                state->db.exec(R"(
+                    drop trigger if exists LogRegisteredPath;
+                    drop trigger if exists LogUpdatedPath;
+                    drop trigger if exists LogInvalidatedPath;
+                    drop table MetadataLog;
+                )");
+                deletePath(metadataSnapshotPath);
+            }
+        }
+    }
+
     /* Prepare SQL statements. */
     state->stmts->RegisterValidPath.create(state->db,
         "insert into ValidPaths (path, hash, registrationTime, deriver, narSize, ultimate, sigs, ca) values (?, ?, ?, ?, ?, ?, ?, ?);");
@@ -376,6 +480,13 @@ LocalStore::LocalStore(const Params & params)
         "update ValidPaths set narSize = ?, hash = ?, ultimate = ?, sigs = ?, ca = ? where path = ?;");
     state->stmts->AddReference.create(state->db,
         "insert or replace into Refs (referrer, reference) values (?, ?);");
+    {
+        std::string rows = "(?, ?)";
+        for (size_t n = 1; n < referencesPerInsert; ++n)
+            rows += ", (?, ?)";
+        state->stmts->AddReferences.create(state->db,
+            "insert or replace into Refs (referrer, reference) values " + rows + ";");
+    }
     state->stmts->QueryPathInfo.create(state->db,
         "select id, hash, registrationTime, deriver, narSize, ultimate, sigs, ca from ValidPaths where path = ?;");
     state->stmts->QueryReferences.create(state->db,
@@ -395,6 +506,29 @@ LocalStore::LocalStore(const Params & params)
     state->stmts->QueryPathFromHashPart.create(state->db,
         "select path from ValidPaths where path >= ? limit 1;");
     state->stmts->QueryValidPaths.create(state->db, "select path from ValidPaths");
+    state->stmts->QueryClosure.create(state->db, closureQuery(false));
+    state->stmts->QueryReverseClosure.create(state->db, closureQuery(true));
+    if (!readOnly) {
+        state->stmts->QueryClosureAggregates.create(state->db,
+            "select narSize, paths from ClosureAggregates where id = ?;");
+        state->stmts->ComputeClosureAggregates.create(state->db,
+            closureCTE("values (?)")
+            + "select coalesce(sum(narSize), 0), count(*) from Closure join ValidPaths using (id);");
+        state->stmts->InsertClosureAggregates.create(state->db,
+            "insert or replace into ClosureAggregates (id, narSize, paths) values (?, ?, ?);");
+    }
+    if (settings.useMetadataSnapshot && !readOnly) {
+        state->stmts->QueryMetadataLogRange.create(state->db,
+            "select min(seq), max(seq) from MetadataLog;");
+        state->stmts->QueryMetadataLog.create(state->db,
+            "select distinct path from MetadataLog where seq > ?;");
+        state->stmts->TruncateMetadataLog.create(state->db,
+            "delete from MetadataLog where seq < ?;");
+        state->stmts->QueryValidPathSizes.create(state->db,
+            "select id, path, narSize from ValidPaths order by path;");
+        state->stmts->QueryAllReferences.create(state->db,
+            "select referrer, reference from Refs;");
+    }
     if (experimentalFeatureSettings.isEnabled(Xp::CaDerivations)) {
         state->stmts->RegisterRealisedOutput.create(state->db,
             R"(
@@ -439,6 +573,58 @@ LocalStore::LocalStore(const Params & params)
                     (select id from Realisations where drvPath = ? and outputName = ?));
             )");
     }
+
+    if (settings.useSQLiteWAL && !readOnly)
+        readers = std::make_unique<Pool<DBConnection>>(
+            std::max(1U, std::thread::hardware_concurrency()),
+            [this]() { return openReader(); });
+}
+
+
+ref<LocalStore::DBConnection> LocalStore::openReader()
+{
+    auto conn = make_ref<DBConnection>();
+    conn->db = SQLite(dbDir + "/db.sqlite", SQLiteOpenMode::ReadOnly);
+    conn->stmts = std::make_unique<DBConnection::Stmts>();
+
+    /* Only the statements used by queries that go through readDB(). */
+    conn->stmts->QueryPathInfo.create(conn->db,
+        "select id, hash, registrationTime, deriver, narSize, ultimate, sigs, ca from ValidPaths where path = ?;");
+    conn->stmts->QueryReferences.create(conn->db,
+        "select path from Refs join ValidPaths on reference = id where referrer = ?;");
+    conn->stmts->QueryReferrers.create(conn->db,
+        "select path from Refs join ValidPaths on referrer = id where reference = (select id from ValidPaths where path = ?);");
+    conn->stmts->QueryValidDerivers.create(conn->db,
+        "select v.id, v.path from DerivationOutputs d join ValidPaths v on d.drv = v.id where d.path = ?;");
+    conn->stmts->QueryClosure.create(conn->db, closureQuery(false));
+    conn->stmts->QueryReverseClosure.create(conn->db, closureQuery(true));
+
+    return conn;
+}
+
+
+template<typename T, typename F>
+T LocalStore::readDB(F && fn)
+{
+    return retrySQLite<T>([&]() {
+        if (readers) {
+            auto conn(readers->get());
+            /* A transaction pins the snapshot across the statements
+               of a query. */
+            SQLiteTxn txn(conn->db);
+            if constexpr (std::is_void_v<T>) {
+                fn(*conn);
+                txn.commit();
+            } else {
+                auto res = fn(*conn);
+                txn.commit();
+                return res;
+            }
+        } else {
+            auto state(_state.lock());
+            return fn(*state);
+        }
+    });
 }
 
 
@@ -884,11 +1070,8 @@ uint64_t LocalStore::addValidPath(State & state,
         }
     }
 
-    {
-        auto state_(Store::state.lock());
-        state_->pathInfoCache.upsert(std::string(info.path.to_string()),
-            PathInfoCacheValue{ .value = std::make_shared<const ValidPathInfo>(info) });
-    }
+    pathInfoCache.upsert(PathInfoCacheKey(info.path),
+        PathInfoCacheValue{ .value = std::make_shared<const ValidPathInfo>(info) });
 
     return id;
 }
@@ -896,17 +1079,16 @@ uint64_t LocalStore::addValidPath(State & state,
 
 std::shared_ptr<const ValidPathInfo> LocalStore::queryPathInfoUncached(const StorePath & path)
 {
-    return retrySQLite<std::shared_ptr<const ValidPathInfo>>([&]() {
-        auto state(_state.lock());
-        return queryPathInfoInternal(*state, path);
+    return readDB<std::shared_ptr<const ValidPathInfo>>([&](DBConnection & conn) {
+        return queryPathInfoInternal(conn, path);
     });
 }
 
 
-std::shared_ptr<const ValidPathInfo> LocalStore::queryPathInfoInternal(State & state, const StorePath & path)
+std::shared_ptr<const ValidPathInfo> LocalStore::queryPathInfoInternal(DBConnection & conn, const StorePath & path)
 {
     /* Get the path info. */
-    auto useQueryPathInfo(state.stmts->QueryPathInfo.use()(printStorePath(path)));
+    auto useQueryPathInfo(conn.stmts->QueryPathInfo.use()(printStorePath(path)));
 
     if (!useQueryPathInfo.next())
         return nullptr;
@@ -944,7 +1126,7 @@ std::shared_ptr<const ValidPathInfo> LocalStore::queryPathInfoInternal(State & s
     }
 
     /* Get the references. */
-    auto useQueryReferences(state.stmts->QueryReferences.use()(info->id));
+    auto useQueryReferences(conn.stmts->QueryReferences.use()(info->id));
 
     while (useQueryReferences.next())
         info->references.insert(parseStorePath(useQueryReferences.getStr(0)));
@@ -967,26 +1149,25 @@ void LocalStore::updatePathInfo(State & state, const ValidPathInfo & info)
 }
 
 
-uint64_t LocalStore::queryValidPathId(State & state, const StorePath & path)
+uint64_t LocalStore::queryValidPathId(DBConnection & conn, const StorePath & path)
 {
-    auto use(state.stmts->QueryPathInfo.use()(printStorePath(path)));
+    auto use(conn.stmts->QueryPathInfo.use()(printStorePath(path)));
     if (!use.next()) // TODO: I guess if SQLITE got corrupted..?
         throw InvalidPath("path '%s' does not exist in the Lix database", printStorePath(path));
     return use.getInt(0);
 }
 
 
-bool LocalStore::isValidPath_(State & state, const StorePath & path)
+bool LocalStore::isValidPath_(DBConnection & conn, const StorePath & path)
 {
-    return state.stmts->QueryPathInfo.use()(printStorePath(path)).next();
+    return conn.stmts->QueryPathInfo.use()(printStorePath(path)).next();
 }
 
 
 bool LocalStore::isValidPathUncached(const StorePath & path)
 {
-    return retrySQLite<bool>([&]() {
-        auto state(_state.lock());
-        return isValidPath_(*state, path);
+    return readDB<bool>([&](DBConnection & conn) {
+        return isValidPath_(conn, path);
     });
 }
 
@@ -1002,6 +1183,9 @@ StorePathSet LocalStore::queryValidPaths(const StorePathSet & paths, SubstituteF
 
 StorePathSet LocalStore::queryAllValidPaths()
 {
+    if (auto snapshot = getMetadataSnapshot())
+        return snapshot->paths();
+
     return retrySQLite<StorePathSet>([&]() {
         auto state(_state.lock());
         auto use(state->stmts->QueryValidPaths.use());
@@ -1012,9 +1196,214 @@ StorePathSet LocalStore::queryAllValidPaths()
 }
 
 
-void LocalStore::queryReferrers(State & state, const StorePath & path, StorePathSet & referrers)
+void LocalStore::computeFSClosure(const StorePathSet & startPaths,
+    StorePathSet & paths_, bool flipDirection, bool includeOutputs, bool includeDerivers)
 {
-    auto useQueryReferrers(state.stmts->QueryReferrers.use()(printStorePath(path)));
+    if (includeOutputs || includeDerivers)
+        return Store::computeFSClosure(startPaths, paths_, flipDirection, includeOutputs, includeDerivers);
+
+    if (auto snapshot = getMetadataSnapshot()) {
+        std::vector<uint32_t> start;
+        for (auto & path : startPaths) {
+            auto i = snapshot->find(path);
+            if (!i)
+                throw InvalidPath("path '%s' is not valid", printStorePath(path));
+            start.push_back(*i);
+        }
+        /* Snapshot indices are in path order. */
+        auto closure = snapshot->closure(start, flipDirection);
+        std::sort(closure.begin(), closure.end());
+        for (auto i : closure)
+            paths_.insert(paths_.end(), snapshot->path(i));
+        return;
+    }
+
+    /* Let the database walk plain reference closures, which is much
+       faster than querying the info of every path in turn. */
+    readDB<void>([&](DBConnection & conn) {
+        StorePathHashSet res;
+        for (auto & start : startPaths) {
+            if (res.contains(start)) continue;
+            auto use((flipDirection ? conn.stmts->QueryReverseClosure : conn.stmts->QueryClosure)
+                .use()(printStorePath(start)));
+            if (!use.next())
+                throw InvalidPath("path '%s' is not valid", printStorePath(start));
+            do
+                res.insert(parseStorePath(use.getStr(0)));
+            while (use.next());
+        }
+        StorePaths sorted(res.begin(), res.end());
+        std::sort(sorted.begin(), sorted.end());
+        paths_.insert(sorted.begin(), sorted.end());
+    });
+}
+
+
+std::shared_ptr<const MetadataSnapshot> LocalStore::getMetadataSnapshot()
+{
+    if (readOnly || !settings.useMetadataSnapshot)
+        return nullptr;
+
+    auto snapshot(metadataSnapshot.lock());
+
+    uint64_t seq = 0;
+    std::optional<MetadataSnapshot::Columns> columns;
+
+    retrySQLite<void>([&]() {
+        auto state(_state.lock());
+        SQLiteTxn txn(state->db);
+
+        uint64_t minSeq;
+        {
+            auto use(state->stmts->QueryMetadataLogRange.use());
+            use.next();
+            minSeq = use.isNull(0) ? 0 : use.getInt(0);
+            seq = use.isNull(1) ? 0 : use.getInt(1);
+        }
+
+        /* Look at the file only now. Since it is replaced before the
+           log is truncated, it is at least as recent as the log we
+           see. */
+        if (!*snapshot || !(*snapshot)->isCurrent(metadataSnapshotPath))
+            *snapshot = MetadataSnapshot::open(metadataSnapshotPath);
+        auto & current = *snapshot;
+
+        if (current && current->seq() == seq) {
+            columns.reset();
+            return;
+        }
+
+        /* The snapshot can be brought up to date from the log unless
+           the log was truncated past it, or recreated since. */
+        if (current && current->seq() < seq && current->seq() + 1 >= minSeq) {
+            std::vector<StorePath> paths;
+            {
+                auto use(state->stmts->QueryMetadataLog.use()((int64_t) current->seq()));
+                while (use.next())
+                    paths.push_back(parseStorePath(use.getStr(0)));
+            }
+
+            /* Merging takes time linear in the size of the snapshot,
+               so if much has changed, a rebuild is about as fast. */
+            if (paths.size() * 4 < current->size()) {
+                MetadataSnapshot::Changes changes;
+                for (auto & path : paths) {
+                    auto & change = changes.emplace(path, std::nullopt).first->second;
+                    auto use(state->stmts->QueryPathInfo.use()(printStorePath(path)));
+                    if (!use.next()) continue;
+                    change = MetadataSnapshot::Change{ .narSize = (uint64_t) use.getInt(4) };
+                    auto useRefs(state->stmts->QueryReferences.use()(use.getInt(0)));
+                    while (useRefs.next())
+                        change->references.insert(parseStorePath(useRefs.getStr(0)));
+                }
+                columns = current->merge(changes);
+                txn.commit();
+                return;
+            }
+        }
+
+        columns = readMetadataColumns(*state);
+        txn.commit();
+    });
+
+    if (!columns)
+        return *snapshot;
+
+    /* Serialise replacing the snapshot and truncating the log, so that
+       another process that got here at the same time doesn't need to
+       write the same snapshot again. */
+    auto lockFd = openLockFile(metadataSnapshotPath + ".lock", true);
+    FdLock lock(lockFd.get(), ltWrite, true, "waiting for the metadata snapshot lock...");
+
+    *snapshot = MetadataSnapshot::open(metadataSnapshotPath);
+    if (!*snapshot || (*snapshot)->seq() != seq) {
+        MetadataSnapshot::write(metadataSnapshotPath, seq, *columns);
+        *snapshot = MetadataSnapshot::open(metadataSnapshotPath);
+        if (!*snapshot)
+            throw Error("metadata snapshot '%s' disappeared while it was being written", metadataSnapshotPath);
+    }
+
+    /* Keep the last entry, so that readers of an older snapshot can
+       tell that they missed some. */
+    retrySQLite<void>([&]() {
+        auto state(_state.lock());
+        state->stmts->TruncateMetadataLog.use()((int64_t) seq).exec();
+    });
+
+    return *snapshot;
+}
+
+
+MetadataSnapshot::Columns LocalStore::readMetadataColumns(State & state)
+{
+    MetadataSnapshot::Columns columns;
+
+    /* Base names sort like store paths, so this returns them in
+       snapshot order. */
+    boost::unordered_flat_map<int64_t, uint32_t> indices;
+    {
+        auto use(state.stmts->QueryValidPathSizes.use());
+        while (use.next()) {
+            indices.emplace(use.getInt(0), columns.size());
+            columns.addPath(parseStorePath(use.getStr(1)), use.getInt(2));
+        }
+    }
+
+    std::vector<std::pair<uint32_t, uint32_t>> edges;
+    {
+        auto use(state.stmts->QueryAllReferences.use());
+        while (use.next()) {
+            auto referrer = indices.find(use.getInt(0));
+            auto reference = indices.find(use.getInt(1));
+            if (referrer != indices.end() && reference != indices.end())
+                edges.emplace_back(referrer->second, reference->second);
+        }
+    }
+    columns.setRefs(edges);
+
+    return columns;
+}
+
+
+std::optional<Store::ClosureAggregates> LocalStore::queryClosureAggregates(const StorePath & path)
+{
+    if (readOnly) return std::nullopt;
+
+    return retrySQLite<ClosureAggregates>([&]() {
+        auto state(_state.lock());
+        SQLiteTxn txn(state->db);
+
+        auto id = queryValidPathId(*state, path);
+
+        {
+            auto use(state->stmts->QueryClosureAggregates.use()(id));
+            if (use.next())
+                return ClosureAggregates{
+                    .narSize = (uint64_t) use.getInt(0),
+                    .paths = (uint64_t) use.getInt(1),
+                };
+        }
+
+        auto use(state->stmts->ComputeClosureAggregates.use()(id));
+        if (!use.next())
+            throw Error("computing the closure size of '%s'", printStorePath(path));
+
+        ClosureAggregates res{
+            .narSize = (uint64_t) use.getInt(0),
+            .paths = (uint64_t) use.getInt(1),
+        };
+
+        state->stmts->InsertClosureAggregates.use()(id)(res.narSize)(res.paths).exec();
+
+        txn.commit();
+        return res;
+    });
+}
+
+
+void LocalStore::queryReferrers(DBConnection & conn, const StorePath & path, StorePathSet & referrers)
+{
+    auto useQueryReferrers(conn.stmts->QueryReferrers.use()(printStorePath(path)));
 
     while (useQueryReferrers.next())
         referrers.insert(parseStorePath(useQueryReferrers.getStr(0)));
@@ -1023,19 +1412,16 @@ void LocalStore::queryReferrers(State & state, const StorePath & path, StorePath
 
 void LocalStore::queryReferrers(const StorePath & path, StorePathSet & referrers)
 {
-    return retrySQLite<void>([&]() {
-        auto state(_state.lock());
-        queryReferrers(*state, path, referrers);
+    return readDB<void>([&](DBConnection & conn) {
+        queryReferrers(conn, path, referrers);
     });
 }
 
 
 StorePathSet LocalStore::queryValidDerivers(const StorePath & path)
 {
-    return retrySQLite<StorePathSet>([&]() {
-        auto state(_state.lock());
-
-        auto useQueryValidDerivers(state->stmts->QueryValidDerivers.use()(printStorePath(path)));
+    return readDB<StorePathSet>([&](DBConnection & conn) {
+        auto useQueryValidDerivers(conn.stmts->QueryValidDerivers.use()(printStorePath(path)));
 
         StorePathSet derivers;
         while (useQueryValidDerivers.next())
@@ -1135,21 +1521,46 @@ void LocalStore::registerValidPaths(const ValidPathInfos & infos)
         SQLiteTxn txn(state->db);
         StorePathSet paths;
 
+        /* The database ids of the registered paths and their
+           references, so that each is looked up at most once. */
+        std::map<StorePath, uint64_t> ids;
+
         for (auto & [_, i] : infos) {
             assert(i.narHash.type == HashType::SHA256);
             if (isValidPath_(*state, i.path))
                 updatePathInfo(*state, i);
             else
-                addValidPath(*state, i, false);
+                ids.emplace(i.path, addValidPath(*state, i, false));
             paths.insert(i.path);
         }
 
+        auto idOf = [&](const StorePath & path) {
+            auto i = ids.find(path);
+            if (i == ids.end())
+                i = ids.emplace(path, queryValidPathId(*state, path)).first;
+            return i->second;
+        };
+
+        std::vector<std::pair<uint64_t, uint64_t>> refs;
         for (auto & [_, i] : infos) {
-            auto referrer = queryValidPathId(*state, i.path);
+            auto referrer = idOf(i.path);
             for (auto & j : i.references)
-                state->stmts->AddReference.use()(referrer)(queryValidPathId(*state, j)).exec();
+                refs.emplace_back(referrer, idOf(j));
         }
 
+        /* Insert the references many rows at a time. Executing one
+           statement per reference dominates the cost of registering
+           large closures otherwise. */
+        size_t n = 0;
+        for (; n + referencesPerInsert <= refs.size(); n += referencesPerInsert) {
+            auto use(state->stmts->AddReferences.use());
+            for (size_t k = n; k < n + referencesPerInsert; ++k)
+                use(refs[k].first)(refs[k].second);
+            use.exec();
+        }
+        for (; n < refs.size(); ++n)
+            state->stmts->AddReference.use()(refs[n].first)(refs[n].second).exec();
+
         /* Check that the derivation outputs are correct.  We can't do
            this in addValidPath() above, because the references might
            not be valid yet. */
@@ -1191,10 +1602,7 @@ void LocalStore::invalidatePath(State & state, const StorePath & path)
     /* Note that the foreign key constraints on the Refs table take
        care of deleting the references entries for `path'. */
 
-    {
-        auto state_(Store::state.lock());
-        state_->pathInfoCache.erase(std::string(path.to_string()));
-    }
+    pathInfoCache.erase(PathInfoCacheKey(path));
 }
 
 const PublicKeys & LocalStore::getPublicKeys()
@@ -1215,6 +1623,29 @@ bool LocalStore::realisationIsUntrusted(const Realisation & realisation)
     return requireSigs && !realisation.checkSignatures(getPublicKeys());
 }
 
+void LocalStore::addMultipleToStore(
+    PathsSource & pathsToCopy,
+    Activity & act,
+    RepairFlag repair,
+    CheckSigsFlag checkSigs)
+{
+    /* Verify the signatures of all paths at once, spread over all
+       cores, rather than one by one as the paths get added. Paths
+       found to be trusted aren't checked again by addToStore(); the
+       others are, so that they are reported (or skipped with
+       --keep-going) just as before. */
+    StorePathSet trustedPaths;
+    if (checkSigs && requireSigs) {
+        std::vector<const ValidPathInfo *> infos;
+        infos.reserve(pathsToCopy.size());
+        for (auto & [info, _] : pathsToCopy)
+            infos.push_back(&info);
+        trustedPaths = findTrustedPaths(*this, infos, getPublicKeys());
+    }
+
+    Store::addMultipleToStore(pathsToCopy, act, repair, checkSigs, trustedPaths);
+}
+
 void LocalStore::addToStore(const ValidPathInfo & info, Source & source,
     RepairFlag repair, CheckSigsFlag checkSigs)
 {
@@ -1926,15 +2357,16 @@ void LocalStore::addBuildLog(const StorePath & drvPath, std::string_view log)
 
     auto baseName = drvPath.to_string();
 
-    auto logPath = fmt("%s/%s/%s/%s.bz2", logDir, drvsLogDir, baseName.substr(0, 2), baseName.substr(2));
+    auto logPath = fmt("%s/%s/%s/%s.zst", logDir, drvsLogDir, baseName.substr(0, 2), baseName.substr(2));
+    auto legacyLogPath = fmt("%s/%s/%s/%s.bz2", logDir, drvsLogDir, baseName.substr(0, 2), baseName.substr(2));
 
-    if (pathExists(logPath)) return;
+    if (pathExists(logPath) || pathExists(legacyLogPath)) return;
 
     createDirs(dirOf(logPath));
 
     auto tmpFile = fmt("%s.tmp.%d", logPath, getpid());
 
-    writeFile(tmpFile, compress("bzip2", log));
+    writeFile(tmpFile, compressSeekable(log));
 
     renameFile(tmpFile, logPath);
 }
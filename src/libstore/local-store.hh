@@ -3,6 +3,8 @@
 
 #include "sqlite.hh"
 
+#include "metadata-snapshot.hh"
+#include "pool.hh"
 #include "store-api.hh"
 #include "indirect-root-store.hh"
 #include "sync.hh"
@@ -79,16 +81,23 @@ private:
      */
     AutoCloseFD globalLock;
 
-    struct State
+    /**
+     * A connection to the SQLite database and its prepared statements.
+     */
+    struct DBConnection
     {
-        /**
-         * The SQLite database object.
-         */
         SQLite db;
 
         struct Stmts;
         std::unique_ptr<Stmts> stmts;
+    };
 
+    /**
+     * The state of the store, including the connection through which
+     * all writes go.
+     */
+    struct State : DBConnection
+    {
         /**
          * The last time we checked whether to do an auto-GC, or an
          * auto-GC finished.
@@ -115,6 +124,33 @@ private:
 
     Sync<State> _state;
 
+    /**
+     * Read-only connections to the database, so that queries from
+     * several threads neither wait for each other nor for writes to
+     * `_state`. Only available in WAL mode, and null otherwise.
+     */
+    std::unique_ptr<Pool<DBConnection>> readers;
+
+    ref<DBConnection> openReader();
+
+    /**
+     * Run the read-only query `fn` on a consistent snapshot of the
+     * database, using one of `readers` if possible.
+     */
+    template<typename T, typename F>
+    T readDB(F && fn);
+
+    /**
+     * The metadata snapshot last used by this process.
+     */
+    Sync<std::shared_ptr<const MetadataSnapshot>> metadataSnapshot;
+
+    /**
+     * Get the metadata snapshot, brought up to date with the database,
+     * or null if `use-metadata-snapshot` is disabled.
+     */
+    std::shared_ptr<const MetadataSnapshot> getMetadataSnapshot();
+
 public:
 
     const Path dbDir;
@@ -122,6 +158,7 @@ public:
     /** Path kept around to reserve some filesystem space to be able to begin a garbage collection */
     const Path reservedSpacePath;
     const Path schemaPath;
+    const Path metadataSnapshotPath;
     const Path tempRootsDir;
     const Path fnTempRoots;
 
@@ -170,6 +207,13 @@ public:
 
     StorePathSet queryAllValidPaths() override;
 
+    std::optional<ClosureAggregates> queryClosureAggregates(const StorePath & path) override;
+
+    void computeFSClosure(const StorePathSet & paths,
+        StorePathSet & out, bool flipDirection = false,
+        bool includeOutputs = false, bool includeDerivers = false) override;
+    using Store::computeFSClosure;
+
     std::shared_ptr<const ValidPathInfo> queryPathInfoUncached(const StorePath & path) override;
 
     void queryReferrers(const StorePath & path, StorePathSet & referrers) override;
@@ -188,6 +232,14 @@ public:
     void addToStore(const ValidPathInfo & info, Source & source,
         RepairFlag repair, CheckSigsFlag checkSigs) override;
 
+    using Store::addMultipleToStore;
+
+    void addMultipleToStore(
+        PathsSource & pathsToCopy,
+        Activity & act,
+        RepairFlag repair,
+        CheckSigsFlag checkSigs) override;
+
     StorePath addToStoreFromDump(Source & dump, std::string_view name,
         FileIngestionMethod method, HashType hashAlgo, RepairFlag repair, const StorePathSet & references) override;
 
@@ -312,7 +364,7 @@ private:
 
     void makeStoreWritable();
 
-    uint64_t queryValidPathId(State & state, const StorePath & path);
+    uint64_t queryValidPathId(DBConnection & conn, const StorePath & path);
 
     uint64_t addValidPath(State & state, const ValidPathInfo & info, bool checkOutputs = true);
 
@@ -326,10 +378,15 @@ private:
     void verifyPath(const StorePath & path, const StorePathSet & store,
         StorePathSet & done, StorePathSet & validPaths, RepairFlag repair, bool & errors);
 
-    std::shared_ptr<const ValidPathInfo> queryPathInfoInternal(State & state, const StorePath & path);
+    std::shared_ptr<const ValidPathInfo> queryPathInfoInternal(DBConnection & conn, const StorePath & path);
 
     void updatePathInfo(State & state, const ValidPathInfo & info);
 
+    /**
+     * Read the contents of a new metadata snapshot from the database.
+     */
+    MetadataSnapshot::Columns readMetadataColumns(State & state);
+
     void upgradeStore6();
     void upgradeStore7();
     PathSet queryValidPathsOld();
@@ -356,8 +413,8 @@ private:
     void optimisePath_(Activity * act, OptimiseStats & stats, const Path & path, InodeHash & inodeHash, RepairFlag repair);
 
     // Internal versions that are not wrapped in retry_sqlite.
-    bool isValidPath_(State & state, const StorePath & path);
-    void queryReferrers(State & state, const StorePath & path, StorePathSet & referrers);
+    bool isValidPath_(DBConnection & conn, const StorePath & path);
+    void queryReferrers(DBConnection & conn, const StorePath & path, StorePathSet & referrers);
 
     /**
      * Add signatures to a ValidPathInfo or Realisation using the secret keys
@@ -1,4 +1,5 @@
 #include "log-store.hh"
+#include "strings.hh"
 
 namespace nix {
 
@@ -9,4 +10,19 @@ std::optional<std::string> LogStore::getBuildLog(const StorePath & path) {
     return getBuildLogExact(maybePath.value());
 }
 
+std::optional<std::string> LogStore::getBuildLogTail(const StorePath & path, size_t lines) {
+    auto maybePath = getBuildDerivationPath(path);
+    if (!maybePath)
+        return std::nullopt;
+    return getBuildLogTailExact(maybePath.value(), lines);
+}
+
+std::optional<std::string> LogStore::getBuildLogTailExact(const StorePath & path, size_t lines)
+{
+    auto log = getBuildLogExact(path);
+    if (log)
+        log->erase(0, findLastLines(*log, lines).value_or(0));
+    return log;
+}
+
 }
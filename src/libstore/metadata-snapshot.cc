@@ -0,0 +1,405 @@
+#include "metadata-snapshot.hh"
+#include "file-system.hh"
+#include "globals.hh"
+#include "logging.hh"
+#include "strings.hh"
+
+#include <cstring>
+#include <variant>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace nix {
+
+static constexpr char snapshotMagic[8] = {'L', 'i', 'x', 'M', 'e', 't', 'a', '\0'};
+
+/**
+ * Bump this when changing the format. Snapshots in other formats are
+ * simply rebuilt.
+ */
+static constexpr uint64_t snapshotVersion = 1;
+
+struct MetadataSnapshot::Header
+{
+    char magic[8];
+    uint64_t version;
+    uint64_t seq;
+    uint64_t paths;
+    uint64_t namesSize;
+    uint64_t refs;
+};
+
+namespace {
+
+/**
+ * The offsets of the sections following the header, each of which is
+ * padded to 8 bytes.
+ */
+struct Layout
+{
+    size_t hashes, nameStarts, narSizes, refStarts, refs, referrerStarts, referrers, names, end;
+
+    Layout(uint64_t paths, uint64_t namesSize, uint64_t refs)
+    {
+        size_t pos = sizeof(MetadataSnapshot::Header);
+        auto section = [&](size_t size) {
+            auto start = pos;
+            pos += (size + 7) & ~size_t(7);
+            return start;
+        };
+        hashes = section(paths * sizeof(MetadataSnapshot::HashBytes));
+        nameStarts = section((paths + 1) * sizeof(uint32_t));
+        narSizes = section(paths * sizeof(uint64_t));
+        refStarts = section((paths + 1) * sizeof(uint64_t));
+        this->refs = section(refs * sizeof(uint32_t));
+        referrerStarts = section((paths + 1) * sizeof(uint64_t));
+        referrers = section(refs * sizeof(uint32_t));
+        names = section(namesSize);
+        end = pos;
+    }
+};
+
+int compare(const MetadataSnapshot::HashBytes & hash, std::string_view name, const StorePath & path)
+{
+    auto r = memcmp(hash.data(), path.hashBytes().data(), StorePath::HashSize);
+    if (r) return r;
+    return name.compare(path.name());
+}
+
+/**
+ * Binary search for `path` among the first `size` paths given by
+ * `hashes` and `name`.
+ */
+template<typename Name>
+std::optional<uint32_t> findPath(
+    const MetadataSnapshot::HashBytes * hashes, size_t size, Name && name, const StorePath & path)
+{
+    size_t lo = 0, hi = size;
+    while (lo < hi) {
+        auto mid = lo + (hi - lo) / 2;
+        auto r = compare(hashes[mid], name(mid), path);
+        if (r == 0) return mid;
+        if (r < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return std::nullopt;
+}
+
+}
+
+void MetadataSnapshot::Columns::addPath(const StorePath & path, uint64_t narSize)
+{
+    HashBytes hash;
+    std::copy(path.hashBytes().begin(), path.hashBytes().end(), hash.begin());
+    addPath(hash, path.name(), narSize);
+}
+
+void MetadataSnapshot::Columns::addPath(const HashBytes & hash, std::string_view name, uint64_t narSize)
+{
+    hashes.push_back(hash);
+    names.append(name);
+    nameStarts.push_back(names.size());
+    narSizes.push_back(narSize);
+    refStarts.push_back(refStarts.back());
+}
+
+void MetadataSnapshot::Columns::setRefs(const std::vector<std::pair<uint32_t, uint32_t>> & edges)
+{
+    refStarts.assign(size() + 1, 0);
+    for (auto & [referrer, _] : edges)
+        refStarts[referrer + 1]++;
+    for (size_t i = 0; i < size(); i++)
+        refStarts[i + 1] += refStarts[i];
+    refs.resize(edges.size());
+    auto next = refStarts;
+    for (auto & [referrer, reference] : edges)
+        refs[next[referrer]++] = reference;
+}
+
+std::optional<uint32_t> MetadataSnapshot::Columns::find(const StorePath & path) const
+{
+    return findPath(hashes.data(), size(), [&](size_t i) {
+        return std::string_view(names).substr(nameStarts[i], nameStarts[i + 1] - nameStarts[i]);
+    }, path);
+}
+
+std::shared_ptr<const MetadataSnapshot> MetadataSnapshot::open(const Path & path)
+{
+    AutoCloseFD fd{::open(path.c_str(), O_RDONLY | O_CLOEXEC)};
+    if (!fd) {
+        if (errno == ENOENT) return nullptr;
+        throw SysError("opening metadata snapshot '%s'", path);
+    }
+
+    struct stat st;
+    if (fstat(fd.get(), &st))
+        throw SysError("getting status of '%s'", path);
+
+    auto invalid = [&](std::string_view reason) -> std::shared_ptr<const MetadataSnapshot> {
+        warn("ignoring metadata snapshot '%s': %s", path, reason);
+        return nullptr;
+    };
+
+    if ((size_t) st.st_size < sizeof(Header))
+        return invalid("it is truncated");
+
+    std::shared_ptr<MetadataSnapshot> snapshot(new MetadataSnapshot);
+    snapshot->dev = st.st_dev;
+    snapshot->ino = st.st_ino;
+    snapshot->dataSize = st.st_size;
+    auto data = mmap(nullptr, snapshot->dataSize, PROT_READ, MAP_SHARED, fd.get(), 0);
+    if (data == MAP_FAILED)
+        throw SysError("mapping metadata snapshot '%s'", path);
+    snapshot->data = static_cast<const char *>(data);
+
+    auto & header = snapshot->header();
+    if (memcmp(header.magic, snapshotMagic, sizeof(snapshotMagic)) || header.version != snapshotVersion)
+        return invalid("it has an unsupported format");
+    if (header.paths > std::numeric_limits<uint32_t>::max()
+        || header.namesSize > std::numeric_limits<uint32_t>::max()
+        || header.refs > snapshot->dataSize)
+        return invalid("it is corrupt");
+
+    Layout layout(header.paths, header.namesSize, header.refs);
+    if (layout.end != snapshot->dataSize)
+        return invalid("it is truncated");
+
+    auto section = [&](size_t offset) { return snapshot->data + offset; };
+    snapshot->hashes = reinterpret_cast<const HashBytes *>(section(layout.hashes));
+    snapshot->nameStarts = reinterpret_cast<const uint32_t *>(section(layout.nameStarts));
+    snapshot->names = section(layout.names);
+    snapshot->narSizes = reinterpret_cast<const uint64_t *>(section(layout.narSizes));
+    snapshot->refStarts = reinterpret_cast<const uint64_t *>(section(layout.refStarts));
+    snapshot->refs = reinterpret_cast<const uint32_t *>(section(layout.refs));
+    snapshot->referrerStarts = reinterpret_cast<const uint64_t *>(section(layout.referrerStarts));
+    snapshot->referrers_ = reinterpret_cast<const uint32_t *>(section(layout.referrers));
+
+    /* Check the offsets and indices, so that the accessors can't read
+       outside of the mapping. */
+    auto n = header.paths;
+    auto sorted = [](auto * starts, size_t n, uint64_t end) {
+        if (starts[0] != 0 || starts[n] != end) return false;
+        for (size_t i = 0; i < n; i++)
+            if (starts[i] > starts[i + 1]) return false;
+        return true;
+    };
+    if (!sorted(snapshot->nameStarts, n, header.namesSize)
+        || !sorted(snapshot->refStarts, n, header.refs)
+        || !sorted(snapshot->referrerStarts, n, header.refs))
+        return invalid("it is corrupt");
+    for (uint64_t i = 0; i < header.refs; i++)
+        if (snapshot->refs[i] >= n || snapshot->referrers_[i] >= n)
+            return invalid("it is corrupt");
+
+    return snapshot;
+}
+
+void MetadataSnapshot::write(const Path & path, uint64_t seq, const Columns & columns)
+{
+    auto n = columns.size();
+    auto e = columns.refs.size();
+
+    /* Derive the referrers from the references. */
+    std::vector<uint64_t> referrerStarts(n + 1, 0);
+    for (auto ref : columns.refs)
+        referrerStarts[ref + 1]++;
+    for (size_t i = 0; i < n; i++)
+        referrerStarts[i + 1] += referrerStarts[i];
+    std::vector<uint32_t> referrers(e);
+    {
+        auto next = referrerStarts;
+        for (uint32_t i = 0; i < n; i++)
+            for (auto j = columns.refStarts[i]; j < columns.refStarts[i + 1]; j++)
+                referrers[next[columns.refs[j]]++] = i;
+    }
+
+    Header header;
+    memcpy(header.magic, snapshotMagic, sizeof(snapshotMagic));
+    header.version = snapshotVersion;
+    header.seq = seq;
+    header.paths = n;
+    header.namesSize = columns.names.size();
+    header.refs = e;
+
+    Layout layout(n, header.namesSize, e);
+
+    auto tmp = fmt("%s.tmp-%d", path, getpid());
+    AutoCloseFD fd{::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)};
+    if (!fd)
+        throw SysError("creating metadata snapshot '%s'", tmp);
+
+    size_t pos = 0;
+    auto writeSection = [&](size_t offset, const void * p, size_t size) {
+        assert(offset >= pos);
+        writeFull(fd.get(), std::string(offset - pos, '\0'));
+        writeFull(fd.get(), {static_cast<const char *>(p), size});
+        pos = offset + size;
+    };
+    writeSection(0, &header, sizeof(header));
+    writeSection(layout.hashes, columns.hashes.data(), n * sizeof(HashBytes));
+    writeSection(layout.nameStarts, columns.nameStarts.data(), (n + 1) * sizeof(uint32_t));
+    writeSection(layout.narSizes, columns.narSizes.data(), n * sizeof(uint64_t));
+    writeSection(layout.refStarts, columns.refStarts.data(), (n + 1) * sizeof(uint64_t));
+    writeSection(layout.refs, columns.refs.data(), e * sizeof(uint32_t));
+    writeSection(layout.referrerStarts, referrerStarts.data(), (n + 1) * sizeof(uint64_t));
+    writeSection(layout.referrers, referrers.data(), e * sizeof(uint32_t));
+    writeSection(layout.names, columns.names.data(), columns.names.size());
+    writeSection(layout.end, nullptr, 0);
+
+    if (settings.fsyncMetadata)
+        fd.fsync();
+    fd.close();
+
+    renameFile(tmp, path);
+}
+
+MetadataSnapshot::~MetadataSnapshot()
+{
+    if (data)
+        munmap(const_cast<char *>(data), dataSize);
+}
+
+bool MetadataSnapshot::isCurrent(const Path & path) const
+{
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && st.st_dev == dev && st.st_ino == ino;
+}
+
+uint64_t MetadataSnapshot::seq() const
+{
+    return header().seq;
+}
+
+uint32_t MetadataSnapshot::size() const
+{
+    return header().paths;
+}
+
+std::optional<uint32_t> MetadataSnapshot::find(const StorePath & path) const
+{
+    return findPath(hashes, size(), [&](size_t i) { return name(i); }, path);
+}
+
+StorePath MetadataSnapshot::path(uint32_t i) const
+{
+    return StorePath(hashes[i], name(i));
+}
+
+uint64_t MetadataSnapshot::narSize(uint32_t i) const
+{
+    return narSizes[i];
+}
+
+std::span<const uint32_t> MetadataSnapshot::references(uint32_t i) const
+{
+    return {refs + refStarts[i], refs + refStarts[i + 1]};
+}
+
+std::span<const uint32_t> MetadataSnapshot::referrers(uint32_t i) const
+{
+    return {referrers_ + referrerStarts[i], referrers_ + referrerStarts[i + 1]};
+}
+
+StorePathSet MetadataSnapshot::paths() const
+{
+    StorePathSet res;
+    for (uint32_t i = 0; i < size(); i++)
+        res.insert(res.end(), path(i));
+    return res;
+}
+
+std::vector<uint32_t> MetadataSnapshot::closure(std::span<const uint32_t> start, bool flipDirection) const
+{
+    std::vector<bool> visited(size(), false);
+    std::vector<uint32_t> res;
+
+    auto enqueue = [&](uint32_t i) {
+        if (visited[i]) return;
+        visited[i] = true;
+        res.push_back(i);
+    };
+
+    for (auto i : start)
+        enqueue(i);
+
+    /* `res` doubles as the queue. */
+    for (size_t next = 0; next < res.size(); next++)
+        for (auto j : flipDirection ? referrers(res[next]) : references(res[next]))
+            enqueue(j);
+
+    return res;
+}
+
+MetadataSnapshot::Columns MetadataSnapshot::merge(const Changes & changes) const
+{
+    Columns res;
+    res.hashes.reserve(size() + changes.size());
+    res.nameStarts.reserve(size() + changes.size() + 1);
+    res.names.reserve(header().namesSize);
+    res.narSizes.reserve(size() + changes.size());
+    res.refs.reserve(header().refs);
+
+    /* Where each path in the result comes from: an index into this
+       snapshot, or a changed path. */
+    std::vector<std::variant<uint32_t, const Changes::value_type *>> sources;
+    std::vector<std::optional<uint32_t>> newIndex(size());
+    sources.reserve(size() + changes.size());
+
+    auto change = changes.begin();
+
+    auto addChanged = [&]() {
+        if (change->second) {
+            res.addPath(change->first, change->second->narSize);
+            sources.push_back(&*change);
+        }
+        ++change;
+    };
+
+    for (uint32_t i = 0; i < size(); i++) {
+        int r = 1;
+        while (change != changes.end() && (r = compare(hashes[i], name(i), change->first)) > 0)
+            addChanged();
+        if (change != changes.end() && r == 0) {
+            /* The changed path replaces this one (or removes it). */
+            if (change->second) newIndex[i] = res.size();
+            addChanged();
+            continue;
+        }
+        newIndex[i] = res.size();
+        res.addPath(hashes[i], name(i), narSizes[i]);
+        sources.push_back(i);
+    }
+    while (change != changes.end())
+        addChanged();
+
+    /* Now that the indices are known, add the references. References
+       to paths that are no longer valid can only be left over from
+       changes that happened while we were reading them, so drop
+       them. */
+    res.refStarts.assign(1, 0);
+    res.refStarts.reserve(sources.size() + 1);
+    res.refs.clear();
+    for (auto & source : sources) {
+        res.refStarts.push_back(res.refStarts.back());
+        std::visit(overloaded {
+            [&](uint32_t i) {
+                for (auto ref : references(i))
+                    if (auto j = newIndex[ref])
+                        res.addRef(*j);
+            },
+            [&](const Changes::value_type * change) {
+                for (auto & ref : change->second->references)
+                    if (auto j = res.find(ref))
+                        res.addRef(*j);
+            },
+        }, source);
+    }
+
+    return res;
+}
+
+}
@@ -0,0 +1,178 @@
+#pragma once
+///@file
+
+#include "file-descriptor.hh"
+#include "path.hh"
+
+#include <array>
+#include <map>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace nix {
+
+/**
+ * A read-only, memory-mapped snapshot of the metadata that bulk queries
+ * on the local store need: the valid paths, their NAR sizes and their
+ * references. It is stored in columns, sorted in `StorePath` order, with
+ * the references (and the referrers derived from them) in compressed
+ * sparse row form, so that listing the store or walking a closure reads
+ * a few arrays instead of doing one SQLite query per path.
+ *
+ * The snapshot reflects the database up to a sequence number of
+ * `MetadataLog`. LocalStore brings it up to date by merging in the
+ * paths logged after that, see `LocalStore::getMetadataSnapshot()`.
+ */
+class MetadataSnapshot
+{
+public:
+
+    typedef std::array<uint8_t, StorePath::HashSize> HashBytes;
+
+    /**
+     * The contents of a snapshot while it is being built. `refStarts`
+     * has one more element than there are paths, `refs[refStarts[i]]`
+     * up to `refs[refStarts[i + 1]]` are the indices of the references
+     * of path `i`, and likewise for the names.
+     */
+    struct Columns
+    {
+        std::vector<HashBytes> hashes;
+        std::vector<uint32_t> nameStarts{0};
+        std::string names;
+        std::vector<uint64_t> narSizes;
+        std::vector<uint64_t> refStarts{0};
+        std::vector<uint32_t> refs;
+
+        /**
+         * Append a path. Paths must be added in `StorePath` order, and
+         * their references right after each of them with `addRef()`.
+         */
+        void addPath(const StorePath & path, uint64_t narSize);
+
+        void addPath(const HashBytes & hash, std::string_view name, uint64_t narSize);
+
+        void addRef(uint32_t ref)
+        {
+            refs.push_back(ref);
+            refStarts.back()++;
+        }
+
+        /**
+         * Replace all references by `edges`, which are (referrer,
+         * reference) pairs in any order.
+         */
+        void setRefs(const std::vector<std::pair<uint32_t, uint32_t>> & edges);
+
+        size_t size() const
+        {
+            return hashes.size();
+        }
+
+        std::optional<uint32_t> find(const StorePath & path) const;
+    };
+
+    /**
+     * The state of a path that changed since the snapshot was taken, or
+     * `std::nullopt` if it is no longer valid.
+     */
+    struct Change
+    {
+        uint64_t narSize;
+        StorePathSet references;
+    };
+
+    typedef std::map<StorePath, std::optional<Change>> Changes;
+
+    /**
+     * Map the snapshot in `path`. Returns null if it doesn't exist, and
+     * warns and returns null if it isn't a valid snapshot.
+     */
+    static std::shared_ptr<const MetadataSnapshot> open(const Path & path);
+
+    /**
+     * Atomically replace the snapshot in `path` with `columns`, as of
+     * sequence number `seq`.
+     */
+    static void write(const Path & path, uint64_t seq, const Columns & columns);
+
+    MetadataSnapshot(const MetadataSnapshot &) = delete;
+
+    ~MetadataSnapshot();
+
+    /**
+     * Whether `path` is (still) the file this snapshot was mapped from.
+     */
+    bool isCurrent(const Path & path) const;
+
+    uint64_t seq() const;
+
+    uint32_t size() const;
+
+    std::optional<uint32_t> find(const StorePath & path) const;
+
+    StorePath path(uint32_t i) const;
+
+    uint64_t narSize(uint32_t i) const;
+
+    std::span<const uint32_t> references(uint32_t i) const;
+
+    std::span<const uint32_t> referrers(uint32_t i) const;
+
+    /**
+     * All paths, in order.
+     */
+    StorePathSet paths() const;
+
+    /**
+     * The indices of the paths reachable from `start` via references,
+     * or referrers if `flipDirection` is set, including `start`.
+     */
+    std::vector<uint32_t> closure(std::span<const uint32_t> start, bool flipDirection) const;
+
+    /**
+     * The contents of this snapshot with `changes` applied.
+     */
+    Columns merge(const Changes & changes) const;
+
+    /**
+     * The header of a snapshot file, see metadata-snapshot.cc.
+     */
+    struct Header;
+
+private:
+
+    MetadataSnapshot() = default;
+
+    /**
+     * The mapping of the whole file.
+     */
+    const char * data = nullptr;
+    size_t dataSize = 0;
+
+    dev_t dev;
+    ino_t ino;
+
+    const Header & header() const
+    {
+        return *reinterpret_cast<const Header *>(data);
+    }
+
+    const HashBytes * hashes;
+    const uint32_t * nameStarts;
+    const char * names;
+    const uint64_t * narSizes;
+    const uint64_t * refStarts;
+    const uint32_t * refs;
+    const uint64_t * referrerStarts;
+    const uint32_t * referrers_;
+
+    std::string_view name(uint32_t i) const
+    {
+        return {names + nameStarts[i], names + nameStarts[i + 1]};
+    }
+};
+
+}
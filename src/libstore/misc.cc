@@ -4,7 +4,6 @@
 #include "store-api.hh"
 #include "thread-pool.hh"
 #include "topo-sort.hh"
-#include "closure.hh"
 #include "filetransfer.hh"
 #include "strings.hh"
 
@@ -13,48 +12,62 @@ namespace nix {
 void Store::computeFSClosure(const StorePathSet & startPaths,
     StorePathSet & paths_, bool flipDirection, bool includeOutputs, bool includeDerivers)
 {
-    std::function<std::set<StorePath>(const StorePath & path, ref<const ValidPathInfo>)> queryDeps;
+    /* Track the visited paths in a hash set and only sort them once
+       at the end, since closures can have hundreds of thousands of
+       paths. */
+    StorePathHashSet closure;
+    StorePaths todo;
+
+    auto enqueue = [&](const StorePath & path) {
+        if (closure.insert(path).second)
+            todo.push_back(path);
+    };
+
+    std::function<void(const StorePath & path, ref<const ValidPathInfo>)> queryDeps;
     if (flipDirection)
         queryDeps = [&](const StorePath& path, ref<const ValidPathInfo>) {
-            StorePathSet res;
             StorePathSet referrers;
             queryReferrers(path, referrers);
             for (auto& ref : referrers)
                 if (ref != path)
-                    res.insert(ref);
+                    enqueue(ref);
 
             if (includeOutputs)
                 for (auto& i : queryValidDerivers(path))
-                    res.insert(i);
+                    enqueue(i);
 
             if (includeDerivers && path.isDerivation())
                 for (auto& [_, maybeOutPath] : queryPartialDerivationOutputMap(path))
                     if (maybeOutPath && isValidPath(*maybeOutPath))
-                        res.insert(*maybeOutPath);
-            return res;
+                        enqueue(*maybeOutPath);
         };
     else
         queryDeps = [&](const StorePath& path, ref<const ValidPathInfo> info) {
-            StorePathSet res;
             for (auto& ref : info->references)
                 if (ref != path)
-                    res.insert(ref);
+                    enqueue(ref);
 
             if (includeOutputs && path.isDerivation())
                 for (auto& [_, maybeOutPath] : queryPartialDerivationOutputMap(path))
                     if (maybeOutPath && isValidPath(*maybeOutPath))
-                        res.insert(*maybeOutPath);
+                        enqueue(*maybeOutPath);
 
             if (includeDerivers && info->deriver && isValidPath(*info->deriver))
-                res.insert(*info->deriver);
-            return res;
+                enqueue(*info->deriver);
         };
 
-    paths_.merge(computeClosure<StorePath>(
-        startPaths,
-        [&](const StorePath& path) -> std::set<StorePath> {
-            return queryDeps(path, queryPathInfo(path));
-        }));
+    for (auto & path : startPaths)
+        enqueue(path);
+
+    while (!todo.empty()) {
+        auto path = std::move(todo.back());
+        todo.pop_back();
+        queryDeps(path, queryPathInfo(path));
+    }
+
+    StorePaths sorted(closure.begin(), closure.end());
+    std::sort(sorted.begin(), sorted.end());
+    paths_.insert(sorted.begin(), sorted.end());
 }
 
 void Store::computeFSClosure(const StorePath & startPath,
@@ -90,7 +103,10 @@ void Store::queryMissing(const std::vector<DerivedPath> & targets,
 
     struct State
     {
+        /* Built paths are keyed by their printed form; the far more
+           numerous opaque paths by the path itself. */
         std::unordered_set<std::string> done;
+        StorePathHashSet doneOpaque;
         StorePathSet & unknown, & willSubstitute, & willBuild;
         uint64_t & downloadSize;
         uint64_t & narSize;
@@ -104,7 +120,7 @@ void Store::queryMissing(const std::vector<DerivedPath> & targets,
         DrvState(size_t left) : left(left) { }
     };
 
-    Sync<State> state_(State{{}, unknown_, willSubstitute_, willBuild_, downloadSize_, narSize_});
+    Sync<State> state_(State{{}, {}, unknown_, willSubstitute_, willBuild_, downloadSize_, narSize_});
 
     std::function<void(DerivedPath)> doPath;
 
@@ -166,7 +182,15 @@ void Store::queryMissing(const std::vector<DerivedPath> & targets,
 
         {
             auto state(state_.lock());
-            if (!state->done.insert(req.to_string(*this)).second) return;
+            auto isNew = std::visit(overloaded {
+                [&](const DerivedPath::Opaque & bo) {
+                    return state->doneOpaque.insert(bo.path).second;
+                },
+                [&](const DerivedPath::Built &) {
+                    return state->done.insert(req.to_string(*this)).second;
+                },
+            }, req.raw());
+            if (!isNew) return;
         }
 
         std::visit(overloaded {
@@ -279,7 +303,7 @@ void Store::queryMissing(const std::vector<DerivedPath> & targets,
 
 StorePaths Store::topoSortPaths(const StorePathSet & paths)
 {
-    return topoSort(paths,
+    return topoSort<StorePath, StorePathHashSet>(paths,
         {[&](const StorePath & path) {
             try {
                 return queryPathInfo(path)->references;
@@ -354,6 +354,27 @@ public:
         });
     }
 
+    void upsertMissingNarInfos(
+        const std::string & uri, const std::set<std::string> & hashParts) override
+    {
+        retrySQLite<void>([&]() {
+            auto state(_state.lock());
+
+            auto & cache(getCache(*state, uri));
+
+            SQLiteTxn txn(state->db);
+
+            auto now = time(0);
+            for (auto & hashPart : hashParts)
+                state->insertMissingNAR.use()
+                    (cache.id)
+                    (hashPart)
+                    (now).exec();
+
+            txn.commit();
+        });
+    }
+
     void upsertRealisation(
         const std::string & uri,
         const Realisation & realisation) override
@@ -33,6 +33,14 @@ public:
         const std::string & uri, const std::string & hashPart,
         std::shared_ptr<const ValidPathInfo> info) = 0;
 
+    /**
+     * Record that none of the given hash parts exist in the cache at
+     * `uri`. All entries are written in a single transaction, which
+     * makes this much faster than calling `upsertNarInfo()` for each.
+     */
+    virtual void upsertMissingNarInfos(
+        const std::string & uri, const std::set<std::string> & hashParts) = 0;
+
     virtual void upsertRealisation(
         const std::string & uri,
         const Realisation & realisation) = 0;
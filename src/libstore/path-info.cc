@@ -103,6 +103,44 @@ size_t ValidPathInfo::checkSignatures(const Store & store, const PublicKeys & pu
 }
 
 
+StorePathSet findTrustedPaths(
+    const Store & store,
+    const std::vector<const ValidPathInfo *> & infos,
+    const PublicKeys & publicKeys)
+{
+    StorePathSet trusted;
+
+    std::vector<std::string> fingerprints;
+    fingerprints.reserve(infos.size());
+    std::vector<std::pair<std::string_view, std::string_view>> sigs;
+    /* The paths to check, with the range of their signatures in `sigs`. */
+    std::vector<std::tuple<const StorePath *, size_t, size_t>> toCheck;
+
+    for (auto info : infos) {
+        if (info->isContentAddressed(store)) {
+            trusted.insert(info->path);
+            continue;
+        }
+        try {
+            fingerprints.push_back(info->fingerprint(store));
+        } catch (Error &) {
+            continue;
+        }
+        toCheck.emplace_back(&info->path, sigs.size(), info->sigs.size());
+        for (auto & sig : info->sigs)
+            sigs.emplace_back(fingerprints.back(), sig);
+    }
+
+    auto valid = verifyDetachedBatch(sigs, publicKeys);
+
+    for (auto & [path, start, count] : toCheck)
+        if (std::find(valid.begin() + start, valid.begin() + start + count, true) != valid.begin() + start + count)
+            trusted.insert(*path);
+
+    return trusted;
+}
+
+
 bool ValidPathInfo::checkSignature(const Store & store, const PublicKeys & publicKeys, const std::string & sig) const
 {
     return verifyDetached(fingerprint(store), sig, publicKeys);
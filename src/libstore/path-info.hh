@@ -136,6 +136,20 @@ struct ValidPathInfo : UnkeyedValidPathInfo {
     virtual ~ValidPathInfo() { }
 };
 
+/**
+ * Like ValidPathInfo::checkSignatures(), but for many paths at once,
+ * with their signatures verified in parallel by verifyDetachedBatch().
+ *
+ * @return the paths that are content-addressed or have at least one
+ * valid signature by one of `publicKeys`. Paths whose fingerprint
+ * can't be computed are left out, so that adding them still checks,
+ * and reports, them.
+ */
+StorePathSet findTrustedPaths(
+    const Store & store,
+    const std::vector<const ValidPathInfo *> & infos,
+    const PublicKeys & publicKeys);
+
 using ValidPathInfos = std::map<StorePath, ValidPathInfo>;
 
 }
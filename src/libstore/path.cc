@@ -4,25 +4,30 @@
 
 namespace nix {
 
-static void checkName(std::string_view path, std::string_view name)
+/**
+ * @param path Returns the path for error messages, so that it is only
+ * printed if the name is invalid.
+ */
+template<typename F>
+static void checkName(F && path, std::string_view name)
 {
     if (name.empty())
-        throw BadStorePath("store path '%s' has an empty name", path);
+        throw BadStorePath("store path '%s' has an empty name", path());
     if (name.size() > StorePath::MaxPathLen)
         throw BadStorePath("store path '%s' has a name longer than %d characters",
-            path, StorePath::MaxPathLen);
+            path(), StorePath::MaxPathLen);
     // See nameRegexStr for the definition
     if (name[0] == '.') {
         // check against "." and "..", followed by end or dash
         if (name.size() == 1)
-            throw BadStorePath("store path '%s' has invalid name '%s'", path, name);
+            throw BadStorePath("store path '%s' has invalid name '%s'", path(), name);
         if (name[1] == '-')
-            throw BadStorePath("store path '%s' has invalid name '%s': first dash-separated component must not be '%s'", path, name, ".");
+            throw BadStorePath("store path '%s' has invalid name '%s': first dash-separated component must not be '%s'", path(), name, ".");
         if (name[1] == '.') {
             if (name.size() == 2)
-                throw BadStorePath("store path '%s' has invalid name '%s'", path, name);
+                throw BadStorePath("store path '%s' has invalid name '%s'", path(), name);
             if (name[2] == '-')
-                throw BadStorePath("store path '%s' has invalid name '%s': first dash-separated component must not be '%s'", path, name, "..");
+                throw BadStorePath("store path '%s' has invalid name '%s': first dash-separated component must not be '%s'", path(), name, "..");
         }
     }
     for (auto c : name)
@@ -30,25 +35,116 @@ static void checkName(std::string_view path, std::string_view name)
                 || (c >= 'a' && c <= 'z')
                 || (c >= 'A' && c <= 'Z')
                 || c == '+' || c == '-' || c == '.' || c == '_' || c == '?' || c == '='))
-            throw BadStorePath("store path '%s' contains illegal character '%s'", path, c);
+            throw BadStorePath("store path '%s' contains illegal character '%s'", path(), c);
 }
 
-StorePath::StorePath(std::string_view _baseName)
-    : baseName(_baseName)
+/**
+ * Same as `base32Chars`, but usable while initialising
+ * `StorePath::dummy`.
+ */
+constexpr std::string_view storePathBase32Chars = "0123456789abcdfghijklmnpqrsvwxyz";
+
+/**
+ * The value of each base-32 digit, for characters that have already
+ * been checked to be valid.
+ */
+constexpr auto base32Digits = []() {
+    std::array<uint8_t, 256> res{};
+    for (size_t i = 0; i < storePathBase32Chars.size(); i++)
+        res[(unsigned char) storePathBase32Chars[i]] = i;
+    return res;
+}();
+
+/* These follow parseHash32 and printHash32 in hash.cc, except that
+   `hash` is stored most significant byte first, i.e. reversed. */
+
+static void decodeHashPart(std::string_view s, uint8_t * hash)
+{
+    memset(hash, 0, StorePath::HashSize);
+    for (unsigned int n = 0; n < StorePath::HashLen; ++n) {
+        unsigned int digit = base32Digits[(unsigned char) s[StorePath::HashLen - n - 1]];
+        unsigned int b = n * 5;
+        unsigned int i = b / 8;
+        unsigned int j = b % 8;
+        hash[StorePath::HashSize - 1 - i] |= digit << j;
+        if (i < StorePath::HashSize - 1)
+            hash[StorePath::HashSize - 2 - i] |= digit >> (8 - j);
+    }
+}
+
+static void encodeHashPart(const uint8_t * hash, std::string & s)
+{
+    for (int n = (int) StorePath::HashLen - 1; n >= 0; n--) {
+        unsigned int b = n * 5;
+        unsigned int i = b / 8;
+        unsigned int j = b % 8;
+        unsigned char c =
+            (hash[StorePath::HashSize - 1 - i] >> j)
+            | (i >= StorePath::HashSize - 1 ? 0 : hash[StorePath::HashSize - 2 - i] << (8 - j));
+        s.push_back(storePathBase32Chars[c & 0x1f]);
+    }
+}
+
+void StorePath::assignName(std::string_view name)
+{
+    assert(nameSize == 0);
+    if (name.size() > InlineLen) {
+        auto p = new char[name.size()];
+        memcpy(p, name.data(), name.size());
+        memcpy(nameBuf, &p, sizeof(p));
+    } else
+        memcpy(nameBuf, name.data(), name.size());
+    nameSize = name.size();
+}
+
+StorePath::StorePath(std::string_view baseName)
+    : nameSize(0)
 {
     if (baseName.size() < HashLen + 1)
         throw BadStorePath("'%s' is too short to be a valid store path", baseName);
-    for (auto c : hashPart())
+    for (auto c : baseName.substr(0, HashLen))
         if (c == 'e' || c == 'o' || c == 'u' || c == 't'
             || !((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z')))
             throw BadStorePath("store path '%s' contains illegal base-32 character '%s'", baseName, c);
-    checkName(baseName, name());
+    checkName([&]() { return baseName; }, baseName.substr(HashLen + 1));
+    decodeHashPart(baseName, hash);
+    assignName(baseName.substr(HashLen + 1));
 }
 
 StorePath::StorePath(const Hash & hash, std::string_view _name)
-    : baseName((hash.to_string(Base::Base32, false) + "-").append(std::string(_name)))
+    : nameSize(0)
+{
+    assert(hash.hashSize == HashSize);
+    checkName([&]() { return (hash.to_string(Base::Base32, false) + "-").append(_name); }, _name);
+    for (size_t i = 0; i < HashSize; i++)
+        this->hash[i] = hash.hash[HashSize - 1 - i];
+    assignName(_name);
+}
+
+StorePath::StorePath(std::span<const uint8_t, HashSize> hash, std::string_view _name)
+    : nameSize(0)
+{
+    memcpy(this->hash, hash.data(), HashSize);
+    checkName([&]() { return to_string(); }, _name);
+    assignName(_name);
+}
+
+std::string StorePath::to_string() const
 {
-    checkName(baseName, name());
+    std::string s;
+    s.reserve(HashLen + 1 + nameSize);
+    encodeHashPart(hash, s);
+    s.push_back('-');
+    s.append(name());
+    return s;
+}
+
+std::string StorePath::hashPart() const
+{
+    std::string s;
+    s.reserve(HashLen);
+    encodeHashPart(hash, s);
+    return s;
 }
 
 bool StorePath::isDerivation() const
@@ -112,13 +208,3 @@ PathSet Store::printStorePathSet(const StorePathSet & paths) const
 }
 
 }
-
-std::size_t std::hash<nix::StorePath>::operator()(const nix::StorePath & path) const noexcept
-{
-    // It's already a cryptographic hash of 160 bits (assuming that nobody gives us bogus ones...), so just parse it.
-    auto h = nix::Hash::parseNonSRIUnprefixed(path.hashPart(), nix::HashType::SHA1);
-    // This need not be stable across machines, so bit casting the start of it is fine.
-    size_t r;
-    memcpy(&r, h.hash, sizeof(r));
-    return r;
-}
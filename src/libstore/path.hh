@@ -1,8 +1,15 @@
 #pragma once
 ///@file
 
+#include <cstring>
+#include <span>
 #include <string_view>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <boost/unordered/unordered_flat_map.hpp>
+#include <boost/unordered/unordered_flat_set.hpp>
 
 #include "types.hh" // IWYU pragma: keep
 
@@ -19,8 +26,6 @@ struct Hash;
  */
 class StorePath
 {
-    std::string baseName;
-
 public:
 
     /**
@@ -28,32 +33,138 @@ public:
      */
     constexpr static size_t HashLen = 32; // i.e. 160 bits
 
+    /**
+     * Size of the hash part of store paths, in bytes.
+     */
+    constexpr static size_t HashSize = 20;
+
     constexpr static size_t MaxPathLen = 211;
 
+private:
+
+    /**
+     * The decoded hash part, most significant byte first. Base-32
+     * prints the most significant digit of the hash first (see
+     * `printHash32()`), so comparing these bytes with `memcmp()` orders
+     * store paths the same way as comparing their base names.
+     */
+    uint8_t hash[HashSize];
+
+    uint8_t nameSize;
+
+    /**
+     * Names up to this length, which covers most store paths, are
+     * stored inline, so that creating and copying a store path usually
+     * doesn't allocate. Together with the decoded hash this makes a
+     * StorePath 64 bytes, where the `std::string` it replaced took 32
+     * plus a separate allocation of at least 34 bytes for the base
+     * name.
+     */
+    constexpr static size_t InlineLen = 43;
+
+    /**
+     * The name if it fits, otherwise a pointer to it.
+     */
+    char nameBuf[InlineLen];
+
+    bool onHeap() const
+    {
+        return nameSize > InlineLen;
+    }
+
+    char * heapData() const
+    {
+        char * p;
+        memcpy(&p, nameBuf, sizeof(p));
+        return p;
+    }
+
+    void assignName(std::string_view name);
+
+    void release()
+    {
+        if (onHeap()) delete[] heapData();
+        nameSize = 0;
+    }
+
+    StorePath(const uint8_t * hash, std::string_view name)
+        : nameSize(0)
+    {
+        memcpy(this->hash, hash, HashSize);
+        assignName(name);
+    }
+
+public:
+
     StorePath() = delete;
 
     StorePath(std::string_view baseName);
 
     StorePath(const Hash & hash, std::string_view name);
 
-    std::string_view to_string() const
+    /**
+     * Construct a store path from the bytes returned by `hashBytes()`
+     * and a name.
+     */
+    StorePath(std::span<const uint8_t, HashSize> hash, std::string_view name);
+
+    StorePath(const StorePath & other)
+        : StorePath(other.hash, other.name())
+    { }
+
+    StorePath(StorePath && other) noexcept
+        : nameSize(0)
     {
-        return baseName;
+        *this = std::move(other);
     }
 
+    ~StorePath()
+    {
+        release();
+    }
+
+    StorePath & operator = (const StorePath & other)
+    {
+        if (this != &other) {
+            release();
+            memcpy(hash, other.hash, HashSize);
+            assignName(other.name());
+        }
+        return *this;
+    }
+
+    StorePath & operator = (StorePath && other) noexcept
+    {
+        if (this != &other) {
+            release();
+            memcpy(hash, other.hash, HashSize);
+            memcpy(nameBuf, other.nameBuf, other.onHeap() ? sizeof(char *) : other.nameSize);
+            nameSize = other.nameSize;
+            other.nameSize = 0;
+        }
+        return *this;
+    }
+
+    /**
+     * The base name of the path, i.e. the hash part and the name
+     * separated by a dash.
+     */
+    std::string to_string() const;
+
     bool operator < (const StorePath & other) const
     {
-        return baseName < other.baseName;
+        auto r = memcmp(hash, other.hash, HashSize);
+        return r < 0 || (r == 0 && name() < other.name());
     }
 
     bool operator == (const StorePath & other) const
     {
-        return baseName == other.baseName;
+        return memcmp(hash, other.hash, HashSize) == 0 && name() == other.name();
     }
 
     bool operator != (const StorePath & other) const
     {
-        return baseName != other.baseName;
+        return !(*this == other);
     }
 
     /**
@@ -63,12 +174,28 @@ public:
 
     std::string_view name() const
     {
-        return std::string_view(baseName).substr(HashLen + 1);
+        return {onHeap() ? heapData() : nameBuf, nameSize};
+    }
+
+    std::string hashPart() const;
+
+    /**
+     * The decoded hash part, in an order such that comparing it with
+     * `memcmp()` orders store paths like their base names.
+     */
+    std::span<const uint8_t, HashSize> hashBytes() const
+    {
+        return std::span<const uint8_t, HashSize>(hash, HashSize);
     }
 
-    std::string_view hashPart() const
+    /**
+     * A prefix of the decoded hash part, for hash tables.
+     */
+    size_t hashPrefix() const
     {
-        return std::string_view(baseName).substr(0, HashLen);
+        size_t r;
+        memcpy(&r, hash, sizeof(r));
+        return r;
     }
 
     static StorePath dummy;
@@ -76,6 +203,8 @@ public:
     static StorePath random(std::string_view name);
 };
 
+static_assert(sizeof(StorePath) == 64, "update the size trade-off described at StorePath::InlineLen");
+
 typedef std::set<StorePath> StorePathSet;
 typedef std::vector<StorePath> StorePaths;
 
@@ -90,7 +219,32 @@ const std::string drvExtension = ".drv";
 namespace std {
 
 template<> struct hash<nix::StorePath> {
-    std::size_t operator()(const nix::StorePath & path) const noexcept;
+    /**
+     * The hash part is already a cryptographic hash, so tell
+     * `boost::unordered_flat_*` not to mix it again.
+     */
+    using is_avalanching = std::true_type;
+
+    std::size_t operator()(const nix::StorePath & path) const noexcept
+    {
+        return path.hashPrefix();
+    }
 };
 
 }
+
+namespace nix {
+
+/**
+ * Sets and maps of store paths for when the iteration order doesn't
+ * matter. These are open-addressed tables that store the paths inline
+ * and hash a prefix of the decoded hash part. Like all open-addressed
+ * tables they move their elements when they grow, so don't hold on to
+ * references into them across insertions.
+ */
+typedef boost::unordered_flat_set<StorePath, std::hash<StorePath>> StorePathHashSet;
+
+template<typename V>
+using StorePathHashMap = boost::unordered_flat_map<StorePath, V, std::hash<StorePath>>;
+
+}
@@ -7,7 +7,12 @@
 #include "globals.hh"
 #include "compression.hh"
 #include "filetransfer.hh"
+#include "finally.hh"
 #include "strings.hh"
+#include "sync.hh"
+#include "thread-pool.hh"
+
+#include <unordered_set>
 
 #include <aws/core/Aws.h>
 #include <aws/core/VersionConfig.h>
@@ -21,7 +26,7 @@
 #include <aws/s3/S3Client.h>
 #include <aws/s3/model/GetObjectRequest.h>
 #include <aws/s3/model/HeadObjectRequest.h>
-#include <aws/s3/model/ListObjectsRequest.h>
+#include <aws/s3/model/ListObjectsV2Request.h>
 #include <aws/s3/model/PutObjectRequest.h>
 #include <aws/transfer/TransferManager.h>
 
@@ -146,31 +151,115 @@ ref<Aws::Client::ClientConfiguration> S3Helper::makeConfig(
     return res;
 }
 
-S3Helper::FileTransferResult S3Helper::getObject(
+static Aws::S3::Model::GetObjectRequest makeGetObjectRequest(
     const std::string & bucketName, const std::string & key)
 {
-    debug("fetching 's3://%s/%s'...", bucketName, key);
-
     auto request =
         Aws::S3::Model::GetObjectRequest()
         .WithBucket(bucketName)
         .WithKey(key);
 
-    request.SetResponseStreamFactory([&]() {
+    request.SetResponseStreamFactory([]() {
         return Aws::New<std::stringstream>("STRINGSTREAM");
     });
 
+    return request;
+}
+
+static std::string rangeHeader(uint64_t start, uint64_t end)
+{
+    return fmt("bytes=%d-%d", start, end - 1);
+}
+
+static std::string bodyOf(Aws::S3::Model::GetObjectResult & result)
+{
+    return dynamic_cast<std::stringstream &>(result.GetBody()).str();
+}
+
+/* Fetch `key` in ranged parts of `partSize` bytes. The first part
+   tells us the size of the object (via Content-Range), after which the
+   remaining parts are fetched in parallel. All parts are pinned to the
+   ETag of the first response so that an object replaced halfway
+   through the download is not spliced together from two versions. */
+static Aws::S3::Model::GetObjectResult getObjectParts(
+    Aws::S3::S3Client & client,
+    const std::string & bucketName, const std::string & key, uint64_t partSize,
+    std::string & data)
+{
+    auto request = makeGetObjectRequest(bucketName, key);
+    request.SetRange(rangeHeader(0, partSize));
+
+    auto first = checkAws(fmt("AWS error fetching '%s'", key),
+        client.GetObject(request));
+
+    data = bodyOf(first);
+
+    /* Content-Range looks like 'bytes 0-1023/4096'. If it is missing,
+       the server ignored the range and sent the entire object. */
+    auto & contentRange = first.GetContentRange();
+    auto slash = contentRange.rfind('/');
+    auto total = slash == std::string::npos
+        ? std::nullopt
+        : string2Int<uint64_t>(contentRange.substr(slash + 1));
+
+    if (!total || *total <= data.size())
+        return first;
+
+    uint64_t offset = data.size();
+    std::vector<std::string> parts((*total - offset + partSize - 1) / partSize);
+
+    ThreadPool pool(std::min<size_t>(parts.size(), std::thread::hardware_concurrency()));
+
+    for (size_t n = 0; n < parts.size(); ++n)
+        pool.enqueue([&, n]() {
+            auto start = offset + n * partSize;
+            auto end = std::min(start + partSize, *total);
+
+            auto request = makeGetObjectRequest(bucketName, key);
+            request.SetRange(rangeHeader(start, end));
+            request.SetIfMatch(first.GetETag());
+
+            auto result = checkAws(fmt("AWS error fetching '%s' (%s)", key, request.GetRange()),
+                client.GetObject(request));
+            parts[n] = bodyOf(result);
+
+            if (parts[n].size() != end - start)
+                throw Error("AWS error fetching '%s': got %d bytes for range %s",
+                    key, parts[n].size(), request.GetRange());
+        });
+
+    pool.process();
+
+    data.reserve(*total);
+    for (auto & part : parts) {
+        data += part;
+        part = {};
+    }
+
+    return first;
+}
+
+S3Helper::FileTransferResult S3Helper::getObject(
+    const std::string & bucketName, const std::string & key, uint64_t partSize)
+{
+    debug("fetching 's3://%s/%s'...", bucketName, key);
+
     FileTransferResult res;
 
     auto now1 = std::chrono::steady_clock::now();
 
     try {
 
-        auto result = checkAws(fmt("AWS error fetching '%s'", key),
-            client->GetObject(request));
+        if (partSize) {
+            std::string data;
+            auto result = getObjectParts(*client, bucketName, key, partSize, data);
+            res.data = decompress(result.GetContentEncoding(), std::move(data));
+        } else {
+            auto result = checkAws(fmt("AWS error fetching '%s'", key),
+                client->GetObject(makeGetObjectRequest(bucketName, key)));
 
-        res.data = decompress(result.GetContentEncoding(),
-            dynamic_cast<std::stringstream &>(result.GetBody()).str());
+            res.data = decompress(result.GetContentEncoding(), bodyOf(result));
+        }
 
     } catch (S3Error & e) {
         if ((e.err != Aws::S3::S3Errors::NO_SUCH_KEY) &&
@@ -239,7 +328,8 @@ struct S3BinaryCacheStoreConfig : virtual BinaryCacheStoreConfig
         R"(
           Compression method for `log/*` files. It is recommended to
           use a compression method supported by most web browsers
-          (e.g. `brotli`).
+          (e.g. `brotli`). Logs compressed with `zstd` are written in the
+          zstd seekable format, the same format used for local build logs.
         )"};
 
     const Setting<bool> multipartUpload{
@@ -250,6 +340,34 @@ struct S3BinaryCacheStoreConfig : virtual BinaryCacheStoreConfig
         this, 5 * 1024 * 1024, "buffer-size",
         "Size (in bytes) of each part in multi-part uploads."};
 
+    const Setting<uint64_t> downloadPartSize{
+        this, 0, "download-part-size",
+        R"(
+          If non-zero, NARs are downloaded as a series of ranged requests
+          of this many bytes each. After the first part has arrived, the
+          remaining parts are fetched in parallel, which is considerably
+          faster for large NARs than a single request.
+        )"};
+
+    const Setting<unsigned int> narinfoListingThreshold{
+        this, 0, "narinfo-listing-threshold",
+        R"(
+          If non-zero, checking the validity of at least this many paths
+          at once (for example when substituting or copying a large
+          closure) lists all `.narinfo` files in the bucket instead of
+          fetching each `.narinfo` file separately. The listing is kept in
+          memory for
+          [`narinfo-cache-negative-ttl`](@docroot@/command-ref/conf-file.md#conf-narinfo-cache-negative-ttl)
+          seconds and answers all validity checks in that time, in
+          addition to the one it was made for. Paths
+          missing from the listing are recorded in the NAR info disk
+          cache.
+
+          Listing takes one request per 1000 objects in the bucket, so
+          this pays off when the bucket is not vastly larger than the
+          closures queried from it.
+        )"};
+
     const std::string name() override { return "S3 Binary Cache Store"; }
 
     std::string doc() override
@@ -268,6 +386,30 @@ struct S3BinaryCacheStoreImpl : virtual S3BinaryCacheStoreConfig, public virtual
 
     S3Helper s3Helper;
 
+    /**
+     * The hash parts of all `.narinfo` files in the bucket, as of the
+     * last listing. See `narinfo-listing-threshold`.
+     */
+    struct NarInfoListing
+    {
+        std::chrono::steady_clock::time_point time;
+        std::unordered_set<std::string> hashParts;
+    };
+
+    struct NarInfoListingState
+    {
+        std::optional<NarInfoListing> listing;
+
+        /**
+         * Set while a new listing is being made. Collects the hash
+         * parts of `.narinfo` files uploaded in the meantime, which the
+         * new listing may not include.
+         */
+        std::optional<std::unordered_set<std::string>> uploadedWhileListing;
+    };
+
+    Sync<NarInfoListingState> narInfoListing;
+
     S3BinaryCacheStoreImpl(
         const std::string & uriScheme,
         const std::string & bucketName,
@@ -311,6 +453,12 @@ struct S3BinaryCacheStoreImpl : virtual S3BinaryCacheStoreConfig, public virtual
        a GET is unlikely to be slower than HEAD. */
     bool isValidPathUncached(const StorePath & storePath) override
     {
+        {
+            auto state(narInfoListing.lock());
+            if (isFresh(state->listing))
+                return state->listing->hashParts.contains(std::string(storePath.hashPart()));
+        }
+
         try {
             queryPathInfo(storePath);
             return true;
@@ -319,6 +467,106 @@ struct S3BinaryCacheStoreImpl : virtual S3BinaryCacheStoreConfig, public virtual
         }
     }
 
+    StorePathSet queryValidPaths(const StorePathSet & paths, SubstituteFlag maybeSubstitute) override
+    {
+        StorePathSet valid;
+        std::set<std::string> missing;
+
+        /* List the bucket without holding the lock, so that concurrent
+           validity checks aren't blocked for the duration. Only one
+           listing is made at a time; other callers meanwhile query the
+           paths one by one. */
+        bool makeListing = false;
+        if (narinfoListingThreshold && paths.size() >= narinfoListingThreshold) {
+            auto state(narInfoListing.lock());
+            if (!isFresh(state->listing) && !state->uploadedWhileListing) {
+                state->uploadedWhileListing.emplace();
+                makeListing = true;
+            }
+        }
+
+        if (makeListing) {
+            Finally doneListing([&]() { narInfoListing.lock()->uploadedWhileListing.reset(); });
+            NarInfoListing listing{.time = std::chrono::steady_clock::now()};
+            listNarInfos([&](std::string hashPart) { listing.hashParts.insert(std::move(hashPart)); });
+            auto state(narInfoListing.lock());
+            listing.hashParts.merge(*state->uploadedWhileListing);
+            state->listing = std::move(listing);
+        }
+
+        bool haveListing;
+
+        {
+            auto state(narInfoListing.lock());
+
+            /* A listing made for this very query is used even if it is
+               already stale, e.g. because `narinfo-cache-negative-ttl`
+               is 0. */
+            haveListing = state->listing && (makeListing || isFresh(state->listing));
+
+            if (haveListing)
+                for (auto & path : paths) {
+                    std::string hashPart(path.hashPart());
+                    if (state->listing->hashParts.contains(hashPart))
+                        valid.insert(path);
+                    else
+                        missing.insert(std::move(hashPart));
+                }
+        }
+
+        if (!haveListing)
+            return S3BinaryCacheStore::queryValidPaths(paths, maybeSubstitute);
+
+        if (diskCache && !missing.empty())
+            diskCache->upsertMissingNarInfos(getUri(), missing);
+
+        return valid;
+    }
+
+    static bool isFresh(const std::optional<NarInfoListing> & listing)
+    {
+        return listing
+            && std::chrono::steady_clock::now() - listing->time
+                < std::chrono::seconds(settings.ttlNegativeNarInfoCache.get());
+    }
+
+    /**
+     * Call `fn` with the hash part of every `.narinfo` file at the top
+     * level of the bucket.
+     */
+    void listNarInfos(std::function<void(std::string)> fn)
+    {
+        auto request =
+            Aws::S3::Model::ListObjectsV2Request()
+            .WithBucket(bucketName)
+            .WithDelimiter("/");
+
+        while (true) {
+            debug("listing bucket 's3://%s' from token '%s'...",
+                bucketName, request.GetContinuationToken());
+
+            stats.list++;
+
+            auto res = checkAws(fmt("AWS error listing bucket '%s'", bucketName),
+                s3Helper.client->ListObjectsV2(request));
+
+            auto & contents = res.GetContents();
+
+            debug("got %d keys, next token '%s'",
+                contents.size(), res.GetNextContinuationToken());
+
+            for (auto & object : contents) {
+                auto & key = object.GetKey();
+                if (key.size() != 40 || !key.ends_with(".narinfo")) continue;
+                fn(key.substr(0, key.size() - 8));
+            }
+
+            if (!res.GetIsTruncated()) break;
+
+            request.SetContinuationToken(res.GetNextContinuationToken());
+        }
+    }
+
     bool fileExists(const std::string & path) override
     {
         stats.head++;
@@ -444,7 +692,10 @@ struct S3BinaryCacheStoreImpl : virtual S3BinaryCacheStoreConfig, public virtual
     {
         auto compress = [&](std::string compression)
         {
-            auto compressed = nix::compress(compression, StreamToSourceAdapter(istream).drain());
+            auto data = StreamToSourceAdapter(istream).drain();
+            auto compressed = compression == "zstd" && path.starts_with("log/")
+                ? compressSeekable(data)
+                : nix::compress(compression, data);
             return std::make_shared<std::stringstream>(std::move(compressed));
         };
 
@@ -456,6 +707,15 @@ struct S3BinaryCacheStoreImpl : virtual S3BinaryCacheStoreConfig, public virtual
             uploadFile(path, compress(logCompression), mimeType, logCompression);
         else
             uploadFile(path, istream, mimeType, "");
+
+        if (path.size() == 40 && path.ends_with(".narinfo")) {
+            auto hashPart = path.substr(0, path.size() - 8);
+            auto state(narInfoListing.lock());
+            if (state->listing)
+                state->listing->hashParts.insert(hashPart);
+            if (state->uploadedWhileListing)
+                state->uploadedWhileListing->insert(hashPart);
+        }
     }
 
     box_ptr<Source> getFile(const std::string & path) override
@@ -463,7 +723,8 @@ struct S3BinaryCacheStoreImpl : virtual S3BinaryCacheStoreConfig, public virtual
         stats.get++;
 
         // FIXME: stream output to sink.
-        auto res = s3Helper.getObject(bucketName, path);
+        auto res = s3Helper.getObject(bucketName, path,
+            path.starts_with("nar/") ? downloadPartSize.get() : 0);
 
         stats.getBytes += res.data ? res.data->size() : 0;
         stats.getTimeMs += res.durationMs;
@@ -484,31 +745,10 @@ struct S3BinaryCacheStoreImpl : virtual S3BinaryCacheStoreConfig, public virtual
     StorePathSet queryAllValidPaths() override
     {
         StorePathSet paths;
-        std::string marker;
-
-        do {
-            debug("listing bucket 's3://%s' from key '%s'...", bucketName, marker);
-
-            auto res = checkAws(fmt("AWS error listing bucket '%s'", bucketName),
-                s3Helper.client->ListObjects(
-                    Aws::S3::Model::ListObjectsRequest()
-                    .WithBucket(bucketName)
-                    .WithDelimiter("/")
-                    .WithMarker(marker)));
-
-            auto & contents = res.GetContents();
 
-            debug("got %d keys, next marker '%s'",
-                contents.size(), res.GetNextMarker());
-
-            for (auto object : contents) {
-                auto & key = object.GetKey();
-                if (key.size() != 40 || !key.ends_with(".narinfo")) continue;
-                paths.insert(parseStorePath(storeDir + "/" + key.substr(0, key.size() - 8) + "-" + MissingName));
-            }
-
-            marker = res.GetNextMarker();
-        } while (!marker.empty());
+        listNarInfos([&](std::string hashPart) {
+            paths.insert(parseStorePath(storeDir + "/" + hashPart + "-" + MissingName));
+        });
 
         return paths;
     }
@@ -28,8 +28,14 @@ struct S3Helper
         unsigned int durationMs;
     };
 
+    /**
+     * Fetch an object. If `partSize` is non-zero, the object is
+     * fetched as a sequence of ranged requests of at most `partSize`
+     * bytes each, issued in parallel once the size of the object is
+     * known from the first response.
+     */
     FileTransferResult getObject(
-        const std::string & bucketName, const std::string & key);
+        const std::string & bucketName, const std::string & key, uint64_t partSize = 0);
 };
 
 }
@@ -22,6 +22,12 @@ enum class SQLiteOpenMode {
      * Fails with an error if the database does not exist.
      */
     NoCreate,
+    /**
+     * Open the database in read-only mode. Unlike `Immutable`, this
+     * sees changes made by other connections.
+     * Fails with an error if the database does not exist.
+     */
+    ReadOnly,
     /**
      * Open the database in immutable mode.
      * In addition to the database being read-only,
@@ -287,6 +287,16 @@ void Store::addMultipleToStore(
     Activity & act,
     RepairFlag repair,
     CheckSigsFlag checkSigs)
+{
+    addMultipleToStore(pathsToCopy, act, repair, checkSigs, {});
+}
+
+void Store::addMultipleToStore(
+    PathsSource & pathsToCopy,
+    Activity & act,
+    RepairFlag repair,
+    CheckSigsFlag checkSigs,
+    const StorePathSet & trustedPaths)
 {
     std::atomic<size_t> nrDone{0};
     std::atomic<size_t> nrFailed{0};
@@ -345,7 +355,8 @@ void Store::addMultipleToStore(
                 MaintainCount<decltype(nrRunning)> mc(nrRunning);
                 showProgress();
                 try {
-                    addToStore(info, *source, repair, checkSigs);
+                    addToStore(info, *source, repair,
+                        trustedPaths.contains(path) ? NoCheckSigs : checkSigs);
                 } catch (Error & e) {
                     nrFailed++;
                     if (!settings.keepGoing)
@@ -526,7 +537,7 @@ StringSet StoreConfig::getDefaultSystemFeatures()
 
 Store::Store(const Params & params)
     : StoreConfig(params)
-    , state({(size_t) pathInfoCacheSize})
+    , pathInfoCache((size_t) pathInfoCacheSize)
 {
     assertLibStoreInitialized();
 }
@@ -546,6 +557,20 @@ bool Store::PathInfoCacheValue::isKnownNow()
     return std::chrono::steady_clock::now() < time_point + ttl;
 }
 
+bool Store::PathInfoCacheValue::matches(const StorePath & path) const
+{
+    if (!value)
+        return missingName == path.name();
+    return path.name() == MissingName || value->path.name() == path.name();
+}
+
+Store::PathInfoCacheKey::PathInfoCacheKey(const StorePath & path)
+{
+    auto h = Hash::parseNonSRIUnprefixed(path.hashPart(), HashType::SHA1);
+    static_assert(sizeof(hash) == 20);
+    memcpy(hash.data(), h.hash, hash.size());
+}
+
 std::map<std::string, std::optional<StorePath>> Store::queryStaticPartialDerivationOutputMap(const StorePath & path)
 {
     std::map<std::string, std::optional<StorePath>> outputs;
@@ -659,9 +684,8 @@ void Store::querySubstitutablePathInfos(const StorePathCAMap & paths, Substituta
 bool Store::isValidPath(const StorePath & storePath)
 {
     {
-        auto state_(state.lock());
-        auto res = state_->pathInfoCache.get(std::string(storePath.to_string()));
-        if (res && res->isKnownNow()) {
+        auto res = pathInfoCache.get(PathInfoCacheKey(storePath));
+        if (res && res->isKnownNow() && res->matches(storePath)) {
             stats.narInfoReadAverted++;
             return res->didExist();
         }
@@ -671,9 +695,10 @@ bool Store::isValidPath(const StorePath & storePath)
         auto res = diskCache->lookupNarInfo(getUri(), std::string(storePath.hashPart()));
         if (res.first != NarInfoDiskCache::oUnknown) {
             stats.narInfoReadAverted++;
-            auto state_(state.lock());
-            state_->pathInfoCache.upsert(std::string(storePath.to_string()),
-                res.first == NarInfoDiskCache::oInvalid ? PathInfoCacheValue{} : PathInfoCacheValue { .value = res.second });
+            pathInfoCache.upsert(PathInfoCacheKey(storePath),
+                res.first == NarInfoDiskCache::oInvalid
+                ? PathInfoCacheValue { .missingName = std::string(storePath.name()) }
+                : PathInfoCacheValue { .value = res.second });
             return res.first == NarInfoDiskCache::oValid;
         }
     }
@@ -722,8 +747,8 @@ ref<const ValidPathInfo> Store::queryPathInfo(const StorePath & storePath)
     auto hashPart = std::string(storePath.hashPart());
 
     {
-        auto res = state.lock()->pathInfoCache.get(std::string(storePath.to_string()));
-        if (res && res->isKnownNow()) {
+        auto res = pathInfoCache.get(PathInfoCacheKey(storePath));
+        if (res && res->isKnownNow() && res->matches(storePath)) {
             stats.narInfoReadAverted++;
             if (!res->didExist())
                 throw InvalidPath("path '%s' does not exist in the store", printStorePath(storePath));
@@ -735,13 +760,12 @@ ref<const ValidPathInfo> Store::queryPathInfo(const StorePath & storePath)
         auto res = diskCache->lookupNarInfo(getUri(), hashPart);
         if (res.first != NarInfoDiskCache::oUnknown) {
             stats.narInfoReadAverted++;
-            {
-                auto state_(state.lock());
-                state_->pathInfoCache.upsert(std::string(storePath.to_string()),
-                    res.first == NarInfoDiskCache::oInvalid ? PathInfoCacheValue{} : PathInfoCacheValue{ .value = res.second });
-                if (res.first == NarInfoDiskCache::oInvalid)
-                    throw InvalidPath("path '%s' does not exist in the store", printStorePath(storePath));
-            }
+            pathInfoCache.upsert(PathInfoCacheKey(storePath),
+                res.first == NarInfoDiskCache::oInvalid
+                ? PathInfoCacheValue { .missingName = std::string(storePath.name()) }
+                : PathInfoCacheValue { .value = res.second });
+            if (res.first == NarInfoDiskCache::oInvalid)
+                throw InvalidPath("path '%s' does not exist in the store", printStorePath(storePath));
             return ref<const ValidPathInfo>(res.second);
         }
     }
@@ -756,10 +780,10 @@ ref<const ValidPathInfo> Store::queryPathInfo(const StorePath & storePath)
         diskCache->upsertNarInfo(getUri(), hashPart, info);
     }
 
-    {
-        auto state_(state.lock());
-        state_->pathInfoCache.upsert(std::string(storePath.to_string()), PathInfoCacheValue { .value = info });
-    }
+    pathInfoCache.upsert(PathInfoCacheKey(storePath),
+        info
+        ? PathInfoCacheValue { .value = info }
+        : PathInfoCacheValue { .missingName = std::string(storePath.name()) });
 
     if (!info) {
         stats.narInfoMissing++;
@@ -1024,6 +1048,11 @@ json Store::pathInfoToJSON(const StorePathSet & storePaths,
 
 std::pair<uint64_t, uint64_t> Store::getClosureSize(const StorePath & storePath)
 {
+    /* Stores that can aggregate closures themselves don't have
+       download sizes, as they don't return NarInfos. */
+    if (auto aggregates = queryClosureAggregates(storePath))
+        return {aggregates->narSize, 0};
+
     uint64_t totalNarSize = 0, totalDownloadSize = 0;
     StorePathSet closure;
     computeFSClosure(storePath, closure, false, false);
@@ -1041,10 +1070,11 @@ std::pair<uint64_t, uint64_t> Store::getClosureSize(const StorePath & storePath)
 
 const Store::Stats & Store::getStats()
 {
-    {
-        auto state_(state.lock());
-        stats.pathInfoCacheSize = state_->pathInfoCache.size();
-    }
+    auto & cacheStats = pathInfoCache.getStats();
+    stats.pathInfoCacheSize = pathInfoCache.size();
+    stats.pathInfoCacheHits = cacheStats.hits.load();
+    stats.pathInfoCacheMisses = cacheStats.misses.load();
+    stats.pathInfoCacheEvictions = cacheStats.evictions.load();
     return stats;
 }
 
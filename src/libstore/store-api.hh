@@ -9,7 +9,7 @@
 #include "hash.hh"
 #include "content-address.hh"
 #include "serialise.hh"
-#include "lru-cache.hh"
+#include "sharded-cache.hh"
 #include "sync.hh"
 #include "globals.hh"
 #include "config.hh"
@@ -197,6 +197,13 @@ protected:
          */
         std::shared_ptr<const ValidPathInfo> value;
 
+        /**
+         * For negative entries, the name of the path that was looked
+         * up. A path with the same hash part but another name may
+         * still exist.
+         */
+        std::string missingName;
+
         /**
          * Whether the value is valid as a cache entry. The path may not
          * exist.
@@ -210,14 +217,40 @@ protected:
         inline bool didExist() {
           return value != nullptr;
         }
+
+        /**
+         * Whether this entry answers a query for `path`. Entries are
+         * keyed by the hash part of the path only, so an entry for a
+         * path with the same hash part but another name does not,
+         * whether it is positive or negative.
+         */
+        bool matches(const StorePath & path) const;
     };
 
-    struct State
+    /**
+     * The key of `pathInfoCache`: the raw hash part of a store path.
+     */
+    struct PathInfoCacheKey
     {
-        LRUCache<std::string, PathInfoCacheValue> pathInfoCache;
+        std::array<uint8_t, 20> hash;
+
+        explicit PathInfoCacheKey(const StorePath & path);
+
+        bool operator == (const PathInfoCacheKey &) const = default;
+
+        struct Hasher
+        {
+            size_t operator()(const PathInfoCacheKey & key) const
+            {
+                /* The hash part is already uniformly distributed. */
+                size_t res;
+                memcpy(&res, key.hash.data(), sizeof(res));
+                return res;
+            }
+        };
     };
 
-    Sync<State> state;
+    ShardedCache<PathInfoCacheKey, PathInfoCacheValue, PathInfoCacheKey::Hasher> pathInfoCache;
 
     std::shared_ptr<NarInfoDiskCache> diskCache;
 
@@ -510,6 +543,18 @@ public:
         RepairFlag repair = NoRepair,
         CheckSigsFlag checkSigs = CheckSigs);
 
+    /**
+     * Like addMultipleToStore(), but the signatures of the paths in
+     * `trustedPaths` are not checked again, because the caller already
+     * has.
+     */
+    void addMultipleToStore(
+        PathsSource & pathsToCopy,
+        Activity & act,
+        RepairFlag repair,
+        CheckSigsFlag checkSigs,
+        const StorePathSet & trustedPaths);
+
     /**
      * Copy the contents of a path to the store and register the
      * validity the resulting path.
@@ -687,6 +732,27 @@ public:
      */
     std::pair<uint64_t, uint64_t> getClosureSize(const StorePath & storePath);
 
+    struct ClosureAggregates
+    {
+        /**
+         * The sum of the NAR sizes of the paths in the closure.
+         */
+        uint64_t narSize;
+
+        /**
+         * The number of paths in the closure.
+         */
+        uint64_t paths;
+    };
+
+    /**
+     * @return the total NAR size and path count of the closure of
+     * `storePath`, if the store can determine them without querying
+     * every path in the closure, and `std::nullopt` otherwise.
+     */
+    virtual std::optional<ClosureAggregates> queryClosureAggregates(const StorePath & storePath)
+    { return std::nullopt; }
+
     /**
      * Optimise the disk space usage of the Nix store by hard-linking files
      * with the same contents.
@@ -791,6 +857,9 @@ public:
         std::atomic<uint64_t> narInfoMissing{0};
         std::atomic<uint64_t> narInfoWrite{0};
         std::atomic<uint64_t> pathInfoCacheSize{0};
+        std::atomic<uint64_t> pathInfoCacheHits{0};
+        std::atomic<uint64_t> pathInfoCacheMisses{0};
+        std::atomic<uint64_t> pathInfoCacheEvictions{0};
         std::atomic<uint64_t> narRead{0};
         std::atomic<uint64_t> narReadBytes{0};
         std::atomic<uint64_t> narReadCompressedBytes{0};
@@ -822,7 +891,7 @@ public:
      */
     void clearPathInfoCache()
     {
-        state.lock()->pathInfoCache.clear();
+        pathInfoCache.clear();
     }
 
     /**
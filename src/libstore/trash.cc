@@ -0,0 +1,230 @@
+#include "trash.hh"
+#include "file-system.hh"
+#include "globals.hh"
+#include "logging.hh"
+#include "signals.hh"
+#include "strings.hh"
+#include "sync.hh"
+
+#include <condition_variable>
+#include <deque>
+#include <signal.h>
+#include <thread>
+
+#if __linux__
+#include <sys/syscall.h>
+#endif
+
+namespace nix {
+
+/**
+ * A thread that deletes the paths moved into the trash, one at a time.
+ */
+class Reaper
+{
+    struct State
+    {
+        std::deque<Path> pending;
+        bool quit = false;
+    };
+
+    Sync<State> state_;
+    std::condition_variable wakeup;
+    std::thread thread;
+
+    void run();
+
+public:
+
+    Reaper()
+        : thread([this]() { run(); })
+    { }
+
+    /**
+     * Wait for the paths in the trash to be deleted. They are deleted
+     * after a build has finished, so this only delays the exit of the
+     * process, not any builds. The remaining paths are deleted at the
+     * default I/O priority, since the process can't exit before.
+     */
+    ~Reaper()
+    {
+        state_.lock()->quit = true;
+        wakeup.notify_one();
+        thread.join();
+    }
+
+    void enqueue(Path path)
+    {
+        state_.lock()->pending.push_back(std::move(path));
+        wakeup.notify_one();
+    }
+};
+
+/**
+ * Set the I/O priority of the calling thread to idle, or back to the
+ * default.
+ */
+static void setIdleIOPriority(bool idle)
+{
+#if __linux__
+    constexpr int IOPRIO_WHO_PROCESS = 1, IOPRIO_CLASS_NONE = 0, IOPRIO_CLASS_IDLE = 3, IOPRIO_CLASS_SHIFT = 13;
+    syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0,
+        (idle ? IOPRIO_CLASS_IDLE : IOPRIO_CLASS_NONE) << IOPRIO_CLASS_SHIFT);
+#endif
+}
+
+void Reaper::run()
+{
+    /* Only use disk bandwidth that nothing else wants. */
+    bool idle = true;
+    setIdleIOPriority(true);
+
+    while (true) {
+        Path path;
+        bool quitting;
+        {
+            auto state(state_.lock());
+            while (state->pending.empty() && !state->quit)
+                state.wait(wakeup);
+            if (state->pending.empty()) return;
+            path = std::move(state->pending.front());
+            state->pending.pop_front();
+            quitting = state->quit;
+        }
+
+        /* The process is now waiting for us to exit, so a busy disk
+           mustn't starve us any longer. */
+        if (quitting && idle) {
+            setIdleIOPriority(false);
+            idle = false;
+        }
+
+        try {
+            deletePath(path);
+        } catch (Interrupted &) {
+            /* Whatever isn't deleted yet stays in the trash, to be
+               picked up by recoverTrash() or emptyTrash(). */
+            return;
+        } catch (Error & e) {
+            e.addTrace({}, "while deleting '%s' in the background", path);
+            logWarning(e.info());
+        }
+    }
+}
+
+/**
+ * The reaper of the current process. Threads don't survive fork(), so
+ * a child process, such as a daemon worker, starts its own and
+ * abandons the one inherited from its parent.
+ */
+static Reaper & getReaper()
+{
+    static struct Holder
+    {
+        std::unique_ptr<Reaper> reaper;
+        pid_t pid = 0;
+
+        ~Holder()
+        {
+            if (pid != getpid())
+                (void) reaper.release();
+        }
+    } holder;
+
+    if (!holder.reaper || holder.pid != getpid()) {
+        (void) holder.reaper.release();
+        holder.reaper = std::make_unique<Reaper>();
+        holder.pid = getpid();
+    }
+
+    return *holder.reaper;
+}
+
+Path trashDirOf(const Path & parent)
+{
+    return fmt("%s/.lix-trash-%d", parent == "/" ? "" : parent, geteuid());
+}
+
+/**
+ * Whether `trashDir` can safely be used as our trash directory. In a
+ * shared directory like /tmp it could have been created by someone
+ * else.
+ */
+static bool isOwnTrashDir(const Path & trashDir)
+{
+    struct stat st;
+    return lstat(trashDir.c_str(), &st) == 0
+        && S_ISDIR(st.st_mode)
+        && st.st_uid == geteuid()
+        && (st.st_mode & 077) == 0;
+}
+
+void deletePathInBackground(const Path & path)
+{
+    static std::atomic<unsigned int> counter{0};
+
+    if (settings.asyncBuildDirCleanup) {
+        auto trashDir = trashDirOf(dirOf(path));
+        if ((mkdir(trashDir.c_str(), 0700) == 0 || errno == EEXIST) && isOwnTrashDir(trashDir)) {
+            auto target = fmt("%s/%s-%d-%d", trashDir, baseNameOf(path), getpid(), counter++);
+            if (rename(path.c_str(), target.c_str()) == 0) {
+                debug("moved '%s' to the trash", path);
+                getReaper().enqueue(std::move(target));
+                return;
+            }
+            if (errno == ENOENT) return;
+        }
+    }
+
+    deletePath(path);
+}
+
+/**
+ * Whether the entry `name` of a trash directory was put there by a
+ * process that is still running, whose reaper may be deleting it right
+ * now. Entries are named `<name>-<pid>-<counter>` by
+ * deletePathInBackground().
+ */
+static bool isOwnedByLiveProcess(std::string_view name)
+{
+    auto counter = name.rfind('-');
+    if (counter == name.npos) return false;
+    auto pidStart = name.rfind('-', counter - 1);
+    if (pidStart == name.npos) return false;
+    auto pid = string2Int<pid_t>(name.substr(pidStart + 1, counter - pidStart - 1));
+    return pid && *pid > 0 && (kill(*pid, 0) == 0 || errno == EPERM);
+}
+
+void emptyTrash(const Path & parent, uint64_t & bytesFreed)
+{
+    bytesFreed = 0;
+
+    auto trashDir = trashDirOf(parent);
+    if (!isOwnTrashDir(trashDir)) return;
+
+    for (auto & i : readDirectory(trashDir)) {
+        if (isOwnedByLiveProcess(i.name)) {
+            debug("leaving '%s' in the trash to the process that put it there", i.name);
+            continue;
+        }
+        auto path = trashDir + "/" + i.name;
+        debug("deleting leftover '%s' from the trash", path);
+        uint64_t n = 0;
+        try {
+            deletePath(path, n);
+        } catch (SysError & e) {
+            e.addTrace({}, "while deleting '%s' from the trash", path);
+            logWarning(e.info());
+        }
+        bytesFreed += n;
+    }
+}
+
+void recoverTrash(const Path & parent)
+{
+    setIdleIOPriority(true);
+    uint64_t bytesFreed;
+    emptyTrash(parent, bytesFreed);
+}
+
+}
@@ -0,0 +1,42 @@
+#pragma once
+///@file
+
+#include "types.hh"
+
+namespace nix {
+
+/**
+ * The trash directory of the current user for paths in `parent`. It
+ * lives next to the paths it receives, so that they can be moved into
+ * it atomically.
+ */
+Path trashDirOf(const Path & parent);
+
+/**
+ * Delete a path without waiting for it to be deleted: it is renamed
+ * into the trash directory of its parent directory and deleted there
+ * by a background thread with idle I/O priority. Falls back to
+ * deleting it synchronously if the trash directory can't be used, or
+ * if `async-build-dir-cleanup` is disabled.
+ *
+ * Must only be called from one thread at a time.
+ */
+void deletePathInBackground(const Path & path);
+
+/**
+ * Delete whatever is left in the trash directory of `parent`, e.g.
+ * because the process that moved it there was interrupted or crashed
+ * before it could finish deleting it. Entries of processes that are
+ * still running are left to them. `bytesFreed` is set to the number of
+ * bytes freed.
+ */
+void emptyTrash(const Path & parent, uint64_t & bytesFreed);
+
+/**
+ * Like emptyTrash(), but at idle I/O priority, which remains set for
+ * the calling thread afterwards. Meant to be run in a process of its
+ * own, such as one forked by the daemon at startup.
+ */
+void recoverTrash(const Path & parent);
+
+}
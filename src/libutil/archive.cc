@@ -1,6 +1,10 @@
 #include <cerrno>
 #include <algorithm>
+#include <condition_variable>
+#include <deque>
 #include <string_view>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 #include <map>
 
@@ -19,6 +23,7 @@
 #include "config.hh"
 #include "logging.hh"
 #include "signals.hh"
+#include "sync.hh"
 
 namespace nix {
 
@@ -34,6 +39,24 @@ struct ArchiveSettings : Config
         "Whether to enable a Darwin-specific hack for dealing with file name collisions."};
     Setting<bool> preallocateContents{this, false, "preallocate-contents",
         "Whether to preallocate files when writing objects with known size."};
+    Setting<unsigned int> narReadAheadThreads{this, 0, "nar-read-ahead-threads",
+        R"(
+          The number of threads used to read file contents ahead of the NAR
+          serialiser when dumping a path, e.g. for `nix copy`, `nix-store --dump`
+          or when adding a path to the store. Small files are read into a
+          bounded buffer in parallel; the kernel is asked to start reading larger
+          files before they are needed. This hides I/O latency on cold page
+          caches and network filesystems. `0` disables read-ahead.
+        )"};
+    Setting<unsigned int> narRestoreThreads{this, 0, "nar-restore-threads",
+        R"(
+          The number of threads used to write small files when unpacking a NAR,
+          e.g. when substituting a path or importing it with `nix-store --restore`.
+          The NAR is still parsed sequentially and directories and symlinks are
+          created in order, but the contents of small files are buffered and
+          written by the given number of threads, which speeds up unpacking
+          trees with very many small files. `0` writes all files sequentially.
+        )"};
 };
 
 static ArchiveSettings archiveSettings;
@@ -43,14 +66,186 @@ static GlobalConfig::Register rArchiveSettings(&archiveSettings);
 PathFilter defaultPathFilter = [](const Path &) { return true; };
 
 
-static WireFormatGenerator dumpContents(const Path & path, off_t size)
+/**
+ * Reads regular files ahead of the NAR serialiser. `dump()` submits
+ * the regular files of each directory it visits in canonical order;
+ * a small set of worker threads then reads small files into memory
+ * and asks the kernel to start reading larger ones, so the serialiser
+ * finds their contents ready by the time it gets to them.
+ *
+ * Submission never blocks: once `maxQueued` files are buffered or in
+ * flight further files are simply read synchronously. Workers never
+ * wait for the consumer, so claiming a file can't deadlock; a file no
+ * worker has started yet is claimed by the consumer and read inline.
+ */
+class NarReadAhead
+{
+public:
+    struct Job
+    {
+        Path path;
+        bool started = false;
+        bool finished = false;
+        /**
+         * Whether `data` holds the entire file. Not set for files that
+         * were too large to buffer or that could not be read, in which
+         * case the consumer reads the file (and reports errors) itself.
+         */
+        bool complete = false;
+        std::string data;
+    };
+
+    /**
+     * Files up to this size are read into memory, larger files are
+     * only announced to the kernel with `POSIX_FADV_WILLNEED`.
+     */
+    static constexpr size_t maxBufferedFileSize = 128 * 1024;
+
+    /**
+     * Upper bound on the number of submitted but not yet claimed files,
+     * bounding buffered memory to `maxQueued * maxBufferedFileSize`.
+     */
+    static constexpr size_t maxQueued = 128;
+
+private:
+    struct State
+    {
+        std::deque<std::shared_ptr<Job>> pending;
+        std::unordered_map<Path, std::shared_ptr<Job>> submitted;
+        bool quit = false;
+    };
+
+    Sync<State> state_;
+    std::condition_variable wakeup, finished;
+    std::vector<std::thread> workers;
+
+    void fill(Job & job)
+    {
+        AutoCloseFD fd{open(job.path.c_str(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW)};
+        if (!fd) return;
+
+        struct stat st;
+        if (fstat(fd.get(), &st) == -1 || !S_ISREG(st.st_mode)) return;
+
+        if (size_t(st.st_size) <= maxBufferedFileSize) {
+            job.data.resize(st.st_size);
+            readFull(fd.get(), job.data.data(), job.data.size());
+            job.complete = true;
+        } else {
+#if HAVE_POSIX_FADVISE
+            posix_fadvise(fd.get(), 0, 0, POSIX_FADV_WILLNEED);
+#endif
+        }
+    }
+
+    void worker()
+    {
+        while (true) {
+            std::shared_ptr<Job> job;
+            {
+                auto state(state_.lock());
+                while (!state->quit && state->pending.empty())
+                    state.wait(wakeup);
+                if (state->quit) return;
+                job = std::move(state->pending.front());
+                state->pending.pop_front();
+                /* Already claimed by the consumer. */
+                if (job->started) continue;
+                job->started = true;
+            }
+
+            try {
+                fill(*job);
+            } catch (...) {
+                /* The consumer will read the file again and report
+                   whatever went wrong with proper context. */
+                job->complete = false;
+                job->data.clear();
+            }
+
+            {
+                auto state(state_.lock());
+                job->finished = true;
+            }
+            finished.notify_all();
+        }
+    }
+
+public:
+    NarReadAhead(unsigned int threads)
+    {
+        for (unsigned int i = 0; i < threads; ++i)
+            workers.emplace_back(&NarReadAhead::worker, this);
+    }
+
+    ~NarReadAhead()
+    {
+        state_.lock()->quit = true;
+        wakeup.notify_all();
+        for (auto & thr : workers)
+            thr.join();
+    }
+
+    /**
+     * Queue a regular file for reading. Returns false if the queue is
+     * full, in which case the caller should try again later.
+     */
+    bool trySubmit(const Path & path)
+    {
+        {
+            auto state(state_.lock());
+            if (state->submitted.size() >= maxQueued) return false;
+            auto job = std::make_shared<Job>();
+            job->path = path;
+            if (!state->submitted.emplace(path, job).second) return true;
+            state->pending.push_back(std::move(job));
+        }
+        wakeup.notify_one();
+        return true;
+    }
+
+    /**
+     * Claim the job for `path`, waiting for it if a worker is busy
+     * with it. Returns `nullptr` if the file was never submitted or no
+     * worker has picked it up yet.
+     */
+    std::shared_ptr<Job> take(const Path & path)
+    {
+        auto state(state_.lock());
+        auto i = state->submitted.find(path);
+        if (i == state->submitted.end()) return nullptr;
+        auto job = std::move(i->second);
+        state->submitted.erase(i);
+        if (!job->started) {
+            job->started = true;
+            return nullptr;
+        }
+        while (!job->finished)
+            state.wait(finished);
+        return job;
+    }
+};
+
+
+static WireFormatGenerator dumpContents(
+    const Path & path, off_t size, std::shared_ptr<NarReadAhead::Job> prefetched)
 {
     co_yield "contents";
     co_yield size;
 
+    if (prefetched && prefetched->complete && prefetched->data.size() == size_t(size)) {
+        co_yield std::span{prefetched->data.data(), prefetched->data.size()};
+        co_yield SerializingTransform::padding(size);
+        co_return;
+    }
+
     AutoCloseFD fd{open(path.c_str(), O_RDONLY | O_CLOEXEC)};
     if (!fd) throw SysError("opening file '%1%'", path);
 
+#if HAVE_POSIX_FADVISE
+    posix_fadvise(fd.get(), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
     std::vector<char> buf(65536);
     size_t left = size;
 
@@ -65,13 +260,16 @@ static WireFormatGenerator dumpContents(const Path & path, off_t size)
 }
 
 
-static WireFormatGenerator dump(const Path & path, time_t & mtime, PathFilter & filter)
+static WireFormatGenerator dump(
+    const Path & path, time_t & mtime, PathFilter & filter, NarReadAhead * readAhead)
 {
     checkInterrupt();
 
     auto st = lstat(path);
     mtime = st.st_mtime;
 
+    auto prefetched = readAhead ? readAhead->take(path) : nullptr;
+
     co_yield "(";
 
     if (S_ISREG(st.st_mode)) {
@@ -81,7 +279,7 @@ static WireFormatGenerator dump(const Path & path, time_t & mtime, PathFilter &
             co_yield "executable";
             co_yield "";
         }
-        co_yield dumpContents(path, st.st_size);
+        co_yield dumpContents(path, st.st_size, std::move(prefetched));
     }
 
     else if (S_ISDIR(st.st_mode)) {
@@ -91,7 +289,10 @@ static WireFormatGenerator dump(const Path & path, time_t & mtime, PathFilter &
         /* If we're on a case-insensitive system like macOS, undo
            the case hack applied by restorePath(). */
         std::map<std::string, std::string> unhacked;
-        for (auto & i : readDirectory(path))
+        std::set<std::string> regularFiles;
+        for (auto & i : readDirectory(path)) {
+            if (readAhead && i.type == DT_REG)
+                regularFiles.insert(i.name);
             if (archiveSettings.useCaseHack) {
                 std::string name(i.name);
                 size_t pos = i.name.find(caseHackSuffix);
@@ -105,16 +306,38 @@ static WireFormatGenerator dump(const Path & path, time_t & mtime, PathFilter &
                        (path + "/" + i.name));
             } else
                 unhacked.emplace(i.name, i.name);
+        }
+
+        /* With read-ahead the filter is applied to the whole directory
+           up front, so we know which regular files will be dumped and
+           in which order. */
+        std::set<std::string> excluded;
+        std::vector<Path> toPrefetch;
+        if (readAhead)
+            for (auto & i : unhacked)
+                if (!filter(path + "/" + i.first))
+                    excluded.insert(i.first);
+                else if (regularFiles.contains(i.second))
+                    toPrefetch.push_back(path + "/" + i.second);
+        size_t nextPrefetch = 0, filesSeen = 0;
 
         for (auto & i : unhacked)
-            if (filter(path + "/" + i.first)) {
+            if (readAhead ? !excluded.contains(i.first) : filter(path + "/" + i.first)) {
+                if (readAhead) {
+                    /* Never submit the file we're about to dump. */
+                    if (regularFiles.contains(i.second))
+                        nextPrefetch = std::max(nextPrefetch, ++filesSeen);
+                    while (nextPrefetch < toPrefetch.size()
+                           && readAhead->trySubmit(toPrefetch[nextPrefetch]))
+                        ++nextPrefetch;
+                }
                 co_yield "entry";
                 co_yield "(";
                 co_yield "name";
                 co_yield i.first;
                 co_yield "node";
                 time_t tmp_mtime;
-                co_yield dump(path + "/" + i.second, tmp_mtime, filter);
+                co_yield dump(path + "/" + i.second, tmp_mtime, filter, readAhead);
                 if (tmp_mtime > mtime) {
                     mtime = tmp_mtime;
                 }
@@ -137,8 +360,12 @@ static WireFormatGenerator dump(const Path & path, time_t & mtime, PathFilter &
 
 WireFormatGenerator dumpPathAndGetMtime(Path path, time_t & mtime, PathFilter & filter)
 {
+    std::unique_ptr<NarReadAhead> readAhead;
+    if (archiveSettings.narReadAheadThreads > 0)
+        readAhead = std::make_unique<NarReadAhead>(archiveSettings.narReadAheadThreads);
+
     co_yield narVersionMagic1;
-    co_yield dump(path, mtime, filter);
+    co_yield dump(path, mtime, filter, readAhead.get());
 }
 
 WireFormatGenerator dumpPath(Path path, PathFilter & filter)
@@ -416,6 +643,154 @@ void parseDump(NARParseVisitor & sink, Source & source)
  * CppNix's CVE-2024-45593 (GHSA-h4vv-h3jq-v493)
  */
 
+/**
+ * Writes small files restored from a NAR on a set of worker threads.
+ * The parser creates directories and symlinks itself, in order, and
+ * hands over the complete contents of each small file; since a file is
+ * only enqueued after its parent directory has been created, workers
+ * never have to wait for each other.
+ *
+ * Files are still created with `O_EXCL`, so a colliding name fails the
+ * restore no matter which of the two entries is created first (see
+ * Note [NAR restoration security]).
+ */
+class NarRestoreWriters
+{
+public:
+    struct Job
+    {
+        Path path;
+        bool executable = false;
+        std::string contents;
+    };
+
+    /**
+     * Files up to this size are buffered and written by the workers,
+     * larger files are written by the parsing thread as they arrive.
+     */
+    static constexpr size_t maxBufferedFileSize = 64 * 1024;
+
+    /**
+     * Upper bound on the contents of enqueued but not yet written
+     * files. The parser waits for the workers once this is reached.
+     */
+    static constexpr size_t maxBufferedBytes = 32 * 1024 * 1024;
+
+private:
+    struct State
+    {
+        std::deque<Job> pending;
+        size_t bufferedBytes = 0;
+        size_t active = 0;
+        std::exception_ptr failure;
+        bool quit = false;
+    };
+
+    Sync<State> state_;
+    std::condition_variable wakeup, progress;
+    std::vector<std::thread> workers;
+
+    static void write(const Job & job)
+    {
+        AutoCloseFD fd{open(job.path.c_str(), O_CREAT | O_EXCL | O_WRONLY | O_CLOEXEC, 0666)};
+        if (!fd) throw SysError("creating file '%1%'", job.path);
+
+        if (job.executable) {
+            struct stat st;
+            if (fstat(fd.get(), &st) == -1)
+                throw SysError("fstat");
+            if (fchmod(fd.get(), st.st_mode | (S_IXUSR | S_IXGRP | S_IXOTH)) == -1)
+                throw SysError("fchmod");
+        }
+
+        writeFull(fd.get(), job.contents);
+        fd.close();
+    }
+
+    void worker()
+    {
+        while (true) {
+            Job job;
+            {
+                auto state(state_.lock());
+                while (!state->quit && state->pending.empty())
+                    state.wait(wakeup);
+                if (state->quit) return;
+                job = std::move(state->pending.front());
+                state->pending.pop_front();
+                state->active++;
+            }
+
+            std::exception_ptr failure;
+            try {
+                write(job);
+            } catch (...) {
+                failure = std::current_exception();
+            }
+
+            {
+                auto state(state_.lock());
+                state->active--;
+                state->bufferedBytes -= job.contents.size();
+                if (failure && !state->failure) {
+                    state->failure = failure;
+                    for (auto & dropped : state->pending)
+                        state->bufferedBytes -= dropped.contents.size();
+                    state->pending.clear();
+                }
+            }
+            progress.notify_all();
+        }
+    }
+
+public:
+    NarRestoreWriters(unsigned int threads)
+    {
+        for (unsigned int i = 0; i < threads; ++i)
+            workers.emplace_back(&NarRestoreWriters::worker, this);
+    }
+
+    ~NarRestoreWriters()
+    {
+        state_.lock()->quit = true;
+        wakeup.notify_all();
+        for (auto & thr : workers)
+            thr.join();
+    }
+
+    /**
+     * Hand a file to the workers, waiting for them to catch up if too
+     * much data is buffered. Rethrows the first error of any worker.
+     */
+    void enqueue(Job && job)
+    {
+        {
+            auto state(state_.lock());
+            while (!state->failure && state->bufferedBytes > 0
+                   && state->bufferedBytes + job.contents.size() > maxBufferedBytes)
+                state.wait(progress);
+            if (state->failure)
+                std::rethrow_exception(state->failure);
+            state->bufferedBytes += job.contents.size();
+            state->pending.push_back(std::move(job));
+        }
+        wakeup.notify_one();
+    }
+
+    /**
+     * Wait until all enqueued files have been written. Rethrows the
+     * first error of any worker.
+     */
+    void finish()
+    {
+        auto state(state_.lock());
+        while (!state->failure && (!state->pending.empty() || state->active))
+            state.wait(progress);
+        if (state->failure)
+            std::rethrow_exception(state->failure);
+    }
+};
+
 /**
  * This code restores NARs from disk.
  *
@@ -426,6 +801,12 @@ struct NARRestoreVisitor : NARParseVisitor
 {
     Path dstPath;
 
+    /**
+     * If set, small files are buffered and handed to these writers
+     * instead of being written on the parsing thread.
+     */
+    NarRestoreWriters * writers = nullptr;
+
 private:
     class MyFileHandle : public FileHandle
     {
@@ -485,6 +866,31 @@ private:
         friend struct NARRestoreVisitor;
     };
 
+    class BufferedFileHandle : public FileHandle
+    {
+        NarRestoreWriters & writers;
+        NarRestoreWriters::Job job;
+
+    public:
+        BufferedFileHandle(NarRestoreWriters & writers, Path path, uint64_t size, bool executable)
+            : writers(writers)
+        {
+            job.path = std::move(path);
+            job.executable = executable;
+            job.contents.reserve(size);
+        }
+
+        void receiveContents(std::string_view data) override
+        {
+            job.contents.append(data);
+        }
+
+        void close() override
+        {
+            writers.enqueue(std::move(job));
+        }
+    };
+
 public:
     void createDirectory(const Path & path) override
     {
@@ -496,6 +902,10 @@ public:
     std::unique_ptr<FileHandle> createRegularFile(const Path & path, uint64_t size, bool executable) override
     {
         Path p = dstPath + path;
+
+        if (writers && size <= NarRestoreWriters::maxBufferedFileSize)
+            return std::make_unique<BufferedFileHandle>(*writers, std::move(p), size, executable);
+
         AutoCloseFD fd = AutoCloseFD{open(p.c_str(), O_CREAT | O_EXCL | O_WRONLY | O_CLOEXEC, 0666)};
         if (!fd) throw SysError("creating file '%1%'", p);
 
@@ -514,7 +924,20 @@ void restorePath(const Path & path, Source & source)
 {
     NARRestoreVisitor sink;
     sink.dstPath = path;
+
+    /* On failure the writers are stopped and joined before the
+       exception propagates, so callers may safely delete the partial
+       result. */
+    std::optional<NarRestoreWriters> writers;
+    if (archiveSettings.narRestoreThreads > 0) {
+        writers.emplace(archiveSettings.narRestoreThreads);
+        sink.writers = &*writers;
+    }
+
     parseDump(sink, source);
+
+    if (writers)
+        writers->finish();
 }
 
 
@@ -3,12 +3,16 @@
 #include "tarfile.hh"
 #include "signals.hh"
 #include "logging.hh"
+#include "strings.hh"
 
 #include <archive.h>
 #include <archive_entry.h>
 #include <cstdio>
 #include <cstring>
 
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <brotli/decode.h>
 #include <brotli/encode.h>
 
@@ -310,4 +314,217 @@ std::string compress(const std::string & method, std::string_view in, const bool
     return std::move(ssink.s);
 }
 
+/* See https://github.com/facebook/zstd/blob/dev/contrib/seekable_format/zstd_seekable_compression_format.md */
+static constexpr uint32_t ZSTD_SKIPPABLE_MAGIC = 0x184D2A5E;
+static constexpr uint32_t ZSTD_SEEKABLE_MAGIC = 0x8F92EAB1;
+static constexpr size_t ZSTD_SEEK_TABLE_FOOTER_SIZE = 9;
+
+struct SeekableZstdCompressionSink : CompressionSink
+{
+    Sink & nextSink;
+    size_t frameSize;
+    int level;
+    std::string frame;
+    std::vector<std::pair<uint32_t, uint32_t>> entries;
+
+    SeekableZstdCompressionSink(Sink & nextSink, size_t frameSize, int level)
+        : nextSink(nextSink), frameSize(frameSize), level(level)
+    {
+        assert(frameSize > 0 && frameSize <= UINT32_MAX / 2);
+    }
+
+    void writeUnbuffered(std::string_view data) override
+    {
+        while (!data.empty()) {
+            auto n = std::min(frameSize - frame.size(), data.size());
+            frame.append(data.substr(0, n));
+            data.remove_prefix(n);
+            if (frame.size() == frameSize)
+                writeFrame();
+        }
+    }
+
+    void writeFrame()
+    {
+        auto compressed = compress("zstd", frame, false, level);
+        nextSink(compressed);
+        entries.emplace_back(compressed.size(), frame.size());
+        frame.clear();
+    }
+
+    void finish() override
+    {
+        flush();
+        /* Always write at least one data frame, so that the result
+           starts with a regular zstd frame header. */
+        if (!frame.empty() || entries.empty())
+            writeFrame();
+
+        std::string table;
+        auto put32 = [&](uint32_t n) {
+            for (int i = 0; i < 4; ++i)
+                table.push_back(char(n >> (8 * i)));
+        };
+        put32(ZSTD_SKIPPABLE_MAGIC);
+        put32(entries.size() * 8 + ZSTD_SEEK_TABLE_FOOTER_SIZE);
+        for (auto & [compressedSize, size] : entries) {
+            put32(compressedSize);
+            put32(size);
+        }
+        put32(entries.size());
+        table.push_back(0); // no checksums
+        put32(ZSTD_SEEKABLE_MAGIC);
+        nextSink(table);
+    }
+};
+
+ref<CompressionSink> makeSeekableCompressionSink(Sink & nextSink, size_t frameSize, int level)
+{
+    return make_ref<SeekableZstdCompressionSink>(nextSink, frameSize, level);
+}
+
+std::string compressSeekable(std::string_view in, size_t frameSize, int level)
+{
+    StringSink ssink;
+    auto sink = makeSeekableCompressionSink(ssink, frameSize, level);
+    (*sink)(in);
+    sink->finish();
+    return std::move(ssink.s);
+}
+
+static void preadFull(int fd, char * buf, size_t count, uint64_t offset)
+{
+    while (count) {
+        checkInterrupt();
+        ssize_t res = pread(fd, buf, count, offset);
+        if (res == -1) {
+            if (errno == EINTR) continue;
+            throw SysError("reading from file");
+        }
+        if (res == 0) throw EndOfFile("unexpected end-of-file");
+        count -= res;
+        buf += res;
+        offset += res;
+    }
+}
+
+static uint32_t get32(std::string_view s, size_t offset)
+{
+    uint32_t n = 0;
+    for (int i = 0; i < 4; ++i)
+        n |= uint32_t(uint8_t(s[offset + i])) << (8 * i);
+    return n;
+}
+
+std::optional<SeekableZstdReader> SeekableZstdReader::open(const Path & path)
+{
+    AutoCloseFD fd{::open(path.c_str(), O_RDONLY | O_CLOEXEC)};
+    if (!fd) throw SysError("opening file '%1%'", path);
+
+    struct stat st;
+    if (fstat(fd.get(), &st) == -1)
+        throw SysError("getting status of '%1%'", path);
+    uint64_t fileSize = st.st_size;
+
+    if (fileSize < 8 + ZSTD_SEEK_TABLE_FOOTER_SIZE) return std::nullopt;
+
+    std::string footer(ZSTD_SEEK_TABLE_FOOTER_SIZE, 0);
+    preadFull(fd.get(), footer.data(), footer.size(), fileSize - footer.size());
+    if (get32(footer, 5) != ZSTD_SEEKABLE_MAGIC) return std::nullopt;
+
+    uint64_t nrFrames = get32(footer, 0);
+    uint8_t descriptor = footer[4];
+    /* Bits 2-6 are reserved and must be zero. */
+    if (descriptor & 0x7c) return std::nullopt;
+    uint64_t entrySize = (descriptor & 0x80) ? 12 : 8;
+
+    uint64_t tableSize = 8 + nrFrames * entrySize + ZSTD_SEEK_TABLE_FOOTER_SIZE;
+    if (tableSize > fileSize) return std::nullopt;
+
+    std::string table(tableSize - ZSTD_SEEK_TABLE_FOOTER_SIZE, 0);
+    preadFull(fd.get(), table.data(), table.size(), fileSize - tableSize);
+    if (get32(table, 0) != ZSTD_SKIPPABLE_MAGIC || get32(table, 4) != tableSize - 8)
+        return std::nullopt;
+
+    std::vector<Frame> frames;
+    frames.reserve(nrFrames);
+    uint64_t compressedOffset = 0, offset = 0;
+    for (uint64_t i = 0; i < nrFrames; ++i) {
+        Frame frame{
+            .compressedOffset = compressedOffset,
+            .offset = offset,
+            .compressedSize = get32(table, 8 + i * entrySize),
+            .size = get32(table, 8 + i * entrySize + 4),
+        };
+        compressedOffset += frame.compressedSize;
+        offset += frame.size;
+        frames.push_back(frame);
+    }
+    if (compressedOffset != fileSize - tableSize) return std::nullopt;
+
+    return SeekableZstdReader(std::move(fd), std::move(frames));
+}
+
+uint64_t SeekableZstdReader::size() const
+{
+    return frames.empty() ? 0 : frames.back().offset + frames.back().size;
+}
+
+std::string SeekableZstdReader::readFrame(const Frame & frame)
+{
+    std::string compressed(frame.compressedSize, 0);
+    preadFull(fd.get(), compressed.data(), compressed.size(), frame.compressedOffset);
+    auto data = decompress("zstd", compressed);
+    if (data.size() != frame.size)
+        throw CompressionError("zstd frame at offset %d has unexpected size", frame.compressedOffset);
+    return data;
+}
+
+std::string SeekableZstdReader::read(uint64_t offset, uint64_t length)
+{
+    std::string res;
+    auto end = offset + std::min(length, size() - std::min(offset, size()));
+    /* Find the first frame that ends after `offset`. */
+    auto i = std::upper_bound(frames.begin(), frames.end(), offset,
+        [](uint64_t offset, const Frame & frame) { return offset < frame.offset + frame.size; });
+    for (; i != frames.end() && i->offset < end; ++i) {
+        auto data = readFrame(*i);
+        auto from = offset > i->offset ? offset - i->offset : 0;
+        auto to = std::min<uint64_t>(data.size(), end - i->offset);
+        res.append(data, from, to - from);
+    }
+    return res;
+}
+
+std::string SeekableZstdReader::tailLines(size_t n)
+{
+    if (n == 0) return "";
+
+    /* The frames read so far, last one first. Only the newlines of
+       each new frame are counted, so this is linear in the size of
+       the tail. The semantics are those of findLastLines(). */
+    std::vector<std::string> tail;
+    size_t start = 0;
+    bool atEnd = true;
+    for (auto i = frames.rbegin(); i != frames.rend(); ++i) {
+        std::string_view data = tail.emplace_back(readFrame(*i));
+        /* A newline that ends the log doesn't start another line. */
+        if (atEnd && !data.empty()) {
+            if (data.ends_with('\n')) data.remove_suffix(1);
+            atEnd = false;
+        }
+        auto j = data.size();
+        while (j > 0 && !(data[j - 1] == '\n' && --n == 0)) j--;
+        if (j > 0) {
+            start = j;
+            break;
+        }
+    }
+
+    std::string res;
+    for (auto i = tail.rbegin(); i != tail.rend(); ++i)
+        res.append(*i, i == tail.rbegin() ? start : 0);
+    return res;
+}
+
 }
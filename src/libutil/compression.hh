@@ -4,6 +4,7 @@
 #include "ref.hh"
 #include "types.hh"
 #include "serialise.hh"
+#include "file-descriptor.hh"
 
 #include <string>
 
@@ -24,6 +25,74 @@ std::string compress(const std::string & method, std::string_view in, const bool
 
 ref<CompressionSink> makeCompressionSink(const std::string & method, Sink & nextSink, const bool parallel = false, int level = -1);
 
+/**
+ * Default amount of uncompressed data per frame written by
+ * makeSeekableCompressionSink().
+ */
+constexpr size_t seekableFrameSize = 1024 * 1024;
+
+/**
+ * Create a sink that compresses its input with zstd as a sequence of
+ * independent frames of `frameSize` uncompressed bytes each, followed
+ * by a seek table in the zstd seekable format. The result is a valid
+ * zstd stream (the seek table is a skippable frame), and
+ * SeekableZstdReader can decompress arbitrary ranges of it by only
+ * decompressing the frames that overlap them.
+ */
+ref<CompressionSink> makeSeekableCompressionSink(
+    Sink & nextSink, size_t frameSize = seekableFrameSize, int level = -1);
+
+std::string compressSeekable(std::string_view in, size_t frameSize = seekableFrameSize, int level = -1);
+
+/**
+ * Random access to files written by makeSeekableCompressionSink().
+ */
+class SeekableZstdReader
+{
+public:
+    struct Frame
+    {
+        uint64_t compressedOffset;
+        uint64_t offset;
+        uint32_t compressedSize;
+        uint32_t size;
+    };
+
+private:
+    AutoCloseFD fd;
+    std::vector<Frame> frames;
+
+    SeekableZstdReader(AutoCloseFD fd, std::vector<Frame> frames)
+        : fd(std::move(fd)), frames(std::move(frames)) {}
+
+    std::string readFrame(const Frame & frame);
+
+public:
+    /**
+     * Open `path` and read its seek table. Returns std::nullopt if the
+     * file does not end in a valid seek table, e.g. because it was not
+     * finished properly; such files can still be decompressed as a
+     * whole with decompress().
+     */
+    static std::optional<SeekableZstdReader> open(const Path & path);
+
+    /**
+     * Size of the uncompressed data.
+     */
+    uint64_t size() const;
+
+    /**
+     * Decompress up to `length` bytes starting at `offset`.
+     */
+    std::string read(uint64_t offset, uint64_t length);
+
+    /**
+     * Decompress the last `n` lines, decompressing frames from the end
+     * until enough lines have been found.
+     */
+    std::string tailLines(size_t n);
+};
+
 MakeError(UnknownCompressionMethod, Error);
 
 MakeError(CompressionError, Error);
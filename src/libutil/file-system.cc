@@ -2,6 +2,8 @@
 #include <cstdlib>
 #include <filesystem>
 #include <atomic>
+#include <deque>
+#include <ranges>
 
 #include "environment-variables.hh"
 #include "file-descriptor.hh"
@@ -11,6 +13,7 @@
 #include "serialise.hh"
 #include "signals.hh"
 #include "strings.hh"
+#include "thread-pool.hh"
 #include "types.hh"
 #include "users.hh"
 
@@ -386,6 +389,80 @@ void syncParent(const Path & path)
     fd.fsync();
 }
 
+/**
+ * Account for the space that deleting a file with the given status
+ * will likely free.
+ */
+static void countFreedBytes(const struct stat & st, uint64_t & bytesFreed)
+{
+    switch (st.st_nlink) {
+        /* Yes: last link. */
+        case 1:
+            bytesFreed += st.st_size;
+            break;
+        /* Maybe: yes, if 'auto-optimise-store' or manual optimisation
+           was performed. Instead of checking for real let's assume
+           it's an optimised file and space will be freed.
+
+           In worst case we will double count on freed space for files
+           with exactly two hardlinks for unoptimised packages.
+         */
+        case 2:
+            bytesFreed += st.st_size;
+            break;
+        /* No: 3+ links. */
+        default:
+            break;
+    }
+}
+
+/**
+ * Make a directory that is about to be deleted accessible, and open it.
+ */
+static AutoCloseDir openDirForDeletion(int parentfd, const std::string & name,
+    const struct stat & st, const Path & path)
+{
+    const auto PERM_MASK = S_IRUSR | S_IWUSR | S_IXUSR;
+    if ((st.st_mode & PERM_MASK) != PERM_MASK) {
+        if (fchmodat(parentfd, name.c_str(), st.st_mode | PERM_MASK, 0) == -1)
+            throw SysError("chmod '%1%'", path);
+    }
+
+    int fd = openat(parentfd, name.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW);
+    if (fd == -1)
+        throw SysError("opening directory '%1%'", path);
+    AutoCloseDir dir(fdopendir(fd));
+    if (!dir) {
+        close(fd);
+        throw SysError("opening directory '%1%'", path);
+    }
+    return dir;
+}
+
+/**
+ * Get the status of a path that is about to be deleted. Returns false
+ * if it doesn't exist.
+ */
+static bool statForDeletion(int parentfd, const std::string & name,
+    const Path & path, struct stat & st)
+{
+    if (fstatat(parentfd, name.c_str(), &st, AT_SYMLINK_NOFOLLOW) == -1) {
+        if (errno == ENOENT) return false;
+        throw SysError("getting status of '%1%'", path);
+    }
+    return true;
+}
+
+static void unlinkForDeletion(int parentfd, const std::string & name,
+    const Path & path, const struct stat & st)
+{
+    int flags = S_ISDIR(st.st_mode) ? AT_REMOVEDIR : 0;
+    if (unlinkat(parentfd, name.c_str(), flags) == -1) {
+        if (errno == ENOENT) return;
+        throw SysError("cannot unlink '%1%'", path);
+    }
+}
+
 static void _deletePath(int parentfd, const Path & path, uint64_t & bytesFreed)
 {
     checkInterrupt();
@@ -393,58 +470,107 @@ static void _deletePath(int parentfd, const Path & path, uint64_t & bytesFreed)
     std::string name(baseNameOf(path));
 
     struct stat st;
-    if (fstatat(parentfd, name.c_str(), &st, AT_SYMLINK_NOFOLLOW) == -1) {
-        if (errno == ENOENT) return;
-        throw SysError("getting status of '%1%'", path);
-    }
+    if (!statForDeletion(parentfd, name, path, st)) return;
 
-    if (!S_ISDIR(st.st_mode)) {
+    if (!S_ISDIR(st.st_mode))
         /* We are about to delete a file. Will it likely free space? */
+        countFreedBytes(st, bytesFreed);
+    else {
+        auto dir = openDirForDeletion(parentfd, name, st, path);
+        for (auto & i : readDirectory(dir.get(), path))
+            _deletePath(dirfd(dir.get()), path + "/" + i.name, bytesFreed);
+    }
 
-        switch (st.st_nlink) {
-            /* Yes: last link. */
-            case 1:
-                bytesFreed += st.st_size;
-                break;
-            /* Maybe: yes, if 'auto-optimise-store' or manual optimisation
-               was performed. Instead of checking for real let's assume
-               it's an optimised file and space will be freed.
-
-               In worst case we will double count on freed space for files
-               with exactly two hardlinks for unoptimised packages.
-             */
-            case 2:
-                bytesFreed += st.st_size;
-                break;
-            /* No: 3+ links. */
-            default:
-                break;
+    unlinkForDeletion(parentfd, name, path, st);
+}
+
+/**
+ * Delete a directory tree using several threads. The top of the tree
+ * is walked breadth-first by the calling thread, deleting files as it
+ * goes, so that small trees are deleted without starting any threads.
+ * Once that has seen enough entries, the subdirectories it has not
+ * read yet are deleted concurrently by a thread pool, each by the
+ * sequential `_deletePath()`. Finally the directories read by the
+ * calling thread are removed, deepest first.
+ */
+static void _deletePathParallel(int parentfd, const Path & path, uint64_t & bytesFreed)
+{
+    /* The directories read by the calling thread stay open until they
+       are removed, so bound their number to keep clear of the file
+       descriptor limit. */
+    constexpr size_t maxReadDirs = 64;
+    constexpr size_t maxEntries = 4096;
+    constexpr size_t maxThreads = 8;
+
+    struct ReadDir
+    {
+        int parentfd;
+        std::string name;
+        Path path;
+        struct stat st;
+        AutoCloseDir dir;
+    };
+
+    struct Subtree
+    {
+        int parentfd;
+        Path path;
+    };
+
+    std::vector<ReadDir> readDirs;
+    std::deque<Subtree> pending{{parentfd, path}};
+    size_t entries = 0;
+
+    while (!pending.empty()
+        && (pending.size() == 1 || (readDirs.size() < maxReadDirs && entries < maxEntries)))
+    {
+        checkInterrupt();
+
+        auto subtree = std::move(pending.front());
+        pending.pop_front();
+
+        std::string name(baseNameOf(subtree.path));
+
+        struct stat st;
+        if (!statForDeletion(subtree.parentfd, name, subtree.path, st)) continue;
+
+        if (!S_ISDIR(st.st_mode)) {
+            countFreedBytes(st, bytesFreed);
+            unlinkForDeletion(subtree.parentfd, name, subtree.path, st);
+            continue;
         }
-    }
 
-    if (S_ISDIR(st.st_mode)) {
-        /* Make the directory accessible. */
-        const auto PERM_MASK = S_IRUSR | S_IWUSR | S_IXUSR;
-        if ((st.st_mode & PERM_MASK) != PERM_MASK) {
-            if (fchmodat(parentfd, name.c_str(), st.st_mode | PERM_MASK, 0) == -1)
-                throw SysError("chmod '%1%'", path);
+        auto dir = openDirForDeletion(subtree.parentfd, name, st, subtree.path);
+        int fd = dirfd(dir.get());
+        for (auto & i : readDirectory(dir.get(), subtree.path)) {
+            entries++;
+            auto childPath = subtree.path + "/" + i.name;
+            if (i.type == DT_DIR || i.type == DT_UNKNOWN)
+                pending.push_back({fd, std::move(childPath)});
+            else
+                _deletePath(fd, childPath, bytesFreed);
         }
 
-        int fd = openat(parentfd, path.c_str(), O_RDONLY);
-        if (fd == -1)
-            throw SysError("opening directory '%1%'", path);
-        AutoCloseDir dir(fdopendir(fd));
-        if (!dir)
-            throw SysError("opening directory '%1%'", path);
-        for (auto & i : readDirectory(dir.get(), path))
-            _deletePath(dirfd(dir.get()), path + "/" + i.name, bytesFreed);
+        readDirs.push_back({subtree.parentfd, std::move(name), subtree.path, st, std::move(dir)});
     }
 
-    int flags = S_ISDIR(st.st_mode) ? AT_REMOVEDIR : 0;
-    if (unlinkat(parentfd, name.c_str(), flags) == -1) {
-        if (errno == ENOENT) return;
-        throw SysError("cannot unlink '%1%'", path);
+    if (!pending.empty()) {
+        std::atomic<uint64_t> subtreeBytesFreed{0};
+
+        ThreadPool pool(std::min<size_t>(maxThreads, std::thread::hardware_concurrency()));
+        for (auto & subtree : pending)
+            pool.enqueue([&subtreeBytesFreed, subtree]() {
+                uint64_t n = 0;
+                _deletePath(subtree.parentfd, subtree.path, n);
+                subtreeBytesFreed += n;
+            });
+        pool.process();
+
+        bytesFreed += subtreeBytesFreed;
     }
+
+    for (auto & dir : std::views::reverse(readDirs))
+        unlinkForDeletion(dir.parentfd, dir.name, dir.path, dir.st);
 }
 
 static void _deletePath(const Path & path, uint64_t & bytesFreed)
@@ -459,7 +585,7 @@ static void _deletePath(const Path & path, uint64_t & bytesFreed)
         throw SysError("opening directory '%1%'", path);
     }
 
-    _deletePath(dirfd.get(), path, bytesFreed);
+    _deletePathParallel(dirfd.get(), path, bytesFreed);
 }
 
 
@@ -477,6 +603,16 @@ void deletePath(const Path & path, uint64_t & bytesFreed)
     _deletePath(path, bytesFreed);
 }
 
+
+std::future<uint64_t> deletePathAsync(Path path)
+{
+    return std::async(std::launch::async, [path{std::move(path)}]() {
+        uint64_t bytesFreed;
+        deletePath(path, bytesFreed);
+        return bytesFreed;
+    });
+}
+
 Paths createDirs(const Path & path)
 {
     Paths created;
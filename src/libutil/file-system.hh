@@ -15,6 +15,7 @@
 #include <unistd.h>
 
 #include <functional>
+#include <future>
 #include <optional>
 
 #ifndef HAVE_STRUCT_DIRENT_D_TYPE
@@ -193,12 +194,20 @@ void syncParent(const Path & path);
 /**
  * Delete a path; i.e., in the case of a directory, it is deleted
  * recursively. It's not an error if the path does not exist. The
- * second variant returns the number of bytes and blocks freed.
+ * second variant returns the number of bytes and blocks freed. Large
+ * directory trees are deleted by several threads.
  */
 void deletePath(const Path & path);
 
 void deletePath(const Path & path, uint64_t & bytesFreed);
 
+/**
+ * Delete a path like deletePath(), but on a background thread. The
+ * returned future yields the number of bytes freed; like any future
+ * from `std::async`, its destructor waits for the deletion to finish.
+ */
+std::future<uint64_t> deletePathAsync(Path path);
+
 /**
  * Create a directory and all its parents, if necessary.  Returns the
  * list of created directories, in order of creation.
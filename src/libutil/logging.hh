@@ -148,6 +148,17 @@ public:
 
     virtual void result(ActivityId act, ResultType type, const Fields & fields) { };
 
+    /**
+     * Report several results of the same type at once, e.g. a batch of
+     * build log lines. Loggers for which this is cheaper than calling
+     * result() for each of them should override this.
+     */
+    virtual void results(ActivityId act, ResultType type, const std::vector<Fields> & fields)
+    {
+        for (auto & f : fields)
+            result(act, type, f);
+    }
+
     virtual void writeToStdout(std::string_view s);
 
     template<typename... Args>
@@ -216,6 +227,11 @@ struct Activity
         logger.result(id, type, fields);
     }
 
+    void results(ResultType type, const std::vector<Logger::Fields> & fields) const
+    {
+        logger.results(id, type, fields);
+    }
+
     friend class Logger;
 };
 
@@ -13,10 +13,11 @@ namespace nix {
 static size_t refLength = 32; /* characters */
 
 
-static void search(
-    std::string_view s,
-    StringSet & hashes,
-    StringSet & seen)
+/* Call `candidate` with every 32-character run of base-32 characters
+   in `s` (and its offset), skipping ahead over non-base-32 characters
+   like Boyer-Moore does. Stops early if `candidate` returns false. */
+template<typename F>
+static void forEachHashCandidate(std::string_view s, F && candidate)
 {
     static std::once_flag initialised;
     static bool isBase32[256];
@@ -36,13 +37,43 @@ static void search(
                 break;
             }
         if (!match) continue;
-        std::string ref(s.substr(i, refLength));
+        if (!candidate(i, s.substr(i, refLength))) return;
+        ++i;
+    }
+}
+
+
+static void search(
+    std::string_view s,
+    StringSet & hashes,
+    StringSet & seen)
+{
+    forEachHashCandidate(s, [&](size_t i, std::string_view candidate) {
+        std::string ref(candidate);
         if (hashes.erase(ref)) {
             debug("found reference to '%1%' at offset '%2%'", ref, i);
             seen.insert(ref);
         }
-        ++i;
-    }
+        return true;
+    });
+}
+
+
+std::map<std::string, size_t> findFirstOccurrences(std::string_view s, const StringSet & hashes)
+{
+    std::map<std::string, size_t> res;
+    std::set<std::string, std::less<>> left(hashes.begin(), hashes.end());
+
+    forEachHashCandidate(s, [&](size_t i, std::string_view candidate) {
+        auto ref = left.find(candidate);
+        if (ref != left.end()) {
+            res.emplace(*ref, i);
+            left.erase(ref);
+        }
+        return !left.empty();
+    });
+
+    return res;
 }
 
 
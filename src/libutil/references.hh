@@ -43,6 +43,14 @@ struct RewritingSource : Source
     size_t read(char * data, size_t len) override;
 };
 
+/**
+ * Find the first occurrence of each of `hashes` (store path hash
+ * parts) in `s`, in a single pass over `s`.
+ *
+ * @return A map from each hash that occurs in `s` to its offset.
+ */
+std::map<std::string, size_t> findFirstOccurrences(std::string_view s, const StringSet & hashes);
+
 HashResult computeHashModulo(HashType ht, const std::string & modulus, Source & source);
 
 }
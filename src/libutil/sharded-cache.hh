@@ -0,0 +1,188 @@
+#pragma once
+///@file
+
+#include "sync.hh"
+
+#include <array>
+#include <atomic>
+#include <list>
+#include <optional>
+#include <unordered_map>
+
+namespace nix {
+
+/**
+ * A thread-safe cache of bounded size. It is split into shards that
+ * are locked independently, so that threads looking up different keys
+ * rarely wait for each other.
+ *
+ * Each shard is a segmented LRU cache: new entries are put in a
+ * probationary segment, and only entries that are looked up again
+ * while in it are promoted to a protected segment, which holds most of
+ * the capacity. Entries are evicted from the probationary segment
+ * first, so a scan over many keys that are only used once (such as a
+ * walk over a large closure) does not push out the entries that are
+ * used repeatedly.
+ */
+template<typename Key, typename Value, typename KeyHash = std::hash<Key>>
+class ShardedCache
+{
+public:
+
+    struct Stats
+    {
+        std::atomic<uint64_t> hits{0};
+        std::atomic<uint64_t> misses{0};
+        std::atomic<uint64_t> evictions{0};
+    };
+
+private:
+
+    static constexpr size_t numShards = 16;
+
+    /**
+     * Percentage of the capacity of a shard reserved for the protected
+     * segment.
+     */
+    static constexpr size_t protectedShare = 80;
+
+    using Order = std::list<Key>;
+
+    struct Entry
+    {
+        Value value;
+        bool isProtected;
+        typename Order::iterator pos;
+    };
+
+    struct Shard
+    {
+        std::unordered_map<Key, Entry, KeyHash> entries;
+
+        /**
+         * The keys in each segment, most recently used first.
+         */
+        Order probation, protected_;
+    };
+
+    size_t shardCapacity, protectedCapacity;
+
+    std::array<Sync<Shard>, numShards> shards;
+
+    Stats stats;
+
+    Sync<Shard> & shardFor(const Key & key)
+    {
+        return shards[KeyHash{}(key) % numShards];
+    }
+
+    void evict(Shard & shard)
+    {
+        auto & segment = shard.probation.empty() ? shard.protected_ : shard.probation;
+        shard.entries.erase(segment.back());
+        segment.pop_back();
+        stats.evictions++;
+    }
+
+public:
+
+    ShardedCache(size_t capacity)
+        : shardCapacity((capacity + numShards - 1) / numShards)
+        , protectedCapacity(shardCapacity * protectedShare / 100)
+    { }
+
+    /**
+     * Insert or update an item in the cache.
+     */
+    void upsert(const Key & key, const Value & value)
+    {
+        if (shardCapacity == 0) return;
+
+        auto shard(shardFor(key).lock());
+
+        if (auto i = shard->entries.find(key); i != shard->entries.end()) {
+            auto & segment = i->second.isProtected ? shard->protected_ : shard->probation;
+            segment.splice(segment.begin(), segment, i->second.pos);
+            i->second.value = value;
+            return;
+        }
+
+        while (shard->entries.size() >= shardCapacity)
+            evict(*shard);
+
+        shard->probation.push_front(key);
+        shard->entries.emplace(key, Entry {
+            .value = value,
+            .isProtected = false,
+            .pos = shard->probation.begin(),
+        });
+    }
+
+    bool erase(const Key & key)
+    {
+        auto shard(shardFor(key).lock());
+        auto i = shard->entries.find(key);
+        if (i == shard->entries.end()) return false;
+        (i->second.isProtected ? shard->protected_ : shard->probation).erase(i->second.pos);
+        shard->entries.erase(i);
+        return true;
+    }
+
+    /**
+     * Look up an item in the cache. If it exists, it becomes the most
+     * recently used item of the protected segment.
+     */
+    std::optional<Value> get(const Key & key)
+    {
+        auto shard(shardFor(key).lock());
+
+        auto i = shard->entries.find(key);
+        if (i == shard->entries.end()) {
+            stats.misses++;
+            return {};
+        }
+        stats.hits++;
+
+        auto & entry = i->second;
+        if (entry.isProtected)
+            shard->protected_.splice(shard->protected_.begin(), shard->protected_, entry.pos);
+        else {
+            shard->protected_.splice(shard->protected_.begin(), shard->probation, entry.pos);
+            entry.isProtected = true;
+            /* Make room by giving the least recently used protected
+               entry another chance in the probationary segment. */
+            if (shard->protected_.size() > protectedCapacity) {
+                auto demoted = std::prev(shard->protected_.end());
+                shard->entries.find(*demoted)->second.isProtected = false;
+                shard->probation.splice(shard->probation.begin(), shard->protected_, demoted);
+            }
+        }
+
+        return entry.value;
+    }
+
+    size_t size()
+    {
+        size_t res = 0;
+        for (auto & shard : shards)
+            res += shard.lock()->entries.size();
+        return res;
+    }
+
+    void clear()
+    {
+        for (auto & shard : shards) {
+            auto shard_(shard.lock());
+            shard_->entries.clear();
+            shard_->probation.clear();
+            shard_->protected_.clear();
+        }
+    }
+
+    const Stats & getStats() const
+    {
+        return stats;
+    }
+};
+
+}
@@ -21,28 +21,45 @@ SourcePath SourcePath::parent() const
     return std::move(*p);
 }
 
-InputAccessor::Stat SourcePath::lstat() const
+static SourceAccessHook realFilesystem;
+
+static std::shared_ptr<SourceAccessHook> installedHook;
+
+static SourceAccessHook & hook()
 {
-    auto st = nix::lstat(path.abs());
+    return installedHook ? *installedHook : realFilesystem;
+}
+
+void setSourceAccessHook(std::shared_ptr<SourceAccessHook> hook)
+{
+    installedHook = std::move(hook);
+}
+
+bool hasSourceAccessHook()
+{
+    return (bool) installedHook;
+}
+
+std::string SourceAccessHook::readFile(const CanonPath & path)
+{
+    return nix::readFile(path.abs());
+}
+
+std::optional<InputAccessor::Stat> SourceAccessHook::maybeLstat(const CanonPath & path)
+{
+    auto st = nix::maybeLstat(path.abs());
+    if (!st) return std::nullopt;
     return InputAccessor::Stat {
         .type =
-            S_ISREG(st.st_mode) ? InputAccessor::tRegular :
-            S_ISDIR(st.st_mode) ? InputAccessor::tDirectory :
-            S_ISLNK(st.st_mode) ? InputAccessor::tSymlink :
+            S_ISREG(st->st_mode) ? InputAccessor::tRegular :
+            S_ISDIR(st->st_mode) ? InputAccessor::tDirectory :
+            S_ISLNK(st->st_mode) ? InputAccessor::tSymlink :
             InputAccessor::tMisc,
-        .isExecutable = S_ISREG(st.st_mode) && st.st_mode & S_IXUSR
+        .isExecutable = S_ISREG(st->st_mode) && st->st_mode & S_IXUSR
     };
 }
 
-std::optional<InputAccessor::Stat> SourcePath::maybeLstat() const
-{
-    // FIXME: merge these into one operation.
-    if (!pathExists())
-        return {};
-    return lstat();
-}
-
-InputAccessor::DirEntries SourcePath::readDirectory() const
+InputAccessor::DirEntries SourceAccessHook::readDirectory(const CanonPath & path)
 {
     InputAccessor::DirEntries res;
     for (auto & entry : nix::readDirectory(path.abs())) {
@@ -58,6 +75,53 @@ InputAccessor::DirEntries SourcePath::readDirectory() const
     return res;
 }
 
+std::string SourceAccessHook::readLink(const CanonPath & path)
+{
+    return nix::readLink(path.abs());
+}
+
+void SourceAccessHook::dumpPath(const CanonPath & path, Sink & sink, PathFilter & filter)
+{
+    sink << nix::dumpPath(path.abs(), filter);
+}
+
+std::string SourcePath::readFile() const
+{
+    return hook().readFile(path);
+}
+
+bool SourcePath::pathExists() const
+{
+    return hook().maybeLstat(path).has_value();
+}
+
+InputAccessor::Stat SourcePath::lstat() const
+{
+    if (auto st = hook().maybeLstat(path))
+        return *st;
+    throw SysError(ENOENT, "getting status of '%s'", path.abs());
+}
+
+std::optional<InputAccessor::Stat> SourcePath::maybeLstat() const
+{
+    return hook().maybeLstat(path);
+}
+
+InputAccessor::DirEntries SourcePath::readDirectory() const
+{
+    return hook().readDirectory(path);
+}
+
+std::string SourcePath::readLink() const
+{
+    return hook().readLink(path);
+}
+
+void SourcePath::dumpPath(Sink & sink, PathFilter & filter) const
+{
+    hook().dumpPath(path, sink, filter);
+}
+
 SourcePath SourcePath::resolveSymlinks(SymlinkResolution mode) const
 {
     SourcePath res(CanonPath::root);
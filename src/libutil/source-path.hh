@@ -60,15 +60,13 @@ struct SourcePath
      * If this `SourcePath` denotes a regular file (not a symlink),
      * return its contents; otherwise throw an error.
      */
-    std::string readFile() const
-    { return nix::readFile(path.abs()); }
+    std::string readFile() const;
 
     /**
      * Return whether this `SourcePath` denotes a file (of any type)
      * that exists
     */
-    bool pathExists() const
-    { return nix::pathExists(path.abs()); }
+    bool pathExists() const;
 
     /**
      * Return stats about this `SourcePath`, or throw an exception if
@@ -92,16 +90,14 @@ struct SourcePath
      * If this `SourcePath` denotes a symlink, return its target;
      * otherwise throw an error.
      */
-    std::string readLink() const
-    { return nix::readLink(path.abs()); }
+    std::string readLink() const;
 
     /**
      * Dump this `SourcePath` to `sink` as a NAR archive.
      */
     void dumpPath(
         Sink & sink,
-        PathFilter & filter = defaultPathFilter) const
-    { sink << nix::dumpPath(path.abs(), filter); }
+        PathFilter & filter = defaultPathFilter) const;
 
     /**
      * Return the location of this path in the "real" filesystem, if
@@ -155,4 +151,36 @@ struct SourcePath
 
 std::ostream & operator << (std::ostream & str, const SourcePath & path);
 
+/**
+ * The filesystem accesses made through `SourcePath`. The default
+ * implementation uses the real filesystem; a subclass installed with
+ * `setSourceAccessHook()` can observe these accesses or serve them
+ * from somewhere else, such as a recorded evaluation trace.
+ */
+struct SourceAccessHook
+{
+    virtual ~SourceAccessHook() { }
+
+    virtual std::string readFile(const CanonPath & path);
+
+    virtual std::optional<InputAccessor::Stat> maybeLstat(const CanonPath & path);
+
+    virtual InputAccessor::DirEntries readDirectory(const CanonPath & path);
+
+    virtual std::string readLink(const CanonPath & path);
+
+    virtual void dumpPath(const CanonPath & path, Sink & sink, PathFilter & filter);
+};
+
+/**
+ * Route all `SourcePath` accesses in this process through `hook`, or
+ * back to the real filesystem if `hook` is null.
+ */
+void setSourceAccessHook(std::shared_ptr<SourceAccessHook> hook);
+
+/**
+ * Whether a hook was installed with `setSourceAccessHook()`.
+ */
+bool hasSourceAccessHook();
+
 }
@@ -248,6 +248,17 @@ std::pair<std::string_view, std::string_view> getLine(std::string_view s)
     }
 }
 
+std::optional<size_t> findLastLines(std::string_view s, size_t n)
+{
+    if (n == 0) return s.size();
+    auto end = s.size();
+    if (end && s[end - 1] == '\n') end--;
+    for (auto i = end; i > 0; i--)
+        if (s[i - 1] == '\n' && --n == 0)
+            return i;
+    return std::nullopt;
+}
+
 std::string showBytes(uint64_t bytes)
 {
     return fmt("%.2f MiB", bytes / (1024.0 * 1024.0));
@@ -196,6 +196,15 @@ std::string stripIndentation(std::string_view s);
  */
 std::pair<std::string_view, std::string_view> getLine(std::string_view s);
 
+/**
+ * Find the offset in 's' at which its last 'n' lines start, not
+ * counting a trailing line break as the start of an empty line.
+ * Returns std::nullopt if 's' does not contain the line break that
+ * precedes the first of those lines, i.e. if 's' may be the tail of a
+ * longer string whose preceding part is needed to find the start.
+ */
+std::optional<size_t> findLastLines(std::string_view s, size_t n);
+
 std::string showBytes(uint64_t bytes);
 
 
@@ -3,15 +3,20 @@
 
 #include "error.hh"
 
+#include <unordered_set>
+
 namespace nix {
 
-template<typename T>
+/**
+ * @tparam Set The set type used to track visited nodes.
+ */
+template<typename T, typename Set = std::unordered_set<T>>
 std::vector<T> topoSort(std::set<T> items,
         std::function<std::set<T>(const T &)> getChildren,
         std::function<Error(const T &, const T &)> makeCycleError)
 {
     std::vector<T> sorted;
-    std::set<T> visited, parents;
+    Set visited, parents;
 
     std::function<void(const T & path, const T * parent)> dfsVisit;
 
@@ -15,6 +15,7 @@
 #include "daemon.hh"
 #include "unix-domain-socket.hh"
 #include "daemon-command.hh"
+#include "trash.hh"
 
 #include <algorithm>
 #include <climits>
@@ -309,6 +310,23 @@ static void daemonLoop(std::optional<TrustedFlag> forceTrustClientOpt)
     //  Get rid of children automatically; don't let them become zombies.
     setSigChldAction(true);
 
+    //  Finish deleting the build directories that previous daemons moved
+    //  to the trash but didn't get to delete. This is done in a child, so
+    //  that this process doesn't start any threads that the processes
+    //  forked for connections would inherit.
+    {
+        ProcessOptions options;
+        options.errorPrefix = "error emptying the trash: ";
+        options.dieWithParent = false;
+        startProcess([&]() {
+            fdSocket.reset();
+            if (auto localStore = openUncachedStore().dynamic_pointer_cast<LocalFSStore>())
+                recoverTrash(localStore->getRealStoreDir());
+            recoverTrash(canonPath(settings.buildDir.get().value_or(defaultTempDir()), true));
+            _exit(0);
+        }, options).release();
+    }
+
     //  Loop accepting connections.
     while (1) {
 
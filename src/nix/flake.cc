@@ -14,6 +14,7 @@
 #include "fetchers.hh"
 #include "registry.hh"
 #include "eval-cache.hh"
+#include "binary-cache-store.hh"
 #include "markdown.hh"
 #include "terminal.hh"
 #include "signals.hh"
@@ -173,7 +174,7 @@ static void enumerateOutputs(EvalState & state, Value & vFlake,
     auto pos = vFlake.determinePos(noPos);
     state.forceAttrs(vFlake, pos, "while evaluating a flake to get its outputs");
 
-    auto aOutputs = vFlake.attrs->get(state.symbols.create("outputs"));
+    auto aOutputs = vFlake.attrs()->get(state.symbols.create("outputs"));
     assert(aOutputs);
 
     state.forceAttrs(*aOutputs->value, pos, "while evaluating the outputs of a flake");
@@ -183,10 +184,10 @@ static void enumerateOutputs(EvalState & state, Value & vFlake,
     /* Hack: ensure that hydraJobs is evaluated before anything
        else. This way we can disable IFD for hydraJobs and then enable
        it for other outputs. */
-    if (auto attr = aOutputs->value->attrs->get(sHydraJobs))
+    if (auto attr = aOutputs->value->attrs()->get(sHydraJobs))
         callback(state.symbols[attr->name], *attr->value, attr->pos);
 
-    for (auto & attr : *aOutputs->value->attrs) {
+    for (auto & attr : *aOutputs->value->attrs()) {
         if (attr.name != sHydraJobs)
             callback(state.symbols[attr.name], *attr.value, attr.pos);
     }
@@ -461,10 +462,10 @@ struct CmdFlakeCheck : FlakeCommand
                 if (!v.isLambda()) {
                     throw Error("overlay is not a function, but %s instead", showType(v));
                 }
-                if (v.lambda.fun->hasFormals()
-                    || !argHasName(v.lambda.fun->arg, "final"))
+                if (v.lambda().fun->hasFormals()
+                    || !argHasName(v.lambda().fun->arg, "final"))
                     throw Error("overlay does not take an argument named 'final'");
-                auto body = dynamic_cast<ExprLambda *>(v.lambda.fun->body.get());
+                auto body = dynamic_cast<ExprLambda *>(v.lambda().fun->body.get());
                 if (!body
                     || body->hasFormals()
                     || !argHasName(body->arg, "prev"))
@@ -499,7 +500,7 @@ struct CmdFlakeCheck : FlakeCommand
                 if (state->isDerivation(v))
                     throw Error("jobset should not be a derivation at top-level");
 
-                for (auto & attr : *v.attrs) {
+                for (auto & attr : *v.attrs()) {
                     state->forceAttrs(*attr.value, attr.pos, "");
                     auto attrPath2 = concatStrings(attrPath, ".", state->symbols[attr.name]);
                     if (state->isDerivation(*attr.value)) {
@@ -538,7 +539,7 @@ struct CmdFlakeCheck : FlakeCommand
 
                 state->forceAttrs(v, pos, "");
 
-                if (auto attr = v.attrs->get(state->symbols.create("path"))) {
+                if (auto attr = v.attrs()->get(state->symbols.create("path"))) {
                     if (attr->name == state->symbols.create("path")) {
                         NixStringContext context;
                         auto path = state->coerceToPath(attr->pos, *attr->value, context, "");
@@ -549,12 +550,12 @@ struct CmdFlakeCheck : FlakeCommand
                 } else
                     throw Error("template '%s' lacks attribute 'path'", attrPath);
 
-                if (auto attr = v.attrs->get(state->symbols.create("description")))
+                if (auto attr = v.attrs()->get(state->symbols.create("description")))
                     state->forceStringNoCtx(*attr->value, attr->pos, "");
                 else
                     throw Error("template '%s' lacks attribute 'description'", attrPath);
 
-                for (auto & attr : *v.attrs) {
+                for (auto & attr : *v.attrs()) {
                     std::string_view name(state->symbols[attr.name]);
                     if (name != "path" && name != "description" && name != "welcomeText")
                         throw Error("template '%s' has unsupported attribute '%s'", attrPath, name);
@@ -610,12 +611,12 @@ struct CmdFlakeCheck : FlakeCommand
 
                         if (name == "checks") {
                             state->forceAttrs(vOutput, pos, "");
-                            for (auto & attr : *vOutput.attrs) {
+                            for (auto & attr : *vOutput.attrs()) {
                                 const auto & attr_name = state->symbols[attr.name];
                                 checkSystemName(attr_name, attr.pos);
                                 if (checkSystemType(attr_name, attr.pos)) {
                                     state->forceAttrs(*attr.value, attr.pos, "");
-                                    for (auto & attr2 : *attr.value->attrs) {
+                                    for (auto & attr2 : *attr.value->attrs()) {
                                         auto drvPath = checkDerivation(
                                             fmt("%s.%s.%s", name, attr_name, state->symbols[attr2.name]),
                                             *attr2.value, attr2.pos);
@@ -632,7 +633,7 @@ struct CmdFlakeCheck : FlakeCommand
 
                         else if (name == "formatter") {
                             state->forceAttrs(vOutput, pos, "");
-                            for (auto & attr : *vOutput.attrs) {
+                            for (auto & attr : *vOutput.attrs()) {
                                 const auto & attr_name = state->symbols[attr.name];
                                 checkSystemName(attr_name, attr.pos);
                                 if (checkSystemType(attr_name, attr.pos)) {
@@ -645,12 +646,12 @@ struct CmdFlakeCheck : FlakeCommand
 
                         else if (name == "packages" || name == "devShells") {
                             state->forceAttrs(vOutput, pos, "");
-                            for (auto & attr : *vOutput.attrs) {
+                            for (auto & attr : *vOutput.attrs()) {
                                 const auto & attr_name = state->symbols[attr.name];
                                 checkSystemName(attr_name, attr.pos);
                                 if (checkSystemType(attr_name, attr.pos)) {
                                     state->forceAttrs(*attr.value, attr.pos, "");
-                                    for (auto & attr2 : *attr.value->attrs)
+                                    for (auto & attr2 : *attr.value->attrs())
                                         checkDerivation(
                                             fmt("%s.%s.%s", name, attr_name, state->symbols[attr2.name]),
                                             *attr2.value, attr2.pos);
@@ -660,12 +661,12 @@ struct CmdFlakeCheck : FlakeCommand
 
                         else if (name == "apps") {
                             state->forceAttrs(vOutput, pos, "");
-                            for (auto & attr : *vOutput.attrs) {
+                            for (auto & attr : *vOutput.attrs()) {
                                 const auto & attr_name = state->symbols[attr.name];
                                 checkSystemName(attr_name, attr.pos);
                                 if (checkSystemType(attr_name, attr.pos)) {
                                     state->forceAttrs(*attr.value, attr.pos, "");
-                                    for (auto & attr2 : *attr.value->attrs)
+                                    for (auto & attr2 : *attr.value->attrs())
                                         checkApp(
                                             fmt("%s.%s.%s", name, attr_name, state->symbols[attr2.name]),
                                             *attr2.value, attr2.pos);
@@ -675,7 +676,7 @@ struct CmdFlakeCheck : FlakeCommand
 
                         else if (name == "defaultPackage" || name == "devShell") {
                             state->forceAttrs(vOutput, pos, "");
-                            for (auto & attr : *vOutput.attrs) {
+                            for (auto & attr : *vOutput.attrs()) {
                                 const auto & attr_name = state->symbols[attr.name];
                                 checkSystemName(attr_name, attr.pos);
                                 if (checkSystemType(attr_name, attr.pos)) {
@@ -688,7 +689,7 @@ struct CmdFlakeCheck : FlakeCommand
 
                         else if (name == "defaultApp") {
                             state->forceAttrs(vOutput, pos, "");
-                            for (auto & attr : *vOutput.attrs) {
+                            for (auto & attr : *vOutput.attrs()) {
                                 const auto & attr_name = state->symbols[attr.name];
                                 checkSystemName(attr_name, attr.pos);
                                 if (checkSystemType(attr_name, attr.pos) ) {
@@ -701,7 +702,7 @@ struct CmdFlakeCheck : FlakeCommand
 
                         else if (name == "legacyPackages") {
                             state->forceAttrs(vOutput, pos, "");
-                            for (auto & attr : *vOutput.attrs) {
+                            for (auto & attr : *vOutput.attrs()) {
                                 checkSystemName(state->symbols[attr.name], attr.pos);
                                 checkSystemType(state->symbols[attr.name], attr.pos);
                                 // FIXME: do getDerivations?
@@ -713,7 +714,7 @@ struct CmdFlakeCheck : FlakeCommand
 
                         else if (name == "overlays") {
                             state->forceAttrs(vOutput, pos, "");
-                            for (auto & attr : *vOutput.attrs)
+                            for (auto & attr : *vOutput.attrs())
                                 checkOverlay(fmt("%s.%s", name, state->symbols[attr.name]),
                                     *attr.value, attr.pos);
                         }
@@ -723,14 +724,14 @@ struct CmdFlakeCheck : FlakeCommand
 
                         else if (name == "nixosModules") {
                             state->forceAttrs(vOutput, pos, "");
-                            for (auto & attr : *vOutput.attrs)
+                            for (auto & attr : *vOutput.attrs())
                                 checkModule(fmt("%s.%s", name, state->symbols[attr.name]),
                                     *attr.value, attr.pos);
                         }
 
                         else if (name == "nixosConfigurations") {
                             state->forceAttrs(vOutput, pos, "");
-                            for (auto & attr : *vOutput.attrs)
+                            for (auto & attr : *vOutput.attrs())
                                 checkNixOSConfiguration(fmt("%s.%s", name, state->symbols[attr.name]),
                                     *attr.value, attr.pos);
                         }
@@ -743,14 +744,14 @@ struct CmdFlakeCheck : FlakeCommand
 
                         else if (name == "templates") {
                             state->forceAttrs(vOutput, pos, "");
-                            for (auto & attr : *vOutput.attrs)
+                            for (auto & attr : *vOutput.attrs())
                                 checkTemplate(fmt("%s.%s", name, state->symbols[attr.name]),
                                     *attr.value, attr.pos);
                         }
 
                         else if (name == "defaultBundler") {
                             state->forceAttrs(vOutput, pos, "");
-                            for (auto & attr : *vOutput.attrs) {
+                            for (auto & attr : *vOutput.attrs()) {
                                 const auto & attr_name = state->symbols[attr.name];
                                 checkSystemName(attr_name, attr.pos);
                                 if (checkSystemType(attr_name, attr.pos)) {
@@ -763,12 +764,12 @@ struct CmdFlakeCheck : FlakeCommand
 
                         else if (name == "bundlers") {
                             state->forceAttrs(vOutput, pos, "");
-                            for (auto & attr : *vOutput.attrs) {
+                            for (auto & attr : *vOutput.attrs()) {
                                 const auto & attr_name = state->symbols[attr.name];
                                 checkSystemName(attr_name, attr.pos);
                                 if (checkSystemType(attr_name, attr.pos)) {
                                     state->forceAttrs(*attr.value, attr.pos, "");
-                                    for (auto & attr2 : *attr.value->attrs) {
+                                    for (auto & attr2 : *attr.value->attrs()) {
                                         checkBundler(
                                             fmt("%s.%s.%s", name, attr_name, state->symbols[attr2.name]),
                                             *attr2.value, attr2.pos);
@@ -1022,6 +1023,7 @@ struct CmdFlakeClone : FlakeCommand
 struct CmdFlakeArchive : FlakeCommand, MixJSON, MixDryRun
 {
     std::string dstUri;
+    bool copyEvalCache = false;
 
     CmdFlakeArchive()
     {
@@ -1031,6 +1033,12 @@ struct CmdFlakeArchive : FlakeCommand, MixJSON, MixDryRun
             .labels = {"store-uri"},
             .handler = {&dstUri}
         });
+
+        addFlag({
+            .longName = "include-eval-cache",
+            .description = "Also copy the evaluation cache of the flake to the destination, which must be a binary cache.",
+            .handler = {&copyEvalCache, true}
+        });
     }
 
     std::string description() override
@@ -1088,9 +1096,26 @@ struct CmdFlakeArchive : FlakeCommand, MixJSON, MixDryRun
             traverse(*flake.lockFile.root);
         }
 
+        if (copyEvalCache && dstUri.empty())
+            throw UsageError("'--include-eval-cache' requires '--to'");
+
         if (!dryRun && !dstUri.empty()) {
             ref<Store> dstStore = dstUri.empty() ? openStore() : openStore(dstUri);
             copyPaths(*store, *dstStore, sources);
+
+            if (copyEvalCache) {
+                auto binaryCache = dstStore.dynamic_pointer_cast<BinaryCacheStore>();
+                if (!binaryCache)
+                    throw UsageError("'--include-eval-cache' requires the destination to be a binary cache");
+                auto fingerprint = flake.getFingerprint();
+                auto bundle = eval_cache::exportEvalCache(fingerprint);
+                if (!bundle)
+                    throw Error("flake '%s' has no evaluation cache yet", flake.flake.lockedRef);
+                binaryCache->upsertFile(
+                    eval_cache::evalCacheBundleName(fingerprint),
+                    std::move(*bundle),
+                    "application/octet-stream");
+            }
         }
     }
 };
@@ -8,6 +8,18 @@ using namespace nix;
 
 struct CmdLog : InstallableCommand
 {
+    std::optional<size_t> tail;
+
+    CmdLog()
+    {
+        addFlag({
+            .longName = "tail",
+            .description = "Only print the last *n* lines of the log.",
+            .labels = {"n"},
+            .handler = {&tail},
+        });
+    }
+
     std::string description() override
     {
         return "show the build log of the specified packages or paths, if available";
@@ -52,7 +64,7 @@ struct CmdLog : InstallableCommand
             }
             auto & logSub = *logSubP;
 
-            auto log = logSub.getBuildLog(path);
+            auto log = tail ? logSub.getBuildLogTail(path, *tail) : logSub.getBuildLog(path);
             if (!log) continue;
             logger->pause();
             printInfo("got build log for '%s' from '%s'", installable->what(), logSub.getUri());
@@ -271,7 +271,7 @@ static void showHelp(std::vector<std::string> subcommand, NixArgs & toplevel)
     state.callFunction(*vGenerateManpage, state.getBuiltin("false"), *vRes, noPos);
     state.callFunction(*vRes, *vDump, *vRes, noPos);
 
-    auto attr = vRes->attrs->get(state.symbols.create(mdName + ".md"));
+    auto attr = vRes->attrs()->get(state.symbols.create(mdName + ".md"));
     if (!attr)
         throw UsageError("`nix` has no subcommand '%s'", concatStringsSep("", subcommand));
 
@@ -417,11 +417,11 @@ void mainWrapped(int argc, char * * argv)
         auto res = nlohmann::json::object();
         res["builtins"] = ({
             auto builtinsJson = nlohmann::json::object();
-            auto builtins = state.baseEnv.values[0]->attrs;
+            auto builtins = state.baseEnv.values[0]->attrs();
             for (auto & builtin : *builtins) {
                 auto b = nlohmann::json::object();
                 if (!builtin.value->isPrimOp()) continue;
-                auto primOp = builtin.value->primOp;
+                auto primOp = builtin.value->primOp();
                 if (!primOp->doc) continue;
                 b["arity"] = primOp->arity;
                 b["args"] = primOp->args;
@@ -100,6 +100,13 @@ struct CmdPathInfo : StorePathsCommand, MixJSON
         else {
 
             for (auto & storePath : storePaths) {
+                /* Paths from `--all` are known to be valid, so there's no
+                   need to look them up just to print them. */
+                if (all && !showSize && !showClosureSize && !showSigs) {
+                    std::cout << store->printStorePath(storePath) << '\n';
+                    continue;
+                }
+
                 auto info = store->queryPathInfo(storePath);
                 auto storePathS = store->printStorePath(info->path);
 
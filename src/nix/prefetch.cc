@@ -34,8 +34,8 @@ std::string resolveMirrorUrl(EvalState & state, const std::string & url)
         vMirrors);
     state.forceAttrs(vMirrors, noPos, "while evaluating the set of all mirrors");
 
-    auto mirrorList = vMirrors.attrs->find(state.symbols.create(mirrorName));
-    if (mirrorList == vMirrors.attrs->end())
+    auto mirrorList = vMirrors.attrs()->find(state.symbols.create(mirrorName));
+    if (mirrorList == vMirrors.attrs()->end())
         throw Error("unknown mirror name '%s'", mirrorName);
     state.forceList(*mirrorList->value, noPos, "while evaluating one mirror configuration");
 
@@ -205,7 +205,7 @@ static int main_nix_prefetch_url(int argc, char * * argv)
             state->forceAttrs(v, noPos, "while evaluating the source attribute to prefetch");
 
             /* Extract the URL. */
-            auto * attr = v.attrs->get(state->symbols.create("urls"));
+            auto * attr = v.attrs()->get(state->symbols.create("urls"));
             if (!attr)
                 throw Error("attribute 'urls' missing");
             state->forceList(*attr->value, noPos, "while evaluating the urls to prefetch");
@@ -214,7 +214,7 @@ static int main_nix_prefetch_url(int argc, char * * argv)
             url = state->forceString(*attr->value->listElems()[0], noPos, "while evaluating the first url from the urls list");
 
             /* Extract the hash mode. */
-            auto attr2 = v.attrs->get(state->symbols.create("outputHashMode"));
+            auto attr2 = v.attrs()->get(state->symbols.create("outputHashMode"));
             if (!attr2)
                 printInfo("warning: this does not look like a fetchurl call");
             else
@@ -222,7 +222,7 @@ static int main_nix_prefetch_url(int argc, char * * argv)
 
             /* Extract the name. */
             if (!name) {
-                auto attr3 = v.attrs->get(state->symbols.create("name"));
+                auto attr3 = v.attrs()->get(state->symbols.create("name"));
                 if (!attr3)
                     name = state->forceString(*attr3->value, noPos, "while evaluating the name of the source to prefetch");
             }
@@ -2,6 +2,9 @@
 #include "store-api.hh"
 #include "fs-accessor.hh"
 #include "shared.hh"
+#include "references.hh"
+#include "signals.hh"
+#include "thread-pool.hh"
 
 #include <queue>
 
@@ -124,6 +127,9 @@ struct CmdWhyDepends : SourceExprCommand, MixOperateOnOptions
             Node * prev = nullptr;
             bool queued = false;
             bool visited = false;
+            /* For each reference that leads to `dependency`, the
+               files and symlinks in this path that contain it. */
+            std::optional<std::map<std::string, Strings>> hits;
         };
 
         std::map<StorePath, Node> graph;
@@ -165,112 +171,145 @@ struct CmdWhyDepends : SourceExprCommand, MixOperateOnOptions
             }
         }
 
-        /* Print the subgraph of nodes that have 'dependency' in their
-           closure (i.e., that have a non-infinite distance to
-           'dependency'). Print every edge on a path between `package`
-           and `dependency`. */
-        std::function<void(Node &, const std::string &, const std::string &)> printNode;
-
-        struct BailOut : std::exception { };
-
-        printNode = [&](Node & node, const std::string & firstPad, const std::string & tailPad) {
-            auto pathS = store->printStorePath(node.path);
-
-            assert(node.dist != inf);
-            if (precise) {
-                logger->cout("%s%s%s%s" ANSI_NORMAL,
-                    firstPad,
-                    node.visited ? "\e[38;5;244m" : "",
-                    firstPad != "" ? "→ " : "",
-                    pathS);
-            }
-
-            if (node.path == dependencyPath && !all
-                && packagePath != dependencyPath)
-                throw BailOut();
-
-            if (node.visited) return;
-            if (precise) node.visited = true;
-
-            /* Sort the references by distance to `dependency` to
-               ensure that the shortest path is printed first. */
+        /* The references of `node` that lead to `dependency`, sorted
+           by distance to `dependency` to ensure that the shortest
+           path is printed first. */
+        auto relevantRefs = [&](Node & node) {
             std::multimap<size_t, Node *> refs;
-            std::set<std::string> hashes;
-
             for (auto & ref : node.refs) {
                 if (ref == node.path && packagePath != dependencyPath) continue;
                 auto & node2 = graph.at(ref);
                 if (node2.dist == inf) continue;
                 refs.emplace(node2.dist, &node2);
-                hashes.insert(std::string(node2.path.hashPart()));
             }
+            return refs;
+        };
+
+        /* For each relevant reference of `node`, find the files and
+           symlinks that contain the reference. Every file is read
+           once and searched for all hashes at the same time. */
+        auto scanNode = [&](Node & node, FSAccessor & accessor) {
+            auto pathS = store->printStorePath(node.path);
+
+            StringSet hashes;
+            for (auto & ref : relevantRefs(node))
+                hashes.insert(std::string(ref.second->path.hashPart()));
 
-            /* For each reference, find the files and symlinks that
-               contain the reference. */
             std::map<std::string, Strings> hits;
 
+            auto getColour = [&](const std::string & hash) {
+                return hash == dependencyPathHash ? ANSI_GREEN : ANSI_BLUE;
+            };
+
             std::function<void(const Path &)> visitPath;
 
             visitPath = [&](const Path & p) {
-                auto st = accessor->stat(p);
+                auto st = accessor.stat(p);
 
                 auto p2 = p == pathS ? "/" : std::string(p, pathS.size() + 1);
 
-                auto getColour = [&](const std::string & hash) {
-                    return hash == dependencyPathHash ? ANSI_GREEN : ANSI_BLUE;
-                };
-
                 if (st.type == FSAccessor::Type::tDirectory) {
-                    auto names = accessor->readDirectory(p);
+                    auto names = accessor.readDirectory(p);
                     for (auto & name : names)
                         visitPath(p + "/" + name);
                 }
 
                 else if (st.type == FSAccessor::Type::tRegular) {
-                    auto contents = accessor->readFile(p);
-
-                    for (auto & hash : hashes) {
-                        auto pos = contents.find(hash);
-                        if (pos != std::string::npos) {
-                            size_t margin = 32;
-                            auto pos2 = pos >= margin ? pos - margin : 0;
-                            hits[hash].emplace_back(fmt("%s: …%s…",
-                                    p2,
-                                    hilite(filterPrintable(
-                                            std::string(contents, pos2, pos - pos2 + hash.size() + margin)),
-                                        pos - pos2, StorePath::HashLen,
-                                        getColour(hash))));
-                        }
+                    auto contents = accessor.readFile(p);
+
+                    for (auto & [hash, pos] : findFirstOccurrences(contents, hashes)) {
+                        size_t margin = 32;
+                        auto pos2 = pos >= margin ? pos - margin : 0;
+                        hits[hash].emplace_back(fmt("%s: …%s…",
+                                p2,
+                                hilite(filterPrintable(
+                                        std::string(contents, pos2, pos - pos2 + hash.size() + margin)),
+                                    pos - pos2, StorePath::HashLen,
+                                    getColour(hash))));
                     }
                 }
 
                 else if (st.type == FSAccessor::Type::tSymlink) {
-                    auto target = accessor->readLink(p);
+                    auto target = accessor.readLink(p);
 
-                    for (auto & hash : hashes) {
-                        auto pos = target.find(hash);
-                        if (pos != std::string::npos)
-                            hits[hash].emplace_back(fmt("%s -> %s", p2,
-                                    hilite(target, pos, StorePath::HashLen, getColour(hash))));
-                    }
+                    for (auto & [hash, pos] : findFirstOccurrences(target, hashes))
+                        hits[hash].emplace_back(fmt("%s -> %s", p2,
+                                hilite(target, pos, StorePath::HashLen, getColour(hash))));
                 }
             };
 
-            // FIXME: should use scanForReferences().
+            if (!hashes.empty()) visitPath(pathS);
+
+            node.hits = std::move(hits);
+        };
+
+        /* With `--all --precise`, every path on some path from
+           `package` to `dependency` gets scanned, so scan them all up
+           front in parallel. Each scan gets its own accessor because
+           accessors for remote stores are not thread-safe. */
+        if (all && precise) {
+            std::set<Node *> toScan;
+            std::function<void(Node &)> collect = [&](Node & node) {
+                if (!toScan.insert(&node).second) return;
+                for (auto & ref : relevantRefs(node))
+                    collect(*ref.second);
+            };
+            collect(graph.at(packagePath));
+
+            ThreadPool pool;
+            for (auto node : toScan)
+                pool.enqueue([&, node]() {
+                    checkInterrupt();
+                    scanNode(*node, *store->getFSAccessor());
+                });
+            pool.process();
+        }
+
+        /* Print the subgraph of nodes that have 'dependency' in their
+           closure (i.e., that have a non-infinite distance to
+           'dependency'). Print every edge on a path between `package`
+           and `dependency`. */
+        std::function<void(Node &, const std::string &, const std::string &)> printNode;
+
+        struct BailOut : std::exception { };
 
-            if (precise) visitPath(pathS);
+        printNode = [&](Node & node, const std::string & firstPad, const std::string & tailPad) {
+            auto pathS = store->printStorePath(node.path);
+
+            assert(node.dist != inf);
+            if (precise) {
+                logger->cout("%s%s%s%s" ANSI_NORMAL,
+                    firstPad,
+                    node.visited ? "\e[38;5;244m" : "",
+                    firstPad != "" ? "→ " : "",
+                    pathS);
+            }
+
+            if (node.path == dependencyPath && !all
+                && packagePath != dependencyPath)
+                throw BailOut();
+
+            if (node.visited) return;
+            if (precise) node.visited = true;
+
+            auto refs = relevantRefs(node);
+
+            if (precise && !node.hits) scanNode(node, *accessor);
 
             for (auto & ref : refs) {
                 std::string hash(ref.second->path.hashPart());
 
                 bool last = all ? ref == *refs.rbegin() : true;
 
-                for (auto & hit : hits[hash]) {
-                    bool first = hit == *hits[hash].begin();
-                    logger->cout("%s%s%s", tailPad,
-                              (first ? (last ? treeLast : treeConn) : (last ? treeNull : treeLine)),
-                              hit);
-                    if (!all) break;
+                if (node.hits) {
+                    auto & hits = (*node.hits)[hash];
+                    for (auto & hit : hits) {
+                        bool first = hit == *hits.begin();
+                        logger->cout("%s%s%s", tailPad,
+                                  (first ? (last ? treeLast : treeConn) : (last ? treeNull : treeLine)),
+                                  hit);
+                        if (!all) break;
+                    }
                 }
 
                 if (!precise) {
@@ -49,6 +49,19 @@ test_custom_build_dir() {
 }
 test_custom_build_dir
 
+# Finished build directories are moved to the trash and deleted in the
+# background, before Nix exits.
+test_build_dir_trash() {
+  local customBuildDir="$TEST_ROOT/trash-build-dir"
+  mkdir "$customBuildDir"
+  nix-build check.nix -A deterministic --argstr checkBuildId "trash-$checkBuildId" \
+      --no-out-link --option build-dir "$customBuildDir"
+  # Only the empty trash directory is left.
+  [[ "$(ls -A "$customBuildDir")" == .lix-trash-* ]]
+  [[ -z "$(ls -A "$customBuildDir"/.lix-trash-*)" ]]
+}
+test_build_dir_trash
+
 nix-build check.nix -A deterministic --argstr checkBuildId $checkBuildId \
     --no-out-link 2> $TEST_ROOT/log
 checkBuildTempDirRemoved $TEST_ROOT/log
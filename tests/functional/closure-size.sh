@@ -0,0 +1,26 @@
+source common.sh
+
+needLocalStore "closure aggregates are only stored by the local store"
+
+clearStore
+
+outPath=$(nix-build dependencies.nix --no-out-link)
+
+expected=0
+for p in $(nix-store -qR "$outPath"); do
+    expected=$((expected + $(nix path-info --json "$p" | jq '.[0].narSize')))
+done
+
+# The first query computes the aggregate, the second one reads it back.
+[[ $(nix path-info --json -S "$outPath" | jq '.[0].closureSize') = "$expected" ]]
+[[ $(nix path-info --json -S "$outPath" | jq '.[0].closureSize') = "$expected" ]]
+
+if [[ -n "$(type -p sqlite3)" ]]; then
+    [[ $(sqlite3 "$NIX_STATE_DIR/db/db.sqlite" 'select count(*) from ClosureAggregates') -ge 1 ]]
+fi
+
+# Deleting the path must drop its aggregate along with it.
+nix-store --delete "$outPath"
+if [[ -n "$(type -p sqlite3)" ]]; then
+    [[ $(sqlite3 "$NIX_STATE_DIR/db/db.sqlite" 'select count(*) from ClosureAggregates') -eq 0 ]]
+fi
@@ -0,0 +1,43 @@
+source common.sh
+
+clearStore
+
+dir=$TEST_ROOT/eval-trace
+trace=$TEST_ROOT/eval-trace.json
+rm -rf "$dir" "$trace"
+mkdir -p "$dir/sub"
+echo hello > "$dir/sub/msg"
+echo skipped > "$dir/sub/skip"
+ln -sfn sub "$dir/link"
+
+cat > "$dir/default.nix" <<'EOF'
+{
+  msg = builtins.readFile ./link/msg;
+  entries = builtins.attrNames (builtins.readDir ./sub);
+  exists = builtins.pathExists ./missing;
+  greeting = builtins.getEnv "GREETING";
+  src = "${./sub}";
+  filtered = "${builtins.path { path = ./sub; filter = p: t: baseNameOf p != "skip"; }}";
+}
+EOF
+
+evaluate() {
+    nix-instantiate --eval --strict "$dir" "$@"
+}
+
+# Record an evaluation, then replay it without any of its inputs.
+expected=$(GREETING=hi evaluate --option record-eval-trace "$trace")
+[[ -s $trace ]]
+mv "$dir" "$dir.moved"
+[[ $(GREETING=bye evaluate --option replay-eval-trace "$trace") = "$expected" ]]
+mv "$dir.moved" "$dir"
+
+# Filtered and unfiltered copies of the same directory stay distinct.
+[[ $(evaluate -A src) != $(evaluate -A filtered) ]]
+[[ $(evaluate -A filtered --option replay-eval-trace "$trace") = $(evaluate -A filtered) ]]
+[[ $(evaluate -A src --option replay-eval-trace "$trace") = $(evaluate -A src) ]]
+
+# Inputs that were not recorded are an error on replay.
+echo 'builtins.readFile ./sub/msg' > "$dir/other.nix"
+expectStderr 1 nix-instantiate --eval "$dir/other.nix" --option replay-eval-trace "$trace" \
+    | grepQuiet "is not in the evaluation trace"
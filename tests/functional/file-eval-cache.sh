@@ -0,0 +1,43 @@
+source common.sh
+
+clearStore
+
+dir=$TEST_ROOT/file-eval-cache
+rm -rf "$dir"
+mkdir -p "$dir"
+cp config.nix "$dir/"
+echo hello > "$dir/msg"
+
+cat > "$dir/default.nix" <<'EOF'
+with import ./config.nix;
+{
+  hello = mkDerivation {
+    name = "hello";
+    msg = builtins.readFile ./msg;
+    greeting = builtins.getEnv "GREETING";
+    buildCommand = "echo $msg > $out";
+  };
+}
+EOF
+
+build() {
+    nix build --file-eval-cache -f "$dir" hello --dry-run "$@"
+}
+
+# The first run populates the cache, the second one is served from it.
+build
+NIX_ALLOW_EVAL=0 build
+
+# Changing a file that was read discards the cache.
+echo bye > "$dir/msg"
+(! NIX_ALLOW_EVAL=0 build)
+build
+NIX_ALLOW_EVAL=0 build
+
+# So does changing an environment variable that was read.
+(! GREETING=hi NIX_ALLOW_EVAL=0 build)
+GREETING=hi build
+GREETING=hi NIX_ALLOW_EVAL=0 build
+
+# Arguments are part of the cache key.
+(! GREETING=hi NIX_ALLOW_EVAL=0 build --argstr foo bar)
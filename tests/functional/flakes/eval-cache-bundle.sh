@@ -0,0 +1,58 @@
+source ./common.sh
+
+requireGit
+
+clearStore
+
+flakeDir=$TEST_ROOT/flake
+cacheDir=$TEST_ROOT/binary-cache
+rm -rf "$flakeDir" "$cacheDir"
+mkdir -p "$flakeDir"
+createSimpleGitFlake "$flakeDir"
+
+# Populate the local evaluation cache and publish it.
+nix build --dry-run "$flakeDir#foo"
+nix flake archive --to "file://$cacheDir" --include-eval-cache "$flakeDir"
+[[ -n $(find "$cacheDir/eval-cache" -name '*.bundle') ]]
+
+# '--include-eval-cache' only makes sense with a destination.
+expectStderr 1 nix flake archive --include-eval-cache "$flakeDir" | grepQuiet "requires '--to'"
+
+# Without a local cache, the published one is used.
+rm -rf "$TEST_HOME/.cache/nix/eval-cache-v5"
+opts=(--substitute-eval-cache --substituters "file://$cacheDir")
+
+# Unsigned bundles are rejected by default...
+(! NIX_ALLOW_EVAL=0 nix build --dry-run "${opts[@]}" "$flakeDir#foo")
+
+# ...but can be used when signatures aren't required.
+rm -rf "$TEST_HOME/.cache/nix/eval-cache-v5"
+NIX_ALLOW_EVAL=0 nix build --dry-run "${opts[@]}" --option require-sigs false "$flakeDir#foo"
+
+# Signed bundles are accepted.
+nix-store --generate-binary-cache-key cache1.example.org "$TEST_ROOT/sk1" "$TEST_ROOT/pk1"
+nix flake archive --to "file://$cacheDir" --include-eval-cache --secret-key-files "$TEST_ROOT/sk1" "$flakeDir"
+rm -rf "$TEST_HOME/.cache/nix/eval-cache-v5"
+NIX_ALLOW_EVAL=0 nix build --dry-run "${opts[@]}" --trusted-public-keys "$(cat "$TEST_ROOT/pk1")" "$flakeDir#foo"
+
+# Attributes that failed to evaluate are still listed after an import,
+# and are evaluated again instead of being reported as missing.
+failingDir=$TEST_ROOT/failing-flake
+createGitRepo "$failingDir"
+cat > "$failingDir/flake.nix" <<EOF2
+{
+  outputs = { self }: {
+    packages.$system = {
+      ok = "ok";
+      broken = throw "broken on purpose";
+    };
+  };
+}
+EOF2
+git -C "$failingDir" add flake.nix
+git -C "$failingDir" commit -m 'Initial'
+nix flake show "$failingDir" || true
+nix flake archive --to "file://$cacheDir" --include-eval-cache "$failingDir"
+rm -rf "$TEST_HOME/.cache/nix/eval-cache-v5"
+expectStderr 1 nix eval "${opts[@]}" --option require-sigs false "$failingDir#packages.$system.broken" \
+    | grepQuiet "broken on purpose"
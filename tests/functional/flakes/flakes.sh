@@ -311,6 +311,11 @@ nix build -o $TEST_ROOT/result flake3#xyzzy flake3#fnord
 # Test doing multiple `lookupFlake`s
 nix build -o $TEST_ROOT/result flake4#xyzzy
 
+# Fetching inputs concurrently must not change the lock file.
+nix flake lock $flake3Dir --recreate-lock-file --output-lock-file $TEST_ROOT/flake3-parallel.lock
+nix flake lock $flake3Dir --recreate-lock-file --output-lock-file $TEST_ROOT/flake3-serial.lock --flake-input-fetch-jobs 1
+cmp $TEST_ROOT/flake3-parallel.lock $TEST_ROOT/flake3-serial.lock
+
 # Test 'nix flake update' and --override-flake.
 nix flake lock $flake3Dir
 [[ -z $(git -C $flake3Dir diff master || echo failed) ]]
@@ -42,8 +42,18 @@ if test -e $drvPath; then false; fi
 
 rm "$NIX_STATE_DIR"/gcroots/foo
 
+# Leftovers of an interrupted background deletion are deleted too.
+trashDir=$NIX_STORE_DIR/.lix-trash-$(id -u)
+mkdir -p -m 700 "$trashDir/leftover"
+touch "$trashDir/leftover/file"
+# Those of a running process are left to it.
+mkdir "$trashDir/busy-$$-0"
+
 nix-collect-garbage
 
+[[ "$(ls -A "$trashDir")" == "busy-$$-0" ]]
+rm -rf "$trashDir"
+
 # Check that the output has been GC'd.
 if test -e $outPath/foobar; then false; fi
 
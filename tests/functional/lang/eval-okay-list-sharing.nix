@@ -0,0 +1,14 @@
+let
+  range = n: builtins.genList (x: x) n;
+  acc = builtins.foldl' (l: x: l ++ [ x ]) [ ] (range 10);
+
+  # Lists that share storage with others must not see what is appended
+  # to those.
+  a = range 3 ++ range 3;
+  b = a ++ [ "b" ];
+  c = a ++ [ "c" ];
+  t = builtins.tail b;
+  d = t ++ [ "d" ];
+  e = b ++ [ "e" ];
+in
+  [ acc a b c t d e (builtins.tail (builtins.tail (builtins.tail [ 1 2 3 ]))) ]
@@ -0,0 +1,14 @@
+let
+  # The same select sites see attribute sets of different layouts, so
+  # the slots they remember must be checked against the name.
+  get = s: s.b.x;
+  getOr = s: s.b.x or 0;
+  sets = [
+    { b.x = 1; }
+    { a = 0; b.x = 2; }
+    { b = { w = 0; x = 3; }; c = 4; }
+    { a = 0; c = 1; b.x = 4; }
+    { b.x = 5; }
+  ];
+in
+  map get sets ++ map getOr (sets ++ [ { a = 1; } { b = 6; } { b.y = 7; } ])
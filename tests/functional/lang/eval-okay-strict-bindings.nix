@@ -0,0 +1,12 @@
+let
+  # Bindings that the body always forces, referring to each other and
+  # to themselves before they are all initialised.
+  a = { x = b; y = a.x.z; };
+  b = { z = 1; };
+  l = [ a.y c ];
+  c = 2;
+  self = { next = self; n = 3; };
+  f = { p, q ? p }: p ++ q;
+in
+  assert a.y == 1;
+  [ (f { p = l; q = [ c ]; }) self.next.next.n (builtins.length l) ]
@@ -13,6 +13,8 @@ rm -rf $NIX_LOG_DIR
 (! nix-store -l $path)
 nix-build dependencies.nix --no-out-link --compress-build-log
 [ "$(nix-store -l $path)" = FOO ]
+[ "$(nix log --tail 1 $path)" = FOO ]
+[ "$(nix log --tail 0 $path)" = "" ]
 
 # test whether empty logs work fine with `nix log`.
 builder="$(realpath "$(mktemp)")"
@@ -24,3 +26,14 @@ outp="$(nix-build -E \
 test -d "$outp"
 
 nix log "$outp"
+
+# test that the build log rate limit elides output but keeps the log intact.
+builder="$(realpath "$(mktemp)")"
+echo -e "#!/bin/sh\ni=0; while [ \$i -lt 100 ]; do echo chatty line \$i; i=\$((i+1)); done\nmkdir \$out" > "$builder"
+outp="$(nix-build -E \
+    'with import ./config.nix; mkDerivation { name = "chatty"; builder = '"$builder"'; }' \
+    --no-out-link --option build-log-rate-limit-lines 10 2> "$TEST_ROOT/chatty.err")"
+
+grepQuiet "lines of build output elided" "$TEST_ROOT/chatty.err"
+(( $(grep -c "chatty line" "$TEST_ROOT/chatty.err") < 100 ))
+(( $(nix-store -l "$outp" | grep -c "chatty line") == 100 ))
@@ -0,0 +1,39 @@
+source common.sh
+
+needLocalStore "the metadata snapshot is only used by the local store"
+
+clearStore
+
+outPath=$(nix-build dependencies.nix --no-out-link)
+dep=$(nix-store --query --references "$outPath" | head -n1)
+
+# What the database says, before the snapshot is enabled.
+expectedClosure=$(nix-store --query --requisites "$outPath")
+expectedReferrers=$(nix-store --query --referrers-closure "$dep")
+expectedAll=$(nix path-info --all)
+
+echo 'use-metadata-snapshot = true' >> "$NIX_CONF_DIR"/nix.conf
+
+# The first query builds the snapshot from scratch.
+[[ $(nix-store --query --requisites "$outPath") == "$expectedClosure" ]]
+[[ -e $NIX_STATE_DIR/db/metadata-snapshot ]]
+[[ $(nix-store --query --referrers-closure "$dep") == "$expectedReferrers" ]]
+[[ $(nix path-info --all) == "$expectedAll" ]]
+
+# Registered and invalidated paths are merged into it.
+newPath=$(nix-store --add ./dependencies.nix)
+[[ $(nix path-info --all) == *"$newPath"* ]]
+nix-store --delete "$newPath"
+[[ $(nix path-info --all) == "$expectedAll" ]]
+[[ $(nix-store --query --requisites "$outPath") == "$expectedClosure" ]]
+
+# A damaged snapshot is rebuilt.
+echo garbage > "$NIX_STATE_DIR"/db/metadata-snapshot
+[[ $(nix path-info --all 2> "$TEST_ROOT"/log) == "$expectedAll" ]]
+grepQuiet "ignoring metadata snapshot" "$TEST_ROOT"/log
+
+nix-store --verify
+
+# Disabling it removes the snapshot and the log.
+nix-store --option use-metadata-snapshot false --query --requisites "$outPath" > /dev/null
+[[ ! -e $NIX_STATE_DIR/db/metadata-snapshot ]]
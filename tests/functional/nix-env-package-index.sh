@@ -0,0 +1,49 @@
+source common.sh
+
+clearStore
+
+dir=$TEST_ROOT/package-index
+rm -rf "$dir"
+mkdir -p "$dir"
+cp config.nix "$dir/"
+echo 1.0 > "$dir/version"
+
+cat > "$dir/default.nix" <<'EOF'
+with import ./config.nix;
+let version = builtins.replaceStrings ["\n"] [""] (builtins.readFile ./version); in
+{
+  foo = mkDerivation {
+    name = "foo-${version}";
+    buildCommand = "mkdir $out";
+    meta.description = "The foo package";
+  };
+  bar = mkDerivation {
+    name = "bar-${builtins.getEnv "BAR_VERSION"}";
+    buildCommand = "mkdir $out";
+  };
+}
+EOF
+
+query() {
+    nix-env --option package-index true -f "$dir" -qaP --description "$@"
+}
+
+# The first query builds the index, the second one is answered from it.
+export BAR_VERSION=2.0
+query | grepQuiet 'foo *foo-1.0 *The foo package'
+[[ $(NIX_ALLOW_EVAL=0 query) = $(query) ]]
+NIX_ALLOW_EVAL=0 query 'bar.*' | grepQuiet 'bar *bar-2.0'
+(! NIX_ALLOW_EVAL=0 query 'bar.*' | grepQuiet foo)
+
+# Changing a file that was read discards the index.
+echo 1.1 > "$dir/version"
+(! NIX_ALLOW_EVAL=0 query)
+query | grepQuiet 'foo-1.1'
+NIX_ALLOW_EVAL=0 query | grepQuiet 'foo-1.1'
+
+# So does changing an environment variable that was read.
+(! BAR_VERSION=3.0 NIX_ALLOW_EVAL=0 query)
+BAR_VERSION=3.0 query | grepQuiet 'bar-3.0'
+
+# Queries that need more than the index still evaluate.
+nix-env --option package-index true -f "$dir" -qa --out-path | grepQuiet "foo-1.1 *$NIX_STORE_DIR/"
@@ -157,6 +157,23 @@ echo "changingThing"
 echo "$replResult" | grepQuiet -s beforeChange
 echo "$replResult" | grepQuiet -s afterChange
 
+# Same for `:load`ed files. Files that haven't changed aren't parsed
+# again, but changed ones are.
+mkdir -p reload
+echo '{ a = import ./a.nix; b = import ./b.nix; }' > reload/default.nix
+echo '"a-before"' > reload/a.nix
+echo '"b-unchanged"' > reload/b.nix
+replResult=$( (
+echo ":load reload"
+echo "a + b"
+sleep 1
+echo '"a-after"' > reload/a.nix
+echo ":reload"
+echo "a + b"
+) | nix repl)
+echo "$replResult" | grepQuiet -s a-beforeb-unchanged
+echo "$replResult" | grepQuiet -s a-afterb-unchanged
+
 # Test recursive printing and formatting
 # Normal output should print attributes in lexicographical order non-recursively
 testReplResponseNoRegex '
@@ -27,3 +27,8 @@ echo "$PRECISE_WHY_DEPENDS_OUTPUT" | grepQuiet reference-to-input-2
 <<<"$PRECISE_WHY_DEPENDS_OUTPUT" sed -n '3p' | grep "    →" | grepQuiet "dependencies-input-2"
 <<<"$PRECISE_WHY_DEPENDS_OUTPUT" sed -n '4p' | grepQuiet "    └───input0: …"                          # in input-2, file input0
 <<<"$PRECISE_WHY_DEPENDS_OUTPUT" sed -n '5p' | grep "        →" | grepQuiet "dependencies-input-0"    # is dependencies-input-0 referenced
+
+# `--all --precise` scans all paths up front, but must print the same edges.
+ALL_PRECISE_WHY_DEPENDS_OUTPUT=$(nix why-depends ./toplevel ./dep --all --precise)
+echo "$ALL_PRECISE_WHY_DEPENDS_OUTPUT" | grepQuiet "reference-to-input-2 -> "
+echo "$ALL_PRECISE_WHY_DEPENDS_OUTPUT" | grepQuiet "input0: …"
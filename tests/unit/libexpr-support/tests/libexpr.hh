@@ -70,43 +70,43 @@ namespace nix {
         if (arg.type() != nString) {
             return false;
         }
-        return std::string_view(arg.string.s) == std::string_view(s);
+        return std::string_view(arg.c_str()) == std::string_view(s);
     }
 
     MATCHER_P(IsIntEq, v, fmt("The string is equal to \"%1%\"", v)) {
         if (arg.type() != nInt) {
             return false;
         }
-        return arg.integer.value == v;
+        return arg.integer().value == v;
     }
 
     MATCHER_P(IsFloatEq, v, fmt("The float is equal to \"%1%\"", v)) {
         if (arg.type() != nFloat) {
             return false;
         }
-        return arg.fpoint == v;
+        return arg.fpoint() == v;
     }
 
     MATCHER(IsTrue, "") {
         if (arg.type() != nBool) {
             return false;
         }
-        return arg.boolean == true;
+        return arg.boolean() == true;
     }
 
     MATCHER(IsFalse, "") {
         if (arg.type() != nBool) {
             return false;
         }
-        return arg.boolean == false;
+        return arg.boolean() == false;
     }
 
     MATCHER_P(IsPathEq, p, fmt("Is a path equal to \"%1%\"", p)) {
             if (arg.type() != nPath) {
                 *result_listener << "Expected a path got " << arg.type();
                 return false;
-            } else if (std::string_view(arg._path) != p) {
-                *result_listener << "Expected a path that equals \"" << p << "\" but got: " << arg.string.s;
+            } else if (std::string_view(arg.pathStr()) != p) {
+                *result_listener << "Expected a path that equals \"" << p << "\" but got: " << arg.pathStr();
                 return false;
             }
             return true;
@@ -128,8 +128,8 @@ namespace nix {
         if (arg.type() != nAttrs) {
             *result_listener << "Expected set got " << arg.type();
             return false;
-        } else if (arg.attrs->size() != (size_t)n) {
-            *result_listener << "Expected a set with " << n << " attributes but got " << arg.attrs->size();
+        } else if (arg.attrs()->size() != (size_t)n) {
+            *result_listener << "Expected a set with " << n << " attributes but got " << arg.attrs()->size();
             return false;
         }
         return true;
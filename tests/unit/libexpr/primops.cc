@@ -71,7 +71,7 @@ namespace nix {
         auto v = eval("builtins.tryEval (throw \"\")");
         ASSERT_THAT(v, IsAttrsOfSize(2));
         auto s = createSymbol("success");
-        auto p = v.attrs->get(s);
+        auto p = v.attrs()->get(s);
         ASSERT_NE(p, nullptr);
         ASSERT_THAT(*p->value, IsFalse());
     }
@@ -80,11 +80,11 @@ namespace nix {
         auto v = eval("builtins.tryEval 123");
         ASSERT_THAT(v, IsAttrs());
         auto s = createSymbol("success");
-        auto p = v.attrs->get(s);
+        auto p = v.attrs()->get(s);
         ASSERT_NE(p, nullptr);
         ASSERT_THAT(*p->value, IsTrue());
         s = createSymbol("value");
-        p = v.attrs->get(s);
+        p = v.attrs()->get(s);
         ASSERT_NE(p, nullptr);
         ASSERT_THAT(*p->value, IsIntEq(123));
     }
@@ -184,14 +184,14 @@ namespace nix {
     TEST_F(PrimOpTest, removeAttrsRetains) {
         auto v = eval("builtins.removeAttrs { x = 1; y = 2; } [\"x\"]");
         ASSERT_THAT(v, IsAttrsOfSize(1));
-        ASSERT_NE(v.attrs->find(createSymbol("y")), nullptr);
+        ASSERT_NE(v.attrs()->find(createSymbol("y")), nullptr);
     }
 
     TEST_F(PrimOpTest, listToAttrsEmptyList) {
         auto v = eval("builtins.listToAttrs []");
         ASSERT_THAT(v, IsAttrsOfSize(0));
         ASSERT_EQ(v.type(), nAttrs);
-        ASSERT_EQ(v.attrs->size(), 0);
+        ASSERT_EQ(v.attrs()->size(), 0);
     }
 
     TEST_F(PrimOpTest, listToAttrsNotFieldName) {
@@ -201,7 +201,7 @@ namespace nix {
     TEST_F(PrimOpTest, listToAttrs) {
         auto v = eval("builtins.listToAttrs [ { name = \"key\"; value = 123; } ]");
         ASSERT_THAT(v, IsAttrsOfSize(1));
-        auto key = v.attrs->find(createSymbol("key"));
+        auto key = v.attrs()->find(createSymbol("key"));
         ASSERT_NE(key, nullptr);
         ASSERT_THAT(*key->value, IsIntEq(123));
     }
@@ -209,7 +209,7 @@ namespace nix {
     TEST_F(PrimOpTest, intersectAttrs) {
         auto v = eval("builtins.intersectAttrs { a = 1; b = 2; } { b = 3; c = 4; }");
         ASSERT_THAT(v, IsAttrsOfSize(1));
-        auto b = v.attrs->find(createSymbol("b"));
+        auto b = v.attrs()->find(createSymbol("b"));
         ASSERT_NE(b, nullptr);
         ASSERT_THAT(*b->value, IsIntEq(3));
     }
@@ -225,26 +225,42 @@ namespace nix {
         auto v = eval("builtins.functionArgs ({ x, y ? 123}: 1)");
         ASSERT_THAT(v, IsAttrsOfSize(2));
 
-        auto x = v.attrs->find(createSymbol("x"));
+        auto x = v.attrs()->find(createSymbol("x"));
         ASSERT_NE(x, nullptr);
         ASSERT_THAT(*x->value, IsFalse());
 
-        auto y = v.attrs->find(createSymbol("y"));
+        auto y = v.attrs()->find(createSymbol("y"));
         ASSERT_NE(y, nullptr);
         ASSERT_THAT(*y->value, IsTrue());
     }
 
+    TEST_F(PrimOpTest, functionArgsSharesBooleans) {
+        auto v = eval("builtins.functionArgs ({ x, y, z ? 123 }: 1)");
+        ASSERT_EQ(v.attrs()->find(createSymbol("x"))->value, &state.vFalse);
+        ASSERT_EQ(v.attrs()->find(createSymbol("y"))->value, &state.vFalse);
+        ASSERT_EQ(v.attrs()->find(createSymbol("z"))->value, &state.vTrue);
+    }
+
+    TEST_F(PrimOpTest, fromJSONSharesConstants) {
+        auto v = eval(R"(builtins.fromJSON "[null, true, false, {\"a\": null}]")");
+        ASSERT_THAT(v, IsListOfSize(4));
+        ASSERT_EQ(v.listElems()[0], &state.vNull);
+        ASSERT_EQ(v.listElems()[1], &state.vTrue);
+        ASSERT_EQ(v.listElems()[2], &state.vFalse);
+        ASSERT_EQ(v.listElems()[3]->attrs()->find(createSymbol("a"))->value, &state.vNull);
+    }
+
     TEST_F(PrimOpTest, mapAttrs) {
         auto v = eval("builtins.mapAttrs (name: value: value * 10) { a = 1; b = 2; }");
         ASSERT_THAT(v, IsAttrsOfSize(2));
 
-        auto a = v.attrs->find(createSymbol("a"));
+        auto a = v.attrs()->find(createSymbol("a"));
         ASSERT_NE(a, nullptr);
         ASSERT_THAT(*a->value, IsThunk());
         state.forceValue(*a->value, noPos);
         ASSERT_THAT(*a->value, IsIntEq(10));
 
-        auto b = v.attrs->find(createSymbol("b"));
+        auto b = v.attrs()->find(createSymbol("b"));
         ASSERT_NE(b, nullptr);
         ASSERT_THAT(*b->value, IsThunk());
         state.forceValue(*b->value, noPos);
@@ -392,13 +408,13 @@ namespace nix {
         auto v = eval("builtins.partition (x: x > 10) [1 23 9 3 42]");
         ASSERT_THAT(v, IsAttrsOfSize(2));
 
-        auto right = v.attrs->get(createSymbol("right"));
+        auto right = v.attrs()->get(createSymbol("right"));
         ASSERT_NE(right, nullptr);
         ASSERT_THAT(*right->value, IsListOfSize(2));
         ASSERT_THAT(*right->value->listElems()[0], IsIntEq(23));
         ASSERT_THAT(*right->value->listElems()[1], IsIntEq(42));
 
-        auto wrong = v.attrs->get(createSymbol("wrong"));
+        auto wrong = v.attrs()->get(createSymbol("wrong"));
         ASSERT_NE(wrong, nullptr);
         ASSERT_EQ(wrong->value->type(), nList);
         ASSERT_EQ(wrong->value->listSize(), 3);
@@ -623,14 +639,14 @@ namespace nix {
         auto v = eval("derivation");
         ASSERT_EQ(v.type(), nFunction);
         ASSERT_TRUE(v.isLambda());
-        ASSERT_NE(v.lambda.fun, nullptr);
-        ASSERT_TRUE(v.lambda.fun->hasFormals());
+        ASSERT_NE(v.lambda().fun, nullptr);
+        ASSERT_TRUE(v.lambda().fun->hasFormals());
     }
 
     TEST_F(PrimOpTest, currentTime) {
         auto v = eval("builtins.currentTime");
         ASSERT_EQ(v.type(), nInt);
-        ASSERT_TRUE(v.integer > 0);
+        ASSERT_TRUE(v.integer() > 0);
     }
 
     TEST_F(PrimOpTest, splitVersion) {
@@ -691,11 +707,11 @@ namespace nix {
         auto v = eval(expr);
         ASSERT_THAT(v, IsAttrsOfSize(2));
 
-        auto name = v.attrs->find(createSymbol("name"));
+        auto name = v.attrs()->find(createSymbol("name"));
         ASSERT_TRUE(name);
         ASSERT_THAT(*name->value, IsStringEq(expectedName));
 
-        auto version = v.attrs->find(createSymbol("version"));
+        auto version = v.attrs()->find(createSymbol("version"));
         ASSERT_TRUE(version);
         ASSERT_THAT(*version->value, IsStringEq(expectedVersion));
     }
@@ -713,14 +729,14 @@ namespace nix {
         // FIXME: add a test that verifies the string context is as expected
         auto v = eval("builtins.replaceStrings [\"oo\" \"a\"] [\"a\" \"i\"] \"foobar\"");
         ASSERT_EQ(v.type(), nString);
-        ASSERT_EQ(v.string.s, std::string_view("fabir"));
+        ASSERT_EQ(v.c_str(), std::string_view("fabir"));
     }
 
     TEST_F(PrimOpTest, concatStringsSep) {
         // FIXME: add a test that verifies the string context is as expected
         auto v = eval("builtins.concatStringsSep \"%\" [\"foo\" \"bar\" \"baz\"]");
         ASSERT_EQ(v.type(), nString);
-        ASSERT_EQ(std::string_view(v.string.s), "foo%bar%baz");
+        ASSERT_EQ(std::string_view(v.c_str()), "foo%bar%baz");
     }
 
     TEST_F(PrimOpTest, split1) {
@@ -80,10 +80,9 @@ TEST_F(ValuePrintingTests, tList)
     vTwo.mkInt(2);
 
     Value vList;
-    state.mkList(vList, 5);
-    vList.bigList.elems[0] = &vOne;
-    vList.bigList.elems[1] = &vTwo;
-    vList.bigList.size = 3;
+    state.mkList(vList, 3);
+    vList.listElems()[0] = &vOne;
+    vList.listElems()[1] = &vTwo;
 
     test(vList, "[ 1 2 «nullptr» ]");
 }
@@ -258,11 +257,10 @@ TEST_F(ValuePrintingTests, depthList)
     vNested.mkAttrs(builder2.finish());
 
     Value vList;
-    state.mkList(vList, 5);
-    vList.bigList.elems[0] = &vOne;
-    vList.bigList.elems[1] = &vTwo;
-    vList.bigList.elems[2] = &vNested;
-    vList.bigList.size = 3;
+    state.mkList(vList, 3);
+    vList.listElems()[0] = &vOne;
+    vList.listElems()[1] = &vTwo;
+    vList.listElems()[2] = &vNested;
 
     test(vList, "[ 1 2 { ... } ]", PrintOptions { .maxDepth = 1 });
     test(vList, "[ 1 2 { nested = { ... }; one = 1; two = 2; } ]", PrintOptions { .maxDepth = 2 });
@@ -547,10 +545,9 @@ TEST_F(ValuePrintingTests, ansiColorsList)
     vTwo.mkInt(2);
 
     Value vList;
-    state.mkList(vList, 5);
-    vList.bigList.elems[0] = &vOne;
-    vList.bigList.elems[1] = &vTwo;
-    vList.bigList.size = 3;
+    state.mkList(vList, 3);
+    vList.listElems()[0] = &vOne;
+    vList.listElems()[1] = &vTwo;
 
     test(vList,
          "[ " ANSI_CYAN "1" ANSI_NORMAL " " ANSI_CYAN "2" ANSI_NORMAL " " ANSI_MAGENTA "«nullptr»" ANSI_NORMAL " ]",
@@ -685,10 +682,9 @@ TEST_F(ValuePrintingTests, ansiColorsListRepeated)
     vInner.mkAttrs(innerBuilder.finish());
 
     Value vList;
-    state.mkList(vList, 3);
-    vList.bigList.elems[0] = &vInner;
-    vList.bigList.elems[1] = &vInner;
-    vList.bigList.size = 2;
+    state.mkList(vList, 2);
+    vList.listElems()[0] = &vInner;
+    vList.listElems()[1] = &vInner;
 
     test(vList,
          "[ { x = " ANSI_CYAN "0" ANSI_NORMAL "; } " ANSI_MAGENTA "«repeated»" ANSI_NORMAL " ]",
@@ -709,10 +705,9 @@ TEST_F(ValuePrintingTests, listRepeated)
     vInner.mkAttrs(innerBuilder.finish());
 
     Value vList;
-    state.mkList(vList, 3);
-    vList.bigList.elems[0] = &vInner;
-    vList.bigList.elems[1] = &vInner;
-    vList.bigList.size = 2;
+    state.mkList(vList, 2);
+    vList.listElems()[0] = &vInner;
+    vList.listElems()[1] = &vInner;
 
     test(vList, "[ { x = 0; } «repeated» ]", PrintOptions { });
     test(vList,
@@ -769,10 +764,9 @@ TEST_F(ValuePrintingTests, ansiColorsListElided)
     vTwo.mkInt(2);
 
     Value vList;
-    state.mkList(vList, 4);
-    vList.bigList.elems[0] = &vOne;
-    vList.bigList.elems[1] = &vTwo;
-    vList.bigList.size = 2;
+    state.mkList(vList, 2);
+    vList.listElems()[0] = &vOne;
+    vList.listElems()[1] = &vTwo;
 
     test(vList,
          "[ " ANSI_CYAN "1" ANSI_NORMAL " " ANSI_FAINT "«1 item elided»" ANSI_NORMAL " ]",
@@ -784,8 +778,10 @@ TEST_F(ValuePrintingTests, ansiColorsListElided)
     Value vThree;
     vThree.mkInt(3);
 
-    vList.bigList.elems[2] = &vThree;
-    vList.bigList.size = 3;
+    state.mkList(vList, 3);
+    vList.listElems()[0] = &vOne;
+    vList.listElems()[1] = &vTwo;
+    vList.listElems()[2] = &vThree;
 
     test(vList,
          "[ " ANSI_CYAN "1" ANSI_NORMAL " " ANSI_FAINT "«2 items elided»" ANSI_NORMAL " ]",
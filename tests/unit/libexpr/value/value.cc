@@ -0,0 +1,140 @@
+#include "tests/libexpr.hh"
+
+#include "value.hh"
+
+namespace nix {
+
+using namespace testing;
+
+struct ValueTest : LibExprTest
+{ };
+
+TEST_F(ValueTest, isTwoWords)
+{
+    ASSERT_EQ(sizeof(Value), 2 * sizeof(uintptr_t));
+}
+
+TEST_F(ValueTest, scalars)
+{
+    Value v;
+
+    v.mkInt(-42);
+    ASSERT_EQ(v.type(), nInt);
+    ASSERT_EQ(v.integer().value, -42);
+
+    v.mkInt(std::numeric_limits<NixInt::Inner>::min());
+    ASSERT_EQ(v.integer().value, std::numeric_limits<NixInt::Inner>::min());
+
+    v.mkFloat(-0.5);
+    ASSERT_EQ(v.type(), nFloat);
+    ASSERT_EQ(v.fpoint(), -0.5);
+
+    v.mkBool(true);
+    ASSERT_EQ(v.type(), nBool);
+    ASSERT_TRUE(v.boolean());
+
+    v.mkNull();
+    ASSERT_EQ(v.type(), nNull);
+}
+
+TEST_F(ValueTest, shortStringsAreInline)
+{
+    Value v;
+    v.mkString(std::string_view("fourteen chars"));
+    ASSERT_EQ(v.type(), nString);
+    ASSERT_EQ(v.str(), "fourteen chars");
+    ASSERT_EQ(v.context(), nullptr);
+    ASSERT_GE(v.c_str(), reinterpret_cast<const char *>(&v));
+    ASSERT_LT(v.c_str(), reinterpret_cast<const char *>(&v + 1));
+
+    Value copy = v;
+    ASSERT_EQ(copy.str(), "fourteen chars");
+
+    v.mkString(std::string_view(""));
+    ASSERT_EQ(v.str(), "");
+
+    /* Making a value from its own characters must work. */
+    copy.mkString(copy.str().substr(4));
+    ASSERT_EQ(copy.str(), "teen chars");
+}
+
+TEST_F(ValueTest, longStringsAndContext)
+{
+    Value v;
+    v.mkString(std::string_view("fifteen chars!!"));
+    ASSERT_EQ(v.str(), "fifteen chars!!");
+    ASSERT_FALSE(v.c_str() >= reinterpret_cast<const char *>(&v)
+        && v.c_str() < reinterpret_cast<const char *>(&v + 1));
+
+    auto path = "/nix/store/g1w7hy3qg1w7hy3qg1w7hy3qg1w7hy3q-foo";
+    v.mkString("short", NixStringContext{NixStringContextElem::parse(path)});
+    ASSERT_EQ(v.str(), "short");
+    ASSERT_NE(v.context(), nullptr);
+    ASSERT_EQ(std::string_view(v.context()[0]), path);
+    ASSERT_EQ(v.context()[1], nullptr);
+}
+
+TEST_F(ValueTest, lists)
+{
+    Value a, b;
+    a.mkInt(1);
+    b.mkInt(2);
+
+    Value v;
+    state.mkList(v, 0);
+    ASSERT_EQ(v.type(), nList);
+    ASSERT_EQ(v.listSize(), 0);
+
+    state.mkList(v, 1);
+    v.listElems()[0] = &a;
+    ASSERT_EQ(v.listSize(), 1);
+    ASSERT_EQ(v.listElems()[0], &a);
+
+    state.mkList(v, 3);
+    v.listElems()[0] = &a;
+    v.listElems()[1] = &b;
+    v.listElems()[2] = &a;
+
+    Value slice;
+    slice.mkListSlice(v, 1, 2);
+    ASSERT_EQ(slice.listSize(), 2);
+    ASSERT_EQ(slice.listElems(), v.listElems() + 1);
+
+    slice.mkListSlice(v, 1, 1);
+    ASSERT_EQ(slice.listSize(), 1);
+    ASSERT_EQ(slice.listElems()[0], &b);
+}
+
+TEST_F(ValueTest, pairsOfPointers)
+{
+    Value a, b;
+    a.mkInt(1);
+    b.mkInt(2);
+
+    Value v;
+    v.mkApp(&a, &b);
+    ASSERT_TRUE(v.isApp());
+    ASSERT_FALSE(v.isThunk());
+    ASSERT_EQ(v.type(), nThunk);
+    ASSERT_EQ(v.app().left, &a);
+    ASSERT_EQ(v.app().right, &b);
+
+    v.mkPrimOpApp(&b, &a);
+    ASSERT_TRUE(v.isPrimOpApp());
+    ASSERT_EQ(v.type(), nFunction);
+    ASSERT_EQ(v.primOpApp().left, &b);
+    ASSERT_EQ(v.primOpApp().right, &a);
+
+    ExprInt e(0);
+    v.mkThunk(nullptr, e);
+    ASSERT_TRUE(v.isThunk());
+    ASSERT_FALSE(v.isBlackhole());
+    ASSERT_EQ(v.thunk().env, nullptr);
+    ASSERT_EQ(v.thunk().expr, &e);
+
+    v.mkBlackhole();
+    ASSERT_TRUE(v.isThunk());
+    ASSERT_TRUE(v.isBlackhole());
+}
+
+}
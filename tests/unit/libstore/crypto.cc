@@ -0,0 +1,90 @@
+#include "crypto.hh"
+#include "path-info.hh"
+#include "tests/libstore.hh"
+
+#include <gtest/gtest.h>
+
+namespace nix {
+
+class SignatureTest : public LibStoreTest
+{
+protected:
+    SecretKey key = SecretKey::generate("cache-1");
+    SecretKey otherKey = SecretKey::generate("cache-2");
+    PublicKeys publicKeys{{key.name, key.toPublicKey()}};
+};
+
+TEST_F(SignatureTest, verifyDetachedBatch)
+{
+    std::string data = "some data";
+    auto good = key.signDetached(data);
+    auto wrongKey = otherKey.signDetached(data);
+
+    auto valid = verifyDetachedBatch({
+        {data, good},
+        {"other data", good},
+        {data, wrongKey},
+        {data, "cache-1:not base64!"},
+        {data, "no colon"},
+    }, publicKeys);
+
+    ASSERT_EQ(valid, (std::vector<bool>{true, false, false, false, false}));
+
+    /* A second check, answered from the cache of verified signatures,
+       agrees with the first. */
+    ASSERT_TRUE(verifyDetached(data, good, publicKeys));
+    ASSERT_FALSE(verifyDetached(data, wrongKey, publicKeys));
+}
+
+TEST_F(SignatureTest, verifyDetachedBatchInChunks)
+{
+    /* Enough signatures to be spread over the thread pool. */
+    std::vector<std::string> data;
+    for (size_t i = 0; i < 300; ++i)
+        data.push_back(fmt("data %d", i));
+    std::vector<std::string> sigs;
+    for (size_t i = 0; i < data.size(); ++i)
+        sigs.push_back((i % 3 ? key : otherKey).signDetached(data[i]));
+
+    std::vector<std::pair<std::string_view, std::string_view>> pairs;
+    for (size_t i = 0; i < data.size(); ++i)
+        pairs.emplace_back(data[i], sigs[i]);
+
+    auto valid = verifyDetachedBatch(pairs, publicKeys);
+    ASSERT_EQ(valid.size(), data.size());
+    for (size_t i = 0; i < data.size(); ++i)
+        ASSERT_EQ(valid[i], i % 3 != 0) << "signature " << i;
+}
+
+TEST_F(SignatureTest, findTrustedPaths)
+{
+    auto narHash = hashString(HashType::SHA256, "nar");
+
+    ValidPathInfo signedPath{StorePath{"g1w7hy3qg1w7hy3qg1w7hy3qg1w7hy3q-signed"}, narHash};
+    signedPath.narSize = 100;
+    signedPath.sign(*store, key);
+
+    ValidPathInfo wronglySigned{StorePath{"h1w7hy3qg1w7hy3qg1w7hy3qg1w7hy3q-wrongly-signed"}, narHash};
+    wronglySigned.narSize = 100;
+    wronglySigned.sign(*store, otherKey);
+
+    ValidPathInfo unsignedPath{StorePath{"i1w7hy3qg1w7hy3qg1w7hy3qg1w7hy3q-unsigned"}, narHash};
+    unsignedPath.narSize = 100;
+
+    ValidPathInfo contentAddressed{*store, "content-addressed",
+        TextInfo{.hash = hashString(HashType::SHA256, "contents"), .references = {}}, narHash};
+    contentAddressed.narSize = 100;
+
+    /* Without a NAR size there is no fingerprint to check the signature
+       against, so the path must be checked again when it is added. */
+    ValidPathInfo noFingerprint{StorePath{"j1w7hy3qg1w7hy3qg1w7hy3qg1w7hy3q-no-size"}, narHash};
+    noFingerprint.sigs.insert(*signedPath.sigs.begin());
+
+    auto trusted = findTrustedPaths(*store,
+        {&signedPath, &wronglySigned, &unsignedPath, &contentAddressed, &noFingerprint},
+        publicKeys);
+
+    ASSERT_EQ(trusted, (StorePathSet{signedPath.path, contentAddressed.path}));
+}
+
+}
@@ -0,0 +1,112 @@
+#include "metadata-snapshot.hh"
+#include "file-system.hh"
+
+#include <gtest/gtest.h>
+
+namespace nix {
+
+static StorePath path(char c, std::string_view name)
+{
+    return StorePath(std::string(StorePath::HashLen, c) + "-" + std::string(name));
+}
+
+/**
+ * c -> b -> a, and c -> a.
+ */
+static MetadataSnapshot::Columns makeColumns()
+{
+    MetadataSnapshot::Columns columns;
+    columns.addPath(path('a', "a"), 1);
+    columns.addPath(path('b', "b"), 2);
+    columns.addRef(0);
+    columns.addPath(path('c', "c"), 3);
+    columns.addRef(0);
+    columns.addRef(1);
+    return columns;
+}
+
+TEST(MetadataSnapshot, writeAndOpen)
+{
+    Path tmpDir = createTempDir();
+    AutoDelete delTmpDir(tmpDir);
+    auto file = tmpDir + "/snapshot";
+
+    EXPECT_EQ(MetadataSnapshot::open(file), nullptr);
+
+    MetadataSnapshot::write(file, 42, makeColumns());
+    auto snapshot = MetadataSnapshot::open(file);
+    ASSERT_NE(snapshot, nullptr);
+    EXPECT_TRUE(snapshot->isCurrent(file));
+    EXPECT_EQ(snapshot->seq(), 42);
+    EXPECT_EQ(snapshot->size(), 3);
+    EXPECT_EQ(snapshot->paths(), (StorePathSet{path('a', "a"), path('b', "b"), path('c', "c")}));
+    EXPECT_EQ(snapshot->find(path('b', "b")), 1);
+    EXPECT_EQ(snapshot->find(path('b', "x")), std::nullopt);
+    EXPECT_EQ(snapshot->narSize(2), 3);
+    EXPECT_EQ(std::vector(snapshot->referrers(0).begin(), snapshot->referrers(0).end()), (std::vector<uint32_t>{1, 2}));
+
+    uint32_t c = 2, a = 0;
+    auto closure = snapshot->closure({&c, 1}, false);
+    std::sort(closure.begin(), closure.end());
+    EXPECT_EQ(closure, (std::vector<uint32_t>{0, 1, 2}));
+    closure = snapshot->closure({&a, 1}, true);
+    std::sort(closure.begin(), closure.end());
+    EXPECT_EQ(closure, (std::vector<uint32_t>{0, 1, 2}));
+
+    MetadataSnapshot::write(file, 43, makeColumns());
+    EXPECT_FALSE(snapshot->isCurrent(file));
+}
+
+TEST(MetadataSnapshot, rejectsCorruptFiles)
+{
+    Path tmpDir = createTempDir();
+    AutoDelete delTmpDir(tmpDir);
+    auto file = tmpDir + "/snapshot";
+
+    MetadataSnapshot::write(file, 1, makeColumns());
+    auto contents = readFile(file);
+
+    writeFile(file, contents.substr(0, contents.size() - 8));
+    EXPECT_EQ(MetadataSnapshot::open(file), nullptr);
+
+    writeFile(file, "garbage");
+    EXPECT_EQ(MetadataSnapshot::open(file), nullptr);
+}
+
+TEST(MetadataSnapshot, merge)
+{
+    Path tmpDir = createTempDir();
+    AutoDelete delTmpDir(tmpDir);
+    auto file = tmpDir + "/snapshot";
+
+    MetadataSnapshot::write(file, 1, makeColumns());
+    auto snapshot = MetadataSnapshot::open(file);
+    ASSERT_NE(snapshot, nullptr);
+
+    /* Invalidate c, add d -> b and 0 -> a, and resize b. */
+    MetadataSnapshot::Changes changes;
+    changes.emplace(path('c', "c"), std::nullopt);
+    changes.emplace(path('d', "d"), MetadataSnapshot::Change{.narSize = 4, .references = {path('b', "b")}});
+    changes.emplace(path('0', "0"), MetadataSnapshot::Change{.narSize = 5, .references = {path('a', "a")}});
+    changes.emplace(path('b', "b"), MetadataSnapshot::Change{.narSize = 6, .references = {path('a', "a")}});
+
+    MetadataSnapshot::write(file, 2, snapshot->merge(changes));
+    snapshot = MetadataSnapshot::open(file);
+    ASSERT_NE(snapshot, nullptr);
+
+    EXPECT_EQ(snapshot->paths(), (StorePathSet{path('0', "0"), path('a', "a"), path('b', "b"), path('d', "d")}));
+    auto b = *snapshot->find(path('b', "b"));
+    auto d = *snapshot->find(path('d', "d"));
+    EXPECT_EQ(snapshot->narSize(b), 6);
+    EXPECT_EQ(snapshot->narSize(d), 4);
+
+    auto closure = snapshot->closure({&d, 1}, false);
+    std::sort(closure.begin(), closure.end());
+    EXPECT_EQ(closure, (std::vector<uint32_t>{*snapshot->find(path('a', "a")), b, d}));
+
+    auto a = *snapshot->find(path('a', "a"));
+    closure = snapshot->closure({&a, 1}, true);
+    EXPECT_EQ(closure.size(), 4);
+}
+
+}
@@ -120,4 +120,24 @@ TEST(NarInfoDiskCacheImpl, create_and_read) {
     }
 }
 
+TEST(NarInfoDiskCacheImpl, upsertMissingNarInfos) {
+    Path tmpDir = createTempDir();
+    AutoDelete delTmpDir(tmpDir);
+
+    auto cache = getTestNarInfoDiskCache(tmpDir + "/test-narinfo-disk-cache.sqlite");
+    cache->createCache("s3://foo", "/nix/storedir", false, 40);
+
+    std::set<std::string> missing{
+        "00000000000000000000000000000000",
+        "11111111111111111111111111111111",
+    };
+    cache->upsertMissingNarInfos("s3://foo", missing);
+
+    for (auto & hashPart : missing)
+        ASSERT_EQ(cache->lookupNarInfo("s3://foo", hashPart).first, NarInfoDiskCache::oInvalid);
+    ASSERT_EQ(
+        cache->lookupNarInfo("s3://foo", "22222222222222222222222222222222").first,
+        NarInfoDiskCache::oUnknown);
+}
+
 }
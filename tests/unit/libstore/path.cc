@@ -76,6 +76,59 @@ TEST_DO_PARSE(triple_dot, "...")
 
 #undef TEST_DO_PARSE
 
+TEST_F(StorePathTest, copy_and_move) {
+    // Short base names are stored inline, long ones on the heap.
+    for (auto name : {std::string("foo"), std::string(200, 'a')}) {
+        auto p = store->parseStorePath(STORE_DIR HASH_PART "-" + name);
+        auto copy = p;
+        EXPECT_EQ(copy, p);
+        EXPECT_EQ(copy.name(), name);
+
+        auto moved = std::move(copy);
+        EXPECT_EQ(moved, p);
+
+        auto other = StorePath::dummy;
+        other = moved;
+        EXPECT_EQ(other.to_string(), p.to_string());
+        other = std::move(moved);
+        EXPECT_EQ(other.hashPart(), HASH_PART);
+    }
+}
+
+TEST_F(StorePathTest, hash_set) {
+    auto p = store->parseStorePath(STORE_DIR HASH_PART "-foo");
+    auto q = store->parseStorePath(STORE_DIR HASH_PART "-bar");
+    StorePathHashSet paths { p, q, p };
+    EXPECT_EQ(paths.size(), 2);
+    EXPECT_EQ(paths.count(store->parseStorePath(STORE_DIR HASH_PART "-foo")), 1);
+    EXPECT_EQ(paths.count(StorePath::dummy), 0);
+}
+
+TEST_F(StorePathTest, decoded_hash) {
+    auto p = store->parseStorePath(STORE_DIR HASH_PART "-foo");
+    EXPECT_EQ(p.to_string(), HASH_PART "-foo");
+    EXPECT_EQ(StorePath(Hash::parseNonSRIUnprefixed(HASH_PART, HashType::SHA1), "foo"), p);
+}
+
+TEST_F(StorePathTest, order_matches_base_name) {
+    std::set<std::string> baseNames {
+        "00000000000000000000000000000000-b",
+        "00000000000000000000000000000001-a",
+        "10000000000000000000000000000000-a",
+        "zzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzz-a",
+        "zzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzz-a" + std::string(100, 'a'),
+        HASH_PART "-foo",
+        HASH_PART "-foo-bar",
+    };
+    StorePathSet paths;
+    for (auto & baseName : baseNames)
+        paths.insert(StorePath(baseName));
+    std::vector<std::string> sorted;
+    for (auto & path : paths)
+        sorted.push_back(path.to_string());
+    EXPECT_EQ(sorted, std::vector<std::string>(baseNames.begin(), baseNames.end()));
+}
+
 #ifndef COVERAGE
 
 RC_GTEST_FIXTURE_PROP(
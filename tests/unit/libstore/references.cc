@@ -42,4 +42,19 @@ TEST(references, scan)
     }
 }
 
+TEST(references, findFirstOccurrences)
+{
+    std::string hash1 = "dc04vv14dak1c1r48qa0m23vr9jy8sm0";
+    std::string hash2 = "zc842j0rz61mjsp3h3wp5ly71ak6qgdn";
+    std::string hash3 = "0000000000000000000000000000000z";
+
+    auto s = "foo/" + hash2 + "-bar " + hash1 + hash2 + " baz";
+
+    ASSERT_EQ(
+        findFirstOccurrences(s, StringSet{hash1, hash2, hash3}),
+        (std::map<std::string, size_t>{{hash1, 41}, {hash2, 4}}));
+
+    ASSERT_EQ(findFirstOccurrences("foobar", StringSet{hash1}), (std::map<std::string, size_t>{}));
+}
+
 }
@@ -0,0 +1,103 @@
+#include "store-api.hh"
+#include "tests/libstore.hh"
+
+#include <gtest/gtest.h>
+
+namespace nix {
+
+struct OnePathStoreConfig : virtual StoreConfig
+{
+    using StoreConfig::StoreConfig;
+
+    const std::string name() override { return "One Path Store"; }
+
+    std::string doc() override { return ""; }
+};
+
+/**
+ * A store that only contains `path`, and counts the queries that miss
+ * the path info cache.
+ */
+struct OnePathStore : virtual OnePathStoreConfig, virtual Store
+{
+    StorePath path;
+    size_t uncachedQueries = 0;
+
+    OnePathStore(StorePath path)
+        : StoreConfig(Params{})
+        , OnePathStoreConfig(Params{})
+        , Store(Params{})
+        , path(std::move(path))
+    { }
+
+    std::string getUri() override { return "one-path://"; }
+
+    std::shared_ptr<const ValidPathInfo> queryPathInfoUncached(const StorePath & query) override
+    {
+        uncachedQueries++;
+        if (query != path) return nullptr;
+        auto info = std::make_shared<ValidPathInfo>(path, Hash::dummy);
+        info->narSize = 1;
+        return info;
+    }
+
+    std::optional<TrustedFlag> isTrustedClient() override { return Trusted; }
+
+    std::optional<StorePath> queryPathFromHashPart(const std::string & hashPart) override
+    { unsupported("queryPathFromHashPart"); }
+
+    void addToStore(const ValidPathInfo & info, Source & source,
+        RepairFlag repair, CheckSigsFlag checkSigs) override
+    { unsupported("addToStore"); }
+
+    StorePath addTextToStore(
+        std::string_view name,
+        std::string_view s,
+        const StorePathSet & references,
+        RepairFlag repair) override
+    { unsupported("addTextToStore"); }
+
+    WireFormatGenerator narFromPath(const StorePath & path) override
+    { unsupported("narFromPath"); }
+
+    std::shared_ptr<const Realisation> queryRealisationUncached(const DrvOutput &) override
+    { return nullptr; }
+
+    ref<FSAccessor> getFSAccessor() override
+    { unsupported("getFSAccessor"); }
+};
+
+class PathInfoCacheTest : public LibStoreTest
+{
+protected:
+    StorePath real{"g1w7hy3qg1w7hy3qg1w7hy3qg1w7hy3q-real"};
+    StorePath wrong{"g1w7hy3qg1w7hy3qg1w7hy3qg1w7hy3q-wrong"};
+};
+
+TEST_F(PathInfoCacheTest, cachesPositiveAndNegativeEntries)
+{
+    OnePathStore store(real);
+
+    ASSERT_TRUE(store.isValidPath(real));
+    ASSERT_TRUE(store.isValidPath(real));
+    ASSERT_EQ(store.uncachedQueries, 1);
+
+    ASSERT_FALSE(store.isValidPath(wrong));
+    ASSERT_FALSE(store.isValidPath(wrong));
+    ASSERT_EQ(store.uncachedQueries, 2);
+}
+
+TEST_F(PathInfoCacheTest, negativeEntryDoesNotHideOtherName)
+{
+    OnePathStore store(real);
+
+    ASSERT_TRUE(store.isValidPath(real));
+    ASSERT_FALSE(store.isValidPath(wrong));
+
+    /* The negative entry for `wrong` replaced the positive one for
+       `real`, but must not answer queries for `real`. */
+    ASSERT_TRUE(store.isValidPath(real));
+    ASSERT_EQ(store.queryPathInfo(real)->path, real);
+}
+
+}
@@ -0,0 +1,119 @@
+#include "archive.hh"
+#include "config.hh"
+#include "file-system.hh"
+#include "finally.hh"
+#include "serialise.hh"
+
+#include <gtest/gtest.h>
+
+namespace nix {
+
+static Path makeTestTree()
+{
+    Path root = createTempDir();
+    createDirs(root + "/tree/small");
+    createDirs(root + "/tree/large/nested");
+    for (int i = 0; i < 300; ++i)
+        writeFile(fmt("%s/tree/small/f%03d", root, i), std::string(i * 7, 'a' + i % 26));
+    writeFile(root + "/tree/large/big", std::string(3 * 1024 * 1024, 'x'));
+    writeFile(root + "/tree/large/nested/medium", std::string(200 * 1024, 'y'));
+    writeFile(root + "/tree/large/empty", "");
+    createSymlink("small/f001", root + "/tree/link");
+    return root;
+}
+
+static std::string dumpWithReadAhead(const Path & path, const std::string & threads)
+{
+    globalConfig.set("nar-read-ahead-threads", threads);
+    Finally reset([] { globalConfig.set("nar-read-ahead-threads", "0"); });
+    StringSink sink;
+    sink << dumpPath(path);
+    return std::move(sink.s);
+}
+
+TEST(dumpPath, readAheadProducesIdenticalNar)
+{
+    Path root = makeTestTree();
+    AutoDelete delRoot(root);
+
+    auto expected = dumpWithReadAhead(root + "/tree", "0");
+    ASSERT_EQ(dumpWithReadAhead(root + "/tree", "1"), expected);
+    ASSERT_EQ(dumpWithReadAhead(root + "/tree", "8"), expected);
+}
+
+TEST(dumpPath, readAheadHonoursFilter)
+{
+    Path root = makeTestTree();
+    AutoDelete delRoot(root);
+
+    PathFilter filter = [](const Path & p) { return !p.ends_with("5") && !p.ends_with("/big"); };
+
+    globalConfig.set("nar-read-ahead-threads", "0");
+    StringSink expected;
+    expected << dumpPath(root + "/tree", filter);
+
+    globalConfig.set("nar-read-ahead-threads", "4");
+    Finally reset([] { globalConfig.set("nar-read-ahead-threads", "0"); });
+    StringSink actual;
+    actual << dumpPath(root + "/tree", filter);
+
+    ASSERT_EQ(actual.s, expected.s);
+}
+
+TEST(dumpPath, readAheadRoundTrips)
+{
+    Path root = makeTestTree();
+    AutoDelete delRoot(root);
+
+    auto nar = dumpWithReadAhead(root + "/tree", "4");
+    StringSource source{nar};
+    restorePath(root + "/restored", source);
+
+    ASSERT_EQ(dumpWithReadAhead(root + "/restored", "0"), nar);
+}
+
+TEST(dumpPath, readAheadSurvivesAbandonedDump)
+{
+    Path root = makeTestTree();
+    AutoDelete delRoot(root);
+
+    globalConfig.set("nar-read-ahead-threads", "4");
+    Finally reset([] { globalConfig.set("nar-read-ahead-threads", "0"); });
+
+    auto g = dumpPath(root + "/tree");
+    for (int i = 0; i < 50; ++i)
+        ASSERT_TRUE(g.next());
+    // dropping the generator here must stop the read-ahead workers
+}
+
+TEST(restorePath, parallelRestoreProducesIdenticalTree)
+{
+    Path root = makeTestTree();
+    AutoDelete delRoot(root);
+    chmod((root + "/tree/small/f007").c_str(), 0755);
+
+    auto nar = dumpWithReadAhead(root + "/tree", "0");
+
+    globalConfig.set("nar-restore-threads", "4");
+    Finally reset([] { globalConfig.set("nar-restore-threads", "0"); });
+    StringSource source{nar};
+    restorePath(root + "/restored", source);
+
+    ASSERT_EQ(dumpWithReadAhead(root + "/restored", "0"), nar);
+}
+
+TEST(restorePath, parallelRestoreReportsWriteErrors)
+{
+    Path root = makeTestTree();
+    AutoDelete delRoot(root);
+
+    auto nar = dumpWithReadAhead(root + "/tree/small/f001", "0");
+
+    globalConfig.set("nar-restore-threads", "4");
+    Finally reset([] { globalConfig.set("nar-restore-threads", "0"); });
+    StringSource source{nar};
+    // the file already exists, so the worker's O_EXCL open must fail
+    ASSERT_THROW(restorePath(root + "/tree/small/f002", source), SysError);
+}
+
+}
@@ -1,4 +1,6 @@
 #include "compression.hh"
+#include "file-system.hh"
+#include "strings.hh"
 #include <cstddef>
 #include <gtest/gtest.h>
 
@@ -161,4 +163,79 @@ TEST_P(PerTypeNonNullCompressionTest, truncatedValidInput)
     }
 }
 
+/* ----------------------------------------------------------------------------
+ * seekable zstd
+ * --------------------------------------------------------------------------*/
+
+static std::string makeLines(size_t n)
+{
+    std::string s;
+    for (size_t i = 0; i < n; ++i)
+        s += fmt("line %d of a rather chatty build log\n", i);
+    return s;
+}
+
+TEST(compressSeekable, isValidZstd)
+{
+    auto input = makeLines(10000);
+    ASSERT_EQ(decompress("zstd", compressSeekable(input, 4096)), input);
+    ASSERT_EQ(decompress("zstd", compressSeekable("", 4096)), "");
+}
+
+TEST(SeekableZstdReader, readsRanges)
+{
+    Path tmpDir = createTempDir();
+    AutoDelete delTmpDir(tmpDir);
+
+    auto input = makeLines(10000);
+    writeFile(tmpDir + "/log.zst", compressSeekable(input, 4096));
+
+    auto reader = SeekableZstdReader::open(tmpDir + "/log.zst");
+    ASSERT_TRUE(reader);
+    ASSERT_EQ(reader->size(), input.size());
+    ASSERT_EQ(reader->read(0, input.size()), input);
+    ASSERT_EQ(reader->read(4000, 10000), input.substr(4000, 10000));
+    ASSERT_EQ(reader->read(input.size() - 10, 100), input.substr(input.size() - 10));
+    ASSERT_EQ(reader->read(input.size() + 10, 100), "");
+    ASSERT_EQ(reader->tailLines(3), input.substr(*findLastLines(input, 3)));
+    ASSERT_EQ(reader->tailLines(20000), input);
+}
+
+TEST(SeekableZstdReader, tailLinesAcrossFrames)
+{
+    Path tmpDir = createTempDir();
+    AutoDelete delTmpDir(tmpDir);
+
+    auto input = makeLines(10000);
+    writeFile(tmpDir + "/log.zst", compressSeekable(input, 4096));
+    auto reader = SeekableZstdReader::open(tmpDir + "/log.zst");
+    ASSERT_TRUE(reader);
+    for (size_t n : {0, 1, 150, 5000, 9999})
+        ASSERT_EQ(reader->tailLines(n), input.substr(*findLastLines(input, n)));
+
+    /* Frames that each hold exactly one line. */
+    std::string lines;
+    for (size_t i = 0; i < 100; ++i)
+        lines += fmt("line %03d\n", i);
+    writeFile(tmpDir + "/lines.zst", compressSeekable(lines, 9));
+    reader = SeekableZstdReader::open(tmpDir + "/lines.zst");
+    ASSERT_TRUE(reader);
+    for (size_t n : {1, 2, 99})
+        ASSERT_EQ(reader->tailLines(n), lines.substr(*findLastLines(lines, n)));
+    ASSERT_EQ(reader->tailLines(100), lines);
+}
+
+TEST(SeekableZstdReader, rejectsFilesWithoutSeekTable)
+{
+    Path tmpDir = createTempDir();
+    AutoDelete delTmpDir(tmpDir);
+
+    writeFile(tmpDir + "/plain.zst", compress("zstd", makeLines(100)));
+    ASSERT_FALSE(SeekableZstdReader::open(tmpDir + "/plain.zst"));
+
+    auto seekable = compressSeekable(makeLines(100), 512);
+    writeFile(tmpDir + "/truncated.zst", seekable.substr(0, seekable.size() - 1));
+    ASSERT_FALSE(SeekableZstdReader::open(tmpDir + "/truncated.zst"));
+}
+
 }
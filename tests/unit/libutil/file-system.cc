@@ -0,0 +1,77 @@
+#include "file-system.hh"
+#include "strings.hh"
+
+#include <gtest/gtest.h>
+
+namespace nix {
+
+/**
+ * Create a tree that is large enough for `deletePath()` to delete part
+ * of it on a thread pool. Returns the number of bytes in its files.
+ */
+static uint64_t makeLargeTree(const Path & root)
+{
+    uint64_t size = 0;
+    for (int d = 0; d < 40; ++d) {
+        auto dir = fmt("%s/d%02d/sub", root, d);
+        createDirs(dir);
+        for (int f = 0; f < 150; ++f) {
+            writeFile(fmt("%s/f%03d", dir, f), std::string(f, 'x'));
+            size += f;
+        }
+    }
+    return size;
+}
+
+TEST(deletePath, nonExistentPath)
+{
+    Path root = createTempDir();
+    AutoDelete delRoot(root);
+
+    uint64_t bytesFreed = 1;
+    deletePath(root + "/missing", bytesFreed);
+    ASSERT_EQ(bytesFreed, 0);
+}
+
+TEST(deletePath, countsFreedBytes)
+{
+    Path root = createTempDir();
+    AutoDelete delRoot(root);
+
+    auto size = makeLargeTree(root + "/tree");
+    writeFile(root + "/tree/top", "hello");
+    createSymlink("top", root + "/tree/link");
+
+    uint64_t bytesFreed;
+    deletePath(root + "/tree", bytesFreed);
+    ASSERT_FALSE(pathExists(root + "/tree"));
+    ASSERT_EQ(bytesFreed, size + 5 + 3);
+}
+
+TEST(deletePath, makesDirectoriesAccessible)
+{
+    Path root = createTempDir();
+    AutoDelete delRoot(root);
+
+    makeLargeTree(root + "/tree");
+    for (int d = 0; d < 40; d += 3)
+        chmod(fmt("%s/tree/d%02d/sub", root, d).c_str(), 0500);
+    chmod((root + "/tree/d00").c_str(), 0);
+
+    deletePath(root + "/tree");
+    ASSERT_FALSE(pathExists(root + "/tree"));
+}
+
+TEST(deletePathAsync, deletesInBackground)
+{
+    Path root = createTempDir();
+    AutoDelete delRoot(root);
+
+    auto size = makeLargeTree(root + "/tree");
+
+    auto bytesFreed = deletePathAsync(root + "/tree");
+    ASSERT_EQ(bytesFreed.get(), size);
+    ASSERT_FALSE(pathExists(root + "/tree"));
+}
+
+}
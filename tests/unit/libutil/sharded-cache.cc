@@ -0,0 +1,127 @@
+#include "sharded-cache.hh"
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+namespace nix {
+
+    /**
+     * Puts all keys in the same shard, so that the eviction order can
+     * be tested.
+     */
+    struct SameShard
+    {
+        size_t operator()(int) const { return 0; }
+    };
+
+    /* ----------------------------------------------------------------------------
+     * upsert / get
+     * --------------------------------------------------------------------------*/
+
+    TEST(ShardedCache, getFromEmptyCache) {
+        ShardedCache<std::string, std::string> c(16);
+        ASSERT_EQ(c.get("x"), std::nullopt);
+        ASSERT_EQ(c.size(), 0);
+    }
+
+    TEST(ShardedCache, getExistingValue) {
+        ShardedCache<std::string, std::string> c(16);
+        c.upsert("foo", "bar");
+        ASSERT_EQ(c.get("foo"), "bar");
+        ASSERT_EQ(c.get("bar"), std::nullopt);
+        ASSERT_EQ(c.size(), 1);
+    }
+
+    TEST(ShardedCache, upsertOnZeroCapacityCache) {
+        ShardedCache<std::string, std::string> c(0);
+        c.upsert("foo", "bar");
+        ASSERT_EQ(c.get("foo"), std::nullopt);
+        ASSERT_EQ(c.size(), 0);
+    }
+
+    TEST(ShardedCache, updateExistingValue) {
+        ShardedCache<std::string, std::string> c(16);
+        c.upsert("foo", "bar");
+        c.get("foo");
+        c.upsert("foo", "baz");
+        ASSERT_EQ(c.get("foo"), "baz");
+        ASSERT_EQ(c.size(), 1);
+    }
+
+    /* ----------------------------------------------------------------------------
+     * eviction
+     * --------------------------------------------------------------------------*/
+
+    TEST(ShardedCache, evictsOldestUnusedEntry) {
+        // One shard of 4 entries.
+        ShardedCache<int, int, SameShard> c(64);
+        for (int i = 0; i < 5; i++)
+            c.upsert(i, i);
+        ASSERT_EQ(c.size(), 4);
+        ASSERT_EQ(c.get(0), std::nullopt);
+        ASSERT_EQ(c.get(4), 4);
+        ASSERT_EQ(c.getStats().evictions.load(), 1);
+    }
+
+    TEST(ShardedCache, scanDoesNotEvictReusedEntries) {
+        // One shard of 10 entries, 8 of them protected.
+        ShardedCache<int, int, SameShard> c(160);
+        for (int i = 0; i < 5; i++) {
+            c.upsert(i, i);
+            c.get(i);
+        }
+        for (int i = 100; i < 1000; i++)
+            c.upsert(i, i);
+        for (int i = 0; i < 5; i++)
+            ASSERT_EQ(c.get(i), i);
+        ASSERT_EQ(c.size(), 10);
+    }
+
+    /* ----------------------------------------------------------------------------
+     * erase / clear
+     * --------------------------------------------------------------------------*/
+
+    TEST(ShardedCache, eraseEntries) {
+        ShardedCache<std::string, std::string> c(16);
+        c.upsert("foo", "bar");
+        c.upsert("baz", "qux");
+        c.get("baz");
+        ASSERT_EQ(c.erase("foo"), true);
+        ASSERT_EQ(c.erase("foo"), false);
+        ASSERT_EQ(c.erase("baz"), true);
+        ASSERT_EQ(c.size(), 0);
+    }
+
+    TEST(ShardedCache, clearNonEmptyCache) {
+        ShardedCache<std::string, std::string> c(16);
+        c.upsert("foo", "bar");
+        c.upsert("baz", "qux");
+        c.clear();
+        ASSERT_EQ(c.size(), 0);
+        ASSERT_EQ(c.get("foo"), std::nullopt);
+    }
+
+    /* ----------------------------------------------------------------------------
+     * concurrency
+     * --------------------------------------------------------------------------*/
+
+    TEST(ShardedCache, concurrentLookups) {
+        ShardedCache<int, int> c(1024);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 8; t++)
+            threads.emplace_back([&, t]() {
+                for (int i = 0; i < 10000; i++) {
+                    int key = (i * 7 + t) % 2048;
+                    if (auto v = c.get(key))
+                        ASSERT_EQ(*v, key);
+                    else
+                        c.upsert(key, key);
+                }
+            });
+        for (auto & thread : threads)
+            thread.join();
+        ASSERT_EQ(c.getStats().hits.load() + c.getStats().misses.load(), 80000);
+        ASSERT_LE(c.size(), 1024);
+    }
+}
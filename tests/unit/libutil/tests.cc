@@ -319,6 +319,21 @@ namespace nix {
         }
     }
 
+    /* ----------------------------------------------------------------------------
+     * findLastLines
+     * --------------------------------------------------------------------------*/
+
+    TEST(findLastLines, all) {
+        ASSERT_EQ(findLastLines("foo\nbar\nxyzzy\n", 1), 8);
+        ASSERT_EQ(findLastLines("foo\nbar\nxyzzy", 1), 8);
+        ASSERT_EQ(findLastLines("foo\nbar\nxyzzy\n", 2), 4);
+        ASSERT_EQ(findLastLines("foo\nbar\nxyzzy\n", 0), 14);
+        ASSERT_EQ(findLastLines("\nfoo\nbar\n", 2), 1);
+        ASSERT_EQ(findLastLines("foo\nbar\n", 2), std::nullopt);
+        ASSERT_EQ(findLastLines("foo", 1), std::nullopt);
+        ASSERT_EQ(findLastLines("", 1), std::nullopt);
+    }
+
     /* ----------------------------------------------------------------------------
      * toLower
      * --------------------------------------------------------------------------*/